@@ -0,0 +1,34 @@
+#include "Bench.hpp"
+#include <memory>
+
+// Allocates a million short lived closures and strings
+static const int ITERATIONS = 1000000;
+
+int main() {
+    // Baseline without a collector: the same number of objects through new and delete
+    double raw = timeMs([&] {
+        for (int i = 0; i < ITERATIONS; i++) {
+            std::unique_ptr<std::string> piece(new std::string("item"));
+            std::unique_ptr<std::vector<int>> scope(new std::vector<int>(4));
+        }
+    });
+    report("raw new/delete", raw);
+
+    const std::string program =
+        "var i = 0;\n"
+        "while (i < " + std::to_string(ITERATIONS) + ") {\n"
+        "  fun f() { return i; }\n"
+        "  var s = \"item\" + \"!\";\n"
+        "  i = i + 1;\n"
+        "}\n";
+
+    // Every allocation is accounted by kind either way, the limit only adds a comparison
+    double unlimited = timeMs([&] { runSource(program); });
+    report("Lox allocation, no heap limit", unlimited);
+
+    HeapConfig limited;
+    limited.maxHeap = 64 * 1024 * 1024;
+    double capped = timeMs([&] { runSource(program, limited); });
+    report("Lox allocation, 64 MB heap limit", capped);
+    return 0;
+}
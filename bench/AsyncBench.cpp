@@ -0,0 +1,51 @@
+#include "Bench.hpp"
+#include <cstdio>
+#include <fstream>
+
+// A chain of async functions that all sleep at once, then each adds one to the result of the previous
+static std::string chain(int tasks) {
+    return R"(
+fun first() { sleep(10); return 1; }
+var last = async(first);
+for (var i = 1; i < )" + std::to_string(tasks) + R"(; i = i + 1) {
+    var previous = last;
+    fun step() { sleep(10); return await(previous) + 1; }
+    last = async(step);
+}
+print await(last);
+)";
+}
+
+// Peak resident memory of the process in KB, including the fiber stacks that malloc does not see
+static long peakKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::stol(line.substr(6));
+    }
+    return 0;
+}
+
+int main() {
+    // Counts grow so that each run's peak is its own
+    std::cout << "  tasks        ms  ideal ms   peak KB  bytes/task" << std::endl;
+    for (int tasks : {1000, 10000, 20000}) {
+        std::string source = chain(tasks); // The tree points into it
+        TokenBuffer tokens = Scanner(source).scanTokens();
+        std::vector<std::shared_ptr<Stmt>> statements = Parser(tokens).parse();
+        std::string output;
+        long before = peakKb();
+        double ms = timeMs([&] {
+            Interpreter interpreter;
+            interpreter.setOutput([&](std::string_view text) { output.append(text); });
+            interpreter.interpret(statements);
+        });
+        long grown = peakKb() - before;
+        if (output != std::to_string(tasks)) {
+            std::cout << "wrong result with " << tasks << " tasks: " << output << std::endl;
+            return 1;
+        }
+        std::printf("%7d %9.1f %9.1f %9ld %11ld\n", tasks, ms, 10.0, grown, grown * 1024 / tasks);
+    }
+    return 0;
+}
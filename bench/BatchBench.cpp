@@ -0,0 +1,72 @@
+#include "Batch.hpp"
+#include "Bench.hpp"
+#include <algorithm>
+#include <cstdio>
+
+static const std::string RULE = "price * qty > limit and region == \"EU\"";
+static const std::vector<std::string> INPUTS = {"price", "qty", "limit", "region"};
+
+// Rows of the batch, half of which pass
+struct Rows {
+    std::vector<double> price, qty, limit;
+    std::vector<std::string> region;
+
+    explicit Rows(size_t count) : price(count), qty(count), limit(count, 150.0), region(count) {
+        for (size_t i = 0; i < count; i++) {
+            price[i] = static_cast<double>(i % 100);
+            qty[i] = static_cast<double>(i % 7);
+            region[i] = i % 3 == 0 ? "US" : "EU";
+        }
+    }
+
+    bool expected(size_t i) const {
+        return price[i] * qty[i] > limit[i] && region[i] == "EU";
+    }
+};
+
+// One evaluation of the compiled rule per row, as before batches
+static double scalar(const std::shared_ptr<const Rule>& rule, const Rows& rows, size_t count) {
+    Evaluator evaluator(rule);
+    size_t wrong = 0;
+    double ms = timeMs([&] {
+        for (size_t i = 0; i < count; i++) {
+            if (evaluator.test({rows.price[i], rows.qty[i], rows.limit[i], rows.region[i]}) != rows.expected(i)) wrong++;
+        }
+    });
+    double rate = count / ms * 1000;
+    std::printf("evaluator, one row at a time: %12.0f rows/s%s\n", rate, wrong == 0 ? "" : "  (wrong results)");
+    return rate;
+}
+
+// The whole batch at once with the given kernels, best of a few runs
+static double batch(const std::shared_ptr<const Rule>& rule, const Rows& rows, size_t count, const BatchKernels& kernels) {
+    BatchEvaluator evaluator(rule);
+    evaluator.setKernels(kernels);
+    std::vector<Column> columns = {rows.price, rows.qty, rows.limit, rows.region};
+    size_t wrong = 0;
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        BatchResult result;
+        double ms = timeMs([&] { result = evaluator.evaluate(columns, count); });
+        best = run == 0 ? ms : std::min(best, ms);
+        wrong = 0;
+        for (size_t i = 0; i < count; i++) {
+            if ((result.kinds[i] == BatchResult::Kind::BOOLEAN && result.booleans[i]) != rows.expected(i)) wrong++;
+        }
+    }
+    double rate = count / best * 1000;
+    std::printf("batch, %-6s kernels:        %12.0f rows/s%s\n", kernels.name, rate, wrong == 0 ? "" : "  (wrong results)");
+    return rate;
+}
+
+int main() {
+    size_t count = 1000000;
+    Rows rows(count);
+    LoxVM vm;
+    std::shared_ptr<const Rule> rule = vm.compileRule(RULE, INPUTS);
+    double before = scalar(rule, rows, count);
+    double after = 0;
+    for (const BatchKernels* kernels : BatchKernels::available()) after = batch(rule, rows, count, *kernels);
+    std::printf("speedup over one row at a time: %.0fx\n", after / before);
+    return 0;
+}
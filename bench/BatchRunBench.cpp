@@ -0,0 +1,73 @@
+#include "BatchRunner.hpp"
+#include "Bench.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <thread>
+
+extern char** environ;
+
+// Short scripts like the nightly jobs, each printing a few lines
+static std::vector<std::string> writeScripts(const std::filesystem::path& directory, size_t count) {
+    std::filesystem::create_directories(directory);
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < count; i++) {
+        std::filesystem::path path = directory / ("job" + std::to_string(i) + ".lox");
+        std::ofstream(path) << "var total = 0;\nfor (var i = 0; i < " << 50 + i % 50 << "; i = i + 1) total = total + i;\n"
+                            << "print \"job " << i << "\";\nprint total;\n";
+        paths.push_back(path.string());
+    }
+    return paths;
+}
+
+// One cpplox process per script, one after another, as the nightly jobs ran them
+static double processes(const std::string& cpplox, const std::vector<std::string>& paths) {
+    size_t failed = 0;
+    double ms = timeMs([&] {
+        for (const std::string& path : paths) {
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+            std::vector<char*> argv = {const_cast<char*>(cpplox.c_str()), const_cast<char*>("--no-cache"), const_cast<char*>(path.c_str()), nullptr};
+            pid_t pid;
+            int status = 0;
+            if (posix_spawn(&pid, cpplox.c_str(), &actions, nullptr, argv.data(), environ) != 0 || waitpid(pid, &status, 0) < 0 || status != 0) failed++;
+            posix_spawn_file_actions_destroy(&actions);
+        }
+    });
+    std::printf("one process per script:  %8.1f ms, %8.0f scripts/s, %6.3f ms per script%s\n", ms, paths.size() / ms * 1000, ms / paths.size(),
+        failed == 0 ? "" : "  (failures)");
+    return ms;
+}
+
+// Every script in one process, on the given number of threads
+static double batch(const std::vector<std::string>& paths, unsigned jobs) {
+    BatchRunner runner(jobs);
+    std::vector<ScriptResult> results;
+    double ms = timeMs([&] { results = runner.run(paths); });
+    bool ok = std::all_of(results.begin(), results.end(), [](const ScriptResult& result) { return result.status == 0 && !result.output.empty(); });
+    std::printf("batch, %2u jobs:           %8.1f ms, %8.0f scripts/s, %6.3f ms per script%s\n", jobs, ms, paths.size() / ms * 1000,
+        ms / paths.size(), ok ? "" : "  (failures)");
+    return ms;
+}
+
+int main(int argc, char* argv[]) {
+    // Job counts doubling up to one per core, or to the count given
+    unsigned cores = argc > 1 ? std::stoi(argv[1]) : std::thread::hardware_concurrency();
+    cores = std::max(1u, cores);
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "cpplox-batch-bench";
+    std::vector<std::string> paths = writeScripts(directory, 500);
+    std::string cpplox = (std::filesystem::path(argv[0]).parent_path() / "cpplox").string();
+    double before = std::filesystem::exists(cpplox) ? processes(cpplox, paths) : 0;
+    double after = batch(paths, 1);
+    if (before > 0) std::printf("speedup on one thread: %.0fx\n", before / after);
+    for (unsigned jobs = 2; jobs < cores; jobs *= 2) batch(paths, jobs);
+    if (cores > 1) batch(paths, cores);
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "Scanner.hpp"
+#include "Parser.hpp"
+#include "Interpreter.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Runs a callable and returns the elapsed wall time in milliseconds
+template <typename Fn>
+double timeMs(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Scans, parses and interprets a Lox program with a fresh interpreter
+inline void runSource(const std::string& source, const HeapConfig& config = HeapConfig()) {
+    Scanner scanner(source);
+    TokenBuffer tokens = scanner.scanTokens();
+    Parser parser(tokens);
+    std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+    Interpreter interpreter(config);
+    interpreter.interpret(statements);
+}
+
+// Prints one benchmark result line
+inline void report(const std::string& name, double ms) {
+    std::cout << name << ": " << ms << " ms" << std::endl;
+}
+
+#endif // BENCH_HPP
@@ -0,0 +1,66 @@
+#include "Bench.hpp"
+#include "ScriptCache.hpp"
+#include <filesystem>
+
+// A library-like script of about 8 MB, mostly functions with loops and calls
+static const size_t SOURCE_BYTES = 8 * 1024 * 1024;
+
+static std::string generate() {
+    std::string source;
+    source.reserve(SOURCE_BYTES + 1024);
+    for (size_t row = 0; source.size() < SOURCE_BYTES; row++) {
+        std::string id = std::to_string(row);
+        source += "fun helper" + id + "(list, limit) {\n";
+        source += "    var total = 0;\n";
+        source += "    for (var i = 0; i < limit; i = i + 1) {\n";
+        source += "        if (i > 10 and total != nil) total = total + list(i) * 2; else total = total - 1;\n";
+        source += "    }\n";
+        source += "    return \"result \" + total;\n";
+        source += "}\n";
+    }
+    return source;
+}
+
+int main() {
+    std::string source = generate();
+    std::string directory = (std::filesystem::temp_directory_path() / "cpplox-cache-bench").string();
+    std::filesystem::remove_all(directory);
+    ScriptCache cache(directory);
+
+    // Cold start: scan and parse, then save the image for the next run
+    double best = 0;
+    std::vector<std::shared_ptr<Stmt>> statements;
+    for (int run = 0; run < 5; run++) {
+        statements.clear();
+        double ms = timeMs([&] {
+            TokenBuffer tokens = Scanner(source).scanTokens();
+            statements = Parser(tokens).parse();
+        });
+        if (run == 0 || ms < best) best = ms;
+    }
+    report("scan and parse", best);
+    report("save image", timeMs([&] { cache.store(source, statements); }));
+    statements.clear();
+
+    // Warm start: hash the text, map the image and decode the tree
+    double warm = 0;
+    for (int run = 0; run < 5; run++) {
+        statements.clear();
+        std::unique_ptr<Source> image;
+        double ms = timeMs([&] { image = cache.load(source, statements); });
+        if (!image) {
+            std::cout << "cache miss" << std::endl;
+            return 1;
+        }
+        if (run == 0 || ms < warm) warm = ms;
+    }
+    report("load image", warm);
+    report("of which hashing the text", timeMs([&] { ScriptCache::hash(source); }));
+
+    size_t imageBytes = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) imageBytes += entry.file_size();
+    std::cout << "source: " << source.size() << " bytes, image: " << imageBytes << " bytes" << std::endl;
+    std::cout << "speedup: " << best / warm << "x" << std::endl;
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "Bench.hpp"
+#include "Channels.hpp"
+#include <cstdio>
+#include <thread>
+
+// Messages through the ring alone, between threads of this program, with nothing to copy
+static void raw(int producers, int consumers, size_t capacity, size_t messages) {
+    Channel channel(capacity);
+    std::vector<std::thread> threads;
+    double sum = 0;
+    double ms = timeMs([&] {
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&] {
+                for (size_t i = 0; i < messages / producers; i++) {
+                    Channel::Message message;
+                    message.value = Value::numberValue(1);
+                    channel.send(std::move(message));
+                }
+            });
+        }
+        std::vector<double> sums(consumers);
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&, c] {
+                for (size_t i = 0; i < messages / consumers; i++) sums[c] += channel.receive().value.number;
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        for (double partial : sums) sum += partial;
+    });
+    std::printf("ring %dP/%dC capacity %5zu: %10.0f messages/s%s\n", producers, consumers, capacity,
+        messages / ms * 1000, sum == static_cast<double>(messages) ? "" : "  (lost messages)");
+}
+
+// A spawned producer sending values to the program, which receives them, as Lox code
+static void script(const std::string& name, const std::string& value, size_t capacity, size_t messages) {
+    std::string source = R"(
+var ch = channel()" + std::to_string(capacity) + R"();
+fun produce() {
+    for (var i = 0; i < )" + std::to_string(messages) + R"(; i = i + 1) send(ch, )" + value + R"();
+}
+spawn(produce);
+var received = 0;
+for (var i = 0; i < )" + std::to_string(messages) + R"(; i = i + 1) { recv(ch); received = received + 1; }
+)";
+    // The loops alone, without the channel, to tell its cost from the interpreter's
+    std::string loops = R"(
+for (var i = 0; i < )" + std::to_string(messages) + R"(; i = i + 1) )" + value + R"(;
+var received = 0;
+for (var i = 0; i < )" + std::to_string(messages) + R"(; i = i + 1) { received = received + 1; }
+)";
+    double loopMs = timeMs([&] { runSource(loops); });
+    double ms = timeMs([&] { runSource(source); });
+    std::printf("lox %-8s capacity %5zu: %10.0f messages/s, %6.2f us per message over the bare loops\n", name.c_str(), capacity,
+        messages / ms * 1000, (ms - loopMs) * 1000 / messages);
+}
+
+int main() {
+    raw(1, 1, 1024, 2000000);
+    raw(1, 1, 16, 2000000);
+    raw(2, 2, 1024, 2000000);
+    raw(4, 4, 1024, 2000000);
+    script("numbers", "i", 1024, 100000);
+    script("numbers", "i", 16, 100000);
+    script("strings", "\"a message of about forty characters long\"", 1024, 100000);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "Bench.hpp"
+#include <unordered_map>
+
+// Identifier heavy code repeated until the source is about 8 MB
+static const size_t SOURCE_BYTES = 8 * 1024 * 1024;
+static const std::string SNIPPET =
+    "var alpha = beta and gamma or delta;\n"
+    "while (counter < limit) { print this_value; counter = counter + step; }\n"
+    "if (ready and not_done) return result; else return false_alarm;\n"
+    "fun classify(input, fallback) { var nil_checked = input or fallback; return nil_checked; }\n";
+
+// The recognizer used before the generated table: a string copy and two map lookups
+static const std::unordered_map<std::string, TokenType> LEGACY_KEYWORDS = {
+    {"and", TokenType::AND}, {"class", TokenType::CLASS}, {"else", TokenType::ELSE},
+    {"false", TokenType::FALSE}, {"for", TokenType::FOR}, {"fun", TokenType::FUN},
+    {"if", TokenType::IF}, {"nil", TokenType::NIL}, {"or", TokenType::OR},
+    {"print", TokenType::PRINT}, {"return", TokenType::RETURN}, {"super", TokenType::SUPER},
+    {"this", TokenType::THIS}, {"true", TokenType::TRUE}, {"var", TokenType::VAR},
+    {"while", TokenType::WHILE}
+};
+
+static bool legacyIsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool legacyIsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int main() {
+    std::string source;
+    while (source.size() < SOURCE_BYTES) source += SNIPPET;
+
+    // Every word of the source, as the scanner would hand them to the recognizer
+    std::vector<std::string_view> words;
+    std::string_view text(source);
+    for (size_t i = 0; i < text.size();) {
+        if (!isCharClass(text[i], CHAR_ALPHA)) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < text.size() && isCharClass(text[i], CHAR_ALPHA | CHAR_DIGIT)) i++;
+        words.push_back(text.substr(start, i - start));
+    }
+    std::cout << words.size() << " words" << std::endl;
+
+    size_t legacyKeywords = 0;
+    report("keywords, unordered_map", timeMs([&] {
+        for (std::string_view word : words) {
+            std::string copy(word);
+            TokenType type = LEGACY_KEYWORDS.find(copy) != LEGACY_KEYWORDS.end() ? LEGACY_KEYWORDS.at(copy) : TokenType::IDENTIFIER;
+            if (type != TokenType::IDENTIFIER) legacyKeywords++;
+        }
+    }));
+
+    size_t tableKeywords = 0;
+    report("keywords, perfect hash", timeMs([&] {
+        for (std::string_view word : words) {
+            if (keywordType(word) != TokenType::IDENTIFIER) tableKeywords++;
+        }
+    }));
+
+    size_t legacyClasses = 0;
+    report("character classes, comparisons", timeMs([&] {
+        for (int run = 0; run < 10; run++) {
+            for (char c : source) legacyClasses += legacyIsAlpha(c) || legacyIsDigit(c);
+        }
+    }));
+
+    size_t tableClasses = 0;
+    report("character classes, table", timeMs([&] {
+        for (int run = 0; run < 10; run++) {
+            for (char c : source) tableClasses += isCharClass(c, CHAR_ALPHA | CHAR_DIGIT);
+        }
+    }));
+
+    double ms = timeMs([&] {
+        Scanner scanner(source);
+        scanner.scanTokens();
+    });
+    report("scan identifier heavy source", ms);
+    std::cout << "throughput: " << source.size() / (1024.0 * 1024.0) / (ms / 1000.0) << " MB/s" << std::endl;
+
+    // Both implementations must agree
+    if (legacyKeywords != tableKeywords || legacyClasses != tableClasses) {
+        std::cerr << "mismatch between implementations" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "Bench.hpp"
+#include <malloc.h>
+
+// A library-like script of about 8 MB, of which only one function in a hundred is called
+static const size_t SOURCE_BYTES = 8 * 1024 * 1024;
+static const size_t CALL_EVERY = 100;
+
+static std::string generate() {
+    std::string source;
+    source.reserve(SOURCE_BYTES + 1024);
+    size_t row = 0;
+    for (; source.size() < SOURCE_BYTES; row++) {
+        std::string id = std::to_string(row);
+        source += "fun helper" + id + "(limit) {\n";
+        source += "    var total = 0;\n";
+        source += "    for (var i = 0; i < limit; i = i + 1) {\n";
+        source += "        if (i > 10 and total != nil) total = total + i * 2; else total = total - 1;\n";
+        source += "    }\n";
+        source += "    return total;\n";
+        source += "}\n";
+    }
+    source += "var sum = 0;\n";
+    for (size_t called = 0; called < row; called += CALL_EVERY) {
+        source += "sum = sum + helper" + std::to_string(called) + "(20);\n";
+    }
+    return source;
+}
+
+// Bytes allocated with malloc and not freed yet
+static size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+int main() {
+    std::string source = generate();
+    std::cout << "source: " << source.size() << " bytes, calling one function in " << CALL_EVERY << std::endl;
+
+    for (bool lazy : {false, true}) {
+        Parser::setLazyFunctions(lazy);
+        std::cout << (lazy ? "lazy bodies" : "eager bodies") << std::endl;
+
+        // Startup: scan and parse, keeping the tree and dropping the tokens
+        double best = 0;
+        size_t treeBytes = 0;
+        for (int run = 0; run < 3; run++) {
+            std::vector<std::shared_ptr<Stmt>> statements;
+            size_t before = heapInUse();
+            double ms = timeMs([&] {
+                TokenBuffer tokens = Scanner(source).scanTokens();
+                statements = Parser(tokens).parse();
+            });
+            treeBytes = heapInUse() - before;
+            if (run == 0 || ms < best) best = ms;
+        }
+        report("  scan and parse", best);
+        std::cout << "  syntax tree: " << treeBytes / 1024 << " KB" << std::endl;
+
+        // The called bodies are parsed as the program runs
+        std::vector<std::shared_ptr<Stmt>> statements;
+        {
+            TokenBuffer tokens = Scanner(source).scanTokens();
+            statements = Parser(tokens).parse();
+        }
+        Interpreter interpreter;
+        report("  run", timeMs([&] { interpreter.interpret(statements); }));
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "Bench.hpp"
+#include <algorithm>
+#include <cstdio>
+
+// A loop heavy function summed over a range, as a plain loop and with parallelReduce
+static const std::string WORK = R"(
+fun work(i) {
+    var x = i;
+    for (var k = 0; k < 2000; k = k + 1) x = (x * 7 + k) - (x * 6);
+    return x - i + 1 / (i + 1);
+}
+fun add(a, b) { return a + b; }
+)";
+static const std::string SERIAL = WORK + R"(
+var total = 0;
+for (var i = 0; i < 4000; i = i + 1) total = add(total, work(i));
+print total;
+)";
+static const std::string PARALLEL = WORK + "print parallelReduce(0, 4000, work, add, 0);";
+
+// Cheap calls, where splitting the range is mostly overhead
+static const std::string LIGHT = R"(
+fun square(i) { return i * i; }
+fun add(a, b) { return a + b; }
+)";
+static const std::string LIGHT_SERIAL = LIGHT + R"(
+var total = 0;
+for (var i = 0; i < 200000; i = i + 1) total = add(total, square(i));
+print total;
+)";
+static const std::string LIGHT_PARALLEL = LIGHT + "print parallelReduce(0, 200000, square, add, 0);";
+
+// Runs a script and returns what it printed, one value per line
+static std::string run(const std::string& source) {
+    TokenBuffer tokens = Scanner(source).scanTokens();
+    std::vector<std::shared_ptr<Stmt>> statements = Parser(tokens).parse();
+    std::string output;
+    Interpreter interpreter;
+    interpreter.setOutput([&](std::string_view text) { output.append(text).append("\n"); });
+    interpreter.interpret(statements);
+    return output;
+}
+
+// Times a parallel script against its serial loop with a doubling number of workers, checking every run gives one result
+static bool measure(const std::string& name, const std::string& serial, const std::string& parallel,
+                    const std::vector<unsigned>& counts) {
+    std::string loop;
+    double serialMs = timeMs([&] { loop = run(serial); });
+    std::cout << name << " serial: " << serialMs << " ms, " << loop;
+    std::cout << "threads        ms  speedup" << std::endl;
+    std::string expected;
+    for (unsigned threads : counts) {
+        TaskPool::configure(threads);
+        double best = 0;
+        for (int attempt = 0; attempt < 3; attempt++) {
+            std::string output;
+            double ms = timeMs([&] { output = run(parallel); });
+            if (expected.empty()) expected = output;
+            if (output != expected) {
+                std::cout << "result changed with " << threads << " threads: " << output;
+                return false;
+            }
+            if (attempt == 0 || ms < best) best = ms;
+        }
+        double speedup = serialMs / best;
+        std::printf("%7u %9.1f %7.2fx  %s\n", threads, best, speedup,
+            std::string(static_cast<size_t>(speedup * 8 + 0.5), '#').c_str());
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // Worker counts doubling up to one per core, or to the count given
+    unsigned cores = argc > 1 ? std::stoi(argv[1]) : std::thread::hardware_concurrency();
+    cores = std::max(1u, cores);
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+    counts.push_back(cores);
+
+    bool same = measure("work over 4000", SERIAL, PARALLEL, counts)
+        && measure("squares over 200000", LIGHT_SERIAL, LIGHT_PARALLEL, counts);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "Bench.hpp"
+#include "ParallelScanner.hpp"
+#include <algorithm>
+#include <cstdio>
+
+// A generated data script of about 256 MB, with strings and comments spanning lines
+static const size_t SOURCE_BYTES = 256 * 1024 * 1024;
+
+static std::string generate() {
+    std::string source;
+    source.reserve(SOURCE_BYTES + 1024);
+    for (size_t row = 0; source.size() < SOURCE_BYTES; row++) {
+        std::string id = std::to_string(row);
+        source += "var record_" + id + " = \"name " + id + ", tags alpha beta gamma\n";
+        source += "    description spanning a second line of the literal\";\n";
+        source += "var weight_" + id + " = " + id + ".25 * 3 + 17; // scaled weight\n";
+        if (row % 8 == 0) source += "/* section " + id + "\n   generated from the schema, do not edit */\n";
+    }
+    return source;
+}
+
+// Checks that two buffers hold the same tokens, values and lines
+static bool sameTokens(const TokenBuffer& a, const TokenBuffer& b) {
+    if (a.size() != b.size() || a.newlineCount() != b.newlineCount()) return false;
+    for (uint32_t i = 0; i < a.size(); i++) {
+        if (a.type(i) != b.type(i) || a.offset(i) != b.offset(i) || a.lexeme(i).size() != b.lexeme(i).size()) return false;
+        if (a.line(i) != b.line(i)) return false;
+        if (a.type(i) == TokenType::NUMBER && a.number(i) != b.number(i)) return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string source = generate();
+    double megabytes = source.size() / (1024.0 * 1024.0);
+    TokenBuffer serial = Scanner(source).scanTokens();
+    double serialMs = timeMs([&] { Scanner(source).scanTokens(); });
+    std::cout << "serial: " << serialMs << " ms, " << megabytes / (serialMs / 1000.0) << " MB/s" << std::endl;
+
+    // Thread counts doubling up to one per core, or to the count given
+    unsigned cores = argc > 1 ? std::stoi(argv[1]) : std::thread::hardware_concurrency();
+    cores = std::max(1u, cores);
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+    counts.push_back(cores);
+
+    std::cout << "threads        ms      MB/s  speedup" << std::endl;
+    for (unsigned threads : counts) {
+        ThreadPool pool(threads);
+        TokenBuffer tokens("");
+        double best = 0;
+        for (int run = 0; run < 3; run++) {
+            double ms = timeMs([&] { tokens = ParallelScanner(source, pool).scanTokens(); });
+            if (run == 0 || ms < best) best = ms;
+        }
+        if (!sameTokens(serial, tokens)) {
+            std::cout << "mismatch with " << threads << " threads" << std::endl;
+            return 1;
+        }
+        double speedup = serialMs / best;
+        std::printf("%7u %9.1f %9.1f %7.2fx  %s\n", threads, best, megabytes / (best / 1000.0), speedup,
+            std::string(static_cast<size_t>(speedup * 8 + 0.5), '#').c_str());
+    }
+    return 0;
+}
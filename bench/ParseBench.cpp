@@ -0,0 +1,66 @@
+#include "Bench.hpp"
+#include "ParallelParser.hpp"
+#include <algorithm>
+#include <cstdio>
+
+// An expression heavy program of about 32 MB
+static const size_t SOURCE_BYTES = 32 * 1024 * 1024;
+
+static std::string generate() {
+    std::string source;
+    source.reserve(SOURCE_BYTES + 1024);
+    for (size_t row = 0; source.size() < SOURCE_BYTES; row++) {
+        std::string id = std::to_string(row % 100);
+        source += "var a" + id + " = (b" + id + " + 2) * c - d / (e - 1.5) + f(g, h * 3, -i);\n";
+        source += "if (a" + id + " >= 10 and !(b <= 2 or c == d) and e != nil) x = y = z + 1;\n";
+        source += "print f(1)(2) + \"text\" + (true or false) + -(-k) * (m - n) / o;\n";
+    }
+    return source;
+}
+
+int main(int argc, char* argv[]) {
+    std::string source = generate();
+    TokenBuffer tokens = Scanner(source).scanTokens();
+
+    // Parsing and freeing the tree are timed apart, the tree is freed between runs
+    double bestParse = 0;
+    double bestFree = 0;
+    for (int run = 0; run < 5; run++) {
+        std::vector<std::shared_ptr<Stmt>> statements;
+        double parseMs = timeMs([&] {
+            Parser parser(tokens);
+            statements = parser.parse();
+        });
+        double freeMs = timeMs([&] { statements.clear(); });
+        if (run == 0 || parseMs < bestParse) bestParse = parseMs;
+        if (run == 0 || freeMs < bestFree) bestFree = freeMs;
+    }
+    report("parse " + std::to_string(tokens.size()) + " tokens", bestParse);
+    report("free tree", bestFree);
+    std::cout << "throughput: " << tokens.size() / (bestParse / 1000.0) / 1e6 << " M tokens/s" << std::endl;
+
+    // Declarations parsed in chunks, with thread counts doubling up to one per core or the count given.
+    // One thread parses the whole script as one chunk, the speedups are against it.
+    unsigned cores = std::max(1, argc > 1 ? std::stoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+    counts.push_back(cores);
+
+    std::cout << "threads        ms  M tokens/s  speedup" << std::endl;
+    double single = 0;
+    for (unsigned threads : counts) {
+        ThreadPool pool(threads);
+        double best = 0;
+        for (int run = 0; run < 5; run++) {
+            std::vector<std::vector<std::shared_ptr<Stmt>>> scripts;
+            std::vector<ErrorLog> errors;
+            double ms = timeMs([&] { scripts = ParallelParser(pool).parse({&tokens}, errors); });
+            if (run == 0 || ms < best) best = ms;
+        }
+        if (threads == 1) single = best;
+        double speedup = single / best;
+        std::printf("%7u %9.1f %11.1f %7.2fx  %s\n", threads, best, tokens.size() / (best / 1000.0) / 1e6, speedup,
+            std::string(static_cast<size_t>(speedup * 8 + 0.5), '#').c_str());
+    }
+    return 0;
+}
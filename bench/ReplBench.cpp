@@ -0,0 +1,38 @@
+#include "Bench.hpp"
+#include "Repl.hpp"
+#include <algorithm>
+#include <cstdio>
+
+// Entries a session accumulates: functions, globals and statements using them
+static std::string historyLine(size_t i) {
+    std::string n = std::to_string(i);
+    switch (i % 3) {
+        case 0: return "fun f" + n + "(x) { return x + " + n + "; }";
+        case 1: return "var v" + n + " = f" + std::to_string(i - 1) + "(1);";
+        default: return "v" + std::to_string(i - 1) + " = v" + std::to_string(i - 1) + " * 2;";
+    }
+}
+
+// Per-line latency of entries calling functions from across the history
+static void session(size_t history) {
+    Repl repl;
+    repl.setOutput([](std::string_view) {});
+    for (size_t i = 0; i < history; i++) repl.feed(historyLine(i));
+
+    std::vector<double> latencies;
+    for (size_t i = 0; i < 1000; i++) {
+        size_t function = history == 0 ? 0 : (i * 7919 % history) / 3 * 3;
+        std::string line = history == 0 ? "print " + std::to_string(i) + " + 1;" : "print f" + std::to_string(function) + "(" + std::to_string(i) + ");";
+        latencies.push_back(timeMs([&] { repl.feed(line); }) * 1000);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double us : latencies) total += us;
+    std::printf("history of %6zu entries: mean %6.1f us, p99 %6.1f us, max %7.1f us per line\n", history, total / latencies.size(),
+        latencies[latencies.size() * 99 / 100], latencies.back());
+}
+
+int main() {
+    for (size_t history : {0, 1000, 10000, 100000}) session(history);
+    return 0;
+}
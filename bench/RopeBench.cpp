@@ -0,0 +1,31 @@
+#include "Bench.hpp"
+
+// Builds a 1 MB string from 100k pieces of 10 characters
+static const int PIECES = 100000;
+static const std::string PIECE = "0123456789";
+
+int main() {
+    // What visitBinary used to do: copy both operands into a fresh string every step
+    size_t copied = 0;
+    double flat = timeMs([&] {
+        std::string s;
+        for (int i = 0; i < PIECES; i++) {
+            s = s + PIECE;
+        }
+        copied = s.size();
+    });
+    report("flat std::string concatenation (" + std::to_string(copied) + " bytes)", flat);
+
+    // The same loop in Lox, the comparison forces the rope to be flattened once
+    const std::string program =
+        "var s = \"\";\n"
+        "var i = 0;\n"
+        "while (i < " + std::to_string(PIECES) + ") {\n"
+        "  s = s + \"" + PIECE + "\";\n"
+        "  i = i + 1;\n"
+        "}\n"
+        "print s == s + \"\";\n";
+    double rope = timeMs([&] { runSource(program); });
+    report("Lox rope concatenation", rope);
+    return 0;
+}
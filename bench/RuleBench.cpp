@@ -0,0 +1,75 @@
+#include "Bench.hpp"
+#include "LoxVM.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+static const std::string RULE = "price * qty > limit and region == \"EU\"";
+static const std::vector<std::string> INPUTS = {"price", "qty", "limit", "region"};
+
+// Inputs of the i-th evaluation, half of which pass
+static std::vector<RuleInput> inputs(size_t i) {
+    return {static_cast<double>(i % 100), static_cast<double>(i % 7), 150.0, i % 3 == 0 ? "US" : "EU"};
+}
+
+static bool expected(size_t i) {
+    return static_cast<double>(i % 100) * static_cast<double>(i % 7) > 150.0 && i % 3 != 0;
+}
+
+// The way a rule ran before: the inputs and the rule as a script, scanned, parsed and run by a new interpreter each time
+static double scriptPerEvaluation(size_t evaluations) {
+    LoxVM vm;
+    size_t wrong = 0;
+    double ms = timeMs([&] {
+        for (size_t i = 0; i < evaluations; i++) {
+            std::vector<RuleInput> values = inputs(i);
+            std::string source = "var price = " + std::to_string(values[0].number) + ";\nvar qty = " + std::to_string(values[1].number)
+                + ";\nvar limit = 150;\nvar region = \"" + std::string(values[3].text) + "\";\nprint " + RULE + ";\n";
+            std::unique_ptr<Isolate> isolate = vm.createIsolate();
+            std::string output;
+            isolate->setOutput([&](std::string_view text) { output = text; });
+            isolate->run(vm.compile(source));
+            if ((output == "true") != expected(i)) wrong++;
+        }
+    });
+    double rate = evaluations / ms * 1000;
+    std::printf("scan, parse and run per evaluation: %12.0f evaluations/s%s\n", rate, wrong == 0 ? "" : "  (wrong results)");
+    return rate;
+}
+
+// Evaluations with one evaluator per thread, sharing the compiled rule
+static double compiled(const std::shared_ptr<const Rule>& rule, unsigned threads, size_t evaluations) {
+    std::vector<size_t> wrong(threads);
+    double ms = timeMs([&] {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                Evaluator evaluator(rule);
+                for (size_t i = t; i < evaluations; i += threads) {
+                    if (evaluator.test(inputs(i)) != expected(i)) wrong[t]++;
+                }
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+    });
+    double rate = evaluations / ms * 1000;
+    bool right = std::all_of(wrong.begin(), wrong.end(), [](size_t count) { return count == 0; });
+    std::printf("compiled rule, %2u threads:          %12.0f evaluations/s, %10.0f per thread%s\n", threads, rate, rate / threads,
+        right ? "" : "  (wrong results)");
+    return rate;
+}
+
+int main(int argc, char* argv[]) {
+    // Thread counts doubling up to one per core, or to the count given
+    unsigned cores = argc > 1 ? std::stoi(argv[1]) : std::thread::hardware_concurrency();
+    cores = std::max(1u, cores);
+
+    LoxVM vm;
+    std::shared_ptr<const Rule> rule = vm.compileRule(RULE, INPUTS);
+    double before = scriptPerEvaluation(5000);
+    double after = compiled(rule, 1, 2000000);
+    std::printf("speedup on one thread: %.0fx\n", after / before);
+    for (unsigned threads = 2; threads < cores; threads *= 2) compiled(rule, threads, 2000000);
+    if (cores > 1) compiled(rule, cores, 2000000);
+    return 0;
+}
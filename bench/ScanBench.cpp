@@ -0,0 +1,79 @@
+#include "Bench.hpp"
+#include <memory>
+
+// Each input is a small program repeated until the source is about 8 MB
+static const size_t SOURCE_BYTES = 8 * 1024 * 1024;
+
+// Hand written code, mostly short tokens
+static const std::string CODE =
+    "fun fib(n) {\n"
+    "  if (n < 2) return n; // base case\n"
+    "  return fib(n - 2) + fib(n - 1);\n"
+    "}\n"
+    "var greeting = \"hello world\";\n"
+    "for (var i = 0; i < 10.5; i = i + 1) print greeting + \"!\";\n";
+
+// Generated code, dominated by indentation, comments, long names and long strings
+static const std::string GENERATED =
+    "// ---------------------------------------------------------------------------\n"
+    "// Generated table row, do not edit by hand, regenerate from the schema instead\n"
+    "// ---------------------------------------------------------------------------\n"
+    "                var generated_configuration_entry_identifier_0001 =\n"
+    "                    \"a fairly long string value used as a template for the output table\";\n"
+    "                print generated_configuration_entry_identifier_0001;\n";
+
+// Repeats a snippet up to the benchmark size
+static std::string repeat(const std::string& snippet) {
+    std::string source;
+    while (source.size() < SOURCE_BYTES) source += snippet;
+    return source;
+}
+
+// Reports the best throughput of a few scans of the source with the given kernels
+static void scanThroughput(const std::string& name, const std::string& source, const ScanKernels& kernels) {
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        double ms = timeMs([&] {
+            Scanner scanner(source, kernels);
+            scanner.scanTokens();
+        });
+        if (run == 0 || ms < best) best = ms;
+    }
+    double megabytes = source.size() / (1024.0 * 1024.0);
+    std::cout << name << " (" << kernels.name << "): " << megabytes / (best / 1000.0) << " MB/s" << std::endl;
+}
+
+// Layout of a token before the token buffer, kept to compare memory use
+struct LegacyToken {
+    TokenType type;
+    std::string lexeme;
+    std::shared_ptr<void> literal;
+    int line;
+};
+
+int main() {
+    std::string code = repeat(CODE);
+    std::string generated = repeat(GENERATED);
+    for (const ScanKernels* kernels : ScanKernels::available()) {
+        scanThroughput("code", code, *kernels);
+        scanThroughput("generated", generated, *kernels);
+    }
+
+    Scanner scanner(code);
+    TokenBuffer tokens = scanner.scanTokens();
+
+    // Estimate what the same tokens cost as individual objects: the vector slot,
+    // lexemes too long for the small string buffer and a shared literal per value
+    size_t legacyBytes = tokens.size() * sizeof(LegacyToken);
+    for (uint32_t i = 0; i < tokens.size(); i++) {
+        size_t length = tokens.lexeme(i).size();
+        if (length > 15) legacyBytes += length + 1;
+        if (tokens.type(i) == TokenType::NUMBER) legacyBytes += 16 + sizeof(double);
+        if (tokens.type(i) == TokenType::STRING) legacyBytes += 16 + sizeof(std::string) + (length > 17 ? length - 1 : 0);
+    }
+    size_t bufferBytes = tokens.memoryUsage();
+    std::cout << "token buffer: " << bufferBytes << " bytes (" << double(bufferBytes) / tokens.size() << " per token)" << std::endl;
+    std::cout << "legacy tokens: " << legacyBytes << " bytes (" << double(legacyBytes) / tokens.size() << " per token)" << std::endl;
+    std::cout << "reduction: " << double(legacyBytes) / bufferBytes << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "Bench.hpp"
+#include "Scheduler.hpp"
+#include <cstdio>
+#include <fstream>
+
+// A small long-lived script, looping and calling a function so its turns end at any depth
+static const std::string SCRIPT = R"(
+fun step(x, k) { return (x * 7 + k) - (x * 6); }
+var x = id;
+for (var k = 0; k < 1000; k = k + 1) x = step(x, k);
+print x - id;
+)";
+
+// Peak resident set of the process so far, in kilobytes
+static long peakKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::stol(line.substr(6));
+    }
+    return 0;
+}
+
+// Runs the script in many contexts at once and prints the latencies of their turns
+static void measure(unsigned threads, uint64_t budget, size_t scripts) {
+    LoxVM vm;
+    std::vector<std::shared_ptr<const Program>> programs;
+    for (size_t id = 0; id < scripts; id++) programs.push_back(vm.compile("var id = " + std::to_string(id) + ";" + SCRIPT));
+    size_t wrong = 0;
+    std::mutex lock;
+    Scheduler::Stats stats;
+    // Small nurseries, as suits many small scripts living at once
+    HeapConfig config;
+    config.nurserySize = 64 * 1024;
+    double ms = timeMs([&] {
+        Scheduler scheduler(threads, budget, config);
+        for (const auto& program : programs) {
+            scheduler.start(program, [&](std::string_view text) {
+                if (text != "499500") {
+                    std::lock_guard<std::mutex> guard(lock);
+                    wrong++;
+                }
+            }, [&](std::string_view) {
+                std::lock_guard<std::mutex> guard(lock);
+                wrong++;
+            });
+        }
+        scheduler.waitAll();
+        stats = scheduler.getStats();
+    });
+    std::printf("%7u %7llu %7zu %9.0f %9llu %9.1f %9.1f %9.1f %11.0f%s\n", threads, static_cast<unsigned long long>(budget),
+        scripts, ms, static_cast<unsigned long long>(stats.slices), stats.meanSliceUs, stats.p99SliceUs, stats.maxSliceUs,
+        stats.p99WaitUs / 1000, wrong == 0 ? "" : "  (wrong output)");
+}
+
+int main() {
+    // The same work as one script after another on this thread, with no turns at all
+    HeapConfig config;
+    config.nurserySize = 64 * 1024;
+    LoxVM vm(config);
+    double serialMs = timeMs([&] {
+        for (size_t id = 0; id < 1000; id++) {
+            std::unique_ptr<Isolate> isolate = vm.createIsolate();
+            isolate->setOutput([](std::string_view) {});
+            isolate->run(vm.compile("var id = " + std::to_string(id) + ";" + SCRIPT));
+        }
+    });
+    std::printf("1000 scripts one after another: %.0f ms\n", serialMs);
+    std::printf("threads  budget scripts        ms    slices   mean us    p99 us    max us p99 wait ms\n");
+    measure(1, 100, 1000);
+    measure(1, 1000, 1000);
+    measure(1, 10000, 1000);
+    measure(2, 1000, 1000);
+    measure(4, 1000, 1000);
+    std::printf("peak resident: %ld KB\n", peakKb());
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "Bench.hpp"
+#include "Server.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <thread>
+
+extern char** environ;
+
+// A short request, like a hook or a check run many times
+static const char* SCRIPT = "fun square(n) { return n * n; }\nvar total = 0;\nfor (var i = 0; i < 10; i = i + 1) total = total + square(i);\nprint \"total\";\nprint total;\n";
+
+// Starts a program with its output to /dev/null and waits for it, returning its exit status
+static int spawnAndWait(const std::vector<std::string>& arguments) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    std::vector<char*> argv;
+    for (const std::string& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid;
+    int status = -1;
+    if (posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) != 0 || waitpid(pid, &status, 0) < 0) status = -1;
+    posix_spawn_file_actions_destroy(&actions);
+    return status;
+}
+
+// Latency of each of a number of requests, with the mean, p50, p99 and max printed
+static void measure(const char* name, size_t requests, const std::function<bool()>& request) {
+    std::vector<double> latencies;
+    size_t failed = 0;
+    for (size_t i = 0; i < requests; i++) {
+        bool ok = true;
+        latencies.push_back(timeMs([&] { ok = request(); }));
+        if (!ok) failed++;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double ms : latencies) total += ms;
+    std::printf("%-32s mean %7.3f ms, p50 %7.3f ms, p99 %7.3f ms, max %7.3f ms%s\n", name, total / requests, latencies[requests / 2],
+        latencies[requests * 99 / 100], latencies.back(), failed == 0 ? "" : "  (failures)");
+}
+
+int main(int argc, char* argv[]) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "cpplox-serve-bench";
+    std::filesystem::create_directories(directory);
+    std::string script = (directory / "fib.lox").string();
+    std::ofstream(script) << SCRIPT;
+    std::string socket = (directory / "lox.sock").string();
+    std::string cpplox = (std::filesystem::path(argv[0]).parent_path() / "cpplox").string();
+    bool haveCpplox = std::filesystem::exists(cpplox);
+
+    Server server(socket, std::max(1u, argc > 1 ? static_cast<unsigned>(std::stoi(argv[1])) : 2u));
+    std::string error;
+    if (!server.listen(error)) {
+        std::printf("%s\n", error.c_str());
+        return 1;
+    }
+    std::thread serving([&] { server.serve(); });
+
+    // A process per request, as before, then the same through the server from a client process and from this one
+    size_t requests = 300;
+    if (haveCpplox) {
+        measure("fork/exec cpplox per request:", requests, [&] { return spawnAndWait({cpplox, "--no-cache", script}) == 0; });
+        measure("fork/exec cpplox --client:", requests, [&] { return spawnAndWait({cpplox, "--client", socket, script}) == 0; });
+    }
+    measure("request from this process:", requests * 10, [&] {
+        std::string output;
+        int status = Server::request(socket, {script, "", {}}, [&](std::string_view text) { output.append(text); }, [](std::string_view) {});
+        return status == 0 && output == "total\n285\n";
+    });
+
+    Server::Stats stats = server.getStats();
+    std::printf("requests served: %llu, programs compiled: %llu, cache hits: %llu\n", static_cast<unsigned long long>(stats.requests),
+        static_cast<unsigned long long>(stats.cacheMisses), static_cast<unsigned long long>(stats.cacheHits));
+    server.stop();
+    serving.join();
+    std::filesystem::remove_all(directory);
+    return 0;
+}
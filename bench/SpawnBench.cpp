@@ -0,0 +1,87 @@
+#include "Bench.hpp"
+#include <algorithm>
+#include <cstdio>
+
+// Recursive fib spawning the left branch above a cutoff, against the plain recursion
+static const std::string FIB = R"(
+fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }
+fun pfib(n) {
+    if (n < 20) return fib(n);
+    fun left() { return pfib(n - 1); }
+    var future = spawn(left);
+    var right = pfib(n - 2);
+    return join(future) + right;
+}
+)";
+
+// Maps a loop heavy function over a power of two range, split in halves down to chunks of 16, and sums the results
+static const std::string MAP = R"(
+fun work(i) {
+    var x = i;
+    for (var k = 0; k < 2000; k = k + 1) x = (x * 7 + k) - (x * 6);
+    return x - i;
+}
+fun map(lo, hi) {
+    var total = 0;
+    for (var i = lo; i < hi; i = i + 1) total = total + work(i);
+    return total;
+}
+fun pmap(lo, hi) {
+    if (hi - lo <= 16) return map(lo, hi);
+    var mid = lo + (hi - lo) / 2;
+    fun left() { return pmap(lo, mid); }
+    var future = spawn(left);
+    var right = pmap(mid, hi);
+    return join(future) + right;
+}
+)";
+
+// Runs a script and returns what it printed, one value per line
+static std::string run(const std::string& source) {
+    TokenBuffer tokens = Scanner(source).scanTokens();
+    std::vector<std::shared_ptr<Stmt>> statements = Parser(tokens).parse();
+    std::string output;
+    Interpreter interpreter;
+    interpreter.setOutput([&](std::string_view text) { output.append(text).append("\n"); });
+    interpreter.interpret(statements);
+    return output;
+}
+
+// Times a parallel script against its serial version with a doubling number of workers
+static bool measure(const std::string& name, const std::string& serial, const std::string& parallel,
+                    const std::vector<unsigned>& counts) {
+    std::string expected;
+    double serialMs = timeMs([&] { expected = run(serial); });
+    std::cout << name << " serial: " << serialMs << " ms" << std::endl;
+    std::cout << "threads        ms  speedup" << std::endl;
+    for (unsigned threads : counts) {
+        TaskPool::configure(threads);
+        double best = 0;
+        for (int attempt = 0; attempt < 3; attempt++) {
+            std::string output;
+            double ms = timeMs([&] { output = run(parallel); });
+            if (output != expected) {
+                std::cout << "mismatch with " << threads << " threads" << std::endl;
+                return false;
+            }
+            if (attempt == 0 || ms < best) best = ms;
+        }
+        double speedup = serialMs / best;
+        std::printf("%7u %9.1f %7.2fx  %s\n", threads, best, speedup,
+            std::string(static_cast<size_t>(speedup * 8 + 0.5), '#').c_str());
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // Worker counts doubling up to one per core, or to the count given
+    unsigned cores = argc > 1 ? std::stoi(argv[1]) : std::thread::hardware_concurrency();
+    cores = std::max(1u, cores);
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+    counts.push_back(cores);
+
+    bool same = measure("fib(27)", FIB + "print fib(27);", FIB + "print pfib(27);", counts)
+        && measure("map over 2048", MAP + "print map(0, 2048);", MAP + "print pmap(0, 2048);", counts);
+    return same ? 0 : 1;
+}
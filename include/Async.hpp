@@ -0,0 +1,182 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include "LoxCallable.hpp"
+#include "EventLoop.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @class LoxPromise
+ * @brief Result of a function run by async(), returned before it has finished
+ *
+ * Awaiting the promise, or calling it, suspends the caller until the function
+ * returns, and gives its result. The result is the value itself, not a copy,
+ * since async functions share the heap. A runtime error in the function is
+ * raised again by every await, with the line where it happened. A promise
+ * belongs to the fibers of one interpreter, so it cannot be passed to spawn().
+ */
+class LoxPromise : public LoxCallable {
+public:
+    bool settled = false; // Set once the function has returned or failed
+    Value result; // Value returned by the function
+    bool failed = false; // Set if the function stopped with an error
+    std::string error; // Message of the error
+    std::optional<Token> token; // Where the error happened, if it was a runtime error
+    std::vector<EventLoop::Fiber*> waiters; // Fibers suspended until the promise is settled
+
+    /**
+     * @brief Suspends the running fiber until the promise is settled
+     *
+     * The promise may move while the fiber is suspended, so it is passed as
+     * the value referencing it, which the fiber keeps as a root.
+     *
+     * @param interpreter The interpreter running the fiber
+     * @param promise A value referencing the promise
+     * @return The result of the function
+     */
+    static Value await(Interpreter& interpreter, const Value& promise);
+
+    int arity() override {
+        return 0;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<promise>";
+    }
+
+    void trace(Heap& heap) override {
+        heap.markValue(result);
+    }
+
+    size_t size() const override {
+        return sizeof(LoxPromise);
+    }
+
+    LoxObject* promote() override;
+};
+
+/**
+ * @class Async
+ * @brief async(fn): runs a function taking no arguments on a new fiber and returns its promise
+ *
+ * The function starts once the caller waits, after the fibers already ready.
+ */
+class Async : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Async);
+    }
+
+    LoxObject* promote() override {
+        return new Async();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Async>(); };
+    }
+};
+
+/**
+ * @class Await
+ * @brief await(promise): suspends the caller until an async function returns, and gives its result
+ */
+class Await : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Await);
+    }
+
+    LoxObject* promote() override {
+        return new Await();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Await>(); };
+    }
+};
+
+/**
+ * @class Sleep
+ * @brief sleep(ms): suspends the caller for a number of milliseconds while other fibers run
+ */
+class Sleep : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Sleep);
+    }
+
+    LoxObject* promote() override {
+        return new Sleep();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Sleep>(); };
+    }
+};
+
+/**
+ * @class ReadLineAsync
+ * @brief readLineAsync(fd): suspends the caller until a line can be read from a file descriptor
+ *
+ * Returns the line without its newline, or nil at the end of the input.
+ */
+class ReadLineAsync : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(ReadLineAsync);
+    }
+
+    LoxObject* promote() override {
+        return new ReadLineAsync();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<ReadLineAsync>(); };
+    }
+};
+
+#endif // ASYNC_HPP
@@ -0,0 +1,123 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "BatchKernels.hpp"
+#include "LoxVM.hpp"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct Column
+ * @brief A column of input values, one per row, viewed rather than copied
+ */
+struct Column {
+    enum class Kind { NUMBER, BOOLEAN, STRING };
+
+    Kind kind; // Which of the pointers holds the values
+    const double* numbers = nullptr; // The values of a number column
+    const bool* booleans = nullptr; // The values of a boolean column
+    const std::string* strings = nullptr; // The values of a string column
+
+    Column(const double* values) : kind(Kind::NUMBER), numbers(values) {}
+    Column(const bool* values) : kind(Kind::BOOLEAN), booleans(values) {}
+    Column(const std::string* values) : kind(Kind::STRING), strings(values) {}
+    Column(const std::vector<double>& values) : Column(values.data()) {}
+    Column(const std::vector<std::string>& values) : Column(values.data()) {}
+};
+
+/**
+ * @struct BatchResult
+ * @brief The value of a rule for each row of a batch
+ */
+struct BatchResult {
+    enum class Kind : uint8_t { NIL, BOOLEAN, NUMBER, STRING, FUNCTION };
+
+    std::vector<Kind> kinds; // Which of the vectors holds the value of each row
+    std::vector<double> numbers; // Value of each number row
+    std::vector<uint8_t> booleans; // Value of each boolean row, 0 or 1
+    std::vector<std::string> strings; // Characters of each string row, or what print shows for a function; empty until a row has one
+};
+
+/**
+ * @class BatchEvaluator
+ * @brief Evaluates a rule over many rows at once, one operator at a time across the rows
+ *
+ * The rule's expression is flattened into a plan once. Each batch is split
+ * into chunks of rows, and each node of the plan produces a column of values
+ * for a whole chunk: arithmetic and comparisons of number columns run in the
+ * SIMD kernels, and the right side of and and or is evaluated only for the
+ * rows the left side leaves undecided, through a selection of row indices.
+ *
+ * Anything the plan does not cover falls back to the interpreter one row at a
+ * time, through an Evaluator: scripts, calls, assignments and variables that
+ * are not inputs make every row fall back, and a chunk where any row would
+ * raise a runtime error is evaluated again row by row, so results and errors
+ * are exactly the interpreter's. An evaluator must only be used by one thread
+ * at a time.
+ */
+class BatchEvaluator {
+public:
+    static constexpr size_t CHUNK_ROWS = 1024; // Rows per chunk, so a node's columns stay in cache
+
+    /**
+     * @brief Constructs an evaluator using the fastest kernels the CPU supports
+     *
+     * @param rule The compiled rule
+     * @param config The sizes of the heap of the interpreter rows fall back to
+     */
+    explicit BatchEvaluator(std::shared_ptr<const Rule> rule, const HeapConfig& config = HeapConfig());
+
+    ~BatchEvaluator();
+
+    /**
+     * @brief Chooses the kernels, to compare instruction sets
+     *
+     * @param kernels One of BatchKernels::available()
+     */
+    void setKernels(const BatchKernels& kernels);
+
+    /**
+     * @brief Evaluates the rule for every row
+     *
+     * @param columns One column per input of the rule, in the order they were declared
+     * @param rows The number of rows, which every column must hold
+     * @return The value of each row
+     * @throws std::invalid_argument If the rule has syntax errors or the number of columns is wrong
+     * @throws RuntimeError The error of the first row that fails, as the interpreter would report it
+     */
+    BatchResult evaluate(const std::vector<Column>& columns, size_t rows);
+
+    /**
+     * @brief Gets the number of rows evaluated by the interpreter one at a time so far
+     *
+     * @return The rows that fell back
+     */
+    uint64_t getScalarRows() const {
+        return scalarRows;
+    }
+
+private:
+    struct Plan;
+
+    std::shared_ptr<const Rule> rule; // The rule evaluated
+    Evaluator evaluator; // Evaluates the rows that fall back
+    std::unique_ptr<Plan> plan; // Nodes and their columns, null if every row falls back
+    const BatchKernels* kernels; // Kernels running the number operators
+    uint64_t scalarRows = 0; // Rows that fell back so far
+
+    /**
+     * @brief Evaluates rows one at a time with the interpreter
+     *
+     * @param columns The input columns
+     * @param first The first row
+     * @param last The row after the last
+     * @param result Receives the values
+     */
+    void evaluateRows(const std::vector<Column>& columns, size_t first, size_t last, BatchResult& result);
+};
+
+#endif // BATCH_HPP
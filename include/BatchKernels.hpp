@@ -0,0 +1,57 @@
+#ifndef BATCHKERNELS_HPP
+#define BATCHKERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @struct BatchKernels
+ * @brief Routines applying one arithmetic or comparison operator to whole columns of numbers
+ *
+ * Each routine reads count numbers from each operand and writes count results,
+ * with the same IEEE semantics as the interpreter's scalar operators, so a NaN
+ * compares unequal to everything and dividing by zero gives an infinity. The
+ * SIMD versions handle 2 or 4 numbers per step and finish with the scalar loop.
+ * The best set supported by the CPU is picked at runtime.
+ */
+struct BatchKernels {
+    using Arithmetic = void (*)(const double* left, const double* right, double* out, size_t count);
+    using Comparison = void (*)(const double* left, const double* right, uint8_t* out, size_t count);
+
+    const char* name; // Instruction set the kernels are written for
+
+    Arithmetic add; // out = left + right
+    Arithmetic subtract; // out = left - right
+    Arithmetic multiply; // out = left * right
+    Arithmetic divide; // out = left / right
+    Comparison greater; // out = left > right, as 0 or 1
+    Comparison greaterEqual; // out = left >= right
+    Comparison less; // out = left < right
+    Comparison lessEqual; // out = left <= right
+    Comparison equal; // out = left == right
+    Comparison notEqual; // out = left != right, so 1 where either is NaN
+
+    /**
+     * @brief Gets the fastest kernels supported by the CPU
+     *
+     * @return The AVX2, SSE2 or scalar kernels
+     */
+    static const BatchKernels& best();
+
+    /**
+     * @brief Gets the portable one number at a time kernels
+     *
+     * @return The scalar kernels
+     */
+    static const BatchKernels& scalar();
+
+    /**
+     * @brief Gets every kernel set the CPU supports, scalar first
+     *
+     * @return The supported kernels, slowest to fastest
+     */
+    static std::vector<const BatchKernels*> available();
+};
+
+#endif // BATCHKERNELS_HPP
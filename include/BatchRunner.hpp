@@ -0,0 +1,59 @@
+#ifndef BATCHRUNNER_HPP
+#define BATCHRUNNER_HPP
+
+#include "LoxVM.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * @struct ScriptResult
+ * @brief How one script of a batch ended and what it printed
+ */
+struct ScriptResult {
+    std::string path; // Path of the script
+    int status = 0; // Exit code cpplox would give for the script alone: 0, 1 if unreadable, 65 or 70
+    std::string output; // Lines the script printed
+    std::string errors; // Syntax or runtime errors reported, one per line
+    double ms = 0; // Time to read, compile and run the script and wait for its tasks
+};
+
+/**
+ * @class BatchRunner
+ * @brief Runs many scripts in one process, each in an isolate of its own, on a pool of threads
+ *
+ * Scripts are handed to the threads one at a time, so long and short ones
+ * balance. Every script gets fresh globals, a heap and sinks capturing what
+ * it prints, so scripts never see each other and their output is not
+ * interleaved, and a syntax or runtime error only fails the script it is in.
+ */
+class BatchRunner {
+    LoxVM vm; // Compiles the scripts and creates their isolates
+    unsigned jobs; // Scripts run at the same time
+
+public:
+    /**
+     * @brief Constructs a runner
+     *
+     * @param jobs The number of scripts run at the same time, 0 for one per core
+     * @param config The heap sizes of each script's isolate
+     */
+    explicit BatchRunner(unsigned jobs, const HeapConfig& config = HeapConfig());
+
+    /**
+     * @brief Lists the scripts of a batch
+     *
+     * @param target A directory, whose .lox files are listed in name order, or a file listing one path per line
+     * @return The paths, empty if the target cannot be read; blank lines and lines starting with # are skipped
+     */
+    static std::vector<std::string> listScripts(const std::string& target);
+
+    /**
+     * @brief Runs every script and waits for all of them
+     *
+     * @param paths The scripts to run
+     * @return The result of each script, in the order of the paths
+     */
+    std::vector<ScriptResult> run(const std::vector<std::string>& paths);
+};
+
+#endif // BATCHRUNNER_HPP
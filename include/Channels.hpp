@@ -0,0 +1,273 @@
+#ifndef CHANNELS_HPP
+#define CHANNELS_HPP
+
+#include "LoxCallable.hpp"
+#include "Snapshot.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * @class Channel
+ * @brief Bounded queue of messages between threads, with blocking send and receive
+ *
+ * The queue is a lock-free ring of cells, each with a sequence number telling
+ * whether it holds a message for the current lap of the readers or is free for
+ * the current lap of the writers. Any number of threads claim cells by moving
+ * the write or read position forward with a compare-and-swap, so neither side
+ * takes a lock while the ring is neither full nor empty. A thread finding it
+ * full or empty spins briefly, then sleeps until the other side makes room or
+ * delivers, which is when the lock is used.
+ */
+class Channel {
+public:
+    /**
+     * @struct Message
+     * @brief A value sent through a channel, belonging to no heap
+     */
+    struct Message {
+        enum class Kind { VALUE, STRING, COPY };
+
+        Kind kind = Kind::VALUE; // Which of the fields holds the value
+        Value value; // The value itself when it references no object
+        std::string text; // Characters of a string
+        Snapshot copy; // Copy of any other value and what it references
+    };
+
+    /**
+     * @brief Constructs an empty channel
+     *
+     * @param capacity The number of messages it holds before senders block, at least one
+     */
+    explicit Channel(size_t capacity);
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    /**
+     * @brief Queues a message, waiting while the channel is full
+     *
+     * @param message The message, moved into the channel
+     */
+    void send(Message message);
+
+    /**
+     * @brief Takes the oldest message, waiting while the channel is empty
+     *
+     * @return The message
+     */
+    Message receive();
+
+    /**
+     * @brief Takes the oldest message, waiting while the channel is empty unless nothing could ever send to it
+     *
+     * @param message Receives the message
+     * @param abandoned Tells whether nothing else can send any more, asked instead of sleeping for good
+     * @return False if the channel is empty and abandoned
+     */
+    bool receive(Message& message, const std::function<bool()>& abandoned);
+
+    /**
+     * @brief Queues a message if there is room
+     *
+     * @param message The message, moved into the channel only if this returns true
+     * @return False if the channel is full
+     */
+    bool trySend(Message& message);
+
+    /**
+     * @brief Takes the oldest message if there is one
+     *
+     * @param message Receives the message
+     * @return False if the channel is empty
+     */
+    bool tryReceive(Message& message);
+
+private:
+    /**
+     * @struct Cell
+     * @brief A slot of the ring and the lap it is ready for
+     */
+    struct Cell {
+        std::atomic<size_t> sequence; // Position a writer may fill it at, or that position plus one once it is full
+        Message message; // The message while the cell is full
+    };
+
+    // Attempts of a full or empty channel before the thread sleeps
+    static constexpr int SPINS = 64;
+
+    const size_t capacity; // Number of cells
+    std::unique_ptr<Cell[]> cells; // The ring
+    alignas(64) std::atomic<size_t> writePosition{0}; // Position of the next message sent, on its own cache line
+    alignas(64) std::atomic<size_t> readPosition{0}; // Position of the next message received, on its own cache line
+    alignas(64) std::atomic<size_t> sleepers{0}; // Threads asleep or about to sleep on the condition variable
+    std::mutex lock; // Guards sleeping
+    std::condition_variable changed; // Signals a message sent or received
+
+    /**
+     * @brief Wakes the threads sleeping on the channel, if there are any
+     */
+    void notify();
+};
+
+/**
+ * @class LoxChannel
+ * @brief Handle to a channel, returned by channel()
+ *
+ * The channel itself is the one thing shared between interpreters: copies of
+ * the handle made by spawn() refer to the same channel, while the values sent
+ * through it are copied. Calling the handle receives from it.
+ */
+class LoxChannel : public LoxCallable {
+public:
+    /**
+     * @brief Constructs a handle
+     *
+     * @param channel The channel it refers to
+     */
+    explicit LoxChannel(std::shared_ptr<Channel> channel) : channel(std::move(channel)) {}
+
+    /**
+     * @brief Gets the channel
+     *
+     * @return The channel the handle refers to
+     */
+    Channel& get() {
+        return *channel;
+    }
+
+    /**
+     * @brief Receives the oldest value sent, waiting while the channel is empty
+     *
+     * Waiting stops with an error when this handle is all that is left of
+     * the channel: no task, message or copy holds it, and the thread is busy
+     * waiting, so nothing can ever send. A channel another task still holds
+     * is waited on even if that task never sends.
+     *
+     * @param interpreter The interpreter receiving, whose heap holds the value
+     * @return The value
+     * @throws NativeError if nothing else can send to the channel
+     */
+    Value receive(Interpreter& interpreter);
+
+    int arity() override {
+        return 0;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<channel>";
+    }
+
+    size_t size() const override {
+        return sizeof(LoxChannel);
+    }
+
+    LoxObject* promote() override {
+        return new LoxChannel(std::move(channel));
+    }
+
+    Copier copier() const override {
+        return [channel = channel](Heap& heap) -> LoxCallable* { return heap.allocate<LoxChannel>(channel); };
+    }
+
+private:
+    std::shared_ptr<Channel> channel; // Shared with the copies in other heaps
+};
+
+/**
+ * @class MakeChannel
+ * @brief channel(capacity): creates a channel holding up to capacity values
+ */
+class MakeChannel : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(MakeChannel);
+    }
+
+    LoxObject* promote() override {
+        return new MakeChannel();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<MakeChannel>(); };
+    }
+};
+
+/**
+ * @class Send
+ * @brief send(channel, value): sends a copy of a value, waiting while the channel is full
+ */
+class Send : public LoxCallable {
+public:
+    int arity() override {
+        return 2;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Send);
+    }
+
+    LoxObject* promote() override {
+        return new Send();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Send>(); };
+    }
+};
+
+/**
+ * @class Receive
+ * @brief recv(channel): receives the oldest value sent, waiting while the channel is empty
+ *
+ * Waits forever if another task holds the channel but never sends to it,
+ * and fails if nothing else holds it at all.
+ */
+class Receive : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Receive);
+    }
+
+    LoxObject* promote() override {
+        return new Receive();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Receive>(); };
+    }
+};
+
+#endif // CHANNELS_HPP
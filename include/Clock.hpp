@@ -9,15 +9,27 @@ public:
         return 0;
     }
 
-    std::pair<std::shared_ptr<void>, TokenType> call(Interpreter& interpreter, std::vector<std::pair<std::shared_ptr<void>, TokenType>> arguments) override {
+    Value call(Interpreter& /* interpreter */, const std::vector<Value>& /* arguments */) override {
         auto now = std::chrono::system_clock::now();
         auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
         auto epoch = now_ms.time_since_epoch();
         auto value = std::chrono::duration_cast<std::chrono::milliseconds>(epoch);
-        return {std::make_shared<double>(value.count()), TokenType::NUMBER};
+        return Value::numberValue(value.count());
     }
 
     std::string toString() const override {
         return "<native fn>";
     }
+
+    size_t size() const override {
+        return sizeof(Clock);
+    }
+
+    LoxObject* promote() override {
+        return new Clock();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Clock>(); };
+    }
 };
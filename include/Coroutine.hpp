@@ -0,0 +1,87 @@
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+#include "FiberContext.hpp"
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+/**
+ * @class Coroutine
+ * @brief A function running on a stack of its own, which it can leave halfway and be resumed on
+ *
+ * Resuming the coroutine runs its function on its stack until the function
+ * yields or returns, then goes back to the resumer. The function keeps its
+ * whole call stack while suspended, so it can yield from any depth, such as
+ * from inside the interpreter's recursive calls. The stack is mapped on the
+ * first resume and unmapped once the function has returned.
+ */
+class Coroutine {
+public:
+    /**
+     * @brief Constructs a coroutine that has not started
+     *
+     * @param body The function to run, an exception it throws is raised again by resume()
+     */
+    explicit Coroutine(std::function<void()> body);
+
+    Coroutine(const Coroutine&) = delete;
+    Coroutine& operator=(const Coroutine&) = delete;
+
+    /**
+     * @brief Frees the stack, first unwinding the function if it has not returned
+     *
+     * A suspended function is resumed one last time with its yield() throwing,
+     * so the destructors of its frames run. The exception is private to the
+     * coroutine and caught by it, a function must not swallow it with catch (...).
+     */
+    ~Coroutine();
+
+    /**
+     * @brief Runs the function until it yields or returns
+     *
+     * Must be called from outside the coroutine, on the thread that resumed it before.
+     */
+    void resume();
+
+    /**
+     * @brief Suspends the function, returning from the resume() that ran it
+     *
+     * Must be called from inside the coroutine.
+     *
+     * @throws Unwind if the coroutine is destroyed while suspended here
+     */
+    void yield();
+
+    /**
+     * @brief Checks if the function has returned
+     *
+     * @return True once the function has returned or thrown
+     */
+    bool isDone() const {
+        return done;
+    }
+
+private:
+    /**
+     * @struct Unwind
+     * @brief Thrown by yield() in a coroutine being destroyed, to unwind its frames
+     */
+    struct Unwind {};
+
+    std::function<void()> body; // The function, released once it has returned
+    FiberContext context; // The coroutine's stack, mapped on the first resume and unmapped once the function returned
+    FiberContext caller; // The resumer's stack while the coroutine runs
+    bool done = false; // Set once the function has returned
+    bool cancelled = false; // Set by the destructor, so yield() throws and the function unwinds
+    std::exception_ptr error; // Exception the function threw, raised again by resume()
+
+    /**
+     * @brief Runs the function of a coroutine being started, then returns to the resumer for good
+     *
+     * @param coroutine The coroutine
+     */
+    static void entry(void* coroutine);
+};
+
+#endif // COROUTINE_HPP
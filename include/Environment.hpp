@@ -2,6 +2,7 @@
 #define ENVIRONMENT_HPP
 
 #include "Token.hpp"
+#include "Heap.hpp"
 #include <unordered_map>
 #include <string>
 #include <utility>
@@ -15,24 +16,32 @@
  * The Environment class is used to store variables and their values. It is 
  * implemented as a hash map that maps variable names to their values. Each 
  * environment can have an optional enclosing environment, which allows for 
- * variable scoping and resolution.
+ * variable scoping and resolution. Environments live on the garbage collected
+ * heap, since closures keep the environment they were declared in alive.
  */
-class Environment {
-    std::unordered_map<std::string, std::pair<std::shared_ptr<void>, TokenType>> values; // Hash map of variable names to values
+class Environment : public LoxObject {
+    std::unordered_map<std::string, Value> values; // Hash map of variable names to values
+    Heap& heap; // Heap notified when a young value is stored in an old environment
 public:
-    std::shared_ptr<Environment> enclosing; // Enclosing environment for variable scoping
+    static constexpr ObjectKind KIND = ObjectKind::ENVIRONMENT; // Accounting category of environments
+    static constexpr size_t ENTRY_SIZE = sizeof(std::pair<const std::string, Value>) + 2 * sizeof(void*); // Approximate bytes per variable, including the hash node and bucket
+
+    Environment* enclosing; // Enclosing environment for variable scoping
 
     /**
      * @brief Construct a new Environment object
+     * 
+     * @param heap The heap owning the environment
      */
-    Environment() : enclosing(nullptr) {}
+    Environment(Heap& heap) : heap(heap), enclosing(nullptr) {}
 
     /**
      * @brief Construct a new Environment object with an enclosing environment
      * 
+     * @param heap The heap owning the environment
      * @param enclosing The enclosing environment
      */
-    Environment(std::shared_ptr<Environment> enclosing) : enclosing(enclosing) {}
+    Environment(Heap& heap, Environment* enclosing) : heap(heap), enclosing(enclosing) {}
 
     /**
      * @brief Defines a new variable in the environment
@@ -40,7 +49,7 @@ public:
      * @param name The name of the variable
      * @param value The value of the variable
      */
-    void define(const std::string& name, const std::pair<std::shared_ptr<void>, TokenType>& value);
+    void define(const std::string& name, const Value& value);
 
     /**
      * @brief Gets the value of a variable in the environment
@@ -48,7 +57,7 @@ public:
      * @param name The name of the variable
      * @return The value of the variable
      */
-    std::pair<std::shared_ptr<void>, TokenType> get(const Token& name);
+    Value get(const Token& name);
 
     /**
      * @brief Gets the value of a variable in the environment
@@ -56,7 +65,7 @@ public:
      * @param name The name of the variable
      * @return The value of the variable
      */
-    std::pair<std::shared_ptr<void>, TokenType> get(const std::string& name);
+    Value get(const std::string& name);
 
     /**
      * @brief Assigns a new value to an existing variable in the environment
@@ -64,7 +73,37 @@ public:
      * @param name The name of the variable
      * @param value The new value of the variable
      */
-    void assign(const Token& name, const std::pair<std::shared_ptr<void>, TokenType>& value);
+    void assign(const Token& name, const Value& value);
+
+    /**
+     * @brief Gets the variables defined in this environment, without the enclosing ones
+     * 
+     * @return The map of variable names to values
+     */
+    const std::unordered_map<std::string, Value>& getValues() const {
+        return values;
+    }
+
+    /**
+     * @brief Marks the enclosing environment and every stored value
+     * 
+     * @param heap The heap performing the collection
+     */
+    void trace(Heap& heap) override;
+
+    /**
+     * @brief Gets the size of the environment on the heap
+     * 
+     * @return The size of the environment in bytes
+     */
+    size_t size() const override;
+
+    /**
+     * @brief Moves the environment into the old space
+     * 
+     * @return The promoted environment
+     */
+    LoxObject* promote() override;
 };
 
 #endif // ENVIRONMENT_HPP
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef ERRORLOG_HPP
+#define ERRORLOG_HPP
+
+#include <string>
+
+/**
+ * @struct ErrorLog
+ * @brief Syntax errors collected to be printed later, see Lox::CollectErrors
+ */
+struct ErrorLog {
+    std::string messages; // Formatted error lines, in the order they were reported
+    bool hadError = false; // Set once any error is reported
+};
+
+#endif // ERRORLOG_HPP
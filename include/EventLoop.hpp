@@ -0,0 +1,222 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "FiberContext.hpp"
+#include "Interpreter.hpp"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class EventLoop
+ * @brief Runs the async functions of one interpreter as fibers on its thread
+ *
+ * Every async function runs on a fiber, a C stack of its own that the loop
+ * switches to and from, so a native deep inside a Lox call stack can suspend
+ * all of it and resume it later. The program itself runs on the main fiber,
+ * the thread's own stack. Only one fiber runs at a time, and it only gives
+ * way when it waits: for a timer, for a line from a file descriptor, for
+ * another function to finish, or because it ended. The loop then resumes the
+ * fibers that are ready in the order they became ready, and when none is,
+ * waits in epoll for the next descriptor to become readable or timer to fire.
+ *
+ * Fibers share the interpreter's heap and globals, so async functions see
+ * each other's assignments. Their scopes and temporaries are swapped in and
+ * out of the interpreter on every switch, and are roots of the heap while the
+ * fiber is suspended.
+ */
+class EventLoop {
+public:
+    /**
+     * @struct Fiber
+     * @brief A suspendable line of execution and what it is waiting for
+     */
+    struct Fiber {
+        FiberContext context; // Stack and registers of the fiber, the thread's own for the main fiber
+        Interpreter::ExecutionState state; // Scopes and temporaries saved while the fiber is not running
+        Value function; // Function run by the fiber, nil once it has returned
+        Value promise; // Settled with the result of the function
+        Value awaited; // Promise the fiber is waiting for, if any
+        Value received; // Value handed over by whatever resumed the fiber
+        bool deadlocked = false; // Set when the fiber is resumed because nothing else can run
+    };
+
+    /**
+     * @brief Constructs a loop with only the main fiber
+     *
+     * @param interpreter The interpreter whose functions the fibers run
+     */
+    explicit EventLoop(Interpreter& interpreter);
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * @brief Frees the fibers, first unwinding those suspended halfway
+     *
+     * Each suspended fiber is resumed one last time with suspend() throwing,
+     * so the destructors of its frames run before its stack is dropped.
+     */
+    ~EventLoop();
+
+    /**
+     * @brief Gets the fiber currently running
+     *
+     * @return The running fiber
+     */
+    Fiber& current() {
+        return *running;
+    }
+
+    /**
+     * @brief Creates a fiber running a function and queues it behind the ready fibers
+     *
+     * @param function A function taking no arguments
+     * @param promise The promise settled with its result
+     */
+    void start(const Value& function, const Value& promise);
+
+    /**
+     * @brief Queues a suspended fiber to be resumed
+     *
+     * @param fiber The fiber whose wait is over
+     */
+    void wake(Fiber& fiber);
+
+    /**
+     * @brief Suspends the running fiber until it is woken, running the others meanwhile
+     *
+     * @throws NativeError if every fiber is waiting for another one
+     * @throws Unwind if the loop is destroyed while the fiber is suspended
+     */
+    void suspend();
+
+    /**
+     * @brief Suspends the running fiber for a while
+     *
+     * @param ms The number of milliseconds to wait
+     */
+    void sleep(double ms);
+
+    /**
+     * @brief Reads a line from a file descriptor, suspending the running fiber until one is available
+     *
+     * Descriptors epoll cannot watch, such as regular files, are read without
+     * suspending.
+     *
+     * @param fd The descriptor to read from
+     * @return The line without its newline, or nil at the end of the input
+     */
+    Value readLine(int fd);
+
+    /**
+     * @brief Runs the other fibers until every one of them has finished
+     *
+     * @throws NativeError if some of them wait for each other
+     */
+    void drain();
+
+    /**
+     * @brief Marks the objects referenced by every fiber
+     *
+     * @param heap The heap performing the collection
+     */
+    void markRoots(Heap& heap);
+
+private:
+    /**
+     * @struct Timer
+     * @brief A fiber sleeping until a deadline
+     */
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline; // When the fiber is woken
+        uint64_t sequence; // Order in which the timers were set, for timers with the same deadline
+        Fiber* fiber; // The sleeping fiber
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    /**
+     * @struct Reader
+     * @brief Buffered input of a file descriptor and the fibers waiting for its lines
+     */
+    struct Reader {
+        std::string buffer; // Bytes read but not returned as a line yet
+        std::deque<Fiber*> waiting; // Fibers waiting for a line, in order
+        bool watched = false; // Set while the descriptor is in the epoll set
+        bool ended = false; // Set once the end of the input was read
+    };
+
+    /**
+     * @struct Unwind
+     * @brief Thrown by suspend() in the fibers of a loop being destroyed, to unwind their frames
+     */
+    struct Unwind {};
+
+    Interpreter& interpreter; // Interpreter whose state is swapped on every switch
+    Fiber main; // The thread's own stack, running the program
+    Fiber* running; // Fiber currently running
+    std::unordered_map<Fiber*, std::unique_ptr<Fiber>> fibers; // Every fiber besides the main one that has not finished
+    std::deque<Fiber*> ready; // Fibers to resume, in order
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers; // Sleeping fibers, earliest deadline first
+    uint64_t timerCount = 0; // Number of timers set so far
+    std::unordered_map<int, Reader> readers; // Input of each descriptor read from so far
+    size_t watching = 0; // Descriptors in the epoll set
+    int epoll = -1; // The epoll instance, created on first use
+    Fiber* drainer = nullptr; // Fiber waiting in drain() for the others to finish
+    std::unique_ptr<Fiber> finished; // Fiber that ended, freed by the next one to run since it cannot free its own stack
+    std::vector<char*> spareStacks; // Stacks of finished fibers, reused by new ones
+    bool cancelling = false; // Set by the destructor, so suspended fibers unwind when resumed
+
+    /**
+     * @brief Runs the function of a new fiber, settles its promise and switches away for good
+     *
+     * @param loop The loop running the fiber
+     */
+    static void entry(void* loop);
+
+    /**
+     * @brief Saves the running fiber and resumes another
+     *
+     * @param next The fiber to resume
+     */
+    void switchTo(Fiber* next);
+
+    /**
+     * @brief Frees the fiber that ended before the current one resumed
+     */
+    void release();
+
+    /**
+     * @brief Wakes the fibers whose timers expired and whose descriptors have input
+     *
+     * @param block True to wait until at least one fiber is woken
+     */
+    void poll(bool block);
+
+    /**
+     * @brief Reads what a descriptor has and hands out the complete lines to the fibers waiting
+     *
+     * @param fd The readable descriptor
+     */
+    void readInput(int fd);
+
+    /**
+     * @brief Adds or removes a descriptor from the epoll set
+     *
+     * @param fd The descriptor
+     * @param reader Its input
+     * @param watch True to watch it
+     * @return False if epoll cannot watch the descriptor
+     */
+    bool watch(int fd, Reader& reader, bool watch);
+};
+
+#endif // EVENTLOOP_HPP
@@ -2,6 +2,7 @@
 #define Expr_HPP
 
 #include <memory>
+#include <vector>
 #include "Token.hpp"
 
 class Assign ;
@@ -90,7 +91,7 @@ public:
     std::shared_ptr<void> value;
 
     Literal (TokenType type, std::shared_ptr<void> value)
-        : type(type), value(value) {}
+        : type(type), value(std::move(value)) {}
 
     void accept(ExprVisitor& visitor) const override {
         return visitor.visitLiteral (*this);
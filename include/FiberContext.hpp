@@ -0,0 +1,109 @@
+#ifndef FIBERCONTEXT_HPP
+#define FIBERCONTEXT_HPP
+
+#include <cstddef>
+#include <ucontext.h>
+
+/**
+ * @class FiberContext
+ * @brief A line of execution that can be switched away from and back to, on a stack of its own or the thread's
+ *
+ * A context constructed on its own stands for whatever stack the thread is
+ * running on, and learns its bounds when it first switches away. start()
+ * gives a context a mapped stack and a function to run there instead.
+ * Switches are announced to AddressSanitizer and ThreadSanitizer when they
+ * are enabled, since both lose track of the stack otherwise.
+ */
+class FiberContext {
+public:
+    // Bytes of each stack, committed only as it is touched
+    static constexpr size_t STACK_SIZE = 1024 * 1024;
+
+    /**
+     * @brief Maps a stack, with an inaccessible guard page below it so an overflow faults
+     *
+     * @return The start of the mapping
+     * @throws std::bad_alloc if it cannot be mapped
+     */
+    static char* mapStack();
+
+    /**
+     * @brief Unmaps a stack from mapStack()
+     *
+     * @param stack The start of the mapping
+     */
+    static void unmapStack(char* stack);
+
+    /**
+     * @brief Constructs the context of the stack the thread is running on
+     */
+    FiberContext() = default;
+
+    FiberContext(const FiberContext&) = delete;
+    FiberContext& operator=(const FiberContext&) = delete;
+
+    /**
+     * @brief Frees the sanitizer state of the context, leaving its stack to whoever mapped it
+     */
+    ~FiberContext();
+
+    /**
+     * @brief Prepares the context to run a function on a stack the first time it is switched to
+     *
+     * The function must never return, it ends by switching away for good.
+     *
+     * @param stack A stack from mapStack()
+     * @param function The function to run
+     * @param argument Passed to the function
+     */
+    void start(char* stack, void (*function)(void*), void* argument);
+
+    /**
+     * @brief Takes the stack back from a context that will not run again
+     *
+     * @return The stack given to start(), or null if it was never started
+     */
+    char* release();
+
+    /**
+     * @brief Gets the stack given to start()
+     *
+     * @return The start of the mapping, or null for the thread's own stack
+     */
+    char* getStack() const {
+        return stack;
+    }
+
+    /**
+     * @brief Saves the running context, this one, and resumes another
+     *
+     * @param next The context to resume
+     * @param leaving True if this context is never resumed again
+     */
+    void switchTo(FiberContext& next, bool leaving = false);
+
+private:
+    ucontext_t context; // Registers saved while the context is not running
+    char* stack = nullptr; // Mapping holding the stack and its guard page, null for the thread's own stack
+    void (*function)(void*) = nullptr; // Run on the first switch to the context
+    void* argument = nullptr; // Passed to the function
+    const void* bottom = nullptr; // Lowest address of the stack, for AddressSanitizer
+    size_t size = 0; // Size of the stack, for AddressSanitizer
+    void* fakeStack = nullptr; // AddressSanitizer's stack of the context while it is suspended
+    void* fiber = nullptr; // ThreadSanitizer's state of the context
+
+    static thread_local FiberContext* switching; // Context the thread is switching away from
+    static thread_local FiberContext* entering; // Context the thread is switching to
+
+    /**
+     * @brief Tells the sanitizers the switch to this context is complete
+     */
+    void arrive();
+
+    /**
+     * @brief Runs the function of a context switched to for the first time
+     */
+    static void entry();
+};
+
+#endif // FIBERCONTEXT_HPP
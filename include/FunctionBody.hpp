@@ -0,0 +1,93 @@
+#ifndef FUNCTIONBODY_HPP
+#define FUNCTIONBODY_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Stmt;
+
+/**
+ * @class FunctionBody
+ * @brief The statements of a function, parsed when the declaration is or on the first call
+ *
+ * A lazy body holds the text between the braces of the declaration, which the
+ * pre-parser has checked for syntax errors. It is scanned and parsed the first
+ * time its statements are asked for, so functions a run never calls never
+ * build a tree. The body is shared by every copy of the declaration, and
+ * parsed once even when several threads call it at the same time.
+ */
+class FunctionBody {
+    std::vector<std::shared_ptr<Stmt>> parsed; // Statements of the body, empty until parsed if lazy
+    std::string_view text; // Source between the braces, viewing the script text, empty if parsed eagerly
+    int line = 0; // Line the text starts on
+    bool lazy = false; // Set if the statements are parsed from the text on demand
+    std::once_flag once; // Guards parsing the text
+    std::vector<std::string> names; // Variables the body reads or assigns, empty until first asked for
+    std::once_flag namesOnce; // Guards collecting the names
+
+public:
+    /**
+     * @brief Constructs a body parsed along with its declaration
+     *
+     * @param statements The statements of the body
+     */
+    explicit FunctionBody(std::vector<std::shared_ptr<Stmt>> statements) : parsed(std::move(statements)) {}
+
+    /**
+     * @brief Constructs a body parsed on demand
+     *
+     * @param text The source between the braces, free of syntax errors and outliving the body
+     * @param line The line the text starts on
+     */
+    FunctionBody(std::string_view text, int line) : text(text), line(line), lazy(true) {}
+
+    /**
+     * @brief Gets the statements of the body, parsing them the first time for a lazy body
+     *
+     * @return The statements of the body
+     */
+    const std::vector<std::shared_ptr<Stmt>>& statements();
+
+    /**
+     * @brief Gets the names of the variables the body reads or assigns, including in nested functions
+     *
+     * Collected the first time they are asked for, parsing a lazy body. Its
+     * own locals are among them, so the names are the most the body can
+     * look up in the scopes enclosing it, not exactly those it does.
+     *
+     * @return Each name once, in the order first found
+     */
+    const std::vector<std::string>& referencedNames();
+
+    /**
+     * @brief Checks if the statements are parsed from the text on demand
+     *
+     * @return True for a lazy body, whether or not it was parsed yet
+     */
+    bool isLazy() const {
+        return lazy;
+    }
+
+    /**
+     * @brief Gets the text of a lazy body
+     *
+     * @return The source between the braces
+     */
+    std::string_view getText() const {
+        return text;
+    }
+
+    /**
+     * @brief Gets the line the text of a lazy body starts on
+     *
+     * @return The 1-based line number
+     */
+    int getLine() const {
+        return line;
+    }
+};
+
+#endif // FUNCTIONBODY_HPP
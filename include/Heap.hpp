@@ -0,0 +1,386 @@
+#ifndef HEAP_HPP
+#define HEAP_HPP
+
+#include "Value.hpp"
+#include "HeapLimitError.hpp"
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Heap;
+
+/**
+ * @brief Kinds of runtime objects tracked separately by the heap's accounting
+ */
+enum class ObjectKind : unsigned char {
+    STRING, ENVIRONMENT, FUNCTION, NATIVE,
+
+    COUNT
+};
+
+const std::string ObjectKindStrings[] = {"strings", "environments", "functions", "natives"};
+
+/**
+ * @class LoxObject
+ * @brief Header shared by every object owned by the garbage collector
+ *
+ * Old objects link to the next old object so the heap can sweep them, and carry
+ * a mark bit used while tracing. Young objects live in the nursery, where the
+ * same link is reused as a forwarding pointer once the object has been copied to
+ * the old space. Subclasses report the objects they reference through trace(),
+ * their footprint through size() and how to move themselves through promote(),
+ * and declare a static KIND used to attribute their bytes in the accounting.
+ */
+class LoxObject {
+public:
+    LoxObject* next = nullptr; // Next old object, or the promoted copy of a forwarded young object
+    bool marked = false; // Reachable during a major collection, or forwarded during a minor one
+    bool old = false; // Set once the object lives in the old space
+    bool remembered = false; // Set while an old object is in the remembered set
+    ObjectKind kind = ObjectKind::NATIVE; // Accounting category of the object
+
+    virtual ~LoxObject() = default;
+
+    /**
+     * @brief Visits every object referenced by this object
+     *
+     * References are passed by reference so a minor collection can redirect them
+     * to the promoted copies.
+     *
+     * @param heap The heap performing the collection
+     */
+    virtual void trace(Heap& /* heap */) {}
+
+    /**
+     * @brief Gets the number of bytes the object accounts for on the heap
+     *
+     * @return The size of the object in bytes
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * @brief Moves the object into a new allocation in the old space
+     *
+     * @return The promoted copy of the object
+     */
+    virtual LoxObject* promote() = 0;
+};
+
+/**
+ * @struct HeapConfig
+ * @brief Tunable sizes of the generational heap
+ */
+struct HeapConfig {
+    size_t nurserySize = 1024 * 1024; // Bytes of young objects allocated between minor collections
+    size_t heapSize = 4 * 1024 * 1024; // Old space bytes allowed before the first major collection
+    double growthFactor = 2.0; // Major threshold multiplier applied to the live old space
+    bool stress = false; // Run a full collection at every safepoint when set
+    size_t maxHeap = 0; // Hard limit on the bytes accounted to the heap, 0 for no limit
+};
+
+/**
+ * @struct GcStats
+ * @brief Counters and pause times recorded by the heap
+ */
+struct GcStats {
+    size_t minorCollections = 0; // Number of nursery collections
+    size_t majorCollections = 0; // Number of full collections
+    double minorPauseTotal = 0; // Total time spent in minor collections, in milliseconds
+    double minorPauseMax = 0; // Longest minor collection, in milliseconds
+    double majorPauseTotal = 0; // Total time spent in major collections, in milliseconds
+    double majorPauseMax = 0; // Longest major collection, in milliseconds
+    size_t promotedBytes = 0; // Bytes copied from the nursery to the old space
+};
+
+/**
+ * @struct MemoryStats
+ * @brief Per kind accounting of the objects owned by the heap
+ */
+struct MemoryStats {
+    static constexpr size_t KINDS = static_cast<size_t>(ObjectKind::COUNT);
+
+    size_t liveObjects[KINDS] = {}; // Objects not reclaimed yet, by kind
+    size_t liveBytes[KINDS] = {}; // Bytes of the objects not reclaimed yet, by kind
+    size_t allocatedObjects[KINDS] = {}; // Objects allocated since the heap was created, by kind
+    size_t peakBytes = 0; // Highest number of bytes accounted to the heap at once
+};
+
+/**
+ * @class Heap
+ * @brief Generational garbage collector for Lox runtime objects
+ *
+ * The heap owns every string, environment and callable created while a program
+ * runs. New objects are bump-allocated in a fixed size nursery. A minor
+ * collection copies the young objects reachable from the roots and from the
+ * remembered set into the old space and resets the nursery in one step. The old
+ * space is collected by mark-and-sweep, so reference cycles such as a closure
+ * stored in the environment it captures are reclaimed. Old objects that are
+ * given a pointer to a young object must report it through writeBarrier().
+ *
+ * Collections only run at safepoints, where the owner of the heap guarantees
+ * that every live object is reachable from the roots it marks. Allocations that
+ * do not fit in the nursery go straight to the old space and request a
+ * collection at the next safepoint.
+ *
+ * Every object's bytes are accounted by kind as it is allocated, resized,
+ * promoted and freed. When a maximum heap size is configured, going over it
+ * requests a full collection and the next safepoint throws HeapLimitError if
+ * the live heap is still too large.
+ */
+class Heap {
+    HeapConfig config; // Sizes the heap was configured with
+    char* nursery; // Start of the nursery
+    char* nurseryTop; // Next free byte in the nursery
+    char* nurseryEnd; // End of the nursery
+    size_t youngBytes = 0; // Bytes accounted to objects currently in the nursery
+    std::vector<LoxObject*> youngObjects; // Objects constructed in the nursery
+    LoxObject* objects = nullptr; // List of every old object
+    std::vector<LoxObject*> grayStack; // Objects whose references are not traced yet
+    std::vector<LoxObject*> rememberedSet; // Old objects that may point into the nursery
+    std::function<void(Heap&)> markRoots; // Callback visiting the root set
+    size_t bytesAllocated = 0; // Bytes accounted to the old space
+    size_t nextGC; // Old space size triggering the next major collection
+    bool minorRequested = false; // Set when the nursery is full
+    bool majorRequested = false; // Set when the old space passed its threshold
+    bool evacuating = false; // Set during a minor collection
+    GcStats stats; // Collection counters and pause times
+    MemoryStats memory; // Accounting of the live objects by kind
+
+public:
+    /**
+     * @brief Constructs an empty heap
+     *
+     * @param config The nursery and old space sizes
+     */
+    explicit Heap(const HeapConfig& config = HeapConfig());
+
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    /**
+     * @brief Frees every object still owned by the heap
+     */
+    ~Heap();
+
+    /**
+     * @brief Allocates a new object, in the nursery if it has room
+     *
+     * Allocation never runs a collection, so pointers held by the caller stay
+     * valid until the next safepoint.
+     *
+     * @param args The arguments forwarded to the object's constructor
+     * @return A pointer to the new object
+     */
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args) {
+        constexpr size_t alignment = alignof(std::max_align_t);
+        constexpr size_t footprint = (sizeof(T) + alignment - 1) & ~(alignment - 1);
+
+        T* object;
+        if (youngBytes < config.nurserySize && static_cast<size_t>(nurseryEnd - nurseryTop) >= footprint) {
+            // Bump allocate in the nursery
+            object = new (nurseryTop) T(std::forward<Args>(args)...);
+            nurseryTop += footprint;
+            youngBytes += object->size();
+            youngObjects.push_back(object);
+        } else {
+            // The nursery is full, allocate directly in the old space until it is collected
+            object = new T(std::forward<Args>(args)...);
+            minorRequested = true;
+            addOldObject(object);
+            remember(object); // The constructor may have stored pointers to young objects
+        }
+
+        object->kind = T::KIND;
+        account(object);
+        return object;
+    }
+
+    /**
+     * @brief Runs any collection requested since the last safepoint
+     */
+    void safepoint() {
+        if (minorRequested || majorRequested || config.stress) collectRequested();
+    }
+
+    /**
+     * @brief Records a store of a value into an object
+     *
+     * Old objects that receive a pointer to a young object are added to the
+     * remembered set, so minor collections treat them as roots.
+     *
+     * @param owner The object being written to
+     * @param value The value stored into the object
+     */
+    void writeBarrier(LoxObject* owner, const Value& value) {
+        if (owner->old && !owner->remembered && value.isObject() && !value.object->old) remember(owner);
+    }
+
+    /**
+     * @brief Checks that a pending allocation fits under the maximum heap size
+     *
+     * Used before allocations too large to wait for the next safepoint.
+     *
+     * @param bytes The number of bytes about to be allocated
+     */
+    void reserve(size_t bytes);
+
+    /**
+     * @brief Updates the accounting of an object whose size changed after allocation
+     *
+     * @param object The object that changed size
+     * @param before The size the object was accounted with until now
+     */
+    void resized(LoxObject* object, size_t before);
+
+    /**
+     * @brief Copies every reachable young object into the old space
+     */
+    void collectNursery();
+
+    /**
+     * @brief Runs a minor collection followed by a mark-and-sweep of the old space
+     */
+    void collect();
+
+    /**
+     * @brief Sets the callback that visits the root set at the start of a collection
+     *
+     * @param callback The function visiting every root
+     */
+    void setRootMarker(std::function<void(Heap&)> callback);
+
+    /**
+     * @brief Visits an object reference, updating it if the object was promoted
+     *
+     * @param object The reference to visit, may be null
+     */
+    template <typename T>
+    void markObject(T*& object) {
+        object = static_cast<T*>(visit(object));
+    }
+
+    /**
+     * @brief Visits the object referenced by a value, if any
+     *
+     * @param value The value to visit
+     */
+    void markValue(Value& value);
+
+    /**
+     * @brief Sets the major threshold multiplier applied after each collection
+     *
+     * @param factor The new growth factor, must be greater than 1
+     */
+    void setGrowthFactor(double factor);
+
+    /**
+     * @brief Enables or disables a full collection at every safepoint
+     *
+     * @param enabled True to collect at every safepoint
+     */
+    void setStressMode(bool enabled);
+
+    /**
+     * @brief Gets the number of bytes currently accounted to the heap
+     *
+     * @return The bytes allocated in both generations
+     */
+    size_t getBytesAllocated() const;
+
+    /**
+     * @brief Gets the collection counters and pause times
+     *
+     * @return The statistics recorded so far
+     */
+    const GcStats& getStats() const;
+
+    /**
+     * @brief Gets the accounting of the objects owned by the heap
+     *
+     * @return The live and allocated objects and bytes by kind
+     */
+    const MemoryStats& getMemoryStats() const;
+
+    /**
+     * @brief Gets the maximum heap size
+     *
+     * @return The limit in bytes, 0 if there is none
+     */
+    size_t getMaxHeap() const;
+
+    /**
+     * @brief Gets the sizes the heap was configured with
+     *
+     * @return The configuration of the heap
+     */
+    const HeapConfig& getConfig() const {
+        return config;
+    }
+
+private:
+    /**
+     * @brief Adds a new object to the accounting of its kind
+     *
+     * @param object The object just allocated
+     */
+    void account(LoxObject* object) {
+        size_t index = static_cast<size_t>(object->kind);
+        memory.liveObjects[index]++;
+        memory.liveBytes[index] += object->size();
+        memory.allocatedObjects[index]++;
+
+        size_t total = bytesAllocated + youngBytes;
+        if (total > memory.peakBytes) memory.peakBytes = total;
+        if (config.maxHeap != 0 && total > config.maxHeap) majorRequested = true;
+    }
+
+    /**
+     * @brief Removes a freed object from the accounting of its kind
+     *
+     * @param object The object about to be freed
+     */
+    void unaccount(LoxObject* object);
+
+    /**
+     * @brief Runs a minor collection, then a major one if the old space is full
+     */
+    void collectRequested();
+
+    /**
+     * @brief Visits an object during either kind of collection
+     *
+     * @param object The object to visit, may be null
+     * @return The current address of the object
+     */
+    LoxObject* visit(LoxObject* object);
+
+    /**
+     * @brief Links an object into the old space
+     *
+     * @param object The object to link
+     */
+    void addOldObject(LoxObject* object);
+
+    /**
+     * @brief Adds an old object to the remembered set
+     *
+     * @param object The object to remember
+     */
+    void remember(LoxObject* object);
+
+    /**
+     * @brief Traces the references of every gray object until none are left
+     */
+    void traceReferences();
+
+    /**
+     * @brief Frees every unmarked old object and clears the marks of survivors
+     */
+    void sweep();
+};
+
+#endif // HEAP_HPP
@@ -0,0 +1,13 @@
+#ifndef HEAPLIMITERROR_HPP
+#define HEAPLIMITERROR_HPP
+
+#include <string>
+#include <stdexcept>
+
+class HeapLimitError : public std::runtime_error {
+public:
+    const size_t limit;
+    HeapLimitError(size_t limit) : std::runtime_error("Out of memory: heap limit of " + std::to_string(limit) + " bytes exceeded."), limit(limit) {}
+};
+
+#endif
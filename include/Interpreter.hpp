@@ -4,6 +4,33 @@
 #include "Expr.hpp"
 #include "Stmt.hpp"
 #include "Environment.hpp"
+#include "Heap.hpp"
+#include "Value.hpp"
+#include "TaskPool.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+class LoxString;
+class EventLoop;
+
+/**
+ * @brief Receives the text of one print statement or one runtime error report, without a trailing newline
+ */
+using Sink = std::function<void(std::string_view text)>;
+
+/**
+ * @struct Sinks
+ * @brief Where an interpreter and the tasks it spawns print, one report at a time
+ */
+struct Sinks {
+    Sink output; // Receives the printed values
+    Sink errors; // Receives the runtime error reports
+    std::mutex lock; // Held while a sink runs, so tasks on other threads never interleave
+};
 
 /**
  * @class Interpreter
@@ -12,23 +39,216 @@
  * The Interpreter class is responsible for evaluating expressions and executing 
  * statements. It implements the visitor pattern to handle different types of 
  * expressions and statements, and maintains an environment for variable storage 
- * and function definitions.
+ * and function definitions. Runtime objects are allocated on the interpreter's
+ * garbage collected heap, whose roots are the globals, the current and saved
+ * environments, the value stack of temporaries and the last result. The heap
+ * may move young objects when a statement starts executing, so values held
+ * across the evaluation of another expression must live on the value stack.
+ *
+ * What the program prints and the runtime errors it reports go to sinks,
+ * standard output and standard error unless others are set, and the error
+ * state is kept per interpreter, so several interpreters can run at once on
+ * different threads.
+ *
+ * Functions passed to spawn(), parallelFor() and parallelReduce() run on
+ * the shared TaskPool, each task in a fresh interpreter with its own heap and
+ * the sinks of the interpreter that spawned it. Nothing but channels is
+ * shared between them: the function and everything it can reach is copied
+ * when it is spawned, its result when it is joined, and values when they are
+ * sent. An interpreter waits for the
+ * tasks it spawned before it is destroyed.
+ *
+ * Functions passed to async() run on the same thread and heap, on fibers of
+ * the interpreter's EventLoop, and interleave with the program whenever it
+ * waits in a native such as sleep() or await(). Each fiber has its own scopes
+ * and temporaries, which the interpreter swaps in when it resumes the fiber.
  */
 class Interpreter : public ExprVisitor, StmtVisitor {
+    Heap heap; // Garbage collected heap owning every runtime object
 public:
-    const std::shared_ptr<Environment> globals = std::make_shared<Environment>(); // Global environment for storing variables and functions
+    Environment* globals; // Global environment for storing variables and functions
+
+    /**
+     * @struct ExecutionState
+     * @brief The scopes and temporaries of one line of execution, kept aside while it is suspended
+     */
+    struct ExecutionState {
+        Environment* environment = nullptr; // Current environment
+        std::vector<Environment*> environments; // Environments saved by the blocks being executed
+        std::vector<Value> stack; // Temporaries kept alive while other expressions are evaluated
+        Value result; // Result of the last executed statement or expression
+
+        /**
+         * @brief Marks every object the state references
+         * 
+         * @param heap The heap performing the collection
+         */
+        void mark(Heap& heap);
+    };
+
+    /**
+     * @class Temporaries
+     * @brief Values native code keeps on the value stack across the calls it makes, popped when it returns
+     *
+     * Calls may collect and move young objects, so a native holding values
+     * between calls reads them back from here rather than from its own copies.
+     */
+    class Temporaries {
+        Interpreter& interpreter; // Interpreter whose stack holds the values
+        size_t base; // Height of the stack below the values
+
+    public:
+        /**
+         * @brief Pushes values onto the value stack of an interpreter
+         * 
+         * @param interpreter The interpreter making the calls
+         * @param values The values to keep alive
+         */
+        Temporaries(Interpreter& interpreter, const std::vector<Value>& values) : interpreter(interpreter), base(interpreter.stack.size()) {
+            for (const Value& value : values) interpreter.push(value);
+        }
+
+        Temporaries(const Temporaries&) = delete;
+        Temporaries& operator=(const Temporaries&) = delete;
+
+        ~Temporaries() {
+            interpreter.stack.resize(base);
+        }
+
+        /**
+         * @brief Gets one of the values, as it is after the latest collection
+         * 
+         * @param index The position of the value when pushed
+         * @return The value, which may be assigned to
+         */
+        Value& operator[](size_t index) {
+            return interpreter.stack[base + index];
+        }
+    };
 
     /**
      * @brief Construct a new Interpreter object and defines clock function
+     * 
+     * @param config The sizes of the interpreter's heap
+     */
+    Interpreter(const HeapConfig& config = HeapConfig());
+
+    /**
+     * @brief Construct a new Interpreter object printing to the given sinks
+     * 
+     * @param config The sizes of the interpreter's heap
+     * @param sinks Sinks shared with other interpreters
+     */
+    Interpreter(const HeapConfig& config, std::shared_ptr<Sinks> sinks);
+
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+
+    /**
+     * @brief Runs the async functions still pending, then waits for the tasks spawned by the interpreter, whose functions may refer to its program
      */
-    Interpreter();
+    ~Interpreter();
 
     /**
      * @brief Interprets and executes a list of statements.
      * 
      * @param statements The statements to execute.
+     * @return False if a runtime error stopped the statements.
      */
-    void interpret(const std::vector<std::shared_ptr<Stmt>>& statements);
+    bool interpret(const std::vector<std::shared_ptr<Stmt>>& statements);
+
+    /**
+     * @brief Sets where the values printed by the program go
+     * 
+     * @param sink Called with the text of each printed value
+     */
+    void setOutput(Sink sink);
+
+    /**
+     * @brief Sets where runtime errors are reported
+     * 
+     * @param sink Called with the message and line of each runtime error
+     */
+    void setErrors(Sink sink);
+
+    /**
+     * @brief Checks if any statement interpreted so far stopped with a runtime error
+     * 
+     * @return True once a runtime error has been reported
+     */
+    bool hadRuntimeError() const;
+
+    /**
+     * @brief Gets the sinks of the interpreter, to share them with the tasks it spawns
+     * 
+     * @return The shared sinks
+     */
+    std::shared_ptr<Sinks> getSinks() const;
+
+    /**
+     * @brief Calls a callable from native code, keeping it and the arguments alive during the call
+     * 
+     * Runtime errors propagate to the caller as exceptions, without being reported.
+     * 
+     * @param callee A FUN value, called without checking its arity
+     * @param arguments The arguments to pass
+     * @return The value returned by the callable
+     */
+    Value call(const Value& callee, const std::vector<Value>& arguments);
+
+    /**
+     * @brief Runs statements then evaluates an expression from native code, in the global scope
+     * 
+     * Runtime errors propagate to the caller as exceptions, without being
+     * reported, and leave the interpreter in the global scope. The heap may
+     * collect first, so values returned by earlier runs must not be used after.
+     * 
+     * @param statements The statements to run, a return statement among them ends the run with its value
+     * @param expr The expression giving the result once the statements ran, null for nil
+     * @return The value returned or of the expression
+     */
+    Value run(const std::vector<std::shared_ptr<Stmt>>& statements, const Expr* expr);
+
+    /**
+     * @brief Defines or redefines a global variable
+     * 
+     * @param name The name of the variable
+     * @param value The value, which may be an object of this interpreter's heap
+     */
+    void defineGlobal(const std::string& name, const Value& value);
+
+    /**
+     * @brief Records a task spawned by the program, to wait for it before the interpreter is destroyed
+     * 
+     * @param task The task spawned
+     */
+    void track(std::shared_ptr<TaskPool::Task> task);
+
+    /**
+     * @brief Gets the event loop running the async functions of the program, creating it on first use
+     * 
+     * @return The event loop of the interpreter
+     */
+    EventLoop& getLoop();
+
+    /**
+     * @brief Calls a hook every given number of statements and loop iterations
+     *
+     * The hook runs where a statement starts or a loop goes round again, so it
+     * may suspend the interpreter, by switching to another stack, and resume it
+     * later, which is how a Scheduler time-slices its contexts.
+     *
+     * @param budget Statements and loop iterations between calls, 0 to stop calling the hook
+     * @param hook The hook to call
+     */
+    void setPreemption(uint64_t budget, std::function<void()> hook);
+
+    /**
+     * @brief Exchanges the current scopes and temporaries with a saved state
+     * 
+     * @param state The state to resume, receives the state being suspended
+     */
+    void swapState(ExecutionState& state);
 
     /**
      * @brief Methods to visit and evaluate different types of expressions.
@@ -69,54 +289,127 @@ public:
      * @param statements The statements to execute
      * @param environment  The environment in which to execute the statements
      */
-    void executeBlock(std::vector<std::shared_ptr<Stmt>> statements, std::shared_ptr<Environment> environment);
+    void executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, Environment* environment);
     
     /**
      * @brief Gets the result of the last executed statement or expression
      * 
-     * @return A reference of the last executede statement or expression
+     * @return The value of the last executed statement or expression
+     */
+    const Value& getResult() const;
+
+    /**
+     * @brief Converts a value to a string representation
+     * 
+     * @param value The value to convert
+     * @return A string representation of the value
      */
-    std::shared_ptr<void>& getResult();
+    std::string stringify(const Value& value);
 
     /**
-     * @brief Gets the type of the result of the last executed expression 
+     * @brief Gets the heap owning the interpreter's runtime objects
      * 
-     * @return The type of the last exectued statement or expression 
+     * @return A reference to the heap
      */
-    TokenType getType();
+    Heap& getHeap();
 
 private:
-    std::shared_ptr<Environment> environment = globals; // Current environment for variable storage and function definitions
-    std::shared_ptr<void> result; // Result of the last executed statement or expression
-    TokenType type; // Type of the last executed statement or expression
+    Environment* environment; // Current environment for variable storage and function definitions
+    std::vector<Environment*> environments; // Environments saved by the blocks being executed
+    std::vector<Value> stack; // Temporaries kept alive while other expressions are evaluated
+    Value result; // Result of the last executed statement or expression
+    std::shared_ptr<Sinks> sinks; // Receive the printed values and runtime error reports
+    bool runtimeError = false; // Set once a runtime error has been reported
+    std::vector<std::shared_ptr<TaskPool::Task>> tasks; // Spawned tasks that may not have finished
+    size_t pruneAt = 64; // Number of tracked tasks at which the finished ones are dropped
+    std::unique_ptr<EventLoop> loop; // Runs the async functions, null until one is used
+    uint64_t budgetLeft = UINT64_MAX; // Statements and loop iterations until the preemption hook runs, never reached without one
+    uint64_t budget = 0; // Statements and loop iterations between calls of the hook, 0 without one
+    std::function<void()> preempt; // Called when the budget runs out
+
+    /**
+     * @brief Counts a statement or loop iteration against the budget, calling the preemption hook when it runs out
+     */
+    void tick() {
+        if (--budgetLeft == 0) expire();
+    }
+
+    /**
+     * @brief Refills the budget and calls the preemption hook
+     */
+    void expire();
 
     /**
      * @brief Evaluates an expression and returns the result
      * 
      * @param expr The expression ot evaluate
-     * @return A shared pointer to the result of the expression
+     * @return The value of the expression
      */
-    std::shared_ptr<void> evaluate(const Expr& expr);
+    Value evaluate(const Expr& expr);
 
     /**
-     * @brief Determines if an object is truthy or falsy for conditional checks
+     * @brief Marks every root of the heap
      * 
-     * @param object The object to check
-     * @param type The type of the object
-     * @return True if the object is truthy, false otherwise
+     * @param heap The heap performing the collection
      */
-    bool isTruthy(const std::shared_ptr<void>& object, TokenType type);
+    void markRoots(Heap& heap);
 
     /**
-     * @brief Determines if two objects are equal
+     * @brief Reports a runtime error, then drops the temporaries and saved environments
      * 
-     * @param left The first object
-     * @param right The second object
-     * @param leftType The type of the first object
-     * @param rightType The type of the second object
-     * @return True if the objects are equal, false otherwise
+     * @param report The message of the error, with its line if it has one
      */
-    bool isEqual(const std::shared_ptr<void>& left, const std::shared_ptr<void>& right, TokenType leftType, TokenType rightType);
+    void fail(const std::string& report);
+
+    /**
+     * @brief Pushes a temporary onto the value stack so it survives collections
+     * 
+     * @param value The value to keep alive
+     */
+    void push(const Value& value);
+
+    /**
+     * @brief Pops the most recently pushed temporary from the value stack
+     * 
+     * @return The popped value
+     */
+    Value pop();
+
+    /**
+     * @brief Allocates a new string on the heap
+     * 
+     * @param text The characters of the string
+     * @return A STRING value referencing the new string
+     */
+    Value makeString(std::string text);
+
+    /**
+     * @brief Concatenates two strings, building a rope node for long results
+     * 
+     * @param op The operator token, used to report strings that are too long
+     * @param left The first string
+     * @param right The second string
+     * @return A STRING value holding both strings
+     */
+    Value concatenate(const Token& op, LoxString* left, LoxString* right);
+
+    /**
+     * @brief Determines if a value is truthy or falsy for conditional checks
+     * 
+     * @param value The value to check
+     * @return True if the value is truthy, false otherwise
+     */
+    bool isTruthy(const Value& value);
+
+    /**
+     * @brief Determines if two values are equal
+     * 
+     * @param op The operator token, used to report running out of heap
+     * @param left The first value
+     * @param right The second value
+     * @return True if the values are equal, false otherwise
+     */
+    bool isEqual(const Token& op, const Value& left, const Value& right);
 
     /**
      * @brief Checks if an operand is a number for unary and binary operations
@@ -135,15 +428,6 @@ private:
      */
     void checkNumberOperands(const Token op, const TokenType leftType, const TokenType rightType);
 
-    /**
-     * @brief Converts an object to a string representation
-     * 
-     * @param object The object to convert
-     * @param type The type of the object
-     * @return A string representation of the object
-     */
-    std::string stringify(const std::shared_ptr<void>& object, TokenType type);
-
     /**
      * @brief Executes a statement
      * 
@@ -11,6 +11,10 @@
 #include "Parser.hpp"
 #include "RuntimeError.hpp"
 #include "Interpreter.hpp"
+#include "Source.hpp"
+#include "ParallelScanner.hpp"
+#include "ParallelParser.hpp"
+#include "ScriptCache.hpp"
 
 /**
  * @class Lox
@@ -21,21 +25,103 @@
  * for reporting errors and exceptions.
  */
 class Lox {
-    static bool hadError; // Flag to indicate if an error occurred
-    static bool hadRuntimeError; // Flag to indicate if a runtime error occurred
+    static thread_local ErrorLog* errorLog; // Collects the syntax errors of this thread instead of printing them, if set
+    static thread_local bool hadError; // Set once a syntax error is printed by this thread, so runs on other threads are not affected
+    static HeapConfig heapConfig; // Heap sizes used by every interpreter
+    static bool printGcStats; // Flag to print collection statistics after each run
+    static unsigned loadThreads; // Threads used to scan and parse several or large sources, 0 for one per core
+    static std::string cacheDirectory; // Directory of the images of parsed scripts, empty to parse every run
+    static uint64_t cacheBytes; // Total size of the images kept in the cache directory
 public:
     /**
-     * @brief Runs the Lox interpreter with the given source code
+     * @class CollectErrors
+     * @brief Collects the syntax errors reported on the current thread while it is alive
      * 
-     * @param source The source code to run
+     * Threads loading parts of a program report into their own log, and the
+     * logs are printed in source order with printErrors once all are done.
      */
-    static void runFile(const std::string& path);
+    class CollectErrors {
+        ErrorLog* outer; // Log collecting before this one, restored on destruction
+    public:
+        explicit CollectErrors(ErrorLog& log) : outer(errorLog) { errorLog = &log; }
+        ~CollectErrors() { errorLog = outer; }
+        CollectErrors(const CollectErrors&) = delete;
+        CollectErrors& operator=(const CollectErrors&) = delete;
+    };
+
+    /**
+     * @brief Runs the Lox interpreter on a script file
+     * 
+     * @param path The path to the script, or "-" for standard input
+     * @param stream True to run each top-level declaration as soon as it is parsed
+     */
+    static void runFile(const std::string& path, bool stream = false);
+
+    /**
+     * @brief Runs several script files as one program
+     * 
+     * The files are scanned and parsed at once, then run in order in the same
+     * global scope. Syntax errors are reported in file order, and nothing
+     * runs if there is any. Files unchanged since they were last parsed are
+     * loaded from the cache directory instead, if one is configured.
+     * 
+     * @param paths The paths to the scripts, "-" for standard input, read whole
+     */
+    static void runFiles(const std::vector<std::string>& paths);
+
+    /**
+     * @brief Runs many scripts on a pool of threads, each in an interpreter of its own
+     * 
+     * Each script's output and errors are printed in turn, in list order,
+     * after a line with its path, exit status and latency, followed by a
+     * summary with the wall time and the latency percentiles.
+     * 
+     * @param target A directory of .lox files, or a file listing one script path per line
+     * @param jobs The number of scripts run at the same time, 0 for one per core
+     * @return 0 if every script succeeded, 1 otherwise
+     */
+    static int runBatch(const std::string& target, unsigned jobs);
 
     /**
      * @brief Runs the Lox interpreter in interactive mode
+     * 
+     * Every line runs in the same session, so globals and functions persist.
+     * Lines are gathered until they form complete declarations, and an empty
+     * line runs incomplete input anyway to report its errors. The prompt ends
+     * at the end of the input.
      */
     static void runPrompt();
 
+    /**
+     * @brief Configures the heap of the interpreters created by later runs
+     * 
+     * @param config The heap sizes to use
+     * @param printStats True to print collection statistics after each run
+     */
+    static void configureHeap(const HeapConfig& config, bool printStats);
+
+    /**
+     * @brief Sets the number of threads used to scan and parse several or large sources, and to run spawned functions
+     * 
+     * @param threads The number of threads, 0 for one per core
+     */
+    static void configureThreads(unsigned threads);
+
+    /**
+     * @brief Sets the directory where parsed script files are cached
+     * 
+     * @param directory The cache directory, empty to parse every script on every run
+     * @param maxBytes The total size of the images kept, the least recently used removed first
+     */
+    static void configureCache(const std::string& directory, uint64_t maxBytes = ScriptCache::DEFAULT_MAX_BYTES);
+
+    /**
+     * @brief Chooses when function bodies are parsed
+     * 
+     * @param lazyFunctions True to parse bodies the first time they are called, false to parse them when declared
+     */
+    static void configureParsing(bool lazyFunctions);
+
     /**
      * @brief Reports a syntax error
      * 
@@ -53,19 +139,47 @@ public:
     static void error(Token token, const std::string& message);
 
     /**
-     * @brief Reports a runtime error
+     * @brief Prints the syntax errors collected in a log
      * 
-     * @param error The RuntimeError object
+     * @param log The errors to print, in the order they were reported
      */
-    static void runtimeError(RuntimeError error);
+    static void printErrors(const ErrorLog& log);
     
 private:
     /**
-     * @brief Runs the Lox interpreter with the given source code
+     * @brief Runs the Lox interpreter on a stream, one top-level declaration at a time
+     * 
+     * Memory is bounded by the largest declaration and the functions declared,
+     * not by the length of the input. Statements before a syntax error have
+     * already run when it is reported, and nothing runs after the first error.
      * 
-     * @param source The source code to run
+     * @param input The stream to read the source code from
+     * @return True if a runtime error stopped the script
      */
-    static void run(const std::string& source);
+    static bool runStream(std::istream& input);
+
+    /**
+     * @brief Scans and parses sources, using the load threads for several or large ones
+     * 
+     * Syntax errors are reported in source order, each source's scanner
+     * errors before its parser errors. When images are asked for and a cache
+     * directory is configured, the scripts found in the cache are decoded
+     * instead, and the others are saved to it if there is no syntax error.
+     * 
+     * @param sources The source code of each script, must outlive the statements
+     * @param images Receives the cache images the statements refer into, null to skip the cache
+     * @return The statements of each script
+     */
+    static std::vector<std::vector<std::shared_ptr<Stmt>>> load(const std::vector<std::string_view>& sources,
+                                                                std::vector<std::unique_ptr<Source>>* images = nullptr);
+
+    /**
+     * @brief Scans and parses sources, see load
+     * 
+     * @param sources The source code of each script, must outlive the statements
+     * @return The statements of each script
+     */
+    static std::vector<std::vector<std::shared_ptr<Stmt>>> parse(const std::vector<std::string_view>& sources);
 
     /**
      * @brief Reads the source code from a file
@@ -74,7 +188,14 @@ private:
      * @return The source code read from the file
      */
     static void report(int line, const std::string& where, const std::string& message);
-    
+
+    /**
+     * @brief Prints the collection statistics and memory accounting of a heap to stderr
+     * 
+     * @param heap The heap to report on
+     */
+    static void reportGcStats(const Heap& heap);
+
 };
 
 #endif // LOX_HPP
\ No newline at end of file
@@ -1,10 +1,12 @@
 #ifndef LOXCALLABLE_HPP
 #define LOXCALLABLE_HPP
 
+#include <functional>
 #include <vector>
 #include <memory>
 #include "Token.hpp"
 #include <utility>
+#include "Heap.hpp"
 #include "Interpreter.hpp"
 
 /**
@@ -15,13 +17,31 @@
  * objects that can be called like functions in Lox code. It provides a
  * method for getting the arity of the callable, a method for calling the
  * callable with a list of arguments, and a method for converting the
- * callable to a string.
+ * callable to a string. Callables are heap objects, so they are reclaimed by
+ * the garbage collector once unreachable. Natives that can be copied to the
+ * heap of another interpreter, see Snapshot, say how through copier().
  */
-class LoxCallable {
+class LoxCallable : public LoxObject {
 public:
+    static constexpr ObjectKind KIND = ObjectKind::NATIVE; // Accounting category of native callables
+
+    /**
+     * @brief Allocates an equivalent native on another heap
+     */
+    using Copier = std::function<LoxCallable*(Heap& heap)>;
+
     virtual int arity() = 0;
-    virtual std::pair<std::shared_ptr<void>, TokenType> call(Interpreter& interpreter, std::vector<std::pair<std::shared_ptr<void>, TokenType>> arguments) = 0;
+    virtual Value call(Interpreter& interpreter, const std::vector<Value>& arguments) = 0;
     virtual std::string toString() const = 0;
+
+    /**
+     * @brief Gets how to copy the native to another heap
+     * 
+     * @return The copier, which may run on another thread, or null if the native cannot be copied
+     */
+    virtual Copier copier() const {
+        return nullptr;
+    }
 };
 
 #endif
\ No newline at end of file
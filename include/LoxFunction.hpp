@@ -11,16 +11,18 @@
  * to the closure environment.
  */
 class LoxFunction : public LoxCallable {
-    const std::unique_ptr<Function> declaration; // The function declaration
-    const std::shared_ptr<Environment> closure; // The closure environment
+    std::unique_ptr<Function> declaration; // The function declaration
+    Environment* closure; // The closure environment
 public:
+    static constexpr ObjectKind KIND = ObjectKind::FUNCTION; // Accounting category of Lox functions
+
     /**
      * @brief Constructs a new LoxFunction object
      * 
      * @param declaration The function declaration
      * @param closure The closure environment
      */
-    LoxFunction(std::unique_ptr<Function> declaration, std::shared_ptr<Environment> closure)
+    LoxFunction(std::unique_ptr<Function> declaration, Environment* closure)
         : declaration(std::move(declaration)), closure(closure) {}
 
     /**
@@ -35,9 +37,9 @@ public:
      * 
      * @param interpreter The interpreter object
      * @param arguments The arguments to pass to the function
-     * @return The return value and type of the function
+     * @return The return value of the function
      */
-    std::pair<std::shared_ptr<void>, TokenType> call(Interpreter& interpreter, std::vector<std::pair<std::shared_ptr<void>, TokenType>> arguments) override;
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
     
     /**
      * @brief Converts the LoxFunction object to a string
@@ -45,6 +47,45 @@ public:
      * @return std::string 
      */
     std::string toString() const override;
+
+    /**
+     * @brief Gets the function declaration
+     * 
+     * @return The declaration the function was created from
+     */
+    const Function& getDeclaration() const {
+        return *declaration;
+    }
+
+    /**
+     * @brief Gets the closure environment
+     * 
+     * @return The environment the function was declared in
+     */
+    Environment* getClosure() const {
+        return closure;
+    }
+
+    /**
+     * @brief Marks the closure environment
+     * 
+     * @param heap The heap performing the collection
+     */
+    void trace(Heap& heap) override;
+
+    /**
+     * @brief Gets the size of the function on the heap
+     * 
+     * @return The size of the function in bytes
+     */
+    size_t size() const override;
+
+    /**
+     * @brief Moves the function into the old space
+     * 
+     * @return The promoted function
+     */
+    LoxObject* promote() override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef LOX_STRING_HPP
+#define LOX_STRING_HPP
+
+#include "Heap.hpp"
+#include <string>
+
+/**
+ * @class LoxString
+ * @brief Heap object holding the characters of a Lox string
+ *
+ * A string is either flat, holding its characters directly, or a rope node
+ * that concatenates two other strings. Concatenation builds rope nodes in
+ * constant time, and a rope is flattened in place the first time its
+ * characters are needed, so building a string from N pieces costs O(N)
+ * instead of copying the growing prefix on every step.
+ */
+class LoxString : public LoxObject {
+    std::string characters; // Characters of a flat string
+    LoxString* left = nullptr; // Left half of a rope node, null once flat
+    LoxString* right = nullptr; // Right half of a rope node, null once flat
+    size_t length; // Number of characters in the string
+
+public:
+    static constexpr ObjectKind KIND = ObjectKind::STRING; // Accounting category of strings
+    static constexpr size_t MIN_ROPE_LENGTH = 256; // Shorter concatenations are copied into a flat string
+
+    /**
+     * @brief Constructs a new flat LoxString object
+     *
+     * @param value The characters of the string
+     */
+    explicit LoxString(std::string value) : characters(std::move(value)), length(characters.size()) {}
+
+    /**
+     * @brief Constructs a new rope node concatenating two strings
+     *
+     * @param left The first part of the string
+     * @param right The second part of the string
+     */
+    LoxString(LoxString* left, LoxString* right)
+        : left(left), right(right), length(left->length + right->length) {}
+
+    /**
+     * @brief Gets the number of characters in the string without flattening it
+     *
+     * @return The length of the string
+     */
+    size_t getLength() const {
+        return length;
+    }
+
+    /**
+     * @brief Checks if the string is a rope node that has not been flattened yet
+     *
+     * @return True if the string is a rope node, false otherwise
+     */
+    bool isRope() const {
+        return left != nullptr;
+    }
+
+    /**
+     * @brief Gets the characters of the string, flattening it first if needed
+     *
+     * @param heap The heap owning the string, told about the flattened size
+     * @return The characters of the string
+     */
+    const std::string& str(Heap& heap);
+
+    /**
+     * @brief Marks both halves of a rope node
+     *
+     * @param heap The heap performing the collection
+     */
+    void trace(Heap& heap) override;
+
+    /**
+     * @brief Gets the size of the string on the heap
+     *
+     * @return The object size plus its characters
+     */
+    size_t size() const override;
+
+    /**
+     * @brief Moves the string into the old space
+     *
+     * @return The promoted string
+     */
+    LoxObject* promote() override;
+
+private:
+    /**
+     * @brief Copies the leaves of the rope into the string and drops the halves
+     */
+    void flatten();
+};
+
+#endif // LOX_STRING_HPP
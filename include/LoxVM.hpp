@@ -0,0 +1,331 @@
+#ifndef LOXVM_HPP
+#define LOXVM_HPP
+
+#include "ErrorLog.hpp"
+#include "Interpreter.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class Program
+ * @brief A parsed script, shared read-only by the isolates running it
+ *
+ * The program owns its source text, which the syntax tree views. Nothing in it
+ * changes once it is compiled, apart from function bodies parsed on their
+ * first call under a once flag, so any number of isolates may run it at the
+ * same time on different threads.
+ */
+class Program {
+    std::string source; // Text of the script, viewed by the tokens of the tree
+    std::vector<std::shared_ptr<Stmt>> statements; // Top-level statements, empty after a syntax error
+    ErrorLog errors; // Syntax errors found while compiling
+
+    friend class LoxVM;
+
+public:
+    /**
+     * @brief Checks if the script has syntax errors, in which case it cannot run
+     *
+     * @return True if any syntax error was found
+     */
+    bool hadError() const {
+        return errors.hadError;
+    }
+
+    /**
+     * @brief Gets the syntax errors of the script
+     *
+     * @return One line per error, in source order
+     */
+    const std::string& getErrors() const {
+        return errors.messages;
+    }
+
+    /**
+     * @brief Gets the top-level statements of the script
+     *
+     * @return The statements, in source order
+     */
+    const std::vector<std::shared_ptr<Stmt>>& getStatements() const {
+        return statements;
+    }
+
+    /**
+     * @brief Gets the text of the script
+     *
+     * @return The source the program was compiled from
+     */
+    const std::string& getSource() const {
+        return source;
+    }
+};
+
+/**
+ * @enum RunStatus
+ * @brief How running a program ended
+ */
+enum class RunStatus {
+    OK, // Every statement ran
+    COMPILE_ERROR, // The program has syntax errors, nothing ran
+    RUNTIME_ERROR // A statement stopped with a runtime error, later ones did not run
+};
+
+/**
+ * @class Isolate
+ * @brief An independent interpreter with its own globals, heap, sinks and error state
+ *
+ * Programs run by the same isolate share its global scope, so one program
+ * can use the functions and variables another declared. An isolate must only
+ * be used by one thread at a time, but different isolates never share any
+ * mutable state and run freely in parallel.
+ */
+class Isolate {
+    Interpreter interpreter; // Runs the programs, owning the heap and globals
+    std::vector<std::shared_ptr<const Program>> programs; // Programs run so far, whose trees the globals may refer to
+    Sink errors; // Receives syntax and runtime errors
+
+public:
+    /**
+     * @brief Constructs an isolate printing to standard output and reporting errors to standard error
+     *
+     * @param config The sizes of the isolate's heap
+     */
+    explicit Isolate(const HeapConfig& config = HeapConfig());
+
+    /**
+     * @brief Sets where the values printed by programs go
+     *
+     * @param sink Called with the text of each printed value
+     */
+    void setOutput(Sink sink);
+
+    /**
+     * @brief Sets where syntax and runtime errors are reported
+     *
+     * @param sink Called with the syntax errors of a program that cannot run, and each runtime error
+     */
+    void setErrors(Sink sink);
+
+    /**
+     * @brief Defines the command line arguments of the programs the isolate runs
+     *
+     * Lox has no lists, so they are bound as globals: argc holds their count,
+     * and arg0, arg1 and so on hold each argument as a string.
+     *
+     * @param arguments The arguments, in order
+     */
+    void setArguments(const std::vector<std::string>& arguments);
+
+    /**
+     * @brief Runs a program in the global scope of the isolate
+     *
+     * The isolate keeps the program alive for as long as it lives, since
+     * functions it declared may be called later.
+     *
+     * @param program The compiled program
+     * @return How the run ended
+     */
+    RunStatus run(std::shared_ptr<const Program> program);
+
+    /**
+     * @brief Checks if any program run so far stopped with a runtime error
+     *
+     * @return True once a runtime error has been reported
+     */
+    bool hadRuntimeError() const;
+
+    /**
+     * @brief Gets the heap owning the isolate's runtime objects
+     *
+     * @return A reference to the heap
+     */
+    Heap& getHeap();
+};
+
+/**
+ * @class Rule
+ * @brief An expression or script compiled once, to be evaluated many times against different inputs
+ *
+ * A rule is either a single expression, such as price * qty > limit, or a
+ * script whose return statement gives the result. It reads its inputs as
+ * global variables, declared by name when it is compiled and bound in that
+ * order on each evaluation. Like a program, nothing in it changes once it is
+ * compiled, so evaluators on any number of threads may share it.
+ */
+class Rule {
+    std::string source; // Text of the rule, viewed by the tokens of the tree
+    std::vector<std::string> inputs; // Names of the inputs, in binding order
+    std::unique_ptr<Expr> expression; // The expression, null for a script or after a syntax error
+    std::vector<std::shared_ptr<Stmt>> statements; // Statements of a script, empty for an expression or after a syntax error
+    ErrorLog errors; // Syntax errors found while compiling
+
+    friend class LoxVM;
+    friend class Evaluator;
+    friend class BatchEvaluator;
+
+public:
+    /**
+     * @brief Checks if the rule has syntax errors, in which case it cannot be evaluated
+     *
+     * @return True if any syntax error was found
+     */
+    bool hadError() const {
+        return errors.hadError;
+    }
+
+    /**
+     * @brief Gets the syntax errors of the rule
+     *
+     * @return One line per error, in source order
+     */
+    const std::string& getErrors() const {
+        return errors.messages;
+    }
+
+    /**
+     * @brief Gets the names of the inputs
+     *
+     * @return The names, in the order values are bound to them
+     */
+    const std::vector<std::string>& getInputs() const {
+        return inputs;
+    }
+};
+
+/**
+ * @struct RuleInput
+ * @brief A value bound to an input of a rule, from outside any heap
+ */
+struct RuleInput {
+    enum class Kind { NIL, BOOLEAN, NUMBER, STRING };
+
+    Kind kind = Kind::NIL; // Which of the fields holds the value
+    bool boolean = false; // The value of a boolean
+    double number = 0; // The value of a number
+    std::string_view text; // The characters of a string, copied into the evaluator's heap when bound
+
+    RuleInput() = default;
+    RuleInput(std::nullptr_t) {}
+    RuleInput(bool value) : kind(Kind::BOOLEAN), boolean(value) {}
+    RuleInput(double value) : kind(Kind::NUMBER), number(value) {}
+    RuleInput(int value) : kind(Kind::NUMBER), number(value) {}
+    RuleInput(std::string_view value) : kind(Kind::STRING), text(value) {}
+    RuleInput(const char* value) : kind(Kind::STRING), text(value) {}
+    RuleInput(const std::string& value) : kind(Kind::STRING), text(value) {}
+};
+
+/**
+ * @class Evaluator
+ * @brief Evaluates a rule again and again, in an interpreter kept for the purpose
+ *
+ * Evaluating binds the inputs as globals of the evaluator's interpreter and
+ * runs the rule's tree, so nothing is scanned or parsed, and numbers and
+ * booleans are bound without allocating. An evaluator must only be used by
+ * one thread at a time; threads evaluating the same rule each create one.
+ */
+class Evaluator {
+    std::shared_ptr<const Rule> rule; // The rule evaluated
+    Interpreter interpreter; // Holds the inputs and anything the rule declares
+
+public:
+    /**
+     * @brief Constructs an evaluator printing to standard output
+     *
+     * @param rule The compiled rule
+     * @param config The sizes of the evaluator's heap
+     */
+    explicit Evaluator(std::shared_ptr<const Rule> rule, const HeapConfig& config = HeapConfig());
+
+    /**
+     * @brief Sets where the values printed by a script go
+     *
+     * @param sink Called with the text of each printed value
+     */
+    void setOutput(Sink sink);
+
+    /**
+     * @brief Evaluates the rule with the given inputs
+     *
+     * @param inputs One value per input of the rule, in the order they were declared
+     * @return The value of the expression or returned by the script, nil if it returned none;
+     *         a string or function stays valid until the next evaluation
+     * @throws std::invalid_argument If the rule has syntax errors or the number of inputs is wrong
+     * @throws RuntimeError If the rule stops with a runtime error
+     */
+    Value evaluate(const std::vector<RuleInput>& inputs);
+
+    /**
+     * @brief Evaluates the rule and checks if the result is truthy
+     *
+     * @param inputs One value per input of the rule, in the order they were declared
+     * @return False if the result is nil or false, true otherwise
+     */
+    bool test(const std::vector<RuleInput>& inputs);
+
+    /**
+     * @brief Converts a result to the text print would show
+     *
+     * @param value A value returned by the last evaluation
+     * @return The text of the value
+     */
+    std::string toString(const Value& value);
+};
+
+/**
+ * @class LoxVM
+ * @brief Entry point for embedding the interpreter, compiling programs and creating isolates
+ *
+ * The VM holds no global state: syntax errors are collected per compilation,
+ * and each isolate has its own output, errors and heap. A VM may be used from
+ * several threads at once.
+ */
+class LoxVM {
+    HeapConfig heapConfig; // Heap sizes of the isolates created
+
+public:
+    /**
+     * @brief Constructs a VM
+     *
+     * @param config The sizes of the heaps of the isolates it creates
+     */
+    explicit LoxVM(const HeapConfig& config = HeapConfig()) : heapConfig(config) {}
+
+    /**
+     * @brief Scans and parses a script
+     *
+     * @param source The text of the script, owned by the program
+     * @return The program, with its syntax errors if it has any
+     */
+    std::shared_ptr<const Program> compile(std::string source) const;
+
+    /**
+     * @brief Scans and parses a rule
+     *
+     * The source is read as one expression if it is one, and as a script otherwise.
+     *
+     * @param source The text of the rule, owned by it
+     * @param inputs The names of the global variables bound on each evaluation
+     * @return The rule, with its syntax errors if it has any
+     */
+    std::shared_ptr<const Rule> compileRule(std::string source, std::vector<std::string> inputs) const;
+
+    /**
+     * @brief Creates an evaluator for a rule
+     *
+     * @param rule The compiled rule
+     * @return The new evaluator, with the VM's heap sizes
+     */
+    std::unique_ptr<Evaluator> createEvaluator(std::shared_ptr<const Rule> rule) const;
+
+    /**
+     * @brief Creates an isolate to run programs in
+     *
+     * @return The new isolate, with the VM's heap sizes
+     */
+    std::unique_ptr<Isolate> createIsolate() const;
+};
+
+#endif // LOXVM_HPP
@@ -0,0 +1,16 @@
+#ifndef NATIVEERROR_HPP
+#define NATIVEERROR_HPP
+
+#include <string>
+#include <stdexcept>
+
+/**
+ * Thrown by native functions, which have no token of their own. The interpreter
+ * reports it as a runtime error at the call.
+ */
+class NativeError : public std::runtime_error {
+public:
+    NativeError(const std::string& message) : std::runtime_error(message) {}
+};
+
+#endif
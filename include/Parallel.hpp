@@ -0,0 +1,76 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include "LoxCallable.hpp"
+
+/**
+ * @class ParallelFor
+ * @brief parallelFor(start, end, fn): calls fn(i) for every i from start up to end, excluded, on the task pool
+ *
+ * Like spawn(), the calls run on copies of the function and of everything it
+ * can reach, so assignments they make are not seen by the caller, and what
+ * they print may come in any order. Returns nil once every call has returned.
+ */
+class ParallelFor : public LoxCallable {
+public:
+    int arity() override {
+        return 3;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(ParallelFor);
+    }
+
+    LoxObject* promote() override {
+        return new ParallelFor();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<ParallelFor>(); };
+    }
+};
+
+/**
+ * @class ParallelReduce
+ * @brief parallelReduce(start, end, fn, combine, init): folds fn(i) over a range with combine, on the task pool
+ *
+ * Gives the same result as the loop
+ * `var acc = init; for (var i = start; i < end; i = i + 1) acc = combine(acc, fn(i));`
+ * as long as combine is associative. The range is split into chunks that
+ * depend only on its length, each chunk is folded in order and the results
+ * of the chunks are combined in order after init, so the result is the same
+ * on every run and with any number of workers, even for combine functions
+ * that are only nearly associative, such as adding fractions.
+ */
+class ParallelReduce : public LoxCallable {
+public:
+    int arity() override {
+        return 5;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(ParallelReduce);
+    }
+
+    LoxObject* promote() override {
+        return new ParallelReduce();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<ParallelReduce>(); };
+    }
+};
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,60 @@
+#ifndef PARALLELPARSER_HPP
+#define PARALLELPARSER_HPP
+
+#include "ErrorLog.hpp"
+#include "ThreadPool.hpp"
+#include "TokenBuffer.hpp"
+#include <memory>
+#include <vector>
+
+class Stmt;
+
+/**
+ * @class ParallelParser
+ * @brief Parses scripts, and the top-level declarations of large ones, on a thread pool
+ *
+ * A pass over the token types matches parentheses and braces to find where
+ * top-level declarations end: after a ';' or '}' outside any of them that is
+ * not followed by 'else'. Large scripts are split at those points into chunks
+ * of whole declarations, and the chunks of every script are parsed at once,
+ * each as a script of its own. The statements are spliced back in source order.
+ *
+ * A chunk with a syntax error may have been split where the serial parser
+ * would have recovered differently, so a script with any error is parsed
+ * again serially, giving exactly the errors of the serial parser.
+ */
+class ParallelParser {
+    ThreadPool& pool; // Threads the chunks are parsed on
+
+public:
+    static constexpr uint32_t MIN_TOKENS = 64 * 1024; // Fewest tokens in a chunk, smaller scripts are one chunk
+    static constexpr unsigned CHUNKS_PER_THREAD = 4; // Extra chunks to balance the threads
+
+    /**
+     * @brief Constructs a parser running on the given threads
+     *
+     * @param pool The threads to parse on
+     */
+    explicit ParallelParser(ThreadPool& pool) : pool(pool) {}
+
+    /**
+     * @brief Parses several scripts at once
+     *
+     * @param scripts The tokens of each script, must outlive the statements
+     * @param errors Set to the syntax errors of each script, in source order
+     * @return The statements of each script
+     */
+    std::vector<std::vector<std::shared_ptr<Stmt>>> parse(const std::vector<const TokenBuffer*>& scripts,
+                                                          std::vector<ErrorLog>& errors);
+
+    /**
+     * @brief Finds the top-level declaration boundaries to split a script at
+     *
+     * @param tokens The tokens of the script
+     * @param minTokens The fewest tokens between two splits
+     * @return The index of the first token of each chunk, starting with 0
+     */
+    static std::vector<uint32_t> split(const TokenBuffer& tokens, uint32_t minTokens);
+};
+
+#endif // PARALLELPARSER_HPP
@@ -0,0 +1,50 @@
+#ifndef PARALLELSCANNER_HPP
+#define PARALLELSCANNER_HPP
+
+#include "Scanner.hpp"
+#include "ThreadPool.hpp"
+#include <string_view>
+
+/**
+ * @class ParallelScanner
+ * @brief Scans a large source in chunks on a thread pool
+ *
+ * The source is split into chunks at line starts. Since only strings and block
+ * comments span lines, a chunk can start in just a few ways: outside them,
+ * inside a string, inside a comment, or one character into the closing of a
+ * comment. A pre-pass over every chunk at once follows only quotes and slashes
+ * to find where the scan of the chunk ends for each of those starts. Chaining
+ * the results from the first chunk gives the real start of every chunk, which
+ * are then scanned at once. The tokens, newlines and errors of the chunks are
+ * joined in order, giving exactly the buffer and errors of the serial scanner.
+ */
+class ParallelScanner {
+    std::string_view source; // Source code to scan, borrowed from the caller
+    ThreadPool& pool; // Threads the chunks are scanned on
+    const ScanKernels& kernels; // Routines skipping long runs of characters
+
+public:
+    static constexpr size_t MIN_CHUNK = 1024 * 1024; // Smallest chunk worth a thread, smaller sources are scanned serially
+    static constexpr unsigned CHUNKS_PER_THREAD = 4; // Extra chunks to balance the threads
+
+    /**
+     * @brief Constructs a scanner for the given source code
+     *
+     * @param source The source code to scan, must outlive the tokens
+     * @param pool The threads to scan on
+     * @param kernels The routines used to skip runs of characters, the fastest available by default
+     */
+    ParallelScanner(std::string_view source, ThreadPool& pool, const ScanKernels& kernels = ScanKernels::best())
+        : source(source), pool(pool), kernels(kernels) {}
+
+    /**
+     * @brief Scans the source code and returns the buffer of tokens
+     *
+     * Errors are reported in source order once every chunk is scanned.
+     *
+     * @return TokenBuffer The tokens, ending with an END_OF_FILE token
+     */
+    TokenBuffer scanTokens();
+};
+
+#endif // PARALLELSCANNER_HPP
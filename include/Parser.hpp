@@ -1,10 +1,12 @@
 #ifndef Parser_HPP
 #define Parser_HPP
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <string>
-#include "Token.hpp"
+#include "TokenBuffer.hpp"
+#include "Scanner.hpp"
 #include "Expr.hpp"
 #include "ParserError.hpp"
 #include "Stmt.hpp"
@@ -13,21 +15,53 @@
  * @class Parser
  * @brief Responsible for parsing tokens into expressions and statements.
  * 
- * This class takes a vector of tokens produced by the scanner and
- * parses them into a syntax tree, producing expressions and statements
- * that can be executed by an interpreter or compiled.
+ * This class takes the token buffer produced by the scanner and
+ * parses it into a syntax tree, producing expressions and statements
+ * that can be executed by an interpreter or compiled. Tokens are
+ * referred to by index while parsing, and only the names and operators
+ * kept by the tree are copied out of the buffer. A parser over a streaming
+ * scanner pulls tokens as it needs them and hands out one top-level
+ * declaration at a time.
  */
 class Parser {
-    const std::vector<Token> tokens; ///< List of tokens to parse.
-    int current = 0; ///< Current position in the list of tokens.
+    const TokenBuffer& tokens; ///< Tokens to parse, must outlive the parser.
+    uint32_t current = 0; ///< Index of the current token.
+    Scanner* stream = nullptr; ///< Scanner pulled from on demand, null if every token is scanned.
+    bool parsedFunction = false; ///< Set once a function is parsed since the last discard.
+    size_t lineCursor = 0; ///< Newlines before the last token built, where line lookups start.
+    uint32_t limit = UINT32_MAX; ///< Index of the token read as the end of the file, past the buffer if none.
+    bool checked = false; ///< Set if the pre-parser checked the tokens, so function bodies are only brace matched.
+    static bool lazyFunctions; ///< Set to keep function bodies as text until first called.
+
+    friend class PreParser;
 
 public:
     /**
-     * @brief Constructs a Parser with a vector of tokens.
+     * @brief Constructs a Parser over a buffer of tokens.
+     * 
+     * @param tokens Buffer of tokens to be parsed.
+     */
+    Parser(const TokenBuffer& tokens) : tokens(tokens) {}
+
+    /**
+     * @brief Constructs a Parser over a range of a buffer of tokens.
+     * 
+     * The token at the limit reads as the end of the file, so the range
+     * parses as a script of its own.
      * 
-     * @param tokens Vector of tokens to be parsed.
+     * @param tokens Buffer of tokens to be parsed.
+     * @param first Index of the first token to parse.
+     * @param limit Index of the token after the range.
      */
-    Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+    Parser(const TokenBuffer& tokens, uint32_t first, uint32_t limit)
+        : tokens(tokens), current(first), lineCursor(tokens.newlinesBefore(tokens.offset(first))), limit(limit) {}
+
+    /**
+     * @brief Constructs a Parser pulling tokens from a streaming scanner.
+     * 
+     * @param stream Scanner reading the source on demand.
+     */
+    explicit Parser(Scanner& stream) : tokens(stream.getTokens()), stream(&stream) {}
 
     /**
      * @brief Parses the token list into a list of statements.
@@ -36,6 +70,52 @@ public:
      */
     std::vector<std::shared_ptr<Stmt>> parse();
 
+    /**
+     * @brief Parses the tokens as a single expression.
+     * 
+     * @return The expression, null after a syntax error or if tokens follow it.
+     */
+    std::unique_ptr<Expr> parseExpression();
+
+    /**
+     * @brief Parses the next top-level declaration.
+     * 
+     * When streaming, the tokens and text of the declarations returned before
+     * are dropped first, so they must have finished running.
+     * 
+     * @param statement Set to the parsed declaration, null after a syntax error.
+     * @return False if the end of the input was reached.
+     */
+    bool parseDeclaration(std::shared_ptr<Stmt>& statement);
+
+    /**
+     * @brief Parses the statements of a function body the pre-parser has checked.
+     * 
+     * Functions declared in the body were checked along with it, so their
+     * bodies are only brace matched to be kept as text.
+     * 
+     * @return A vector of parsed statements.
+     */
+    std::vector<std::shared_ptr<Stmt>> parseChecked();
+
+    /**
+     * @brief Chooses when function bodies are parsed.
+     * 
+     * Lazy bodies are checked by the pre-parser when declared, and parsed the
+     * first time their function is called. Bodies with syntax errors are
+     * always parsed when declared, so the errors are reported.
+     * 
+     * @param lazy True to parse bodies on first call, false to parse them when declared.
+     */
+    static void setLazyFunctions(bool lazy);
+
+    /**
+     * @brief Checks when function bodies are parsed.
+     * 
+     * @return True if bodies are parsed on first call.
+     */
+    static bool getLazyFunctions();
+
 private:
     // High-level parsing functions
 
@@ -51,7 +131,8 @@ private:
     std::shared_ptr<Stmt> statement();
     std::shared_ptr<Stmt> declaration();
     std::vector<std::shared_ptr<Stmt>> block();
-    std::shared_ptr<Stmt> function(const std::string& kind);
+    std::shared_ptr<Stmt> function(const char* kind);
+    std::shared_ptr<FunctionBody> lazyBody(uint32_t open);
     std::shared_ptr<Stmt> returnStatement();
     std::shared_ptr<Stmt> ifStatement();
     std::shared_ptr<Stmt> whileStatement();
@@ -63,25 +144,67 @@ private:
     // Expression parsing functions
 
     /**
-     * @brief These methods parse different types of expressions.
+     * @brief Binding strength of the operators, from loosest to tightest.
+     */
+    enum class Precedence : unsigned char {
+        NONE, ASSIGNMENT, OR, AND, EQUALITY, COMPARISON, TERM, FACTOR, UNARY, CALL, PRIMARY
+    };
+
+    using PrefixRule = std::unique_ptr<Expr> (Parser::*)();
+    using InfixRule = std::unique_ptr<Expr> (Parser::*)(std::unique_ptr<Expr> left);
+
+    /**
+     * @struct ParseRule
+     * @brief How a token type parses at the start of an expression and after one.
+     */
+    struct ParseRule {
+        PrefixRule prefix = nullptr; ///< Parses an expression starting with the token, null if none can.
+        InfixRule infix = nullptr; ///< Parses the token as an operator after its left operand, null if it is not one.
+        Precedence precedence = Precedence::NONE; ///< Binding strength of the token as an operator.
+    };
+
+    static constexpr std::array<ParseRule, TOKEN_TYPE_COUNT> buildRules();
+    static const std::array<ParseRule, TOKEN_TYPE_COUNT> RULES; ///< Rule of each token type, indexed by type.
+
+    /**
+     * @brief Parses an expression with a Pratt parser driven by RULES.
+     * 
+     * The prefix rule of the first token parses the start of the expression,
+     * then each following operator binding at least as tightly as the given
+     * precedence takes the expression so far as its left operand.
      * 
-     * The methods return a unique pointer to a parsed expression, handling
-     * operations like assignments, logical expressions, equality checks, comparisons,
-     * arithmetic operations, unary operations, and primary expressions.
+     * @param precedence The loosest operator precedence to include.
+     * @return A unique pointer to the parsed expression.
+     */
+    std::unique_ptr<Expr> parsePrecedence(Precedence precedence);
+
+    /**
+     * @brief Parses a whole expression, assignments included.
      * 
      * @return A unique pointer to the parsed expression.
      */
     std::unique_ptr<Expr> expression();
-    std::unique_ptr<Expr> assignment();
-    std::unique_ptr<Expr> logicalOr();
-    std::unique_ptr<Expr> logicalAnd();
-    std::unique_ptr<Expr> equality();
-    std::unique_ptr<Expr> comparison();
-    std::unique_ptr<Expr> term();
-    std::unique_ptr<Expr> factor();
+
+    /**
+     * @brief Prefix rules, called with the first token of the expression consumed.
+     * 
+     * @return A unique pointer to the parsed expression.
+     */
+    std::unique_ptr<Expr> grouping();
     std::unique_ptr<Expr> unary();
-    std::unique_ptr<Expr> primary();
-    std::unique_ptr<Expr> call();
+    std::unique_ptr<Expr> literal();
+    std::unique_ptr<Expr> variable();
+
+    /**
+     * @brief Infix rules, called with the operator consumed.
+     * 
+     * @param left The left operand or callee parsed so far.
+     * @return A unique pointer to the parsed expression.
+     */
+    std::unique_ptr<Expr> assignment(std::unique_ptr<Expr> left);
+    std::unique_ptr<Expr> logical(std::unique_ptr<Expr> left);
+    std::unique_ptr<Expr> binary(std::unique_ptr<Expr> left);
+    std::unique_ptr<Expr> call(std::unique_ptr<Expr> left);
     std::unique_ptr<Expr> finishCall(std::unique_ptr<Expr> callee);
 
     // Utility functions
@@ -92,14 +215,16 @@ private:
      * These methods help in token management, error handling, and 
      * parser state management, facilitating the parsing process.
      */
-    Token consume(TokenType type, const std::string& message);
-    bool match(std::vector<TokenType> types);
+    uint32_t consume(TokenType type, const char* message);
+    bool match(std::initializer_list<TokenType> types);
     bool check(TokenType type);
-    Token advance();
+    uint32_t advance();
     bool isAtEnd();
-    Token peek();
-    Token previous();
-    ParseError error(Token token, const std::string& message);
+    uint32_t peek();
+    uint32_t previous();
+    TokenType typeAt(uint32_t index);
+    Token token(uint32_t index);
+    ParseError error(uint32_t token, const std::string& message);
     void synchronize();
 };
 
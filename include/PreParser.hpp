@@ -0,0 +1,77 @@
+#ifndef PREPARSER_HPP
+#define PREPARSER_HPP
+
+#include "Parser.hpp"
+
+/**
+ * @class PreParser
+ * @brief Checks the syntax of a function body without building its tree
+ *
+ * The pre-parser walks the same grammar as the Parser, driven by the same
+ * operator table, but only moves over the tokens and keeps no nodes. It stops
+ * at the first syntax error without reporting it: the Parser then parses the
+ * body itself, so errors are reported and recovered from exactly as if the
+ * body had never been pre-parsed. A body without errors is kept as text and
+ * parsed the first time its function is called.
+ */
+class PreParser {
+    const TokenBuffer& tokens; // Tokens to check, must outlive the pre-parser
+    Scanner* stream; // Scanner pulled from on demand, null if every token is scanned
+    uint32_t current; // Index of the current token
+    uint32_t limit; // Index of the token read as the end of the file
+
+    using Precedence = Parser::Precedence;
+
+    // Thrown at the first syntax error, which the Parser reports
+    struct Failure {};
+
+public:
+    /**
+     * @brief Constructs a pre-parser starting inside a function body
+     *
+     * @param tokens Buffer of tokens to check.
+     * @param stream Scanner the parser pulls tokens from, null if every token is scanned.
+     * @param first Index of the first token after the opening brace.
+     * @param limit Index of the token read as the end of the file.
+     */
+    PreParser(const TokenBuffer& tokens, Scanner* stream, uint32_t first, uint32_t limit)
+        : tokens(tokens), stream(stream), current(first), limit(limit) {}
+
+    /**
+     * @brief Checks the statements of the body and finds its closing brace
+     *
+     * @param close Set to the index of the closing brace if the body is free of errors.
+     * @return False if the Parser would report a syntax error in the body.
+     */
+    bool body(uint32_t& close);
+
+private:
+    /**
+     * @brief Check the statements and declarations the parser methods of the same names parse.
+     */
+    void declaration();
+    void statement();
+    void block();
+    void function();
+    void forStatement();
+    void varDeclaration();
+
+    /**
+     * @brief Checks an expression, see Parser::parsePrecedence.
+     *
+     * @param precedence The loosest operator precedence to include.
+     * @return True if the expression is a variable, the only valid assignment target.
+     */
+    bool expression(Precedence precedence = Precedence::ASSIGNMENT);
+
+    /**
+     * @brief Token helpers, see the parser methods of the same names.
+     */
+    void consume(TokenType type);
+    bool match(TokenType type);
+    bool check(TokenType type);
+    void advance();
+    TokenType typeAt(uint32_t index);
+};
+
+#endif // PREPARSER_HPP
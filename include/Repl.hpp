@@ -0,0 +1,80 @@
+#ifndef REPL_HPP
+#define REPL_HPP
+
+#include "LoxVM.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @class Repl
+ * @brief An interactive session whose globals and functions persist from one entry to the next
+ *
+ * Each entry is compiled on its own and run in the same isolate, so it costs
+ * the time to scan, parse and run the new lines only, however long the
+ * session has been going. The programs of earlier entries stay alive, since
+ * the functions they declared point into their trees. Lines are buffered
+ * until they form complete declarations, so a function or block may span
+ * several lines.
+ */
+class Repl {
+    LoxVM vm; // Compiles each entry
+    std::unique_ptr<Isolate> isolate; // Holds the globals, heap and programs of the session
+    std::string pending; // Lines read so far that are not yet complete
+
+public:
+    /**
+     * @brief Starts a session printing to standard output and reporting errors to standard error
+     *
+     * @param config The sizes of the session's heap
+     */
+    explicit Repl(const HeapConfig& config = HeapConfig());
+
+    /**
+     * @brief Sets where the values printed by entries go
+     *
+     * @param sink Called with the text of each printed value
+     */
+    void setOutput(Sink sink);
+
+    /**
+     * @brief Sets where syntax and runtime errors are reported
+     *
+     * @param sink Called with the syntax errors of an entry that cannot run, and each runtime error
+     */
+    void setErrors(Sink sink);
+
+    /**
+     * @brief Adds a line of input, running the pending lines once they are complete
+     *
+     * Input is incomplete while every syntax error it has is at its end, such
+     * as an unclosed block or string or a missing semicolon, and then waits
+     * for more lines. Any other syntax error is reported at once.
+     *
+     * @param line The line, without its newline
+     * @return True if the input is incomplete and more lines are needed
+     */
+    bool feed(std::string_view line);
+
+    /**
+     * @brief Runs the pending lines even though they are incomplete, reporting their syntax errors
+     */
+    void flush();
+
+    /**
+     * @brief Gets the heap owning the session's runtime objects
+     *
+     * @return A reference to the heap
+     */
+    Heap& getHeap();
+
+private:
+    /**
+     * @brief Runs the pending lines and clears them
+     *
+     * @param program The pending lines, compiled
+     */
+    void run(std::shared_ptr<const Program> program);
+};
+
+#endif // REPL_HPP
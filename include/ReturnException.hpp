@@ -2,17 +2,17 @@
 #define RETURN_HPP
 
 #include "Token.hpp"
+#include "Value.hpp"
 #include <stdexcept>
 #include <memory>
 
 
 class ReturnException : public std::runtime_error {
 public:
-    ReturnException(std::shared_ptr<void> &value, TokenType type)
-        : std::runtime_error("Return statement"), value(value), type(type) {}
+    ReturnException(const Value& value)
+        : std::runtime_error("Return statement"), value(value) {}
 
-    std::shared_ptr<void> value;
-    TokenType type;
+    Value value;
 };
 
 #endif // !RETURN_HPP
\ No newline at end of file
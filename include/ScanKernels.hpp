@@ -0,0 +1,86 @@
+#ifndef SCANKERNELS_HPP
+#define SCANKERNELS_HPP
+
+#include "TokenBuffer.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * @struct ScanKernels
+ * @brief Routines skipping the long runs of characters the scanner sees most
+ *
+ * Each routine starts at a position in the source and returns the position of
+ * the first character that ends the run, or the end of the source. The SIMD
+ * versions classify 16 or 32 bytes per step and fall back to the scalar loop
+ * for the last few bytes. Routines that can cross newlines record them in the
+ * token buffer from the comparison masks, so lines are counted in bulk too.
+ * The best set supported by the CPU is picked at runtime.
+ */
+struct ScanKernels {
+    const char* name; // Instruction set the kernels are written for
+
+    /**
+     * @brief Skips spaces, tabs, carriage returns and newlines
+     *
+     * @param data The source code
+     * @param pos The first position to examine
+     * @param end The length of the source
+     * @param tokens The buffer recording the newlines skipped
+     * @return The position of the first other character
+     */
+    size_t (*skipWhitespace)(const char* data, size_t pos, size_t end, TokenBuffer& tokens);
+
+    /**
+     * @brief Finds the newline ending a line comment
+     *
+     * @param data The source code
+     * @param pos The first position to examine
+     * @param end The length of the source
+     * @return The position of the newline, not consumed
+     */
+    size_t (*findNewline)(const char* data, size_t pos, size_t end);
+
+    /**
+     * @brief Finds the quote closing a string literal
+     *
+     * @param data The source code
+     * @param pos The first position to examine
+     * @param end The length of the source
+     * @param tokens The buffer recording the newlines inside the string
+     * @return The position of the quote, not consumed
+     */
+    size_t (*findQuote)(const char* data, size_t pos, size_t end, TokenBuffer& tokens);
+
+    /**
+     * @brief Skips letters, digits and underscores
+     *
+     * @param data The source code
+     * @param pos The first position to examine
+     * @param end The length of the source
+     * @return The position of the first character that cannot continue an identifier
+     */
+    size_t (*skipIdentifier)(const char* data, size_t pos, size_t end);
+
+    /**
+     * @brief Gets the fastest kernels supported by the CPU
+     *
+     * @return The AVX2, SSE2 or scalar kernels
+     */
+    static const ScanKernels& best();
+
+    /**
+     * @brief Gets the portable byte at a time kernels
+     *
+     * @return The scalar kernels
+     */
+    static const ScanKernels& scalar();
+
+    /**
+     * @brief Gets every kernel set the CPU supports, scalar first
+     *
+     * @return The supported kernels, slowest to fastest
+     */
+    static std::vector<const ScanKernels*> available();
+};
+
+#endif // SCANKERNELS_HPP
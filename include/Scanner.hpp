@@ -1,42 +1,146 @@
 #ifndef SCANNER_HPP
 #define SCANNER_HPP
 
-#include "Token.hpp"
+#include "TokenBuffer.hpp"
+#include "ScanKernels.hpp"
+#include <istream>
+#include <memory>
 #include <string>
 #include <vector>
-#include <unordered_map>
+
+/**
+ * @struct ScanError
+ * @brief A syntax error found while scanning, held back to be reported in order
+ */
+struct ScanError {
+    size_t offset; // Position in the source the error was found at
+    std::string message; // Description of the error
+};
 
 /**
  * @class Scanner
  * @brief Scans the source code and returns a vector of tokens
  * 
- * The Scanner class goes through the raw source code and creates a vector of tokens
- * to be used by the parser
+ * The Scanner class goes through the raw source code and fills a TokenBuffer
+ * to be used by the parser. Runs of whitespace, comments, string bodies and
+ * identifiers are skipped with the SIMD kernels the CPU supports.
  * 
+ * A scanner constructed over a stream scans on demand instead: the parser asks
+ * for tokens through ensure(), the input is read in growing chunks into a
+ * window, and discard() drops the text and tokens the parser is done with.
+ * A token that reaches the end of the window is scanned again once more input
+ * has been read, so tokens never depend on how the input was split. Windows
+ * holding the text of a function are kept, since its body points into them.
  */
 class Scanner {
 private:
-    const std::string source; // Source code to scan
-    std::vector<Token> tokens; // List of tokens
-    int start = 0; // Start position of current lexeme being scanned
-    int current = 0; // Current position of the scanner
-    int line = 1; // Current line number being scanned
-    static const std::unordered_map<std::string, TokenType> keywords; // Map of reserved keywords and their token types
+    TokenBuffer tokens; // Tokens scanned so far
+    std::string_view source; // Source code to scan, borrowed from the caller
+    const ScanKernels& kernels; // Routines skipping long runs of characters
+    size_t start = 0; // Start position of current lexeme being scanned
+    size_t current = 0; // Current position of the scanner
+    std::istream* input = nullptr; // Stream the source is read from, null if the source is in memory
+    bool inputDone = false; // Set once the stream has been read to its end
+    std::unique_ptr<std::string> window; // Text read from the stream, the source is its undiscarded end
+    bool keepWindow = false; // Set if a function was parsed from the window and its text must be kept
+    std::vector<std::unique_ptr<std::string>> superseded; // Earlier windows the current tokens may still point into
+    std::vector<std::unique_ptr<std::string>> retained; // Windows kept alive for functions declared in them
+    static constexpr size_t CHUNK_SIZE = 64 * 1024; // Smallest read from the stream
+    std::vector<ScanError>* deferredErrors = nullptr; // Errors are collected here instead of reported if set
     
 public:
     /**
      * @brief Constructs a new Scanner object with the given source code
      * 
-     * @param source The source code to scan 
+     * @param source The source code to scan, must outlive the tokens
+     * @param kernels The routines used to skip runs of characters, the fastest available by default
+     */
+    Scanner(std::string_view source, const ScanKernels& kernels = ScanKernels::best())
+        : tokens(source), source(source), kernels(kernels) {}
+
+    /**
+     * @brief Constructs a new Scanner object over part of a script
+     * 
+     * @param source The source code to scan, must outlive the tokens
+     * @param firstLine The line number of the start of the source
+     * @param kernels The routines used to skip runs of characters, the fastest available by default
+     */
+    Scanner(std::string_view source, int firstLine, const ScanKernels& kernels = ScanKernels::best())
+        : tokens(source, firstLine), source(source), kernels(kernels) {}
+
+    /**
+     * @brief Constructs a new Scanner reading its source from a stream on demand
+     * 
+     * @param input The stream to read, must outlive the scanner
+     * @param kernels The routines used to skip runs of characters, the fastest available by default
+     */
+    explicit Scanner(std::istream& input, const ScanKernels& kernels = ScanKernels::best());
+
+    /**
+     * @brief Scans until the token at the given index exists or the input ends
+     * 
+     * @param index The index of the token needed by the parser
+     */
+    void ensure(uint32_t index);
+
+    /**
+     * @brief Drops the tokens before the given index and the text they were scanned from
+     * 
+     * The remaining tokens are renumbered from zero. Text that syntax trees
+     * still point into must be kept.
+     * 
+     * @param count The number of tokens to drop
+     * @param keepText True to keep the dropped text alive for the rest of the run
      */
-    Scanner(const std::string& source) : source(source) {}
+    void discard(uint32_t count, bool keepText);
 
     /**
-     * @brief Scans the source code and returns a vector of tokens
+     * @brief Gets the tokens scanned so far
      * 
-     * @return std::vector<Token> 
+     * @return The token buffer, which stays at the same address while streaming
      */
-    std::vector<Token> scanTokens();
+    const TokenBuffer& getTokens() const {
+        return tokens;
+    }
+
+    /**
+     * @brief Scans the tokens starting in a range of the source
+     * 
+     * The last token is completed even if it runs past the limit. Errors are
+     * collected instead of reported.
+     * 
+     * @param from The position to start scanning at, where a token or whitespace begins
+     * @param limit The position no further token may start at
+     * @param errors Receives the errors found, with their positions
+     */
+    void scanRange(size_t from, size_t limit, std::vector<ScanError>& errors);
+
+    /**
+     * @brief Gets the position the scanner stopped at
+     * 
+     * @return The position after the last character consumed
+     */
+    size_t position() const {
+        return current;
+    }
+
+    /**
+     * @brief Moves the tokens scanned so far out of the scanner
+     * 
+     * @return The tokens, without an END_OF_FILE token
+     */
+    TokenBuffer takeTokens() {
+        return std::move(tokens);
+    }
+
+    /**
+     * @brief Scans the source code and returns the buffer of tokens
+     * 
+     * The buffer is moved out of the scanner, so this can only be called once.
+     * 
+     * @return TokenBuffer The tokens, ending with an END_OF_FILE token
+     */
+    TokenBuffer scanTokens();
 
     /**
      * @brief Checks if the scanner is at the end of the source code
@@ -65,12 +169,37 @@ public:
     void addToken(const TokenType type);
 
     /**
-     * @brief Adds a token of the given type and literal value to the list of tokens
+     * @brief Checks if more text can still be read from the stream
      * 
-     * @param type The type of token to add
-     * @param literal The literal value of the token
+     * @return True if the end of the window is not the end of the input
+     */
+    bool hasMoreInput() const;
+
+    /**
+     * @brief Reads the next chunk of the stream into a larger window
+     * 
+     * @return True if any text was read
+     */
+    bool refill();
+
+    /**
+     * @brief Reports or collects a syntax error at the current position
+     * 
+     * @param message The error message
+     */
+    void error(const std::string& message);
+
+    /**
+     * @brief Records the newline just consumed for line numbers
+     */
+    void newline();
+
+    /**
+     * @brief Gets the line of the current position
+     * 
+     * @return The 1-based line number
      */
-    void addToken(const TokenType type, std::shared_ptr<void> literal);
+    int line() const;
 
     /**
      * @brief Checks if the current character matches the expected character
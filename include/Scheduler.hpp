@@ -0,0 +1,180 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "Coroutine.hpp"
+#include "LoxVM.hpp"
+#include "TaskPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class Scheduler
+ * @brief Runs many programs at once on a few threads, taking turns after a budget of statements
+ *
+ * Each program started runs in a context of its own: an interpreter with its
+ * own globals, heap and sinks, and a coroutine whose stack holds the
+ * interpreter's frames while it waits for its next turn. Once a context has
+ * executed its budget of statements and loop iterations it yields, and its
+ * thread resumes the context that has waited longest, so a long loop never
+ * holds back the others for more than one slice.
+ *
+ * A context stays on the thread it was started on, the least loaded one at
+ * that time, since the interpreter keeps per-thread state. Natives that block,
+ * such as sleep, recv and join, block the thread and every context on it, so
+ * contexts meant to wait on each other belong in separate schedulers or tasks.
+ */
+class Scheduler {
+public:
+    /**
+     * @struct Stats
+     * @brief Counters and latencies of the slices run so far
+     */
+    struct Stats {
+        size_t started = 0; // Programs started, including those that could not compile
+        size_t finished = 0; // Programs that have stopped running
+        uint64_t slices = 0; // Turns contexts were given
+        uint64_t preemptions = 0; // Turns that ended with the budget spent rather than the program
+        double meanSliceUs = 0; // Mean length of a turn, in microseconds
+        double p99SliceUs = 0; // Length 99 turns in 100 stay below
+        double maxSliceUs = 0; // Longest turn
+        double p99WaitUs = 0; // Time 99 contexts in 100 waited below between their turns
+    };
+
+    /**
+     * @brief Starts the threads
+     *
+     * @param threads The number of threads, 0 for one per hardware thread
+     * @param budget Statements and loop iterations a context runs per turn, at least 1
+     * @param config The sizes of the contexts' heaps
+     */
+    Scheduler(unsigned threads, uint64_t budget, const HeapConfig& config = HeapConfig());
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /**
+     * @brief Waits for every program started to finish, then stops the threads
+     */
+    ~Scheduler();
+
+    /**
+     * @brief Starts running a program in a new context
+     *
+     * A program with syntax errors reports them and finishes at once.
+     *
+     * @param program The compiled program
+     * @param output Called with the text of each printed value, on the context's thread
+     * @param errors Called with the syntax errors or the runtime error, on the context's thread
+     * @return An identifier to wait for the program with, counting up from 0
+     */
+    size_t start(std::shared_ptr<const Program> program, Sink output, Sink errors);
+
+    /**
+     * @brief Waits for a program to finish
+     *
+     * @param id The identifier start() returned
+     * @return How the run ended
+     */
+    RunStatus wait(size_t id);
+
+    /**
+     * @brief Waits for every program started so far to finish
+     */
+    void waitAll();
+
+    /**
+     * @brief Gets the counters and latencies so far, while the programs run or after
+     *
+     * @return The statistics, merged from every thread
+     */
+    Stats getStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct Histogram
+     * @brief Counts of durations in buckets growing by an eighth of a power of two
+     */
+    struct Histogram {
+        static constexpr int SUB_BUCKETS = 8; // Buckets per power of two, so a bucket spans at most 12.5% of its value
+        static constexpr int BUCKETS = 64 * SUB_BUCKETS;
+
+        std::vector<uint64_t> counts = std::vector<uint64_t>(BUCKETS); // Durations per bucket
+        uint64_t total = 0; // Number of durations
+        uint64_t sumNs = 0; // Sum of the durations
+        uint64_t maxNs = 0; // Longest duration
+
+        void record(uint64_t ns);
+        void merge(const Histogram& other);
+
+        // Upper bound of the bucket holding the given fraction of durations, in microseconds
+        double percentileUs(double fraction) const;
+    };
+
+    /**
+     * @struct Context
+     * @brief A running program with its interpreter and the stack it is suspended on
+     */
+    struct Context {
+        size_t id; // Identifier returned by start()
+        std::shared_ptr<const Program> program; // The program, whose tree the interpreter runs
+        Interpreter interpreter; // Globals, heap and sinks of the program
+        Coroutine coroutine; // Runs the program, yielding when the budget is spent
+        TaskPool::ThreadState poolState; // Tasks the program is in the middle of, while suspended
+        RunStatus status = RunStatus::OK; // How the run ended
+        Clock::time_point queuedAt; // When it last became ready to run
+
+        Context(size_t id, std::shared_ptr<const Program> program, const HeapConfig& config);
+    };
+
+    /**
+     * @struct Lane
+     * @brief A thread and the contexts taking turns on it
+     */
+    struct Lane {
+        std::thread thread; // Runs the turns
+        std::mutex lock; // Guards the queue, the histograms and stopping
+        std::condition_variable ready; // Signals a context queued or the lane stopping
+        std::deque<std::unique_ptr<Context>> queue; // Contexts waiting for a turn, oldest first
+        std::atomic<size_t> load{0}; // Contexts on the lane, running or queued
+        Histogram slices; // Lengths of the turns
+        Histogram waits; // Times between a context becoming ready and its turn
+        uint64_t preemptions = 0; // Turns that ended with the budget spent
+        bool stopping = false; // Set once the lane should return when it is idle
+    };
+
+    const uint64_t budget; // Statements and loop iterations per turn
+    const HeapConfig config; // Heap sizes of the contexts
+    std::vector<std::unique_ptr<Lane>> lanes; // One per thread
+
+    mutable std::mutex lock; // Guards the outcomes
+    std::condition_variable changed; // Signals a program finished
+    std::vector<RunStatus> statuses; // How each program ended, by identifier
+    std::vector<bool> done; // Which programs have finished, by identifier
+    size_t finished = 0; // Number of finished programs
+
+    /**
+     * @brief Gives the contexts of a lane turns until it stops
+     *
+     * @param lane The lane
+     */
+    void run(Lane& lane);
+
+    /**
+     * @brief Records how a program ended and wakes those waiting for it
+     *
+     * @param id The identifier of the program
+     * @param status How it ended
+     */
+    void finish(size_t id, RunStatus status);
+};
+
+#endif // SCHEDULER_HPP
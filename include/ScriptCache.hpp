@@ -0,0 +1,103 @@
+#ifndef SCRIPTCACHE_HPP
+#define SCRIPTCACHE_HPP
+
+#include "Source.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Stmt;
+
+/**
+ * @class ScriptCache
+ * @brief Directory of parsed scripts saved as images, so unchanged scripts skip the scanner and parser
+ *
+ * An image holds the strings the tokens and literals of a script refer to,
+ * followed by its syntax tree encoded as a stream of bytes. Positions in it are
+ * offsets, so it is mapped read-only as it is and decoded in one pass, with the
+ * tokens of the tree viewing the strings in the mapping. Function bodies not
+ * parsed yet are stored as ranges of the script text, so they stay lazy on a
+ * hit and view the script itself. Images are named after a hash of the script
+ * text seeded with the interpreter version, and also record the length and
+ * hash of the text, the version and a checksum of their contents. An image
+ * that does not match its script or is damaged counts as a miss, and is
+ * replaced once the script is parsed again.
+ *
+ * The directory is bounded in size. Loading an image updates its modification
+ * time, and saving one removes the images used least recently until the
+ * others fit in the limit again.
+ */
+class ScriptCache {
+    std::string directory; // Directory holding the images
+    uint64_t maxBytes; // Total size of the images kept
+    uint64_t version; // Hash of the interpreter version and image format, seeding the script hashes
+
+public:
+    static constexpr uint32_t FORMAT = 2; // Layout of the images, bumped whenever it or the syntax tree changes
+
+    static constexpr uint64_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024; // Total size of the images kept when no limit is given
+
+    /**
+     * @brief Constructs a cache over the given directory
+     *
+     * @param directory The directory holding the images, created when the first one is saved
+     * @param maxBytes The total size of the images kept, the least recently used removed first
+     */
+    explicit ScriptCache(std::string directory, uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+    /**
+     * @brief Gets the directory used when none is given
+     *
+     * @return $XDG_CACHE_HOME/cpplox, or ~/.cache/cpplox, or empty if neither variable is set
+     */
+    static std::string defaultDirectory();
+
+    /**
+     * @brief Loads the statements of a script from its image
+     *
+     * @param source The text of the script
+     * @param statements Set to the statements of the script on a hit
+     * @return The mapped image the tokens of the statements view, null on a miss
+     */
+    std::unique_ptr<Source> load(std::string_view source, std::vector<std::shared_ptr<Stmt>>& statements) const;
+
+    /**
+     * @brief Saves the statements of a script as its image
+     *
+     * The image is written to a temporary file and renamed over the old one,
+     * so other runs never see a partial image. Failing to write is ignored,
+     * the script is parsed again next time. Images used least recently are
+     * then removed until the directory fits in its limit.
+     *
+     * @param source The text of the script
+     * @param statements The statements parsed from the script, without syntax errors
+     */
+    void store(std::string_view source, const std::vector<std::shared_ptr<Stmt>>& statements) const;
+
+    /**
+     * @brief Hashes bytes with 64-bit xxHash
+     *
+     * @param data The bytes to hash
+     * @param seed The value the hash starts from
+     * @return The hash of the bytes
+     */
+    static uint64_t hash(std::string_view data, uint64_t seed = 0);
+
+private:
+    /**
+     * @brief Gets the path of the image of a script
+     *
+     * @param key The hash of the script text
+     * @return The path of the image in the cache directory
+     */
+    std::string pathOf(uint64_t key) const;
+
+    /**
+     * @brief Removes the images with the oldest modification times until the rest fit in the limit
+     */
+    void evict() const;
+};
+
+#endif // SCRIPTCACHE_HPP
@@ -0,0 +1,160 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "LoxVM.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct ServeRequest
+ * @brief A script to run on a server, given by path or as source text
+ */
+struct ServeRequest {
+    std::string path; // Path of the script, read by the server, so best absolute
+    std::string source; // Source text, run instead of the file if the path is empty
+    std::vector<std::string> arguments; // Bound as argc, arg0, arg1 and so on
+};
+
+/**
+ * @class Server
+ * @brief Runs scripts sent over a Unix domain socket, without a process per run
+ *
+ * Each connection carries one request and gets back what the script prints
+ * as it prints it, what it reports as errors, and its exit status: 0, 1 if
+ * the file cannot be read, 65 for a syntax error or 70 for a runtime error.
+ * Requests are handled by worker threads started once, each request in an
+ * isolate of its own. Compiled programs are cached by the hash of their text,
+ * so a script sent again skips scanning and parsing.
+ *
+ * Messages in both directions are frames of a type byte, a 32-bit length in
+ * host order and the payload. A request is a path (P) or source (S) frame,
+ * any argument (A) frames and a run (R) frame. The reply is output (O) and
+ * error (E) frames, in the order the script wrote them, then an exit (X)
+ * frame holding the status as a 32-bit integer.
+ */
+class Server {
+public:
+    /**
+     * @struct Stats
+     * @brief Counters of the requests served
+     */
+    struct Stats {
+        uint64_t requests = 0; // Requests that ran or failed to
+        uint64_t cacheHits = 0; // Programs found in the cache
+        uint64_t cacheMisses = 0; // Programs compiled
+    };
+
+    static constexpr size_t CACHE_PROGRAMS = 1024; // Programs kept, the least recently used dropped first
+    static constexpr long REQUEST_TIMEOUT_SECONDS = 10; // Default time a client may take to send a request or to read each reply
+
+    /**
+     * @brief Constructs a server, which does not listen yet
+     *
+     * @param socketPath Path of the socket to create
+     * @param jobs The number of requests run at the same time, 0 for one per core
+     * @param config The heap sizes of each request's isolate
+     */
+    Server(std::string socketPath, unsigned jobs, const HeapConfig& config = HeapConfig());
+
+    /**
+     * @brief Stops the server if it is serving and removes the socket
+     */
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /**
+     * @brief Creates the socket, replacing a stale file at its path, and starts the workers
+     *
+     * @param error Receives the reason if listening failed
+     * @return True if the server is listening
+     */
+    bool listen(std::string& error);
+
+    /**
+     * @brief Accepts connections until stop is called, then waits for the requests running
+     */
+    void serve();
+
+    /**
+     * @brief Makes serve return, safe to call from a signal handler
+     */
+    void stop();
+
+    /**
+     * @brief Sets how long a client may leave a worker waiting, for connections accepted from then on
+     *
+     * A request not received in time is dropped, and a reply the client does
+     * not read in time is cut off, the script running on without output.
+     *
+     * @param seconds The time allowed, at least one second
+     */
+    void setRequestTimeout(long seconds);
+
+    /**
+     * @brief Gets the counters of the requests served so far
+     *
+     * @return A copy of the counters
+     */
+    Stats getStats() const;
+
+    /**
+     * @brief Sends a request to a server and waits for the script to finish
+     *
+     * @param socketPath Path of the server's socket
+     * @param request The script to run and its arguments
+     * @param output Called with the text the script prints, newlines included, as it arrives
+     * @param errors Called with the errors the script reports, newlines included
+     * @return The exit status of the script, or 1 if the server could not be reached
+     */
+    static int request(const std::string& socketPath, const ServeRequest& request, Sink output, Sink errors);
+
+private:
+    std::string socketPath; // Path of the socket
+    unsigned jobs; // Worker threads
+    LoxVM vm; // Compiles the programs and creates the isolates
+    int listener = -1; // Listening socket, -1 before listen
+    std::atomic<bool> stopping{false}; // Set by stop
+    std::atomic<long> timeoutSeconds{REQUEST_TIMEOUT_SECONDS}; // Time a client may take to send or read
+
+    std::mutex queueLock; // Guards the queue of connections
+    std::condition_variable queued; // Signals a connection or shutdown to the workers
+    std::deque<int> connections; // Accepted connections waiting for a worker
+    std::vector<std::thread> workers; // Threads running the requests
+
+    mutable std::mutex cacheLock; // Guards the cache and the counters
+    std::list<std::pair<size_t, std::shared_ptr<const Program>>> cache; // Programs by hash of their text, most recently used first
+    std::unordered_map<size_t, decltype(cache)::iterator> cacheIndex; // Cache entries by hash
+    Stats stats; // Counters of the requests served
+
+    /**
+     * @brief Takes connections off the queue and runs their requests until the server stops
+     */
+    void work();
+
+    /**
+     * @brief Reads a request from a connection, runs it and streams back the reply
+     *
+     * @param connection The connected socket, closed by the caller
+     */
+    void handle(int connection);
+
+    /**
+     * @brief Finds a program in the cache or compiles and caches it
+     *
+     * @param source The text of the script
+     * @return The compiled program
+     */
+    std::shared_ptr<const Program> compile(std::string source);
+};
+
+#endif // SERVER_HPP
@@ -0,0 +1,111 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "Heap.hpp"
+#include "LoxCallable.hpp"
+#include "Stmt.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Snapshot
+ * @brief A deep copy of a value that belongs to no heap
+ *
+ * Values cannot be shared between interpreters, since each heap moves and
+ * frees its objects on its own. A snapshot copies everything a value can
+ * reach into plain memory: strings as their characters, functions as their
+ * declaration and their closure, and natives through their copier.
+ *
+ * Environments are copied as the chain up to and including the globals, but
+ * holding only the variables some copied function can name: each name its
+ * body reads or assigns is looked up along its closure and copied from the
+ * first scope defining it. A task thus sees the variables it uses as they
+ * were when it was captured, the rest of the globals are neither copied nor
+ * visible to it, and a native that cannot be copied, such as a promise, only
+ * fails the capture if a copied function names the variable holding it.
+ * Objects reached along several paths are copied once, so sharing and cycles,
+ * such as a function stored in the environment it closes over, survive the
+ * copy.
+ *
+ * Several values captured together share the copies of what they both reach.
+ * A snapshot is captured on the thread owning the source heap and may be
+ * restored any number of times, on any thread, into any heap. Restoring does
+ * not reach a safepoint, so the objects it allocates need no rooting until
+ * the caller stores the value.
+ */
+class Snapshot {
+    static constexpr uint32_t NONE = UINT32_MAX; // Index of no object
+
+    /**
+     * @struct Slot
+     * @brief A copied value, with an index into the copied objects instead of a pointer
+     */
+    struct Slot {
+        TokenType type = TokenType::NIL; // Type tag of the value
+        double number = 0; // Payload of NUMBER values
+        uint32_t object = NONE; // Copied object of STRING and FUN values
+    };
+
+    /**
+     * @struct Object
+     * @brief A copied heap object, using the fields of its kind
+     */
+    struct Object {
+        ObjectKind kind; // Kind of the original object
+        std::string text; // Characters of a string
+        std::shared_ptr<const Function> declaration; // Declaration of a function
+        LoxCallable::Copier copy; // Copier of a native
+        std::vector<std::pair<std::string, Slot>> variables; // Variables of an environment that copied functions name
+        uint32_t link = NONE; // Closure of a function, or enclosing scope of an environment
+    };
+
+    std::vector<Object> objects; // Every object reachable from the values, in the order they were found
+    std::vector<Slot> roots; // The copied values
+
+public:
+    /**
+     * @brief Constructs a snapshot of nil
+     */
+    Snapshot() = default;
+
+    /**
+     * @brief Copies a value and everything it references
+     *
+     * @param value The value to copy
+     * @param heap The heap owning the value, used to flatten strings
+     * @return The snapshot of the value
+     * @throws NativeError if the value, or a variable a function it reaches names, holds a native that cannot be copied
+     */
+    static Snapshot capture(const Value& value, Heap& heap);
+
+    /**
+     * @brief Copies several values and everything they reference, once
+     *
+     * @param values The values to copy
+     * @param heap The heap owning the values, used to flatten strings
+     * @return The snapshot of the values
+     * @throws NativeError if a value, or a variable a function they reach names, holds a native that cannot be copied
+     */
+    static Snapshot capture(const std::vector<Value>& values, Heap& heap);
+
+    /**
+     * @brief Allocates a new copy of the value on a heap
+     *
+     * @param heap The heap receiving the copy
+     * @return The copied value, or the first of the copied values, referencing objects of the heap
+     */
+    Value restore(Heap& heap) const;
+
+    /**
+     * @brief Allocates a new copy of the values on a heap
+     *
+     * @param heap The heap receiving the copy
+     * @return The copied values in the order they were captured, referencing objects of the heap
+     */
+    std::vector<Value> restoreAll(Heap& heap) const;
+};
+
+#endif // SNAPSHOT_HPP
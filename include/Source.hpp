@@ -0,0 +1,69 @@
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @class Source
+ * @brief Owner of the text of a Lox program
+ *
+ * Scripts loaded from a file are mapped read-only into memory, so the text is
+ * never copied and the kernel can page it in and out as the scanner walks it.
+ * Token buffers and syntax trees refer into the text through string views, so
+ * the source must outlive every tree parsed from it. Text typed at the prompt
+ * or built in memory is owned as a string instead.
+ */
+class Source {
+    std::string owned; // Text of a source that is not mapped
+    const char* data; // First character of the text
+    size_t length; // Number of characters in the text
+    void* mapping = nullptr; // Start of the mapped file, null if the text is owned
+
+public:
+    /**
+     * @brief Constructs a source owning the given text
+     *
+     * @param text The source code
+     */
+    explicit Source(std::string text);
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+    /**
+     * @brief Unmaps the file, if any
+     */
+    ~Source();
+
+    /**
+     * @brief Maps a file read-only into memory
+     *
+     * Falls back to reading the file on platforms without mmap.
+     *
+     * @param path The path of the script
+     * @return The mapped source, or null if the file cannot be opened
+     */
+    static std::unique_ptr<Source> map(const std::string& path);
+
+    /**
+     * @brief Gets the text of the source
+     *
+     * @return A view of the whole text
+     */
+    std::string_view text() const {
+        return std::string_view(data, length);
+    }
+
+    /**
+     * @brief Checks if the text is mapped from a file
+     *
+     * @return True if the file is mapped, false if the text is owned
+     */
+    bool isMapped() const {
+        return mapping != nullptr;
+    }
+};
+
+#endif // SOURCE_HPP
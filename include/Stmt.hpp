@@ -2,7 +2,9 @@
 #define Stmt_HPP
 
 #include <memory>
+#include <vector>
 #include "Token.hpp"
+#include "FunctionBody.hpp"
 
 class Block ;
 class Expression ;
@@ -36,7 +38,7 @@ public:
     std::vector<std::shared_ptr<Stmt>> statements;
 
     Block (std::vector<std::shared_ptr<Stmt>> statements)
-        : statements(statements) {}
+        : statements(std::move(statements)) {}
 
     void accept(StmtVisitor& visitor) const override {
         return visitor.visitBlock (*this);
@@ -59,10 +61,10 @@ class Function  : public Stmt {
 public:
     Token name;
     std::vector<Token> params;
-    std::vector<std::shared_ptr<Stmt>> body;
+    std::shared_ptr<FunctionBody> body;
 
-    Function (Token name, std::vector<Token> params, std::vector<std::shared_ptr<Stmt>> body)
-        : name(name), params(params), body(body) {}
+    Function (Token name, std::vector<Token> params, std::shared_ptr<FunctionBody> body)
+        : name(name), params(std::move(params)), body(std::move(body)) {}
 
     void accept(StmtVisitor& visitor) const override {
         return visitor.visitFunction (*this);
@@ -76,7 +78,7 @@ public:
     std::shared_ptr<Stmt> elseBranch;
 
     If (std::unique_ptr<Expr> condition, std::shared_ptr<Stmt> thenBranch, std::shared_ptr<Stmt> elseBranch)
-        : condition(std::move(condition)), thenBranch(thenBranch), elseBranch(elseBranch) {}
+        : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
 
     void accept(StmtVisitor& visitor) const override {
         return visitor.visitIf (*this);
@@ -127,7 +129,7 @@ public:
     std::shared_ptr<Stmt> body;
 
     While (std::unique_ptr<Expr> condition, std::shared_ptr<Stmt> body)
-        : condition(std::move(condition)), body(body) {}
+        : condition(std::move(condition)), body(std::move(body)) {}
 
     void accept(StmtVisitor& visitor) const override {
         return visitor.visitWhile (*this);
@@ -0,0 +1,239 @@
+#ifndef TASKPOOL_HPP
+#define TASKPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class TaskPool
+ * @brief Work-stealing pool of threads running independent tasks
+ *
+ * Every worker owns a deque of tasks. A worker pushes the tasks it submits to
+ * the back of its own deque and takes work from the back too, so it runs the
+ * most recently spawned, cache-warm task first, while idle workers steal the
+ * oldest task from the front of another worker's deque. Threads outside the
+ * pool hand their tasks to the workers in turn.
+ *
+ * A task runs exactly once, on whichever thread claims it first. A thread
+ * waiting for a task that has not started runs it itself, and otherwise runs
+ * the queued tasks spawned by that task, directly or not, until it is done.
+ * Only those: an unrelated task could wait for something the waiting thread
+ * only provides once its own wait is over, such as a message on a channel,
+ * and would never return from under it. A thread blocked on anything else, such as a channel,
+ * says so with a Blocking scope, and the pool starts a spare thread that only
+ * steals, so the task that would unblock it is never stuck in a queue.
+ */
+class TaskPool {
+public:
+    /**
+     * @class Task
+     * @brief A unit of work, run once by the pool or by a thread waiting for it
+     */
+    class Task : public std::enable_shared_from_this<Task> {
+        std::function<void()> work; // Released once it has run, along with what it captured
+        std::atomic<int> state{QUEUED}; // QUEUED, RUNNING or DONE
+        std::shared_ptr<Task> parent; // Task running on the thread that submitted it, if any
+
+        static constexpr int QUEUED = 0;
+        static constexpr int RUNNING = 1;
+        static constexpr int DONE = 2;
+
+        friend class TaskPool;
+
+    public:
+        /**
+         * @brief Constructs a task
+         *
+         * @param work The work to run, must not throw
+         */
+        explicit Task(std::function<void()> work) : work(std::move(work)) {}
+
+        /**
+         * @brief Checks if a task was submitted by another one, or by one of its descendants
+         *
+         * @param ancestor The possible ancestor
+         * @return True if the ancestor is up the chain of parents
+         */
+        bool descendsFrom(const Task& ancestor) const {
+            for (const Task* task = parent.get(); task != nullptr; task = task->parent.get()) {
+                if (task == &ancestor) return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Checks if the task has finished
+         *
+         * Everything the work wrote is visible to the caller once this returns true.
+         *
+         * @return True once the work has run
+         */
+        bool isDone() const {
+            return state.load() == DONE;
+        }
+    };
+
+    /**
+     * @class Blocking
+     * @brief Marks the calling thread as blocked on something other than a task while it exists
+     */
+    class Blocking {
+        TaskPool& pool;
+
+    public:
+        /**
+         * @brief Counts the thread as blocked, starting a spare thread if there are fewer spares than blocked threads
+         *
+         * @param pool The pool whose tasks may be needed to unblock the thread
+         */
+        explicit Blocking(TaskPool& pool);
+
+        Blocking(const Blocking&) = delete;
+        Blocking& operator=(const Blocking&) = delete;
+
+        ~Blocking();
+    };
+
+    /**
+     * @struct ThreadState
+     * @brief What the pool tracks about the tasks running on a thread, per stack when a thread switches between stacks
+     */
+    struct ThreadState {
+        Task* task = nullptr; // Innermost task running
+        int helpDepth = 0; // Tasks run while waiting for others
+    };
+
+    /**
+     * @brief Exchanges the calling thread's state with a saved one
+     *
+     * Code running several stacks on one thread, any of which may be in the
+     * middle of a task, swaps the state in when it resumes a stack and out
+     * when the stack is suspended.
+     *
+     * @param state The state to resume, receives the state being suspended
+     */
+    static void swapThreadState(ThreadState& state);
+
+    /**
+     * @brief Starts the workers
+     *
+     * @param threads The number of workers, at least one
+     */
+    explicit TaskPool(unsigned threads);
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    /**
+     * @brief Runs every queued task, then stops and joins the workers and spare threads
+     */
+    ~TaskPool();
+
+    /**
+     * @brief Gets the pool shared by the interpreters of the process, starting it on first use
+     *
+     * @return The shared pool
+     */
+    static TaskPool& shared();
+
+    /**
+     * @brief Sets the number of workers of the shared pool
+     *
+     * A pool already started finishes its tasks and is replaced by one of the
+     * new size when next used, so this must not be called while tasks run.
+     *
+     * @param threads The number of workers, 0 for one per core
+     */
+    static void configure(unsigned threads);
+
+    /**
+     * @brief Gets the number of workers
+     *
+     * @return The number of threads of the pool
+     */
+    unsigned size() const {
+        return static_cast<unsigned>(workers.size());
+    }
+
+    /**
+     * @brief Queues a task, a child of the task running on the calling thread if there is one
+     *
+     * @param task The task to run, created with std::make_shared
+     */
+    void submit(std::shared_ptr<Task> task);
+
+    /**
+     * @brief Waits for a task to finish, running it or other tasks meanwhile
+     *
+     * @param task A task submitted to this pool
+     */
+    void wait(Task& task);
+
+private:
+    /**
+     * @struct Worker
+     * @brief A thread of the pool and the deque of tasks it owns
+     */
+    struct Worker {
+        std::mutex lock; // Guards the deque, taken by the owner and by thieves
+        std::deque<std::shared_ptr<Task>> tasks; // Owner end at the back, stolen from the front
+        std::thread thread; // Runs workerLoop
+    };
+
+    // Nesting of tasks run while waiting beyond which a thread blocks instead, bounding its stack
+    static constexpr int MAX_HELP_DEPTH = 64;
+
+    std::vector<std::unique_ptr<Worker>> workers; // Workers of the pool, one deque each
+    std::atomic<size_t> queued{0}; // Tasks in the deques, including ones a waiter already ran, counted before they are pushed
+    std::atomic<size_t> sleepers{0}; // Threads blocked on the condition variable
+    std::atomic<size_t> nextWorker{0}; // Worker receiving the next task from outside the pool
+    std::atomic<uint64_t> changes{0}; // Number of tasks queued or finished, for waiters that found nothing to help with
+    std::mutex mutex; // Guards sleeping, stopping, spares and blocked
+    std::condition_variable changed; // Signals a new task, a finished task or shutdown
+    bool stopping = false; // Set when the pool is destroyed
+    std::vector<std::thread> spares; // Threads started for blocked threads, kept until the pool is destroyed
+    size_t blocked = 0; // Threads inside a Blocking scope
+
+    static thread_local TaskPool* currentPool; // Pool of the worker running on this thread, if any
+    static thread_local Worker* currentWorker; // Worker running on this thread, null on spare threads
+    static thread_local int helpDepth; // Tasks this thread is running while waiting for others
+    static thread_local Task* currentTask; // Innermost task running on this thread, if any
+
+    /**
+     * @brief Runs a task unless another thread has claimed it
+     *
+     * @param task The task to run
+     * @return True if this call ran the task
+     */
+    bool tryRun(Task& task);
+
+    /**
+     * @brief Runs one queued task, from the own deque first, else stolen from another worker
+     *
+     * @param awaited If set, only a descendant of this task is run
+     * @return False if no task was found
+     */
+    bool runOne(const Task* awaited = nullptr);
+
+    /**
+     * @brief Wakes the threads blocked on the condition variable, if there are any
+     */
+    void notify();
+
+    /**
+     * @brief Runs tasks until the pool is stopped and no task is left
+     *
+     * @param self The worker running on this thread, or null for a spare thread, which only steals
+     */
+    void workerLoop(Worker* self);
+};
+
+#endif // TASKPOOL_HPP
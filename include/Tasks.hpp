@@ -0,0 +1,140 @@
+#ifndef TASKS_HPP
+#define TASKS_HPP
+
+#include "LoxCallable.hpp"
+#include "Snapshot.hpp"
+#include "TaskPool.hpp"
+#include <memory>
+#include <optional>
+#include <string>
+
+/**
+ * @class LoxFuture
+ * @brief Handle to a function running on the task pool, returned by spawn()
+ *
+ * Joining the future, or calling it, waits for the function and returns a
+ * copy of its result in the joining interpreter's heap, so a future can be
+ * joined any number of times, by any task it was passed to. A runtime error
+ * in the function is raised again by every join, with the line where it
+ * happened.
+ */
+class LoxFuture : public LoxCallable {
+public:
+    /**
+     * @struct State
+     * @brief The task and its outcome, shared by every copy of the future
+     */
+    struct State {
+        std::shared_ptr<TaskPool::Task> task; // Runs the function, done once the outcome is set
+        Snapshot result; // Copy of the returned value
+        bool failed = false; // Set if the function stopped with an error
+        std::string error; // Message of the error
+        std::optional<Token> token; // Where the error happened, if it was a runtime error
+    };
+
+    /**
+     * @brief Constructs a future
+     *
+     * @param state The state of the spawned task
+     */
+    explicit LoxFuture(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+    /**
+     * @brief Waits for the function and copies its result into an interpreter's heap
+     *
+     * @param interpreter The interpreter joining the future
+     * @return The copied result
+     */
+    Value join(Interpreter& interpreter);
+
+    int arity() override {
+        return 0;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& /* arguments */) override {
+        return join(interpreter);
+    }
+
+    std::string toString() const override {
+        return "<future>";
+    }
+
+    size_t size() const override {
+        return sizeof(LoxFuture);
+    }
+
+    LoxObject* promote() override {
+        return new LoxFuture(std::move(state));
+    }
+
+    Copier copier() const override {
+        return [state = state](Heap& heap) -> LoxCallable* { return heap.allocate<LoxFuture>(state); };
+    }
+
+private:
+    std::shared_ptr<State> state; // Shared with the task and with copies in other heaps
+};
+
+/**
+ * @class Spawn
+ * @brief spawn(fn): runs a function taking no arguments on the task pool and returns its future
+ *
+ * The function and everything it can reach, the globals included, is copied
+ * when it is spawned, so the task sees the values of that moment and its
+ * assignments are not seen by anyone else.
+ */
+class Spawn : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Spawn);
+    }
+
+    LoxObject* promote() override {
+        return new Spawn();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Spawn>(); };
+    }
+};
+
+/**
+ * @class Join
+ * @brief join(future): waits for a spawned function and returns a copy of its result
+ */
+class Join : public LoxCallable {
+public:
+    int arity() override {
+        return 1;
+    }
+
+    Value call(Interpreter& interpreter, const std::vector<Value>& arguments) override;
+
+    std::string toString() const override {
+        return "<native fn>";
+    }
+
+    size_t size() const override {
+        return sizeof(Join);
+    }
+
+    LoxObject* promote() override {
+        return new Join();
+    }
+
+    Copier copier() const override {
+        return [](Heap& heap) -> LoxCallable* { return heap.allocate<Join>(); };
+    }
+};
+
+#endif // TASKS_HPP
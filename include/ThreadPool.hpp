@@ -0,0 +1,81 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads running batches of indexed tasks
+ *
+ * A batch runs a task once for every index in a range, with the calling
+ * thread working alongside the workers, and returns once every index is done.
+ * Indices are handed out one at a time, so uneven tasks still balance.
+ */
+class ThreadPool {
+    std::vector<std::thread> workers; // Threads besides the caller
+    std::mutex mutex; // Guards the batch state below
+    std::condition_variable wake; // Signals a new batch or shutdown to the workers
+    std::condition_variable finished; // Signals the caller that a worker left the batch
+    const std::function<void(size_t)>* task = nullptr; // Task of the current batch
+    size_t count = 0; // Number of indices in the current batch
+    std::atomic<size_t> next{0}; // Next index to hand out
+    size_t busy = 0; // Workers still running the current batch
+    unsigned long batch = 0; // Number of the current batch, for workers to notice a new one
+    bool stopping = false; // Set when the pool is destroyed
+    std::exception_ptr failure; // First exception thrown by the current batch
+
+public:
+    /**
+     * @brief Starts the workers
+     *
+     * @param threads The number of threads running a batch, including the caller
+     */
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Stops and joins the workers
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Gets the number of threads running a batch
+     *
+     * @return The number of workers plus the caller
+     */
+    unsigned size() const {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    /**
+     * @brief Runs a task for every index and waits for all of them
+     *
+     * If tasks throw, the first exception is rethrown once the batch is done.
+     *
+     * @param count The number of indices, the task gets 0 to count - 1
+     * @param task The task to run for each index
+     */
+    void forEach(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    /**
+     * @brief Runs tasks of the current batch until its indices run out
+     */
+    void work();
+
+    /**
+     * @brief Waits for batches and works on them until the pool is stopped
+     */
+    void workerLoop();
+};
+
+#endif // THREADPOOL_HPP
@@ -3,20 +3,21 @@
 
 #include "TokenInfo.hpp"
 #include <string>
-#include <memory>
+#include <string_view>
 
 /**
  * @class Token
  * @brief Represents a token in the source code
  * 
- * The Token class represents a token in the source code. Each token has a type,
- * lexeme, literal value, and line number
+ * The Token class represents a token kept by the syntax tree after parsing. Each
+ * token has a type, lexeme, and line number. The lexeme is a view into the
+ * source, which must outlive the token. Literal values are read from the
+ * TokenBuffer while parsing and stored in the Literal nodes instead.
  * 
  */
 class Token{
     const TokenType type;
-    const std::string lexeme;
-    std::shared_ptr<void> literal;
+    const std::string_view lexeme;
     const int line;
 public:
     
@@ -25,11 +26,10 @@ public:
      * 
      * @param type Type of the token
      * @param lexeme Lexeme (text) of the token
-     * @param literal Literal value of the token if any
      * @param line Line number where the token is located
      */
-    Token(TokenType type, const std::string& lexeme, std::shared_ptr<void> literal, int line)
-        : type(type), lexeme(lexeme), literal(literal), line(line) {}
+    Token(TokenType type, std::string_view lexeme, int line)
+        : type(type), lexeme(lexeme), line(line) {}
     
     /**
      * @brief Converts the token to a string representation
@@ -41,9 +41,9 @@ public:
     /**
      * @brief Gets the lexeme of the token
      * 
-     * @return std::string The lexeme (text) of the token
+     * @return std::string_view The lexeme (text) of the token
      */
-    std::string getLexeme() const;
+    std::string_view getLexeme() const;
 
     /**
      * @brief Gets the type of the token
@@ -52,13 +52,6 @@ public:
      */
     TokenType getType() const;
 
-    /**
-     * @brief Gets the literal value of the token
-     * 
-     * @return std::shared_ptr<void> The literal value of the token
-     */
-    std::shared_ptr<void> getLiteral() const;
-
     /**
      * @brief Gets the line number where the token is located
      * 
@@ -0,0 +1,250 @@
+#ifndef TOKENBUFFER_HPP
+#define TOKENBUFFER_HPP
+
+#include "Token.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @class TokenBuffer
+ * @brief Compact storage for the tokens of a source file
+ *
+ * Tokens are stored as a struct of arrays indexed by token number: a type byte
+ * and the 32-bit offset and length of the lexeme in the source, which the
+ * buffer borrows and must outlive it. Number values live in a side table
+ * holding only number tokens, and string values are the lexemes without their
+ * quotes. Line numbers are not stored per token, they are computed on demand
+ * from the offsets of the newlines seen by the scanner.
+ *
+ * When a script is streamed, the buffer only holds the tokens of a window of
+ * the input, and line numbers are counted from the first line of the window.
+ */
+class TokenBuffer {
+    std::string_view source; // Source code the offsets point into
+    std::vector<TokenType> types; // Type of each token
+    std::vector<uint32_t> offsets; // Offset of each lexeme in the source
+    std::vector<uint32_t> lengths; // Length of each lexeme
+    std::vector<uint32_t> numberTokens; // Indices of the number tokens, in increasing order
+    std::vector<double> numbers; // Value of each number token, parallel to numberTokens
+    std::vector<uint32_t> newlines; // Offsets of the newlines in the source, in increasing order
+    int firstLine; // Line number of the start of the source
+
+public:
+    /**
+     * @brief Constructs an empty buffer for the given source code
+     *
+     * @param source The source code the tokens are scanned from, not copied
+     * @param firstLine The line number of the start of the source
+     */
+    explicit TokenBuffer(std::string_view source, int firstLine = 1) : source(source), firstLine(firstLine) {}
+
+    /**
+     * @brief Appends a token
+     *
+     * @param type The type of the token
+     * @param offset The offset of the lexeme in the source
+     * @param length The length of the lexeme
+     */
+    void add(TokenType type, uint32_t offset, uint32_t length) {
+        types.push_back(type);
+        offsets.push_back(offset);
+        lengths.push_back(length);
+    }
+
+    /**
+     * @brief Appends a number token along with its value
+     *
+     * @param offset The offset of the lexeme in the source
+     * @param length The length of the lexeme
+     * @param value The value of the number
+     */
+    void addNumber(uint32_t offset, uint32_t length, double value);
+
+    /**
+     * @brief Records the position of a newline in the source
+     *
+     * @param offset The offset of the newline, greater than any recorded so far
+     */
+    void addNewline(uint32_t offset) {
+        newlines.push_back(offset);
+    }
+
+    /**
+     * @brief Points the buffer at a copy of its source with more text appended
+     *
+     * @param extended The new source, starting with the same text as the old one
+     */
+    void rebase(std::string_view extended) {
+        source = extended;
+    }
+
+    /**
+     * @brief Drops the tokens and newlines recorded after the given counts
+     *
+     * @param tokenCount The number of tokens to keep
+     * @param newlineCount The number of newlines to keep
+     */
+    void truncate(uint32_t tokenCount, size_t newlineCount);
+
+    /**
+     * @struct Slice
+     * @brief The tail of a buffer to copy into a joined buffer
+     */
+    struct Slice {
+        const TokenBuffer* buffer; // Buffer to copy from
+        uint32_t first; // Index of the first token to copy
+        size_t newlinesFrom; // Offset of the first newline to copy
+        size_t newlinesTo; // Offset past the last newline to copy
+    };
+
+    /**
+     * @brief Joins buffers scanned from consecutive parts of the same source
+     *
+     * The slices are copied concurrently, each into its own range of the result.
+     *
+     * @param source The source code all the buffers were scanned from
+     * @param slices The parts to join, in source order
+     * @param pool The threads to copy on
+     * @return The joined buffer
+     */
+    static TokenBuffer join(std::string_view source, const std::vector<Slice>& slices, ThreadPool& pool);
+
+    /**
+     * @brief Gets the number of newlines recorded so far
+     *
+     * @return The number of newlines
+     */
+    size_t newlineCount() const {
+        return newlines.size();
+    }
+
+    /**
+     * @brief Gets the number of tokens in the buffer
+     *
+     * @return The number of tokens
+     */
+    uint32_t size() const {
+        return static_cast<uint32_t>(types.size());
+    }
+
+    /**
+     * @brief Gets the type of a token
+     *
+     * @param index The index of the token
+     * @return The type of the token
+     */
+    TokenType type(uint32_t index) const {
+        return types[index];
+    }
+
+    /**
+     * @brief Gets the offset of a token in the source
+     *
+     * @param index The index of the token
+     * @return The offset of the first character of the lexeme
+     */
+    uint32_t offset(uint32_t index) const {
+        return offsets[index];
+    }
+
+    /**
+     * @brief Gets the text of a token
+     *
+     * @param index The index of the token
+     * @return A view of the lexeme in the source
+     */
+    std::string_view lexeme(uint32_t index) const {
+        return source.substr(offsets[index], lengths[index]);
+    }
+
+    /**
+     * @brief Gets the value of a number token
+     *
+     * @param index The index of a NUMBER token
+     * @return The value of the number
+     */
+    double number(uint32_t index) const;
+
+    /**
+     * @brief Gets the value of a string token
+     *
+     * @param index The index of a STRING token
+     * @return A view of the characters between the quotes
+     */
+    std::string_view string(uint32_t index) const {
+        return source.substr(offsets[index] + 1, lengths[index] - 2);
+    }
+
+    /**
+     * @brief Gets the line a token starts on
+     *
+     * @param index The index of the token
+     * @return The 1-based line number
+     */
+    int line(uint32_t index) const {
+        return lineAt(offsets[index]);
+    }
+
+    /**
+     * @brief Gets the line of a position in the source
+     *
+     * Only newlines recorded so far are counted, which is enough for the
+     * scanner reporting an error at its current position.
+     *
+     * @param offset The offset in the source
+     * @return The 1-based line number
+     */
+    int lineAt(uint32_t offset) const;
+
+    /**
+     * @brief Counts the newlines before a position in the source
+     *
+     * @param offset The offset in the source
+     * @return The number of recorded newlines at smaller offsets, a cursor for lineFrom
+     */
+    size_t newlinesBefore(uint32_t offset) const;
+
+    /**
+     * @brief Gets the line of a position, walking from a cursor into the newlines
+     *
+     * Reading positions in increasing order walks each newline once, instead
+     * of searching all of them for every position.
+     *
+     * @param offset The offset in the source
+     * @param cursor The number of newlines before the previous offset looked up, updated
+     * @return The 1-based line number
+     */
+    int lineFrom(uint32_t offset, size_t& cursor) const;
+
+    /**
+     * @brief Builds a token that can outlive the buffer, but not the source
+     *
+     * @param index The index of the token
+     * @return The token with its type, lexeme view and line
+     */
+    Token token(uint32_t index) const {
+        return Token(types[index], lexeme(index), line(index));
+    }
+
+    /**
+     * @brief Gets the source code the tokens point into
+     *
+     * @return The source code
+     */
+    std::string_view getSource() const {
+        return source;
+    }
+
+    /**
+     * @brief Gets the number of bytes used by the token arrays and side tables
+     *
+     * @return The size of the buffer, excluding the source itself
+     */
+    size_t memoryUsage() const;
+};
+
+#endif // TOKENBUFFER_HPP
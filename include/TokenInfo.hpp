@@ -1,50 +1,207 @@
 #ifndef TOKENINFO_HPP
 #define TOKENINFO_HPP
 
+#include <array>
+#include <cstddef>
 #include <string>
+#include <string_view>
 
-enum class TokenType {
-    // Single-character tokens
-    LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
-    COMMA, DOT, MINUS, PLUS, SEMICOLON, SLASH, STAR,
+/**
+ * Every token type, in enum order. TOKEN declares a type, CHAR_TOKEN a type
+ * always scanned from the given single character, and KEYWORD a reserved word
+ * with its spelling. The enum, the type names, the keyword recognizer and the
+ * character tables below are all generated from this list, so adding a token or
+ * a keyword is one line here.
+ */
+#define LOX_TOKENS(TOKEN, CHAR_TOKEN, KEYWORD)                                          \
+    /* Single-character tokens */                                                       \
+    CHAR_TOKEN(LEFT_PAREN, '(') CHAR_TOKEN(RIGHT_PAREN, ')')                            \
+    CHAR_TOKEN(LEFT_BRACE, '{') CHAR_TOKEN(RIGHT_BRACE, '}')                            \
+    CHAR_TOKEN(COMMA, ',') CHAR_TOKEN(DOT, '.') CHAR_TOKEN(MINUS, '-')                  \
+    CHAR_TOKEN(PLUS, '+') CHAR_TOKEN(SEMICOLON, ';') TOKEN(SLASH) CHAR_TOKEN(STAR, '*') \
+                                                                                        \
+    /* One or two character tokens */                                                   \
+    TOKEN(BANG) TOKEN(BANG_EQUAL)                                                       \
+    TOKEN(EQUAL) TOKEN(EQUAL_EQUAL)                                                     \
+    TOKEN(GREATER) TOKEN(GREATER_EQUAL)                                                 \
+    TOKEN(LESS) TOKEN(LESS_EQUAL)                                                       \
+                                                                                        \
+    /* Literals */                                                                      \
+    TOKEN(IDENTIFIER) TOKEN(STRING) TOKEN(NUMBER)                                       \
+                                                                                        \
+    /* Keywords */                                                                      \
+    KEYWORD(AND, "and") KEYWORD(CLASS, "class") KEYWORD(ELSE, "else")                   \
+    KEYWORD(FALSE, "false") KEYWORD(FUN, "fun") KEYWORD(FOR, "for")                     \
+    KEYWORD(IF, "if") KEYWORD(NIL, "nil") KEYWORD(OR, "or")                             \
+    KEYWORD(PRINT, "print") KEYWORD(RETURN, "return") KEYWORD(SUPER, "super")           \
+    KEYWORD(THIS, "this") KEYWORD(TRUE, "true") KEYWORD(VAR, "var")                     \
+    KEYWORD(WHILE, "while")                                                             \
+                                                                                        \
+    TOKEN(END_OF_FILE)
 
-    // One or two character tokens
-    BANG, BANG_EQUAL,
-    EQUAL, EQUAL_EQUAL,
-    GREATER, GREATER_EQUAL,
-    LESS, LESS_EQUAL,
+#define LOX_TOKEN_NAME(name) name,
+#define LOX_TOKEN_NAME_WITH(name, spelling) name,
+#define LOX_TOKEN_STRING(name) #name,
+#define LOX_TOKEN_STRING_WITH(name, spelling) #name,
+#define LOX_TOKEN_SKIP(name)
+#define LOX_TOKEN_SKIP_WITH(name, spelling)
+#define LOX_TOKEN_ENTRY(name, spelling) {spelling, TokenType::name},
 
-    // Literals
-    IDENTIFIER, STRING, NUMBER,
+// Stored as a single byte in token buffers and values
+enum class TokenType : unsigned char {
+    LOX_TOKENS(LOX_TOKEN_NAME, LOX_TOKEN_NAME_WITH, LOX_TOKEN_NAME_WITH)
+};
 
-    // Keywords
-    AND, CLASS, ELSE, FALSE, FUN, FOR, IF, NIL, OR,
-    PRINT, RETURN, SUPER, THIS, TRUE, VAR, WHILE,
+// Number of token types, for tables indexed by type
+constexpr size_t TOKEN_TYPE_COUNT = static_cast<size_t>(TokenType::END_OF_FILE) + 1;
 
-    END_OF_FILE
+const std::string TypeStrings[] = {
+    LOX_TOKENS(LOX_TOKEN_STRING, LOX_TOKEN_STRING_WITH, LOX_TOKEN_STRING_WITH)
 };
 
-const std::string TypeStrings[] = {
+inline std::string getTypeString(TokenType type) {
+    return TypeStrings[static_cast<int>(type)];
+}
 
-    // Single-character tokens.
-    "LEFT_PAREN", "RIGHT_PAREN", "LEFT_BRACE", "RIGHT_BRACE", "COMMA", "DOT", "MINUS", "PLUS", "SEMICOLON", "SLASH",
-    "STAR",
+/**
+ * @brief A reserved word and the token type it scans as
+ */
+struct Keyword {
+    std::string_view text;
+    TokenType type = TokenType::IDENTIFIER;
+};
 
-    // One or two character tokens.
-    "BANG", "BANG_EQUAL", "EQUAL", "EQUAL_EQUAL", "GREATER", "GREATER_EQUAL", "LESS", "LESS_EQUAL",
+/**
+ * @brief A token scanned from a single character
+ */
+struct CharToken {
+    char c;
+    TokenType type;
+};
 
-    // Literals.
-    "IDENTIFIER", "STRING", "NUMBER",
+constexpr Keyword KEYWORDS[] = {
+    LOX_TOKENS(LOX_TOKEN_SKIP, LOX_TOKEN_SKIP_WITH, LOX_TOKEN_ENTRY)
+};
 
-    // Keywords.
-    "AND", "CLASS", "ELSE", "FALSE", "FUN", "FOR", "IF", "NIL", "OR", "PRINT", "RETURN", "SUPER", "THIS", "TRUE", "VAR",
-    "WHILE",
+constexpr CharToken CHAR_TOKENS[] = {
+    LOX_TOKENS(LOX_TOKEN_SKIP, LOX_TOKEN_ENTRY, LOX_TOKEN_SKIP_WITH)
+};
 
-    // EOF reserved word
-    "END_OF_FILE"};
+/**
+ * @struct KeywordTable
+ * @brief Perfect hash table of the keywords, built at compile time
+ *
+ * A word hashes from its length and its first and last characters, with the
+ * last character scaled by a multiplier searched at compile time so that no
+ * two keywords share a slot. Recognizing a word is then one hash and at most
+ * one comparison.
+ */
+struct KeywordTable {
+    static constexpr size_t SIZE = 64; // Number of slots, a power of two
+    std::array<Keyword, SIZE> slots{}; // Keyword hashed to each slot, empty text if none
+    unsigned multiplier = 0; // Scale of the last character in the hash
+    bool perfect = false; // Set if every keyword got its own slot
 
-inline std::string getTypeString(TokenType type) {
-    return TypeStrings[static_cast<int>(type)];
+    static constexpr size_t hash(std::string_view text, unsigned multiplier) {
+        return (text.size() + static_cast<unsigned char>(text.front())
+            + multiplier * static_cast<unsigned char>(text.back())) & (SIZE - 1);
+    }
+
+    constexpr TokenType find(std::string_view text) const {
+        if (text.empty()) return TokenType::IDENTIFIER;
+        const Keyword& slot = slots[hash(text, multiplier)];
+        return slot.text == text ? slot.type : TokenType::IDENTIFIER;
+    }
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    for (unsigned multiplier = 0; multiplier < 256; multiplier++) {
+        KeywordTable table;
+        table.multiplier = multiplier;
+        table.perfect = true;
+        for (const Keyword& keyword : KEYWORDS) {
+            Keyword& slot = table.slots[KeywordTable::hash(keyword.text, multiplier)];
+            if (!slot.text.empty()) {
+                table.perfect = false;
+                break;
+            }
+            slot = keyword;
+        }
+        if (table.perfect) return table;
+    }
+    return KeywordTable();
 }
 
-#endif
\ No newline at end of file
+constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+static_assert(KEYWORD_TABLE.perfect, "No collision free keyword hash, grow KeywordTable::SIZE");
+
+/**
+ * @brief Gets the token type of an identifier or reserved word
+ *
+ * @param text The word to look up
+ * @return The keyword's type, or IDENTIFIER if the word is not reserved
+ */
+constexpr TokenType keywordType(std::string_view text) {
+    return KEYWORD_TABLE.find(text);
+}
+
+constexpr bool keywordsRecognized() {
+    for (const Keyword& keyword : KEYWORDS) {
+        if (keywordType(keyword.text) != keyword.type) return false;
+    }
+    return keywordType("classes") == TokenType::IDENTIFIER && keywordType("f") == TokenType::IDENTIFIER;
+}
+static_assert(keywordsRecognized(), "Keyword table does not round trip");
+
+// Character classes used by the scanner
+enum CharClass : unsigned char {
+    CHAR_ALPHA = 1, // Letter or underscore, starts an identifier
+    CHAR_DIGIT = 2, // Decimal digit
+    CHAR_SINGLE = 4 // Always a token on its own, see CHAR_TOKENS
+};
+
+/**
+ * @struct CharTables
+ * @brief Classes and single character token types of every byte
+ */
+struct CharTables {
+    std::array<unsigned char, 256> classes{}; // CharClass bits of each byte
+    std::array<TokenType, 256> tokens{}; // Token type of the CHAR_SINGLE bytes
+};
+
+constexpr CharTables buildCharTables() {
+    CharTables tables;
+    for (int c = 0; c < 256; c++) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') tables.classes[c] |= CHAR_ALPHA;
+        if (c >= '0' && c <= '9') tables.classes[c] |= CHAR_DIGIT;
+    }
+    for (const CharToken& token : CHAR_TOKENS) {
+        unsigned char c = static_cast<unsigned char>(token.c);
+        tables.classes[c] |= CHAR_SINGLE;
+        tables.tokens[c] = token.type;
+    }
+    return tables;
+}
+
+constexpr CharTables CHAR_TABLES = buildCharTables();
+
+/**
+ * @brief Checks if a character belongs to any of the given classes
+ *
+ * @param c The character to check
+ * @param classes The CharClass bits to test
+ * @return True if the character is in one of the classes
+ */
+constexpr bool isCharClass(char c, unsigned char classes) {
+    return (CHAR_TABLES.classes[static_cast<unsigned char>(c)] & classes) != 0;
+}
+
+#undef LOX_TOKEN_NAME
+#undef LOX_TOKEN_NAME_WITH
+#undef LOX_TOKEN_STRING
+#undef LOX_TOKEN_STRING_WITH
+#undef LOX_TOKEN_SKIP
+#undef LOX_TOKEN_SKIP_WITH
+#undef LOX_TOKEN_ENTRY
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include "TokenInfo.hpp"
+
+class LoxObject;
+
+/**
+ * @struct Value
+ * @brief A Lox runtime value
+ *
+ * Values are tagged with the same TokenType the interpreter has always used to
+ * describe them (NIL, TRUE, FALSE, NUMBER, STRING and FUN). Numbers and booleans
+ * are stored inline, while strings and callables point to objects owned by the
+ * garbage collected Heap. Values are trivially copyable, so copying one never
+ * touches a reference count.
+ */
+struct Value {
+    TokenType type; // Type tag of the value
+    union {
+        double number; // Payload for NUMBER values
+        LoxObject* object; // Payload for STRING and FUN values
+    };
+
+    /**
+     * @brief Constructs a nil value
+     */
+    Value() : type(TokenType::NIL), object(nullptr) {}
+
+    /**
+     * @brief Creates a boolean value
+     *
+     * @param value The boolean to wrap
+     * @return A TRUE or FALSE value
+     */
+    static Value boolean(bool value) {
+        Value result;
+        result.type = value ? TokenType::TRUE : TokenType::FALSE;
+        return result;
+    }
+
+    /**
+     * @brief Creates a number value
+     *
+     * @param value The number to wrap
+     * @return A NUMBER value
+     */
+    static Value numberValue(double value) {
+        Value result;
+        result.type = TokenType::NUMBER;
+        result.number = value;
+        return result;
+    }
+
+    /**
+     * @brief Creates a value pointing to a heap object
+     *
+     * @param type The type tag of the object (STRING or FUN)
+     * @param object The heap object
+     * @return A value referencing the object
+     */
+    static Value objectValue(TokenType type, LoxObject* object) {
+        Value result;
+        result.type = type;
+        result.object = object;
+        return result;
+    }
+
+    /**
+     * @brief Checks if the value references a heap object
+     *
+     * @return True if the value holds a string or callable, false otherwise
+     */
+    bool isObject() const {
+        return type == TokenType::STRING || type == TokenType::FUN;
+    }
+};
+
+#endif // VALUE_HPP
@@ -0,0 +1,84 @@
+#include "Async.hpp"
+#include "NativeError.hpp"
+#include "RuntimeError.hpp"
+#include <algorithm>
+#include <cmath>
+
+Value LoxPromise::await(Interpreter& interpreter, const Value& promise) {
+    EventLoop& loop = interpreter.getLoop();
+    EventLoop::Fiber& self = loop.current();
+    LoxPromise* waited = static_cast<LoxPromise*>(promise.object);
+    if (!waited->settled) {
+        waited->waiters.push_back(&self);
+        self.awaited = promise;
+        try {
+            loop.suspend();
+        } catch (...) {
+            // Nothing will settle the promise, stop waiting for it
+            waited = static_cast<LoxPromise*>(self.awaited.object);
+            waited->waiters.erase(std::find(waited->waiters.begin(), waited->waiters.end(), &self));
+            self.awaited = Value();
+            throw;
+        }
+        // Collections while suspended may have moved the promise
+        waited = static_cast<LoxPromise*>(self.awaited.object);
+        self.awaited = Value();
+    }
+
+    if (waited->failed) {
+        // Errors with a line are reported there, others at the await
+        if (waited->token) throw RuntimeError(*waited->token, waited->error);
+        throw NativeError(waited->error);
+    }
+    return waited->result;
+}
+
+Value LoxPromise::call(Interpreter& interpreter, const std::vector<Value>& /* arguments */) {
+    return await(interpreter, Value::objectValue(TokenType::FUN, this));
+}
+
+LoxObject* LoxPromise::promote() {
+    LoxPromise* promoted = new LoxPromise();
+    promoted->settled = settled;
+    promoted->result = result;
+    promoted->failed = failed;
+    promoted->error = std::move(error);
+    if (token) promoted->token.emplace(*token);
+    promoted->waiters = std::move(waiters);
+    return promoted;
+}
+
+Value Async::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& function = arguments[0];
+    if (function.type != TokenType::FUN || static_cast<LoxCallable*>(function.object)->arity() != 0) {
+        throw NativeError("Can only run functions taking no arguments asynchronously.");
+    }
+    Value promise = Value::objectValue(TokenType::FUN, interpreter.getHeap().allocate<LoxPromise>());
+    interpreter.getLoop().start(function, promise);
+    return promise;
+}
+
+Value Await::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& promise = arguments[0];
+    if (promise.type != TokenType::FUN || dynamic_cast<LoxPromise*>(static_cast<LoxCallable*>(promise.object)) == nullptr) {
+        throw NativeError("Can only await promises.");
+    }
+    return LoxPromise::await(interpreter, promise);
+}
+
+Value Sleep::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& ms = arguments[0];
+    if (ms.type != TokenType::NUMBER || !(ms.number >= 0)) {
+        throw NativeError("Sleep duration must be a non-negative number.");
+    }
+    interpreter.getLoop().sleep(ms.number);
+    return Value();
+}
+
+Value ReadLineAsync::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& fd = arguments[0];
+    if (fd.type != TokenType::NUMBER || fd.number < 0 || fd.number != std::floor(fd.number) || fd.number > 1e9) {
+        throw NativeError("File descriptor must be a non-negative integer.");
+    }
+    return interpreter.getLoop().readLine(static_cast<int>(fd.number));
+}
@@ -0,0 +1,503 @@
+#include "Batch.hpp"
+#include "Expr.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+using Kind = BatchResult::Kind;
+
+// Thrown when a row of a chunk would raise a runtime error, so the chunk is evaluated again by the interpreter
+struct Unsupported {};
+
+/**
+ * @struct Vector
+ * @brief The values a node produced for the rows of a chunk
+ */
+struct Vector {
+    Kind kind = Kind::NIL; // Kind of every selected row, unless mixed
+    bool mixed = false; // Set when the rows differ in kind
+    std::vector<Kind> kinds; // Kind of each row when mixed
+    const double* numbers; // Numbers of the rows, the storage below or an input column
+    std::vector<double> numberStorage; // Numbers computed by the node
+    std::vector<uint8_t> booleans; // Booleans of the rows, 0 or 1
+    std::vector<std::string_view> strings; // Characters of the rows, viewing the inputs, the tree or the chunk's arena
+
+    Vector()
+        : kinds(BatchEvaluator::CHUNK_ROWS), numberStorage(BatchEvaluator::CHUNK_ROWS), booleans(BatchEvaluator::CHUNK_ROWS),
+          strings(BatchEvaluator::CHUNK_ROWS) {
+        numbers = numberStorage.data();
+    }
+
+    Kind at(uint32_t row) const {
+        return mixed ? kinds[row] : kind;
+    }
+
+    // Falsiness is nil and false only, as in the interpreter
+    bool truthy(uint32_t row) const {
+        Kind k = at(row);
+        return k == Kind::BOOLEAN ? booleans[row] != 0 : k != Kind::NIL;
+    }
+
+    // Numbers are written to the storage, which input columns were only viewing
+    double* ownNumbers() {
+        numbers = numberStorage.data();
+        return numberStorage.data();
+    }
+
+    void setUniform(Kind uniform) {
+        kind = uniform;
+        mixed = false;
+    }
+
+    // Decides if per-row writes left the selected rows of one kind
+    void settle(const uint32_t* rows, size_t count) {
+        mixed = false;
+        if (count == 0) return;
+        kind = kinds[rows[0]];
+        for (size_t i = 1; i < count; i++) {
+            if (kinds[rows[i]] != kind) {
+                mixed = true;
+                return;
+            }
+        }
+    }
+};
+
+/**
+ * @struct Node
+ * @brief An operator of the flattened expression and the column it produces
+ */
+struct Node {
+    enum class Type { LITERAL, INPUT, NEGATE, NOT, BINARY, LOGICAL };
+
+    Type type;
+    TokenType op = TokenType::NIL; // Operator of a binary or logical node
+    int left = -1; // Operand of a unary node, left operand of a binary or logical one
+    int right = -1; // Right operand
+    size_t input = 0; // Column read by an input node
+    Vector values; // The node's column, filled once for a literal
+    std::vector<uint32_t> undecided; // Rows the left side of a logical node leaves to the right side
+
+    explicit Node(Type type) : type(type) {}
+};
+}
+
+/**
+ * @struct BatchEvaluator::Plan
+ * @brief The expression as a list of nodes, children before their parents
+ */
+struct BatchEvaluator::Plan {
+    std::vector<std::unique_ptr<Node>> nodes;
+    int root = -1;
+    std::vector<uint32_t> all; // Every row of a chunk, the selection of the root
+    std::deque<std::string> arena; // Strings concatenated in the current chunk
+    const std::vector<Column>* columns = nullptr; // Inputs of the current batch
+    size_t start = 0; // First row of the current chunk
+    size_t rows = 0; // Rows in the current chunk
+    const BatchKernels* kernels = nullptr;
+
+    const Vector* run(int index, const uint32_t* selected, size_t count);
+    const Vector* binary(Node& node, const uint32_t* selected, size_t count);
+    const Vector* logical(Node& node, const uint32_t* selected, size_t count);
+};
+
+namespace {
+/**
+ * @class Planner
+ * @brief Flattens an expression into nodes, giving up on anything the columns cannot evaluate
+ */
+class Planner : public ExprVisitor {
+public:
+    Planner(std::vector<std::unique_ptr<Node>>& nodes, const std::vector<std::string>& inputs) : nodes(nodes), inputs(inputs) {}
+
+    int index = -1; // Node produced for the last expression visited
+    bool supported = true; // Cleared on the first expression that must fall back
+
+    void visitAssign(const Assign&) override {
+        supported = false;
+    }
+
+    void visitCall(const Call&) override {
+        supported = false;
+    }
+
+    void visitGrouping(const Grouping& expr) override {
+        expr.expression->accept(*this);
+    }
+
+    void visitLiteral(const Literal& expr) override {
+        Node& node = add(Node::Type::LITERAL);
+        Vector& values = node.values;
+        switch (expr.type) {
+            case TokenType::NUMBER:
+                std::fill(values.numberStorage.begin(), values.numberStorage.end(), *std::static_pointer_cast<double>(expr.value));
+                values.setUniform(Kind::NUMBER);
+                break;
+            case TokenType::STRING:
+                std::fill(values.strings.begin(), values.strings.end(), std::string_view(*std::static_pointer_cast<std::string>(expr.value)));
+                values.setUniform(Kind::STRING);
+                break;
+            case TokenType::TRUE:
+            case TokenType::FALSE:
+                std::fill(values.booleans.begin(), values.booleans.end(), expr.type == TokenType::TRUE);
+                values.setUniform(Kind::BOOLEAN);
+                break;
+            default:
+                values.setUniform(Kind::NIL);
+                break;
+        }
+    }
+
+    void visitVariable(const Variable& expr) override {
+        // A name bound twice holds the last value bound, as with the interpreter's globals
+        auto found = std::find(inputs.rbegin(), inputs.rend(), std::string(expr.name.getLexeme()));
+        if (found == inputs.rend()) {
+            supported = false;
+            return;
+        }
+        add(Node::Type::INPUT).input = static_cast<size_t>(inputs.rend() - found - 1);
+    }
+
+    void visitUnary(const Unary& expr) override {
+        int operand = visit(*expr.right);
+        if (!supported) return;
+        Node& node = add(expr.op.getType() == TokenType::MINUS ? Node::Type::NEGATE : Node::Type::NOT);
+        node.left = operand;
+    }
+
+    void visitBinary(const Binary& expr) override {
+        both(Node::Type::BINARY, *expr.left, expr.op, *expr.right);
+    }
+
+    void visitLogical(const Logical& expr) override {
+        both(Node::Type::LOGICAL, *expr.left, expr.op, *expr.right);
+    }
+
+private:
+    std::vector<std::unique_ptr<Node>>& nodes; // Nodes of the plan, appended to
+    const std::vector<std::string>& inputs;
+
+    int visit(const Expr& expr) {
+        expr.accept(*this);
+        return index;
+    }
+
+    Node& add(Node::Type type) {
+        nodes.push_back(std::make_unique<Node>(type));
+        index = static_cast<int>(nodes.size() - 1);
+        return *nodes.back();
+    }
+
+    void both(Node::Type type, const Expr& leftExpr, const Token& op, const Expr& rightExpr) {
+        int left = visit(leftExpr);
+        if (!supported) return;
+        int right = visit(rightExpr);
+        if (!supported) return;
+        Node& node = add(type);
+        node.op = op.getType();
+        node.left = left;
+        node.right = right;
+    }
+};
+
+// Equality of two rows, as Interpreter::isEqual compares values
+bool equalRows(const Vector& left, const Vector& right, uint32_t row) {
+    Kind kind = left.at(row);
+    if (kind != right.at(row)) return false;
+    switch (kind) {
+        case Kind::NUMBER: return left.numbers[row] == right.numbers[row];
+        case Kind::BOOLEAN: return left.booleans[row] == right.booleans[row];
+        case Kind::STRING: return left.strings[row] == right.strings[row];
+        default: return true;
+    }
+}
+
+BatchKernels::Arithmetic arithmeticKernel(const BatchKernels& kernels, TokenType op) {
+    switch (op) {
+        case TokenType::PLUS: return kernels.add;
+        case TokenType::MINUS: return kernels.subtract;
+        case TokenType::STAR: return kernels.multiply;
+        case TokenType::SLASH: return kernels.divide;
+        default: return nullptr;
+    }
+}
+
+BatchKernels::Comparison comparisonKernel(const BatchKernels& kernels, TokenType op) {
+    switch (op) {
+        case TokenType::GREATER: return kernels.greater;
+        case TokenType::GREATER_EQUAL: return kernels.greaterEqual;
+        case TokenType::LESS: return kernels.less;
+        case TokenType::LESS_EQUAL: return kernels.lessEqual;
+        case TokenType::EQUAL_EQUAL: return kernels.equal;
+        case TokenType::BANG_EQUAL: return kernels.notEqual;
+        default: return nullptr;
+    }
+}
+}
+
+const Vector* BatchEvaluator::Plan::run(int index, const uint32_t* selected, size_t count) {
+    Node& node = *nodes[index];
+    Vector& out = node.values;
+    switch (node.type) {
+        case Node::Type::LITERAL:
+            return &out;
+        case Node::Type::INPUT: {
+            const Column& column = (*columns)[node.input];
+            switch (column.kind) {
+                case Column::Kind::NUMBER:
+                    out.numbers = column.numbers + start;
+                    out.setUniform(Kind::NUMBER);
+                    break;
+                case Column::Kind::BOOLEAN:
+                    for (size_t i = 0; i < count; i++) out.booleans[selected[i]] = column.booleans[start + selected[i]];
+                    out.setUniform(Kind::BOOLEAN);
+                    break;
+                case Column::Kind::STRING:
+                    for (size_t i = 0; i < count; i++) out.strings[selected[i]] = column.strings[start + selected[i]];
+                    out.setUniform(Kind::STRING);
+                    break;
+            }
+            return &out;
+        }
+        case Node::Type::NEGATE: {
+            const Vector& operand = *run(node.left, selected, count);
+            for (size_t i = 0; i < count; i++) {
+                if (operand.at(selected[i]) != Kind::NUMBER) throw Unsupported();
+            }
+            double* numbers = out.ownNumbers();
+            for (size_t row = 0; row < rows; row++) numbers[row] = -operand.numbers[row];
+            out.setUniform(Kind::NUMBER);
+            return &out;
+        }
+        case Node::Type::NOT: {
+            const Vector& operand = *run(node.left, selected, count);
+            if (!operand.mixed && operand.kind == Kind::BOOLEAN) {
+                for (size_t row = 0; row < rows; row++) out.booleans[row] = !operand.booleans[row];
+            } else {
+                for (size_t i = 0; i < count; i++) out.booleans[selected[i]] = !operand.truthy(selected[i]);
+            }
+            out.setUniform(Kind::BOOLEAN);
+            return &out;
+        }
+        case Node::Type::BINARY:
+            return binary(node, selected, count);
+        case Node::Type::LOGICAL:
+            return logical(node, selected, count);
+    }
+    return &out;
+}
+
+const Vector* BatchEvaluator::Plan::binary(Node& node, const uint32_t* selected, size_t count) {
+    const Vector& left = *run(node.left, selected, count);
+    const Vector& right = *run(node.right, selected, count);
+    Vector& out = node.values;
+    bool numbers = !left.mixed && !right.mixed && left.kind == Kind::NUMBER && right.kind == Kind::NUMBER;
+
+    // Number columns go through the kernels whole, the rows outside the selection are computed and ignored
+    if (numbers) {
+        if (BatchKernels::Arithmetic kernel = arithmeticKernel(*kernels, node.op)) {
+            kernel(left.numbers, right.numbers, out.ownNumbers(), rows);
+            out.setUniform(Kind::NUMBER);
+        } else {
+            comparisonKernel(*kernels, node.op)(left.numbers, right.numbers, out.booleans.data(), rows);
+            out.setUniform(Kind::BOOLEAN);
+        }
+        return &out;
+    }
+
+    // Anything else goes row by row, and a row the interpreter would reject sends the chunk back to it
+    switch (node.op) {
+        case TokenType::EQUAL_EQUAL:
+        case TokenType::BANG_EQUAL: {
+            bool equal = node.op == TokenType::EQUAL_EQUAL;
+            for (size_t i = 0; i < count; i++) out.booleans[selected[i]] = equalRows(left, right, selected[i]) == equal;
+            out.setUniform(Kind::BOOLEAN);
+            return &out;
+        }
+        case TokenType::PLUS: {
+            double* sums = out.ownNumbers();
+            for (size_t i = 0; i < count; i++) {
+                uint32_t row = selected[i];
+                Kind leftKind = left.at(row);
+                Kind rightKind = right.at(row);
+                if (leftKind == Kind::NUMBER && rightKind == Kind::NUMBER) {
+                    sums[row] = left.numbers[row] + right.numbers[row];
+                    out.kinds[row] = Kind::NUMBER;
+                } else if (leftKind == Kind::STRING && rightKind == Kind::STRING) {
+                    std::string& joined = arena.emplace_back();
+                    joined.reserve(left.strings[row].size() + right.strings[row].size());
+                    joined.append(left.strings[row]).append(right.strings[row]);
+                    out.strings[row] = joined;
+                    out.kinds[row] = Kind::STRING;
+                } else {
+                    throw Unsupported();
+                }
+            }
+            out.settle(selected, count);
+            return &out;
+        }
+        default: {
+            // The other operators take numbers only
+            for (size_t i = 0; i < count; i++) {
+                if (left.at(selected[i]) != Kind::NUMBER || right.at(selected[i]) != Kind::NUMBER) throw Unsupported();
+            }
+            if (BatchKernels::Arithmetic kernel = arithmeticKernel(*kernels, node.op)) {
+                kernel(left.numbers, right.numbers, out.ownNumbers(), rows);
+                out.setUniform(Kind::NUMBER);
+            } else {
+                comparisonKernel(*kernels, node.op)(left.numbers, right.numbers, out.booleans.data(), rows);
+                out.setUniform(Kind::BOOLEAN);
+            }
+            return &out;
+        }
+    }
+}
+
+const Vector* BatchEvaluator::Plan::logical(Node& node, const uint32_t* selected, size_t count) {
+    const Vector& left = *run(node.left, selected, count);
+
+    // Or keeps the truthy rows of its left side, and only keeps the falsy ones
+    bool keepTruthy = node.op == TokenType::OR;
+    node.undecided.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (left.truthy(selected[i]) != keepTruthy) node.undecided.push_back(selected[i]);
+    }
+    if (node.undecided.empty()) return &left;
+    if (node.undecided.size() == count) return run(node.right, selected, count);
+
+    // The rows decided by the left side take its values, the others those of the right side
+    const Vector& right = *run(node.right, node.undecided.data(), node.undecided.size());
+    Vector& out = node.values;
+    double* numbers = out.ownNumbers();
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t row = selected[i];
+        bool fromRight = next < node.undecided.size() && node.undecided[next] == row;
+        if (fromRight) next++;
+        const Vector& source = fromRight ? right : left;
+        Kind kind = source.at(row);
+        out.kinds[row] = kind;
+        switch (kind) {
+            case Kind::NUMBER: numbers[row] = source.numbers[row]; break;
+            case Kind::BOOLEAN: out.booleans[row] = source.booleans[row]; break;
+            case Kind::STRING: out.strings[row] = source.strings[row]; break;
+            default: break;
+        }
+    }
+    out.settle(selected, count);
+    return &out;
+}
+
+BatchEvaluator::BatchEvaluator(std::shared_ptr<const Rule> rule, const HeapConfig& config)
+    : rule(rule), evaluator(rule, config), kernels(&BatchKernels::best()) {
+    if (rule->hadError() || rule->expression == nullptr) return;
+    plan = std::make_unique<Plan>();
+    Planner planner(plan->nodes, rule->inputs);
+    rule->expression->accept(planner);
+    if (!planner.supported) {
+        plan.reset();
+        return;
+    }
+    plan->root = planner.index;
+    for (uint32_t row = 0; row < CHUNK_ROWS; row++) plan->all.push_back(row);
+}
+
+BatchEvaluator::~BatchEvaluator() = default;
+
+void BatchEvaluator::setKernels(const BatchKernels& kernels) {
+    this->kernels = &kernels;
+}
+
+BatchResult BatchEvaluator::evaluate(const std::vector<Column>& columns, size_t rows) {
+    if (rule->hadError()) throw std::invalid_argument("Cannot evaluate a rule with syntax errors.");
+    if (columns.size() != rule->inputs.size()) {
+        throw std::invalid_argument("Expected " + std::to_string(rule->inputs.size()) + " columns but got " + std::to_string(columns.size()) + ".");
+    }
+
+    BatchResult result;
+    result.kinds.resize(rows);
+    result.numbers.resize(rows);
+    result.booleans.resize(rows);
+    if (!plan) {
+        evaluateRows(columns, 0, rows, result);
+        return result;
+    }
+
+    plan->columns = &columns;
+    plan->kernels = kernels;
+    for (size_t start = 0; start < rows; start += CHUNK_ROWS) {
+        size_t count = std::min(CHUNK_ROWS, rows - start);
+        plan->start = start;
+        plan->rows = count;
+        plan->arena.clear();
+        const Vector* values;
+        try {
+            values = plan->run(plan->root, plan->all.data(), count);
+        } catch (const Unsupported&) {
+            evaluateRows(columns, start, start + count, result);
+            continue;
+        }
+
+        // Uniform columns are copied whole, mixed ones row by row
+        if (!values->mixed && values->kind == Kind::NUMBER) {
+            std::copy(values->numbers, values->numbers + count, result.numbers.begin() + start);
+            std::fill(result.kinds.begin() + start, result.kinds.begin() + start + count, Kind::NUMBER);
+            continue;
+        }
+        if (!values->mixed && values->kind == Kind::BOOLEAN) {
+            std::copy(values->booleans.begin(), values->booleans.begin() + count, result.booleans.begin() + start);
+            std::fill(result.kinds.begin() + start, result.kinds.begin() + start + count, Kind::BOOLEAN);
+            continue;
+        }
+        for (uint32_t row = 0; row < count; row++) {
+            Kind kind = values->at(row);
+            result.kinds[start + row] = kind;
+            switch (kind) {
+                case Kind::NUMBER: result.numbers[start + row] = values->numbers[row]; break;
+                case Kind::BOOLEAN: result.booleans[start + row] = values->booleans[row]; break;
+                case Kind::STRING:
+                    if (result.strings.empty()) result.strings.resize(rows);
+                    result.strings[start + row] = values->strings[row];
+                    break;
+                default: break;
+            }
+        }
+    }
+    return result;
+}
+
+void BatchEvaluator::evaluateRows(const std::vector<Column>& columns, size_t first, size_t last, BatchResult& result) {
+    std::vector<RuleInput> inputs(columns.size());
+    for (size_t row = first; row < last; row++) {
+        for (size_t i = 0; i < columns.size(); i++) {
+            const Column& column = columns[i];
+            switch (column.kind) {
+                case Column::Kind::NUMBER: inputs[i] = RuleInput(column.numbers[row]); break;
+                case Column::Kind::BOOLEAN: inputs[i] = RuleInput(column.booleans[row]); break;
+                case Column::Kind::STRING: inputs[i] = RuleInput(column.strings[row]); break;
+            }
+        }
+        Value value = evaluator.evaluate(inputs);
+        scalarRows++;
+        switch (value.type) {
+            case TokenType::NUMBER:
+                result.kinds[row] = Kind::NUMBER;
+                result.numbers[row] = value.number;
+                break;
+            case TokenType::TRUE:
+            case TokenType::FALSE:
+                result.kinds[row] = Kind::BOOLEAN;
+                result.booleans[row] = value.type == TokenType::TRUE;
+                break;
+            case TokenType::STRING:
+            case TokenType::FUN:
+                result.kinds[row] = value.type == TokenType::STRING ? Kind::STRING : Kind::FUNCTION;
+                if (result.strings.empty()) result.strings.resize(result.kinds.size());
+                result.strings[row] = evaluator.toString(value);
+                break;
+            default:
+                result.kinds[row] = Kind::NIL;
+                break;
+        }
+    }
+}
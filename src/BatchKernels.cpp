@@ -0,0 +1,153 @@
+#include "BatchKernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define CPPLOX_BATCH_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Scalar kernels, also used for the numbers after the last full vector, kept scalar so they measure one number per step
+
+#define CPPLOX_SCALAR __attribute__((optimize("no-tree-vectorize")))
+#define SCALAR_ARITHMETIC(name, op) \
+    CPPLOX_SCALAR void name(const double* left, const double* right, double* out, size_t count) { \
+        for (size_t i = 0; i < count; i++) out[i] = left[i] op right[i]; \
+    }
+#define SCALAR_COMPARISON(name, op) \
+    CPPLOX_SCALAR void name(const double* left, const double* right, uint8_t* out, size_t count) { \
+        for (size_t i = 0; i < count; i++) out[i] = left[i] op right[i]; \
+    }
+
+    SCALAR_ARITHMETIC(scalarAdd, +)
+    SCALAR_ARITHMETIC(scalarSubtract, -)
+    SCALAR_ARITHMETIC(scalarMultiply, *)
+    SCALAR_ARITHMETIC(scalarDivide, /)
+    SCALAR_COMPARISON(scalarGreater, >)
+    SCALAR_COMPARISON(scalarGreaterEqual, >=)
+    SCALAR_COMPARISON(scalarLess, <)
+    SCALAR_COMPARISON(scalarLessEqual, <=)
+    SCALAR_COMPARISON(scalarEqual, ==)
+    SCALAR_COMPARISON(scalarNotEqual, !=)
+
+#undef SCALAR_COMPARISON
+#undef SCALAR_ARITHMETIC
+#undef CPPLOX_SCALAR
+
+    const BatchKernels SCALAR = {
+        "scalar", scalarAdd, scalarSubtract, scalarMultiply, scalarDivide,
+        scalarGreater, scalarGreaterEqual, scalarLess, scalarLessEqual, scalarEqual, scalarNotEqual
+    };
+
+#ifdef CPPLOX_BATCH_X86
+    // SSE2 kernels, 2 numbers per step, always available on x86-64
+
+#define SSE2_ARITHMETIC(name, intrinsic, tail) \
+    void name(const double* left, const double* right, double* out, size_t count) { \
+        size_t i = 0; \
+        for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, intrinsic(_mm_loadu_pd(left + i), _mm_loadu_pd(right + i))); \
+        tail(left + i, right + i, out + i, count - i); \
+    }
+
+    // The mask of a comparison holds one bit per number, spread here into one byte per number
+#define SSE2_COMPARISON(name, intrinsic, tail) \
+    void name(const double* left, const double* right, uint8_t* out, size_t count) { \
+        size_t i = 0; \
+        for (; i + 2 <= count; i += 2) { \
+            int mask = _mm_movemask_pd(intrinsic(_mm_loadu_pd(left + i), _mm_loadu_pd(right + i))); \
+            out[i] = mask & 1; \
+            out[i + 1] = (mask >> 1) & 1; \
+        } \
+        tail(left + i, right + i, out + i, count - i); \
+    }
+
+    SSE2_ARITHMETIC(sse2Add, _mm_add_pd, scalarAdd)
+    SSE2_ARITHMETIC(sse2Subtract, _mm_sub_pd, scalarSubtract)
+    SSE2_ARITHMETIC(sse2Multiply, _mm_mul_pd, scalarMultiply)
+    SSE2_ARITHMETIC(sse2Divide, _mm_div_pd, scalarDivide)
+    SSE2_COMPARISON(sse2Greater, _mm_cmpgt_pd, scalarGreater)
+    SSE2_COMPARISON(sse2GreaterEqual, _mm_cmpge_pd, scalarGreaterEqual)
+    SSE2_COMPARISON(sse2Less, _mm_cmplt_pd, scalarLess)
+    SSE2_COMPARISON(sse2LessEqual, _mm_cmple_pd, scalarLessEqual)
+    SSE2_COMPARISON(sse2Equal, _mm_cmpeq_pd, scalarEqual)
+    SSE2_COMPARISON(sse2NotEqual, _mm_cmpneq_pd, scalarNotEqual)
+
+#undef SSE2_COMPARISON
+#undef SSE2_ARITHMETIC
+
+    const BatchKernels SSE2 = {
+        "sse2", sse2Add, sse2Subtract, sse2Multiply, sse2Divide,
+        sse2Greater, sse2GreaterEqual, sse2Less, sse2LessEqual, sse2Equal, sse2NotEqual
+    };
+
+    // AVX2 kernels, 4 numbers per step, only called after checking the CPU supports them
+
+#define CPPLOX_AVX2 __attribute__((target("avx2")))
+#define AVX2_ARITHMETIC(name, intrinsic, tail) \
+    CPPLOX_AVX2 void name(const double* left, const double* right, double* out, size_t count) { \
+        size_t i = 0; \
+        for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, intrinsic(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i))); \
+        tail(left + i, right + i, out + i, count - i); \
+    }
+
+    // Ordered predicates are false for NaN, the unordered one for != is true, as with the scalar operators
+#define AVX2_COMPARISON(name, predicate, tail) \
+    CPPLOX_AVX2 void name(const double* left, const double* right, uint8_t* out, size_t count) { \
+        size_t i = 0; \
+        for (; i + 4 <= count; i += 4) { \
+            int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(left + i), _mm256_loadu_pd(right + i), predicate)); \
+            out[i] = mask & 1; \
+            out[i + 1] = (mask >> 1) & 1; \
+            out[i + 2] = (mask >> 2) & 1; \
+            out[i + 3] = (mask >> 3) & 1; \
+        } \
+        tail(left + i, right + i, out + i, count - i); \
+    }
+
+    AVX2_ARITHMETIC(avx2Add, _mm256_add_pd, scalarAdd)
+    AVX2_ARITHMETIC(avx2Subtract, _mm256_sub_pd, scalarSubtract)
+    AVX2_ARITHMETIC(avx2Multiply, _mm256_mul_pd, scalarMultiply)
+    AVX2_ARITHMETIC(avx2Divide, _mm256_div_pd, scalarDivide)
+    AVX2_COMPARISON(avx2Greater, _CMP_GT_OQ, scalarGreater)
+    AVX2_COMPARISON(avx2GreaterEqual, _CMP_GE_OQ, scalarGreaterEqual)
+    AVX2_COMPARISON(avx2Less, _CMP_LT_OQ, scalarLess)
+    AVX2_COMPARISON(avx2LessEqual, _CMP_LE_OQ, scalarLessEqual)
+    AVX2_COMPARISON(avx2Equal, _CMP_EQ_OQ, scalarEqual)
+    AVX2_COMPARISON(avx2NotEqual, _CMP_NEQ_UQ, scalarNotEqual)
+
+#undef AVX2_COMPARISON
+#undef AVX2_ARITHMETIC
+#undef CPPLOX_AVX2
+
+    const BatchKernels AVX2 = {
+        "avx2", avx2Add, avx2Subtract, avx2Multiply, avx2Divide,
+        avx2Greater, avx2GreaterEqual, avx2Less, avx2LessEqual, avx2Equal, avx2NotEqual
+    };
+
+    bool cpuHasAvx2() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+}
+
+const BatchKernels& BatchKernels::best() {
+#ifdef CPPLOX_BATCH_X86
+    static const BatchKernels& selected = cpuHasAvx2() ? AVX2 : SSE2;
+    return selected;
+#else
+    return SCALAR;
+#endif
+}
+
+const BatchKernels& BatchKernels::scalar() {
+    return SCALAR;
+}
+
+std::vector<const BatchKernels*> BatchKernels::available() {
+    std::vector<const BatchKernels*> kernels = {&SCALAR};
+#ifdef CPPLOX_BATCH_X86
+    kernels.push_back(&SSE2);
+    if (cpuHasAvx2()) kernels.push_back(&AVX2);
+#endif
+    return kernels;
+}
@@ -0,0 +1,60 @@
+#include "BatchRunner.hpp"
+#include "Source.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+BatchRunner::BatchRunner(unsigned jobs, const HeapConfig& config)
+    : vm(config), jobs(jobs == 0 ? std::thread::hardware_concurrency() : jobs) {}
+
+std::vector<std::string> BatchRunner::listScripts(const std::string& target) {
+    std::vector<std::string> paths;
+    std::error_code error;
+    if (std::filesystem::is_directory(target, error)) {
+        for (const auto& entry : std::filesystem::directory_iterator(target, error)) {
+            if (entry.path().extension() == ".lox" && entry.is_regular_file(error)) paths.push_back(entry.path().string());
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    std::ifstream list(target);
+    std::string line;
+    while (std::getline(list, line)) {
+        // Trailing whitespace, such as a carriage return, is not part of the path
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty() && line[0] != '#') paths.push_back(line);
+    }
+    return paths;
+}
+
+std::vector<ScriptResult> BatchRunner::run(const std::vector<std::string>& paths) {
+    std::vector<ScriptResult> results(paths.size());
+    ThreadPool pool(std::max(1u, std::min(jobs, static_cast<unsigned>(paths.size()))));
+    pool.forEach(paths.size(), [&](size_t i) {
+        ScriptResult& result = results[i];
+        result.path = paths[i];
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<Source> file = Source::map(paths[i]);
+        if (!file) {
+            result.status = 1;
+            result.errors = "Could not open file " + paths[i] + "\n";
+        } else {
+            // The isolate is destroyed before the clock stops, so tasks the script spawned are waited for
+            std::shared_ptr<const Program> program = vm.compile(std::string(file->text()));
+            std::unique_ptr<Isolate> isolate = vm.createIsolate();
+            isolate->setOutput([&](std::string_view text) { result.output.append(text).append("\n"); });
+            isolate->setErrors([&](std::string_view text) { result.errors.append(text).append("\n"); });
+            switch (isolate->run(program)) {
+                case RunStatus::OK: result.status = 0; break;
+                case RunStatus::COMPILE_ERROR: result.status = 65; break;
+                case RunStatus::RUNTIME_ERROR: result.status = 70; break;
+            }
+            isolate.reset();
+        }
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    });
+    return results;
+}
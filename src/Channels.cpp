@@ -0,0 +1,186 @@
+#include "Channels.hpp"
+#include "Interpreter.hpp"
+#include "LoxString.hpp"
+#include "NativeError.hpp"
+#include "TaskPool.hpp"
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+namespace {
+const double MAX_CAPACITY = 1 << 20; // Largest capacity, the cells are allocated up front
+
+// Copies a value out of its heap, strings as their characters, numbers and other values without an object as they are
+Channel::Message pack(const Value& value, Heap& heap) {
+    Channel::Message message;
+    if (value.type == TokenType::STRING) {
+        message.kind = Channel::Message::Kind::STRING;
+        message.text = static_cast<LoxString*>(value.object)->str(heap);
+    } else if (value.isObject()) {
+        message.kind = Channel::Message::Kind::COPY;
+        message.copy = Snapshot::capture(value, heap);
+    } else {
+        message.value = value;
+    }
+    return message;
+}
+
+Value unpack(Channel::Message& message, Heap& heap) {
+    switch (message.kind) {
+        case Channel::Message::Kind::STRING:
+            return Value::objectValue(TokenType::STRING, heap.allocate<LoxString>(std::move(message.text)));
+        case Channel::Message::Kind::COPY:
+            return message.copy.restore(heap);
+        default:
+            return message.value;
+    }
+}
+
+LoxChannel& channelOf(const Value& value, const char* error) {
+    LoxChannel* channel = value.type == TokenType::FUN ? dynamic_cast<LoxChannel*>(static_cast<LoxCallable*>(value.object)) : nullptr;
+    if (channel == nullptr) throw NativeError(error);
+    return *channel;
+}
+}
+
+Channel::Channel(size_t capacity) : capacity(capacity), cells(new Cell[capacity]) {
+    for (size_t i = 0; i < capacity; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool Channel::trySend(Message& message) {
+    size_t position = writePosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position % capacity];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (lap == 0) {
+            // The cell is free for this position, claim it
+            if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (lap < 0) {
+            // The cell still holds the message of the previous lap
+            return false;
+        } else {
+            // Another writer claimed the position first
+            position = writePosition.load(std::memory_order_relaxed);
+        }
+    }
+    cell->message = std::move(message);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool Channel::tryReceive(Message& message) {
+    size_t position = readPosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position % capacity];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (lap == 0) {
+            // The cell holds the message for this position, claim it
+            if (readPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (lap < 0) {
+            // Nothing was written at this position yet
+            return false;
+        } else {
+            // Another reader claimed the position first
+            position = readPosition.load(std::memory_order_relaxed);
+        }
+    }
+    message = std::move(cell->message);
+    cell->message = Message();
+    // Free for the writer one lap later
+    cell->sequence.store(position + capacity, std::memory_order_release);
+    return true;
+}
+
+void Channel::send(Message message) {
+    for (int spin = 0; spin < SPINS; spin++) {
+        if (trySend(message)) {
+            notify();
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    // The receivers may be tasks queued behind this one, the pool runs them elsewhere meanwhile
+    TaskPool::Blocking blocking(TaskPool::shared());
+    sleepers++;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return trySend(message); });
+    }
+    sleepers--;
+    notify();
+}
+
+Channel::Message Channel::receive() {
+    Message message;
+    receive(message, [] { return false; });
+    return message;
+}
+
+bool Channel::receive(Message& message, const std::function<bool()>& abandoned) {
+    for (int spin = 0; spin < SPINS; spin++) {
+        if (tryReceive(message)) {
+            notify();
+            return true;
+        }
+        std::this_thread::yield();
+    }
+
+    TaskPool::Blocking blocking(TaskPool::shared());
+    sleepers++;
+    bool received = false;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&] { return (received = tryReceive(message)) || abandoned(); });
+    }
+    sleepers--;
+    if (received) notify();
+    return received;
+}
+
+void Channel::notify() {
+    // Sleepers register before checking the ring, so either they see the change or it sees them
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load() == 0) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+    }
+    // Senders and receivers sleep on the same variable, waking one could wake the wrong side
+    changed.notify_all();
+}
+
+Value LoxChannel::receive(Interpreter& interpreter) {
+    // Messages and snapshots hold the channel like handles do, so a count of one leaves this handle alone, on a thread that cannot send while it waits
+    Channel::Message message;
+    if (!channel->receive(message, [&] { return channel.use_count() == 1; })) {
+        throw NativeError("Nothing else can send to the channel.");
+    }
+    return unpack(message, interpreter.getHeap());
+}
+
+Value LoxChannel::call(Interpreter& interpreter, const std::vector<Value>& /* arguments */) {
+    return receive(interpreter);
+}
+
+Value MakeChannel::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& capacity = arguments[0];
+    if (capacity.type != TokenType::NUMBER || capacity.number < 1 || capacity.number > MAX_CAPACITY || capacity.number != std::floor(capacity.number)) {
+        throw NativeError("Channel capacity must be an integer from 1 to 1048576.");
+    }
+    auto channel = std::make_shared<Channel>(static_cast<size_t>(capacity.number));
+    return Value::objectValue(TokenType::FUN, interpreter.getHeap().allocate<LoxChannel>(std::move(channel)));
+}
+
+Value Send::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    Channel& channel = channelOf(arguments[0], "Can only send to channels.").get();
+    channel.send(pack(arguments[1], interpreter.getHeap()));
+    return Value();
+}
+
+Value Receive::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    return channelOf(arguments[0], "Can only receive from channels.").receive(interpreter);
+}
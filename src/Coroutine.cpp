@@ -0,0 +1,47 @@
+#include "Coroutine.hpp"
+#include <utility>
+
+Coroutine::Coroutine(std::function<void()> body) : body(std::move(body)) {}
+
+Coroutine::~Coroutine() {
+    if (context.getStack() != nullptr && !done) {
+        cancelled = true;
+        try {
+            resume();
+        } catch (...) {
+            // An error raised while unwinding has nowhere to go
+        }
+    }
+    FiberContext::unmapStack(context.release());
+}
+
+void Coroutine::resume() {
+    if (done) return;
+    if (context.getStack() == nullptr) context.start(FiberContext::mapStack(), &Coroutine::entry, this);
+    caller.switchTo(context);
+
+    // The stack is no longer in use once the function has returned
+    if (done) {
+        FiberContext::unmapStack(context.release());
+        if (error) std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+void Coroutine::yield() {
+    context.switchTo(caller);
+    if (cancelled) throw Unwind();
+}
+
+void Coroutine::entry(void* coroutine) {
+    Coroutine* self = static_cast<Coroutine*>(coroutine);
+    try {
+        self->body();
+    } catch (const Unwind&) {
+        // Destroyed while suspended, nobody is left to see an error
+    } catch (...) {
+        self->error = std::current_exception();
+    }
+    self->body = nullptr;
+    self->done = true;
+    self->context.switchTo(self->caller, true);
+}
@@ -1,39 +1,60 @@
 #include "Environment.hpp"
+#include "RuntimeError.hpp"
 
-void Environment::define(const std::string& name, const std::pair<std::shared_ptr<void>, TokenType>& value) {
+void Environment::define(const std::string& name, const Value& value) {
     // Define the variable in the environment
-    values[name] = value;
-}
-
-std::pair<std::shared_ptr<void>, TokenType> Environment::get(const Token& name) {
-    // Look up the variable in the environment
-    if (values.find(name.getLexeme()) != values.end()) {
-        return values[name.getLexeme()];
+    if (values.insert_or_assign(name, value).second) {
+        // A new variable grows the environment
+        heap.resized(this, size() - ENTRY_SIZE);
     }
+    heap.writeBarrier(this, value);
+}
 
-    // If the variable is not found, check the enclosing environment
-    if (enclosing != nullptr) {
-        return (*enclosing).get(name);
+Value Environment::get(const Token& name) {
+    // The name is converted once, then looked up in each scope from the innermost outwards
+    const std::string key(name.getLexeme());
+    for (Environment* environment = this; environment != nullptr; environment = environment->enclosing) {
+        auto found = environment->values.find(key);
+        if (found != environment->values.end()) {
+            return found->second;
+        }
     }
 
-    // If the variable is not found in the enclosing environment, throw an error
-    throw std::runtime_error("Undefined variable '" + name.getLexeme() + "'.");
+    // If the variable is not found in any enclosing environment, throw an error
+    throw RuntimeError(name, "Undefined variable '" + key + "'.");
 }
 
 
-void Environment::assign(const Token& name, const std::pair<std::shared_ptr<void>, TokenType>& value) {
-    // Assign a new value to an existing variable in the environment
-    if (values.find(name.getLexeme()) != values.end()) {
-        values[name.getLexeme()] = value;
-        return;
+void Environment::assign(const Token& name, const Value& value) {
+    // Assign a new value to the variable in the innermost scope defining it
+    const std::string key(name.getLexeme());
+    for (Environment* environment = this; environment != nullptr; environment = environment->enclosing) {
+        auto found = environment->values.find(key);
+        if (found != environment->values.end()) {
+            found->second = value;
+            environment->heap.writeBarrier(environment, value);
+            return;
+        }
     }
 
-    // If the variable is not found, check the enclosing environment
-    if (enclosing != nullptr) {
-        (*enclosing).assign(name, value);
-        return;
+    // If the variable is not found in any enclosing environment, throw an error
+    throw RuntimeError(name, "Undefined variable '" + key + "'.");
+}
+
+void Environment::trace(Heap& heap) {
+    // Keep the enclosing scope and every stored value alive
+    heap.markObject(enclosing);
+    for (auto& entry : values) {
+        heap.markValue(entry.second);
     }
+}
+
+size_t Environment::size() const {
+    return sizeof(Environment) + values.size() * ENTRY_SIZE;
+}
 
-    // If the variable is not found in the enclosing environment, throw an error
-    throw std::runtime_error("Undefined variable '" + name.getLexeme() + "'.");
-}
\ No newline at end of file
+LoxObject* Environment::promote() {
+    Environment* promoted = new Environment(heap, enclosing);
+    promoted->values = std::move(values);
+    return promoted;
+}
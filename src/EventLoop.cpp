@@ -0,0 +1,304 @@
+#include "EventLoop.hpp"
+#include "Async.hpp"
+#include "LoxString.hpp"
+#include "NativeError.hpp"
+#include "RuntimeError.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+const size_t MAX_SPARE_STACKS = 64; // Stacks kept for reuse when fibers finish
+const int MAX_EVENTS = 64; // Events taken from epoll at once
+}
+
+EventLoop::EventLoop(Interpreter& interpreter) : interpreter(interpreter), running(&main) {}
+
+EventLoop::~EventLoop() {
+    // Fibers suspended halfway unwind before their stacks go, those that never ran have no frames
+    cancelling = true;
+    while (true) {
+        auto started = std::find_if(fibers.begin(), fibers.end(), [](const auto& entry) { return entry.second->context.getStack() != nullptr; });
+        if (started == fibers.end()) break;
+        switchTo(started->first);
+        release();
+    }
+    for (auto& [fiber, owned] : fibers) FiberContext::unmapStack(owned->context.release());
+    if (finished) FiberContext::unmapStack(finished->context.release());
+    for (char* stack : spareStacks) FiberContext::unmapStack(stack);
+    if (epoll >= 0) close(epoll);
+}
+
+void EventLoop::start(const Value& function, const Value& promise) {
+    auto fiber = std::make_unique<Fiber>();
+    fiber->state.environment = interpreter.globals;
+    fiber->function = function;
+    fiber->promise = promise;
+    ready.push_back(fiber.get());
+    fibers.emplace(fiber.get(), std::move(fiber));
+}
+
+void EventLoop::wake(Fiber& fiber) {
+    ready.push_back(&fiber);
+}
+
+void EventLoop::suspend() {
+    Fiber* self = running;
+
+    // Timers that expired while this fiber ran get their turn behind the fibers already ready
+    poll(false);
+    while (ready.empty()) {
+        if (timers.empty() && watching == 0) {
+            // Every fiber waits for another, only the program can stop waiting, with an error
+            if (self == &main) throw NativeError("Every async function is waiting for another.");
+            main.deadlocked = true;
+            ready.push_back(&main);
+            break;
+        }
+        poll(true);
+    }
+
+    Fiber* next = ready.front();
+    ready.pop_front();
+    if (next != self) switchTo(next);
+
+    // Resumed
+    release();
+    if (cancelling) throw Unwind();
+    if (self->deadlocked) {
+        self->deadlocked = false;
+        throw NativeError("Every async function is waiting for another.");
+    }
+}
+
+void EventLoop::sleep(double ms) {
+    auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    timers.push(Timer{std::chrono::steady_clock::now() + delay, timerCount++, running});
+    suspend();
+}
+
+Value EventLoop::readLine(int fd) {
+    Reader& reader = readers[fd];
+    while (true) {
+        // A line already read, or what is left at the end of the input
+        size_t newline = reader.buffer.find('\n');
+        if (newline != std::string::npos || (reader.ended && !reader.buffer.empty())) {
+            std::string line = reader.buffer.substr(0, newline);
+            reader.buffer.erase(0, newline == std::string::npos ? std::string::npos : newline + 1);
+            return Value::objectValue(TokenType::STRING, interpreter.getHeap().allocate<LoxString>(std::move(line)));
+        }
+        if (reader.ended) return Value();
+
+        // Descriptors epoll cannot watch never block for long, they are read in place
+        if (!reader.watched && !watch(fd, reader, true)) {
+            char chunk[4096];
+            ssize_t count = ::read(fd, chunk, sizeof(chunk));
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0 && errno == EBADF) throw NativeError("Cannot read from file descriptor " + std::to_string(fd) + ".");
+            if (count <= 0) reader.ended = true;
+            else reader.buffer.append(chunk, count);
+            continue;
+        }
+
+        // Otherwise wait for the loop to hand over a line, in the order the fibers asked
+        Fiber* self = running;
+        reader.waiting.push_back(self);
+        suspend();
+        Value line = self->received;
+        self->received = Value();
+        return line;
+    }
+}
+
+void EventLoop::drain() {
+    while (!fibers.empty()) {
+        drainer = running;
+        try {
+            suspend();
+        } catch (...) {
+            drainer = nullptr;
+            throw;
+        }
+    }
+}
+
+void EventLoop::markRoots(Heap& heap) {
+    auto mark = [&](Fiber& fiber) {
+        // The running fiber's state is the interpreter's own
+        if (&fiber != running) fiber.state.mark(heap);
+        heap.markValue(fiber.function);
+        heap.markValue(fiber.promise);
+        heap.markValue(fiber.awaited);
+        heap.markValue(fiber.received);
+    };
+    mark(main);
+    for (auto& [fiber, owned] : fibers) mark(*owned);
+}
+
+void EventLoop::entry(void* argument) {
+    EventLoop* loop = static_cast<EventLoop*>(argument);
+    Fiber* self = loop->running;
+    loop->release();
+
+    // Run the function, keeping its error for the fibers awaiting it
+    Interpreter& interpreter = loop->interpreter;
+    Value result;
+    bool failed = false;
+    bool unwound = false;
+    std::string error;
+    std::optional<Token> token;
+    try {
+        result = interpreter.call(self->function, {});
+    } catch (const Unwind&) {
+        unwound = true;
+    } catch (const RuntimeError& caught) {
+        failed = true;
+        error = caught.what();
+        token.emplace(caught.token);
+    } catch (const std::exception& caught) {
+        failed = true;
+        error = caught.what();
+    }
+
+    // The loop is being destroyed and nobody is left to await the promise; the fiber leaves for good, outside the handler
+    if (unwound) {
+        auto owned = loop->fibers.find(self);
+        loop->finished = std::move(owned->second);
+        loop->fibers.erase(owned);
+        loop->switchTo(&loop->main);
+    }
+
+    // Settle the promise and wake whoever awaits it
+    LoxPromise* promise = static_cast<LoxPromise*>(self->promise.object);
+    promise->settled = true;
+    promise->result = result;
+    interpreter.getHeap().writeBarrier(promise, result);
+    promise->failed = failed;
+    promise->error = std::move(error);
+    if (token) promise->token.emplace(*token);
+    for (Fiber* waiter : promise->waiters) loop->wake(*waiter);
+    promise->waiters.clear();
+    self->function = Value();
+    self->promise = Value();
+
+    // The fiber is freed by the next one to run, once this stack is no longer in use
+    auto owned = loop->fibers.find(self);
+    loop->finished = std::move(owned->second);
+    loop->fibers.erase(owned);
+    if (loop->fibers.empty() && loop->drainer != nullptr) {
+        loop->wake(*loop->drainer);
+        loop->drainer = nullptr;
+    }
+    loop->suspend();
+}
+
+void EventLoop::switchTo(Fiber* next) {
+    Fiber* self = running;
+    interpreter.swapState(self->state);
+    interpreter.swapState(next->state);
+    running = next;
+
+    if (next->context.getStack() == nullptr && next != &main) {
+        // First run: give the fiber a stack, reusing one of a finished fiber if possible
+        char* stack;
+        if (!spareStacks.empty()) {
+            stack = spareStacks.back();
+            spareStacks.pop_back();
+        } else {
+            stack = FiberContext::mapStack();
+        }
+        next->context.start(stack, &EventLoop::entry, this);
+    }
+    // A fiber that ended never comes back, so its sanitizer state can go
+    self->context.switchTo(next->context, finished.get() == self);
+}
+
+void EventLoop::release() {
+    if (!finished) return;
+    char* stack = finished->context.release();
+    if (spareStacks.size() < MAX_SPARE_STACKS) {
+        spareStacks.push_back(stack);
+    } else {
+        FiberContext::unmapStack(stack);
+    }
+    finished.reset();
+}
+
+void EventLoop::poll(bool block) {
+    auto now = std::chrono::steady_clock::now();
+    if (watching > 0) {
+        // Wait for input until the next timer at the latest
+        int timeout = 0;
+        if (block) {
+            timeout = -1;
+            if (!timers.empty()) {
+                auto left = std::chrono::ceil<std::chrono::milliseconds>(timers.top().deadline - now).count();
+                timeout = static_cast<int>(std::max<long long>(0, left));
+            }
+        }
+        epoll_event events[MAX_EVENTS];
+        int count = epoll_wait(epoll, events, MAX_EVENTS, timeout);
+        for (int i = 0; i < count; i++) readInput(events[i].data.fd);
+        now = std::chrono::steady_clock::now();
+    } else if (block && !timers.empty() && timers.top().deadline > now) {
+        std::this_thread::sleep_until(timers.top().deadline);
+        now = std::chrono::steady_clock::now();
+    }
+
+    // Wake the sleepers whose deadline passed, earliest first
+    while (!timers.empty() && timers.top().deadline <= now) {
+        wake(*timers.top().fiber);
+        timers.pop();
+    }
+}
+
+void EventLoop::readInput(int fd) {
+    Reader& reader = readers[fd];
+    char chunk[4096];
+    ssize_t count = ::read(fd, chunk, sizeof(chunk));
+    if (count < 0 && (errno == EINTR || errno == EAGAIN)) return;
+    if (count <= 0) {
+        reader.ended = true;
+    } else {
+        reader.buffer.append(chunk, count);
+    }
+
+    // Hand out the complete lines, then nil to the fibers left once the input ended
+    while (!reader.waiting.empty()) {
+        Fiber* fiber = reader.waiting.front();
+        size_t newline = reader.buffer.find('\n');
+        if (newline == std::string::npos && !reader.ended) break;
+        if (newline == std::string::npos && reader.buffer.empty()) {
+            fiber->received = Value();
+        } else {
+            std::string line = reader.buffer.substr(0, newline);
+            reader.buffer.erase(0, newline == std::string::npos ? std::string::npos : newline + 1);
+            fiber->received = Value::objectValue(TokenType::STRING, interpreter.getHeap().allocate<LoxString>(std::move(line)));
+        }
+        reader.waiting.pop_front();
+        wake(*fiber);
+    }
+
+    // Input nobody asked for stays in the pipe until someone does
+    if (reader.waiting.empty()) watch(fd, reader, false);
+}
+
+bool EventLoop::watch(int fd, Reader& reader, bool watch) {
+    if (epoll < 0) {
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll < 0) return false;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, fd, &event) != 0) return false;
+    reader.watched = watch;
+    if (watch) {
+        watching++;
+    } else {
+        watching--;
+    }
+    return true;
+}
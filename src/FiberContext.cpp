@@ -0,0 +1,101 @@
+#include "FiberContext.hpp"
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+// AddressSanitizer must be told when execution moves to another stack
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#define START_SWITCH_FIBER(fakeStack, bottom, size) __sanitizer_start_switch_fiber(fakeStack, bottom, size)
+#define FINISH_SWITCH_FIBER(fakeStack, bottom, size) __sanitizer_finish_switch_fiber(fakeStack, bottom, size)
+#else
+#define START_SWITCH_FIBER(fakeStack, bottom, size)
+#define FINISH_SWITCH_FIBER(fakeStack, bottom, size)
+#endif
+
+// ThreadSanitizer must be told which stack runs, or it takes the switches for one thread's calls and returns
+#if defined(__SANITIZE_THREAD__)
+#include <sanitizer/tsan_interface.h>
+#define CURRENT_FIBER() __tsan_get_current_fiber()
+#define CREATE_FIBER() __tsan_create_fiber(0)
+#define DESTROY_FIBER(fiber) __tsan_destroy_fiber(fiber)
+#define SWITCH_TO_FIBER(fiber) __tsan_switch_to_fiber(fiber, 0)
+#else
+#define CURRENT_FIBER() nullptr
+#define CREATE_FIBER() nullptr
+#define DESTROY_FIBER(fiber)
+#define SWITCH_TO_FIBER(fiber)
+#endif
+
+thread_local FiberContext* FiberContext::switching = nullptr;
+thread_local FiberContext* FiberContext::entering = nullptr;
+
+namespace {
+const size_t GUARD_SIZE = 4096; // Inaccessible page below each stack, so an overflow faults instead of corrupting memory
+}
+
+char* FiberContext::mapStack() {
+    void* mapping = mmap(nullptr, STACK_SIZE + GUARD_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED) throw std::bad_alloc();
+    mprotect(mapping, GUARD_SIZE, PROT_NONE);
+    return static_cast<char*>(mapping);
+}
+
+void FiberContext::unmapStack(char* stack) {
+    if (stack != nullptr) munmap(stack, STACK_SIZE + GUARD_SIZE);
+}
+
+FiberContext::~FiberContext() {
+    release();
+}
+
+void FiberContext::start(char* stack, void (*function)(void*), void* argument) {
+    this->stack = stack;
+    this->function = function;
+    this->argument = argument;
+    bottom = stack + GUARD_SIZE;
+    size = STACK_SIZE;
+    getcontext(&context);
+    context.uc_stack.ss_sp = stack + GUARD_SIZE;
+    context.uc_stack.ss_size = STACK_SIZE;
+    context.uc_link = nullptr;
+    makecontext(&context, &FiberContext::entry, 0);
+    fiber = CREATE_FIBER();
+}
+
+char* FiberContext::release() {
+    if (stack == nullptr) return nullptr;
+    DESTROY_FIBER(fiber);
+    fiber = nullptr;
+    fakeStack = nullptr;
+    bottom = nullptr;
+    size = 0;
+    char* released = stack;
+    stack = nullptr;
+    return released;
+}
+
+void FiberContext::switchTo(FiberContext& next, [[maybe_unused]] bool leaving) {
+    // The thread's own stack may be a different thread's each time, so its state is taken as it leaves
+    if (stack == nullptr) fiber = CURRENT_FIBER();
+    switching = this;
+    entering = &next;
+    START_SWITCH_FIBER(leaving ? nullptr : &fakeStack, next.bottom, next.size);
+    SWITCH_TO_FIBER(next.fiber);
+    swapcontext(&context, &next.context);
+    arrive();
+}
+
+void FiberContext::arrive() {
+    // Learns the bounds of the stack left, which the thread's own stack only reveals here
+    [[maybe_unused]] FiberContext* from = switching;
+    FINISH_SWITCH_FIBER(fakeStack, &from->bottom, &from->size);
+}
+
+void FiberContext::entry() {
+    FiberContext* self = entering;
+    self->arrive();
+    self->function(self->argument);
+    std::abort();
+}
@@ -0,0 +1,124 @@
+#include "FunctionBody.hpp"
+#include "Lox.hpp"
+#include <unordered_set>
+
+namespace {
+/**
+ * @class NameCollector
+ * @brief Lists the variables a tree reads or assigns, looking into nested function bodies
+ */
+class NameCollector : public ExprVisitor, public StmtVisitor {
+    std::unordered_set<std::string_view> seen; // Names already listed
+
+public:
+    std::vector<std::string> names; // Each name once, in the order first found
+
+    void name(std::string_view name) {
+        if (seen.insert(name).second) names.emplace_back(name);
+    }
+
+    void stmts(const std::vector<std::shared_ptr<Stmt>>& stmts) {
+        for (const std::shared_ptr<Stmt>& stmt : stmts) {
+            if (stmt != nullptr) stmt->accept(*this);
+        }
+    }
+
+    void expr(const std::unique_ptr<Expr>& expr) {
+        if (expr != nullptr) expr->accept(*this);
+    }
+
+    void visitAssign(const Assign& expr) override {
+        name(expr.name.getLexeme());
+        this->expr(expr.value);
+    }
+
+    void visitBinary(const Binary& expr) override {
+        this->expr(expr.left);
+        this->expr(expr.right);
+    }
+
+    void visitCall(const Call& expr) override {
+        this->expr(expr.callee);
+        for (const std::unique_ptr<Expr>& argument : expr.arguments) this->expr(argument);
+    }
+
+    void visitGrouping(const Grouping& expr) override {
+        this->expr(expr.expression);
+    }
+
+    void visitLiteral(const Literal&) override {}
+
+    void visitLogical(const Logical& expr) override {
+        this->expr(expr.left);
+        this->expr(expr.right);
+    }
+
+    void visitUnary(const Unary& expr) override {
+        this->expr(expr.right);
+    }
+
+    void visitVariable(const Variable& expr) override {
+        name(expr.name.getLexeme());
+    }
+
+    void visitBlock(const Block& stmt) override {
+        stmts(stmt.statements);
+    }
+
+    void visitExpression(const Expression& stmt) override {
+        expr(stmt.expression);
+    }
+
+    void visitFunction(const Function& stmt) override {
+        for (const std::string& nested : stmt.body->referencedNames()) name(nested);
+    }
+
+    void visitIf(const If& stmt) override {
+        expr(stmt.condition);
+        if (stmt.thenBranch != nullptr) stmt.thenBranch->accept(*this);
+        if (stmt.elseBranch != nullptr) stmt.elseBranch->accept(*this);
+    }
+
+    void visitPrint(const Print& stmt) override {
+        expr(stmt.expression);
+    }
+
+    void visitReturn(const Return& stmt) override {
+        expr(stmt.value);
+    }
+
+    void visitVar(const Var& stmt) override {
+        expr(stmt.initializer);
+    }
+
+    void visitWhile(const While& stmt) override {
+        expr(stmt.condition);
+        if (stmt.body != nullptr) stmt.body->accept(*this);
+    }
+};
+}
+
+const std::vector<std::shared_ptr<Stmt>>& FunctionBody::statements() {
+    if (!lazy) return parsed;
+
+    std::call_once(once, [this] {
+        // The pre-parser found no errors, any reported here are printed rather than lost
+        ErrorLog errors;
+        {
+            Lox::CollectErrors collect(errors);
+            TokenBuffer tokens = Scanner(text, line).scanTokens();
+            parsed = Parser(tokens).parseChecked();
+        }
+        Lox::printErrors(errors);
+    });
+    return parsed;
+}
+
+const std::vector<std::string>& FunctionBody::referencedNames() {
+    std::call_once(namesOnce, [this] {
+        NameCollector collector;
+        collector.stmts(statements());
+        names = std::move(collector.names);
+    });
+    return names;
+}
@@ -0,0 +1,241 @@
+#include "Heap.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    // Milliseconds elapsed since the given time point
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+Heap::Heap(const HeapConfig& config)
+    : config(config), nextGC(config.heapSize) {
+    // Reserve the nursery up front, objects are bump allocated into it
+    nursery = static_cast<char*>(::operator new(config.nurserySize));
+    nurseryTop = nursery;
+    nurseryEnd = nursery + config.nurserySize;
+}
+
+Heap::~Heap() {
+    // Destroy the young objects in place and free the nursery
+    for (LoxObject* object : youngObjects) {
+        object->~LoxObject();
+    }
+    ::operator delete(nursery);
+
+    // Free every old object regardless of reachability
+    LoxObject* object = objects;
+    while (object != nullptr) {
+        LoxObject* next = object->next;
+        delete object;
+        object = next;
+    }
+}
+
+void Heap::collectRequested() {
+    if (config.stress || majorRequested) {
+        collect();
+    } else {
+        collectNursery();
+        if (bytesAllocated > nextGC) collect();
+    }
+
+    // Everything left is reachable, so the program really needs more than the limit
+    if (config.maxHeap != 0 && getBytesAllocated() > config.maxHeap) throw HeapLimitError(config.maxHeap);
+}
+
+void Heap::collectNursery() {
+    auto start = std::chrono::steady_clock::now();
+
+    // Copy the young objects referenced by the roots and the remembered set
+    evacuating = true;
+    if (markRoots) markRoots(*this);
+    for (LoxObject* object : rememberedSet) {
+        object->remembered = false;
+        object->trace(*this);
+    }
+    rememberedSet.clear();
+
+    // Copy everything the promoted objects reference in turn
+    traceReferences();
+    evacuating = false;
+
+    // Every survivor now lives in the old space, so the nursery can be reset
+    for (LoxObject* object : youngObjects) {
+        if (!object->marked) unaccount(object);
+        object->~LoxObject();
+    }
+    youngObjects.clear();
+    nurseryTop = nursery;
+    youngBytes = 0;
+    minorRequested = false;
+    if (bytesAllocated > nextGC) majorRequested = true;
+
+    double pause = millisecondsSince(start);
+    stats.minorCollections++;
+    stats.minorPauseTotal += pause;
+    stats.minorPauseMax = std::max(stats.minorPauseMax, pause);
+}
+
+void Heap::collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    // Empty the nursery first so only old objects need marking
+    collectNursery();
+
+    // Mark the roots, then everything reachable from them
+    if (markRoots) markRoots(*this);
+    traceReferences();
+    sweep();
+
+    // Grow the threshold with the live heap so collections stay proportional to allocation
+    nextGC = std::max(config.heapSize, static_cast<size_t>(bytesAllocated * config.growthFactor));
+    majorRequested = false;
+
+    double pause = millisecondsSince(start);
+    stats.majorCollections++;
+    stats.majorPauseTotal += pause;
+    stats.majorPauseMax = std::max(stats.majorPauseMax, pause);
+}
+
+void Heap::reserve(size_t bytes) {
+    if (config.maxHeap != 0 && getBytesAllocated() + bytes > config.maxHeap) throw HeapLimitError(config.maxHeap);
+}
+
+void Heap::resized(LoxObject* object, size_t before) {
+    size_t after = object->size();
+    size_t index = static_cast<size_t>(object->kind);
+    memory.liveBytes[index] = memory.liveBytes[index] + after - before;
+
+    if (!object->old) {
+        youngBytes = youngBytes + after - before;
+        if (youngBytes >= config.nurserySize) minorRequested = true;
+    } else {
+        bytesAllocated = bytesAllocated + after - before;
+        if (bytesAllocated > nextGC) majorRequested = true;
+    }
+
+    size_t total = bytesAllocated + youngBytes;
+    if (total > memory.peakBytes) memory.peakBytes = total;
+    if (config.maxHeap != 0 && total > config.maxHeap) majorRequested = true;
+}
+
+void Heap::setRootMarker(std::function<void(Heap&)> callback) {
+    markRoots = std::move(callback);
+}
+
+void Heap::markValue(Value& value) {
+    if (value.isObject()) value.object = visit(value.object);
+}
+
+LoxObject* Heap::visit(LoxObject* object) {
+    if (object == nullptr) return object;
+
+    if (evacuating) {
+        // Old objects stay where they are during a minor collection
+        if (object->old) return object;
+
+        // Already copied, follow the forwarding pointer
+        if (object->marked) return object->next;
+
+        // Copy the object and leave a forwarding pointer behind
+        size_t youngSize = object->size();
+        LoxObject* promoted = object->promote();
+        promoted->kind = object->kind;
+        addOldObject(promoted);
+        stats.promotedBytes += promoted->size();
+        size_t index = static_cast<size_t>(promoted->kind);
+        memory.liveBytes[index] = memory.liveBytes[index] + promoted->size() - youngSize;
+        object->marked = true;
+        object->next = promoted;
+        grayStack.push_back(promoted);
+        return promoted;
+    }
+
+    // Defer tracing to keep the recursion depth independent of the object graph
+    if (!object->marked) {
+        object->marked = true;
+        grayStack.push_back(object);
+    }
+    return object;
+}
+
+void Heap::addOldObject(LoxObject* object) {
+    object->old = true;
+    object->marked = false;
+    object->remembered = false;
+    object->next = objects;
+    objects = object;
+    bytesAllocated += object->size();
+    if (bytesAllocated > nextGC) majorRequested = true;
+}
+
+void Heap::unaccount(LoxObject* object) {
+    size_t index = static_cast<size_t>(object->kind);
+    memory.liveObjects[index]--;
+    memory.liveBytes[index] -= object->size();
+}
+
+void Heap::remember(LoxObject* object) {
+    object->remembered = true;
+    rememberedSet.push_back(object);
+}
+
+void Heap::traceReferences() {
+    while (!grayStack.empty()) {
+        LoxObject* object = grayStack.back();
+        grayStack.pop_back();
+        object->trace(*this);
+    }
+}
+
+void Heap::sweep() {
+    LoxObject* previous = nullptr;
+    LoxObject* object = objects;
+    while (object != nullptr) {
+        if (object->marked) {
+            // Reachable, clear the mark for the next collection
+            object->marked = false;
+            previous = object;
+            object = object->next;
+            continue;
+        }
+
+        // Unreachable, unlink and free the object
+        LoxObject* unreached = object;
+        object = object->next;
+        if (previous != nullptr) {
+            previous->next = object;
+        } else {
+            objects = object;
+        }
+        bytesAllocated -= unreached->size();
+        unaccount(unreached);
+        delete unreached;
+    }
+}
+
+void Heap::setGrowthFactor(double factor) {
+    if (factor > 1.0) config.growthFactor = factor;
+}
+
+void Heap::setStressMode(bool enabled) {
+    config.stress = enabled;
+}
+
+size_t Heap::getBytesAllocated() const {
+    return bytesAllocated + youngBytes;
+}
+
+const GcStats& Heap::getStats() const {
+    return stats;
+}
+
+const MemoryStats& Heap::getMemoryStats() const {
+    return memory;
+}
+
+size_t Heap::getMaxHeap() const {
+    return config.maxHeap;
+}
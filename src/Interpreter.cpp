@@ -3,102 +3,242 @@
 #include "Lox.hpp"
 #include "LoxFunction.hpp"
 #include "Clock.hpp"
+#include "Tasks.hpp"
+#include "Parallel.hpp"
+#include "Channels.hpp"
+#include "Async.hpp"
+#include "EventLoop.hpp"
+#include "NativeError.hpp"
+#include "LoxString.hpp"
+#include <algorithm>
 #include <iostream>
 #include "ReturnException.hpp"
 
-Interpreter::Interpreter() {
-    globals->define("clock", std::make_pair(std::make_shared<Clock>(), TokenType::FUN)); // Add the clock function to the global environment
+Interpreter::Interpreter(const HeapConfig& config)
+    : Interpreter(config, std::make_shared<Sinks>()) {
+    sinks->output = [](std::string_view text) { std::cout << text << std::endl; };
+    sinks->errors = [](std::string_view text) { std::cerr << text << std::endl; };
 }
 
-void Interpreter::interpret(const std::vector<std::shared_ptr<Stmt>>& statements) {
+Interpreter::Interpreter(const HeapConfig& config, std::shared_ptr<Sinks> sinks)
+    : heap(config), globals(heap.allocate<Environment>(heap)), environment(globals), sinks(std::move(sinks)) {
+    heap.setRootMarker([this](Heap& heap) { markRoots(heap); });
+    globals->define("clock", Value::objectValue(TokenType::FUN, heap.allocate<Clock>())); // Add the clock function to the global environment
+    globals->define("spawn", Value::objectValue(TokenType::FUN, heap.allocate<Spawn>())); // Run a function on the task pool
+    globals->define("join", Value::objectValue(TokenType::FUN, heap.allocate<Join>())); // Wait for the result of a spawned function
+    globals->define("parallelFor", Value::objectValue(TokenType::FUN, heap.allocate<ParallelFor>())); // Call a function over a range on the task pool
+    globals->define("parallelReduce", Value::objectValue(TokenType::FUN, heap.allocate<ParallelReduce>())); // Fold a function over a range on the task pool
+    globals->define("channel", Value::objectValue(TokenType::FUN, heap.allocate<MakeChannel>())); // Create a channel between tasks
+    globals->define("send", Value::objectValue(TokenType::FUN, heap.allocate<Send>())); // Send a copy of a value through a channel
+    globals->define("recv", Value::objectValue(TokenType::FUN, heap.allocate<Receive>())); // Receive a value from a channel
+    globals->define("async", Value::objectValue(TokenType::FUN, heap.allocate<Async>())); // Run a function on a fiber of this thread
+    globals->define("await", Value::objectValue(TokenType::FUN, heap.allocate<Await>())); // Wait for the result of an async function
+    globals->define("sleep", Value::objectValue(TokenType::FUN, heap.allocate<Sleep>())); // Let other async functions run for a while
+    globals->define("readLineAsync", Value::objectValue(TokenType::FUN, heap.allocate<ReadLineAsync>())); // Read a line without blocking other async functions
+}
+
+Interpreter::~Interpreter() {
+    if (loop) {
+        try {
+            loop->drain();
+        } catch (const std::exception&) {
+            // Functions waiting for each other never finish, and are dropped with the loop
+        }
+    }
+    for (const std::shared_ptr<TaskPool::Task>& task : tasks) {
+        if (!task->isDone()) TaskPool::shared().wait(*task);
+    }
+}
+
+bool Interpreter::interpret(const std::vector<std::shared_ptr<Stmt>>& statements) {
     try {
         // Execute each statement
         for (const auto& statement : statements) {
             execute(*statement);
         }
+        return true;
     } catch (const RuntimeError& error) {
-        // Catch any runtime errors and print them
-        Lox::runtimeError(error);
+        // Catch any runtime errors, report them and unwind to the global scope
+        fail(std::string(error.what()) + "\n[line " + std::to_string(error.token.getLine()) + "]");
+    } catch (const HeapLimitError& error) {
+        // Running out of heap outside of any call has no line to report
+        fail(error.what());
+    }
+    return false;
+}
+
+void Interpreter::setOutput(Sink sink) {
+    std::lock_guard<std::mutex> lock(sinks->lock);
+    sinks->output = std::move(sink);
+}
+
+void Interpreter::setErrors(Sink sink) {
+    std::lock_guard<std::mutex> lock(sinks->lock);
+    sinks->errors = std::move(sink);
+}
+
+bool Interpreter::hadRuntimeError() const {
+    return runtimeError;
+}
+
+std::shared_ptr<Sinks> Interpreter::getSinks() const {
+    return sinks;
+}
+
+Value Interpreter::call(const Value& callee, const std::vector<Value>& arguments) {
+    // The callee and arguments are temporaries like those of a call expression
+    const size_t base = stack.size();
+    push(callee);
+    for (const Value& argument : arguments) {
+        push(argument);
+    }
+
+    try {
+        Value value = static_cast<LoxCallable*>(stack[base].object)->call(*this, std::vector<Value>(stack.begin() + base + 1, stack.end()));
+        stack.resize(base);
+        return value;
+    } catch (...) {
+        stack.resize(base);
+        throw;
     }
 }
 
+Value Interpreter::run(const std::vector<std::shared_ptr<Stmt>>& statements, const Expr* expr) {
+    // Nothing from an earlier run is held any more, so the heap may collect even if no statement runs
+    heap.safepoint();
+    const size_t base = stack.size();
+    try {
+        for (const auto& statement : statements) {
+            execute(*statement);
+        }
+        Value value = expr != nullptr ? evaluate(*expr) : Value();
+        stack.resize(base);
+        return value;
+    } catch (const ReturnException& returned) {
+        stack.resize(base);
+        return returned.value;
+    } catch (...) {
+        // Blocks restore their scopes as they unwind, the temporaries of the failed expression are dropped here
+        stack.resize(base);
+        throw;
+    }
+}
+
+void Interpreter::defineGlobal(const std::string& name, const Value& value) {
+    globals->define(name, value);
+}
+
+void Interpreter::track(std::shared_ptr<TaskPool::Task> task) {
+    // Finished tasks are dropped once in a while, so spawning in a loop keeps the list short
+    if (tasks.size() >= pruneAt) {
+        tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](const auto& task) { return task->isDone(); }), tasks.end());
+        pruneAt = 2 * tasks.size() + 64;
+    }
+    tasks.push_back(std::move(task));
+}
+
+EventLoop& Interpreter::getLoop() {
+    if (!loop) loop = std::make_unique<EventLoop>(*this);
+    return *loop;
+}
+
+void Interpreter::swapState(ExecutionState& state) {
+    std::swap(environment, state.environment);
+    environments.swap(state.environments);
+    stack.swap(state.stack);
+    std::swap(result, state.result);
+}
+
+void Interpreter::ExecutionState::mark(Heap& heap) {
+    heap.markObject(environment);
+    for (Environment*& saved : environments) {
+        heap.markObject(saved);
+    }
+    for (Value& value : stack) {
+        heap.markValue(value);
+    }
+    heap.markValue(result);
+}
+
 void Interpreter::execute(const Stmt& stmt) {
+    // Statement boundaries are the only points where the heap may collect or the interpreter be suspended
+    heap.safepoint();
+    tick();
     stmt.accept(*this);
 }
 
-std::shared_ptr<void> Interpreter::evaluate(const Expr& expr) {
+void Interpreter::setPreemption(uint64_t budget, std::function<void()> hook) {
+    this->budget = budget;
+    preempt = budget == 0 ? nullptr : std::move(hook);
+    budgetLeft = budget == 0 ? UINT64_MAX : budget;
+}
+
+void Interpreter::expire() {
+    budgetLeft = budget == 0 ? UINT64_MAX : budget;
+    if (preempt) preempt();
+}
+
+Value Interpreter::evaluate(const Expr& expr) {
     expr.accept(*this);
     return result;
 }
 
 void Interpreter::visitBinary(const Binary& expr) {
-    // Evaluate the left and right expressions
-    std::shared_ptr<void> left = evaluate(*expr.left);
-    const TokenType leftType = getType();
-    std::shared_ptr<void> right = evaluate(*expr.right);
-    const TokenType rightType = getType();
+    // Evaluate the left and right expressions, keeping the left alive meanwhile
+    push(evaluate(*expr.left));
+    Value right = evaluate(*expr.right);
+    Value left = pop();
 
     // Perform the operation based on the operator type
     switch (expr.op.getType()) {
         // Equality and comparison operations
         case TokenType::GREATER:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<bool>(*std::static_pointer_cast<double>(left) > *std::static_pointer_cast<double>(right));
-            type = *std::static_pointer_cast<bool>(result) ? TokenType::TRUE : TokenType::FALSE;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::boolean(left.number > right.number);
             break;
         case TokenType::GREATER_EQUAL:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<bool>(*std::static_pointer_cast<double>(left) >= *std::static_pointer_cast<double>(right));
-            type = *std::static_pointer_cast<bool>(result) ? TokenType::TRUE : TokenType::FALSE;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::boolean(left.number >= right.number);
             break;
         case TokenType::LESS:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<bool>(*std::static_pointer_cast<double>(left) < *std::static_pointer_cast<double>(right));
-            type = *std::static_pointer_cast<bool>(result) ? TokenType::TRUE : TokenType::FALSE;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::boolean(left.number < right.number);
             break;
         case TokenType::LESS_EQUAL:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<bool>(*std::static_pointer_cast<double>(left) <= *std::static_pointer_cast<double>(right));
-            type = *std::static_pointer_cast<bool>(result) ? TokenType::TRUE : TokenType::FALSE;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::boolean(left.number <= right.number);
             break;
         case TokenType::BANG_EQUAL:
-            result = std::make_shared<bool>(!isEqual(left, right, leftType, rightType));
-            type = *std::static_pointer_cast<bool>(result) ? TokenType::TRUE : TokenType::FALSE;
+            result = Value::boolean(!isEqual(expr.op, left, right));
             break;
         case TokenType::EQUAL_EQUAL:
-            result = std::make_shared<bool>(isEqual(left, right, leftType, rightType));
-            type = *std::static_pointer_cast<bool>(result) ? TokenType::TRUE : TokenType::FALSE;
+            result = Value::boolean(isEqual(expr.op, left, right));
             break;
         
         // Arithmetic operations
         case TokenType::MINUS:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<double>(*std::static_pointer_cast<double>(left) - *std::static_pointer_cast<double>(right));
-            type = TokenType::NUMBER;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::numberValue(left.number - right.number);
             break;
         case TokenType::PLUS:
-            if (leftType == TokenType::NUMBER && rightType == TokenType::NUMBER) {
+            if (left.type == TokenType::NUMBER && right.type == TokenType::NUMBER) {
                 // If both are numbers, add them
-                result = std::make_shared<double>(*std::static_pointer_cast<double>(left) + *std::static_pointer_cast<double>(right));
-                type = TokenType::NUMBER;
-            } else if (leftType == TokenType::STRING && rightType == TokenType::STRING) {
+                result = Value::numberValue(left.number + right.number);
+            } else if (left.type == TokenType::STRING && right.type == TokenType::STRING) {
                 // If both are strings, concatenate them
-                result = std::make_shared<std::string>(*std::static_pointer_cast<std::string>(left) + *std::static_pointer_cast<std::string>(right));
-                type = TokenType::STRING;
+                result = concatenate(expr.op, static_cast<LoxString*>(left.object), static_cast<LoxString*>(right.object));
             } else {
                 // Otherwise, throw an error
                 throw RuntimeError(expr.op, "Operands must be two numbers or two strings.");
             }
             break;
         case TokenType::SLASH:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<double>(*std::static_pointer_cast<double>(left) / *std::static_pointer_cast<double>(right));
-            type = TokenType::NUMBER;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::numberValue(left.number / right.number);
             break;
         case TokenType::STAR:
-            checkNumberOperands(expr.op, leftType, rightType);
-            result = std::make_shared<double>(*std::static_pointer_cast<double>(left) * *std::static_pointer_cast<double>(right));
-            type = TokenType::NUMBER;
+            checkNumberOperands(expr.op, left.type, right.type);
+            result = Value::numberValue(left.number * right.number);
             break;
         default:
             // Unreachable
@@ -112,27 +252,38 @@ void Interpreter::visitGrouping(const Grouping& expr) {
 }
 
 void Interpreter::visitLiteral(const Literal& expr) {
-    // Set the result and type to the value and type of the literal
-    result = expr.value;
-    type = expr.type;
+    // Set the result to the value of the literal
+    switch (expr.type) {
+        case TokenType::NUMBER:
+            result = Value::numberValue(*std::static_pointer_cast<double>(expr.value));
+            break;
+        case TokenType::STRING:
+            result = makeString(*std::static_pointer_cast<std::string>(expr.value));
+            break;
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+            result = Value::boolean(expr.type == TokenType::TRUE);
+            break;
+        default:
+            result = Value();
+            break;
+    }
 }
 
 void Interpreter::visitUnary(const Unary& expr) {
     // Evaluate the right expression
-    std::shared_ptr<void> right = evaluate(*expr.right);
-    TokenType rightType = getType();
+    Value right = evaluate(*expr.right);
 
     // Perform the operation based on the operator type
     switch (expr.op.getType()) {
         case TokenType::MINUS:
             // Negate the number
-            checkNumberOperand(expr.op, rightType);
-            result = std::make_shared<double>(-*std::static_pointer_cast<double>(right));
+            checkNumberOperand(expr.op, right.type);
+            result = Value::numberValue(-right.number);
             break;
         case TokenType::BANG:
             // Negate the boolean
-            result = std::make_shared<bool>(!isTruthy(right, rightType));
-            type = !isTruthy(right, rightType) ? TokenType::TRUE : TokenType::FALSE;
+            result = Value::boolean(!isTruthy(right));
             break;
         default:
             break;
@@ -141,67 +292,60 @@ void Interpreter::visitUnary(const Unary& expr) {
 
 void Interpreter::visitVariable(const Variable& expr) {
     // Look up the variable in the environment
-    std::pair<std::shared_ptr<void>, TokenType> value = environment->get(expr.name);
-
-    // Set the result and type to the value and type of the variable
-    result = value.first;
-    type = value.second;
+    result = environment->get(expr.name);
 }
 
 void Interpreter::visitLogical(const Logical& expr) {
     // Evaluate the left expression
-    std::shared_ptr<void> left = evaluate(*expr.left);
-    TokenType leftType = getType();
+    Value left = evaluate(*expr.left);
 
     // Perform the operation based on the operator type
     if (expr.op.getType() == TokenType::OR) {
         // If the left expression is truthy, return it
-        if (isTruthy(left, leftType)) {
-            result = left;
-            type = leftType;
-            return;
-        }
+        if (isTruthy(left)) return;
     } else {
         // If the left expression is falsy, return it
-        if (!isTruthy(left, leftType)) {
-            result = left;
-            type = leftType;
-            return;
-        }
+        if (!isTruthy(left)) return;
     }
 
     // Evaluate the right expression
     result = evaluate(*expr.right);
-    type = getType();
 }
 
 void Interpreter::visitCall(const Call& expr) {
-    // Evaluate the callee
-    std::shared_ptr<void> callee = evaluate(*expr.callee);
-    TokenType calleeType = getType();
-    std::vector<std::pair<std::shared_ptr<void>, TokenType>> arguments;
+    // Evaluate the callee and keep it alive for the duration of the call
+    Value callee = evaluate(*expr.callee);
 
     // Check if the callee is a function or class
-    if (calleeType != TokenType::FUN && calleeType != TokenType::CLASS) {
+    if (callee.type != TokenType::FUN && callee.type != TokenType::CLASS) {
        throw RuntimeError(expr.paren, "Can only call functions and classes.");
     }
+    const size_t base = stack.size();
+    push(callee);
 
-    // Evaluate the arguments
+    // Evaluate the arguments onto the value stack
     for (const auto& argument : expr.arguments) {
-        evaluate(*argument);
-        arguments.push_back(std::make_pair(getResult(), getType()));
+        push(evaluate(*argument));
     }
+    std::vector<Value> arguments(stack.begin() + base + 1, stack.end());
 
     // Call the function or class
-    std::shared_ptr<LoxFunction> function = std::static_pointer_cast<LoxFunction>(callee);
-    if (arguments.size() != function->arity()) {
+    LoxCallable* function = static_cast<LoxCallable*>(stack[base].object);
+    if (arguments.size() != static_cast<size_t>(function->arity())) {
         throw RuntimeError(expr.paren, "Expected " + std::to_string(function->arity()) + " arguments but got " + std::to_string(arguments.size()) + ".");
     }
 
-    // Get the return value and type of the function
-    auto [returnValue, returnType] = function->call(*this, arguments);
+    // Get the return value of the function, reporting heap exhaustion and native errors at the call
+    Value returnValue;
+    try {
+        returnValue = function->call(*this, arguments);
+    } catch (const HeapLimitError& error) {
+        throw RuntimeError(expr.paren, error.what());
+    } catch (const NativeError& error) {
+        throw RuntimeError(expr.paren, error.what());
+    }
+    stack.resize(base);
     result = returnValue;
-    type = returnType;
 }
 
 void Interpreter::visitExpression(const Expression& stmt) {
@@ -211,18 +355,20 @@ void Interpreter::visitExpression(const Expression& stmt) {
 
 void Interpreter::visitFunction(const Function& stmt) {
     // Create a new function and define it in the current environment
-    std::shared_ptr<LoxFunction> function = std::make_shared<LoxFunction>(std::make_unique<Function>(stmt), environment);
-    environment->define(stmt.name.getLexeme(), std::make_pair(function, TokenType::FUN));
+    LoxFunction* function = heap.allocate<LoxFunction>(std::make_unique<Function>(stmt), environment);
+    environment->define(std::string(stmt.name.getLexeme()), Value::objectValue(TokenType::FUN, function));
 }
 
 void Interpreter::visitPrint(const Print& stmt) {
     // Evaluate the expression and print the result
-    std::shared_ptr<void> value = evaluate(*stmt.expression);
-    std::cout << stringify(value, type) << std::endl;
+    Value value = evaluate(*stmt.expression);
+    std::string text = stringify(value);
+    std::lock_guard<std::mutex> lock(sinks->lock);
+    sinks->output(text);
 }
 
 void Interpreter::visitVar(const Var& stmt) {
-    std::shared_ptr<void> value = nullptr;
+    Value value;
     
     // Evaluate the initialiser if present
     if (stmt.initializer != nullptr) {
@@ -230,41 +376,44 @@ void Interpreter::visitVar(const Var& stmt) {
     }
     
     // Define the variable in the current environment
-    environment->define(stmt.name.getLexeme(), std::make_pair(value, type));
+    environment->define(std::string(stmt.name.getLexeme()), value);
 }
 
 void Interpreter::visitAssign(const Assign& stmt) {
     // Evaluate the value and assign it to the variable
-    std::shared_ptr<void> value = evaluate(*stmt.value);
-    TokenType valueType = getType();
-    environment->assign(stmt.name, std::make_pair(value, valueType));
+    Value value = evaluate(*stmt.value);
+    environment->assign(stmt.name, value);
 }
 
 void Interpreter::visitBlock(const Block& stmt) {
     // Execute the block of statements within a new environment
-    executeBlock(stmt.statements, std::make_shared<Environment>(environment));
+    executeBlock(stmt.statements, heap.allocate<Environment>(heap, environment));
 }
 
-void Interpreter::executeBlock(std::vector<std::shared_ptr<Stmt>> statements, std::shared_ptr<Environment> environment) {
-    std::shared_ptr<Environment> previous = this->environment;
+void Interpreter::executeBlock(const std::vector<std::shared_ptr<Stmt>>& statements, Environment* environment) {
+    // Save the current environment where the collector can see it
+    environments.push_back(this->environment);
+    this->environment = environment;
     try {
         // Execute the block of statements within the given environment
-        this->environment = environment;
         for (const auto& statement : statements) {
             execute(*statement);
         }
-    } catch (const RuntimeError& error) {
-        // Catch any runtime errors and print them
-        Lox::runtimeError(error);
+    } catch (...) {
+        // Restore the previous environment before unwinding further
+        this->environment = environments.back();
+        environments.pop_back();
+        throw;
     }
 
     // Restore the previous environment
-    this->environment = previous;
+    this->environment = environments.back();
+    environments.pop_back();
 }
 
 void Interpreter::visitIf(const If& stmt) {
     // Evaluate the condition and execute the appropriate branch
-    if (isTruthy(evaluate(*stmt.condition), getType())) {
+    if (isTruthy(evaluate(*stmt.condition))) {
         execute(*stmt.thenBranch);
     } else if (stmt.elseBranch != nullptr) {
         execute(*stmt.elseBranch);
@@ -273,64 +422,123 @@ void Interpreter::visitIf(const If& stmt) {
 
 void Interpreter::visitWhile(const While& stmt) {
     // Execute the loop while the condition is truthy
-    while (isTruthy(evaluate(*stmt.condition), type)) {
+    while (isTruthy(evaluate(*stmt.condition))) {
         execute(*stmt.body);
+        // Going round again counts too, so a loop never runs past its slice
+        tick();
     }
 }
 
 void Interpreter::visitReturn(const Return& stmt) {
     // Evaluate the return value
-    std::shared_ptr<void> value = nullptr;
+    Value value;
     if (stmt.value != nullptr) {
         value = evaluate(*stmt.value);
     }
 
     // Throw a return exception to extit the function
-    throw ReturnException(value, type);
+    throw ReturnException(value);
 }
 
-std::shared_ptr<void>& Interpreter::getResult() {
+const Value& Interpreter::getResult() const {
     return result;
 }
 
-TokenType Interpreter::getType() {
-    return type;
+Heap& Interpreter::getHeap() {
+    return heap;
+}
+
+void Interpreter::markRoots(Heap& heap) {
+    // Globals and every environment currently in use
+    heap.markObject(globals);
+    heap.markObject(environment);
+    for (Environment*& saved : environments) {
+        heap.markObject(saved);
+    }
+
+    // Temporaries and the last result
+    for (Value& value : stack) {
+        heap.markValue(value);
+    }
+    heap.markValue(result);
+
+    // The states of the suspended async functions
+    if (loop) loop->markRoots(heap);
+}
+
+void Interpreter::fail(const std::string& report) {
+    {
+        std::lock_guard<std::mutex> lock(sinks->lock);
+        sinks->errors(report);
+    }
+    runtimeError = true;
+
+    // Later statements run from the global scope
+    stack.clear();
+    environments.clear();
+    environment = globals;
 }
 
-bool Interpreter::isTruthy(const std::shared_ptr<void>& object, TokenType type) {
-    if (type == TokenType::FALSE) {
+void Interpreter::push(const Value& value) {
+    stack.push_back(value);
+}
+
+Value Interpreter::pop() {
+    Value value = stack.back();
+    stack.pop_back();
+    return value;
+}
+
+Value Interpreter::makeString(std::string text) {
+    return Value::objectValue(TokenType::STRING, heap.allocate<LoxString>(std::move(text)));
+}
+
+Value Interpreter::concatenate(const Token& op, LoxString* left, LoxString* right) {
+    // Ropes make doubling cheap, so the length itself can run out long before the heap does
+    if (left->getLength() > std::string().max_size() - right->getLength()) {
+        throw RuntimeError(op, "String too long.");
+    }
+
+    // Short results are cheaper to copy than to keep as a tree
+    if (left->getLength() + right->getLength() < LoxString::MIN_ROPE_LENGTH) {
+        return makeString(left->str(heap) + right->str(heap));
+    }
+    return Value::objectValue(TokenType::STRING, heap.allocate<LoxString>(left, right));
+}
+
+bool Interpreter::isTruthy(const Value& value) {
+    if (value.type == TokenType::FALSE) {
         return false;
-    } else if (type == TokenType::NIL) {
+    } else if (value.type == TokenType::NIL) {
         return false;
     } 
     return true;
 }
 
-bool Interpreter::isEqual(const std::shared_ptr<void>& left, const std::shared_ptr<void>& right, TokenType leftType, TokenType rightType) {
+bool Interpreter::isEqual(const Token& op, const Value& left, const Value& right) {
     // Check if the types are the same
-    if (leftType != rightType) 
+    if (left.type != right.type) 
         return false;
 
-    // Check if boolean values are the same type
-    if (leftType == TokenType::TRUE || leftType == TokenType::FALSE) 
-        return leftType == rightType;
-    if (left == nullptr && right == nullptr) {
-        std::cout << "Both are null" << std::endl;
-        return true;
-    }
-    if (left == nullptr) 
-        return false;
-    
     // Check if the values are the same
-    if (leftType == TokenType::NUMBER) 
-        return *std::static_pointer_cast<double>(left) == *std::static_pointer_cast<double>(right);
-    if (leftType == TokenType::STRING) 
-        return *std::static_pointer_cast<std::string>(left) == *std::static_pointer_cast<std::string>(right);
-    if (leftType == TokenType::TRUE || leftType == TokenType::FALSE) 
-        return *std::static_pointer_cast<bool>(left) == *std::static_pointer_cast<bool>(right);
+    if (left.type == TokenType::NUMBER) 
+        return left.number == right.number;
+    if (left.type == TokenType::STRING) {
+        LoxString* leftString = static_cast<LoxString*>(left.object);
+        LoxString* rightString = static_cast<LoxString*>(right.object);
+        if (leftString == rightString) return true;
+        if (leftString->getLength() != rightString->getLength()) return false;
+        try {
+            return leftString->str(heap) == rightString->str(heap);
+        } catch (const HeapLimitError& error) {
+            throw RuntimeError(op, error.what());
+        }
+    }
+    if (left.type == TokenType::FUN) 
+        return left.object == right.object;
     
-    // Otherwise return false
-    return false;
+    // nil, true and false are equal to themselves
+    return true;
 }
 
 void Interpreter::checkNumberOperand(const Token op, const TokenType type) {
@@ -347,31 +555,28 @@ void Interpreter::checkNumberOperands(const Token op, const TokenType leftType,
     throw RuntimeError(op, "Operands must be numbers.");
 }
 
-std::string Interpreter::stringify(const std::shared_ptr<void>& object, TokenType type) {
-    if (type == TokenType::NIL) {
+std::string Interpreter::stringify(const Value& value) {
+    if (value.type == TokenType::NIL) {
         return "nil";
     }
-    if (type == TokenType::FUN) {
-        return std::static_pointer_cast<LoxFunction>(object)->toString();
+    if (value.type == TokenType::FUN) {
+        return static_cast<LoxCallable*>(value.object)->toString();
     }
-    if (type == TokenType::NUMBER) {
-        auto num = *std::static_pointer_cast<double>(object);
-        std::string text = std::to_string(num);
-        // Remove trailing ".0" if present
-        if (text.find(".0") != std::string::npos) {
-            text = text.substr(0, text.find(".0"));
+    if (value.type == TokenType::NUMBER) {
+        std::string text = std::to_string(value.number);
+        // Remove trailing zeros and the decimal point if nothing is left after it
+        if (text.find('.') != std::string::npos) {
+            text.erase(text.find_last_not_of('0') + 1);
+            if (text.back() == '.') text.pop_back();
         }
         return text;
-    } else if (type == TokenType::STRING) {
-        return *std::static_pointer_cast<std::string>(object);
-    } else if (type == TokenType::TRUE) {
+    } else if (value.type == TokenType::STRING) {
+        return static_cast<LoxString*>(value.object)->str(heap);
+    } else if (value.type == TokenType::TRUE) {
         return "true";
-    } else if (type == TokenType::FALSE) {
+    } else if (value.type == TokenType::FALSE) {
         return "false";
-    } else if (object == nullptr) {
-        return "nil";
     }
 
     return "nil";
 }
-
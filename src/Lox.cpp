@@ -1,55 +1,229 @@
 #include "Lox.hpp"
+#include "BatchRunner.hpp"
+#include "Repl.hpp"
 #include "Stmt.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
 #include <vector>
 
-bool Lox::hadError = false;
-bool Lox::hadRuntimeError = false;
+thread_local ErrorLog* Lox::errorLog = nullptr;
+thread_local bool Lox::hadError = false;
+HeapConfig Lox::heapConfig;
+bool Lox::printGcStats = false;
+unsigned Lox::loadThreads = 0;
+std::string Lox::cacheDirectory;
+uint64_t Lox::cacheBytes = ScriptCache::DEFAULT_MAX_BYTES;
 
-void Lox::runFile(const std::string& path) {
-    // Reads file from path
-    std::ifstream file(path, std::ios::binary);
-    if (!file) {
-        // File doesn't exist
-        std::cerr << "Could not open file " << path << std::endl;
-        exit(1);
+void Lox::runFile(const std::string& path, bool stream) {
+    bool runtimeError = false;
+    if (stream) {
+        // Reads the file in chunks as the parser needs them
+        std::ifstream file;
+        if (path != "-") {
+            file.open(path, std::ios::binary);
+            if (!file) {
+                // File doesn't exist
+                std::cerr << "Could not open file " << path << std::endl;
+                exit(1);
+            }
+        }
+        runtimeError = runStream(path == "-" ? std::cin : file);
+    } else {
+        // Maps the file read-only, and loads its syntax tree from the cache if it is unchanged
+        runFiles({path});
     }
 
-    // Stores bytes into vector and runs it
-    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    file.close();
-    run(source);
-
     // Indicate an error in the exit code
     if (hadError) std::exit(65);
-    if (hadRuntimeError) std::exit(70);
+    if (runtimeError) std::exit(70);
 }
 
 void Lox::runPrompt() {
+    // One session for every line, so globals and functions declared earlier stay defined
+    Repl repl(heapConfig);
     std::string line;
+    bool incomplete = false;
     while (true) {
-        // Puts input into line then runs it
-        std::cout << "> ";
-        std::getline(std::cin, line);
-        if (line.empty()) break;
-        run(line);
-        hadError = false;
+        // Continuation lines get their own prompt, and an empty one runs what was typed so far
+        std::cout << (incomplete ? "... " : "> ") << std::flush;
+        if (!std::getline(std::cin, line)) break;
+        if (line.empty()) {
+            if (incomplete) repl.flush();
+            incomplete = false;
+            continue;
+        }
+        incomplete = repl.feed(line);
     }
+    repl.flush();
+    if (printGcStats) reportGcStats(repl.getHeap());
 }
 
-void Lox::run(const std::string& source) {
-    // Scans the source code
-    Scanner scanner(source);
-    std::vector<Token> tokens = scanner.scanTokens();
+int Lox::runBatch(const std::string& target, unsigned jobs) {
+    std::vector<std::string> paths = BatchRunner::listScripts(target);
+    if (paths.empty()) {
+        std::cerr << "No scripts found in " << target << std::endl;
+        return 1;
+    }
+
+    BatchRunner runner(jobs == 0 ? loadThreads : jobs, heapConfig);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ScriptResult> results = runner.run(paths);
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Reports each script with what it printed, in list order
+    size_t failed = 0;
+    std::vector<double> latencies;
+    char line[64];
+    for (const ScriptResult& result : results) {
+        if (result.status != 0) failed++;
+        latencies.push_back(result.ms);
+        std::snprintf(line, sizeof(line), "exit %d in %.2f ms", result.status, result.ms);
+        std::cout << "=== " << result.path << ": " << line << "\n" << result.output << result.errors;
+    }
+
+    // Nearest-rank percentiles of the per-script latency
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))]; };
+    double total = 0;
+    for (double ms : latencies) total += ms;
+    char summary[256];
+    std::snprintf(summary, sizeof(summary), "=== %zu scripts, %zu failed, %.2f ms wall time; latency mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms",
+        results.size(), failed, wallMs, total / latencies.size(), percentile(0.5), percentile(0.99), latencies.back());
+    std::cout << summary << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+void Lox::runFiles(const std::vector<std::string>& paths) {
+    // Maps every file before loading any, the trees point into the mappings
+    std::vector<std::unique_ptr<Source>> files;
+    std::vector<std::string_view> sources;
+    for (const std::string& path : paths) {
+        // Standard input cannot be mapped, it is read whole instead
+        if (path == "-") files.push_back(std::make_unique<Source>(std::string(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>())));
+        else files.push_back(Source::map(path));
+        if (!files.back()) {
+            // File doesn't exist
+            std::cerr << "Could not open file " << path << std::endl;
+            exit(1);
+        }
+        sources.push_back(files.back()->text());
+    }
+
+    std::vector<std::unique_ptr<Source>> images;
+    std::vector<std::vector<std::shared_ptr<Stmt>>> scripts = load(sources, &images);
+    if (hadError) std::exit(65);
+
+    // Runs the scripts in order in the same global scope, stopping at the first runtime error
+    Interpreter interpreter(heapConfig);
+    for (const std::vector<std::shared_ptr<Stmt>>& statements : scripts) {
+        interpreter.interpret(statements);
+        if (interpreter.hadRuntimeError()) break;
+    }
 
-    // Parses the tokens
-    Parser parser(tokens);
-    std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+    if (printGcStats) reportGcStats(interpreter.getHeap());
+    if (interpreter.hadRuntimeError()) std::exit(70);
+}
+
+std::vector<std::vector<std::shared_ptr<Stmt>>> Lox::load(const std::vector<std::string_view>& sources,
+                                                           std::vector<std::unique_ptr<Source>>* images) {
+    if (images == nullptr || cacheDirectory.empty()) return parse(sources);
 
-    if (hadError) return; // Stop if there was a syntax error
+    // Decodes the scripts found in the cache
+    ScriptCache cache(cacheDirectory, cacheBytes);
+    std::vector<std::vector<std::shared_ptr<Stmt>>> statements(sources.size());
+    std::vector<size_t> misses;
+    std::vector<std::string_view> missed;
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::unique_ptr<Source> image = cache.load(sources[i], statements[i]);
+        if (image) {
+            images->push_back(std::move(image));
+        } else {
+            misses.push_back(i);
+            missed.push_back(sources[i]);
+        }
+    }
+    if (misses.empty()) return statements;
 
-    // Runs the interpreter
-    Interpreter interpreter;
-    interpreter.interpret(statements);
+    // Parses the others, saving them for the next run if they are free of errors
+    std::vector<std::vector<std::shared_ptr<Stmt>>> parsed = parse(missed);
+    for (size_t i = 0; i < misses.size(); i++) {
+        if (!hadError) cache.store(missed[i], parsed[i]);
+        statements[misses[i]] = std::move(parsed[i]);
+    }
+    return statements;
+}
+
+std::vector<std::vector<std::shared_ptr<Stmt>>> Lox::parse(const std::vector<std::string_view>& sources) {
+    // Threads are only started for several scripts or one large enough to split
+    bool large = false;
+    for (std::string_view source : sources) large = large || source.size() >= 2 * ParallelParser::MIN_TOKENS;
+    unsigned threads = loadThreads == 0 ? std::thread::hardware_concurrency() : loadThreads;
+    ThreadPool pool(sources.size() > 1 || large ? threads : 1);
+
+    // Scans the small scripts one per thread, then each large one in chunks on every thread
+    std::vector<TokenBuffer> tokens(sources.size(), TokenBuffer(""));
+    std::vector<ErrorLog> scanErrors(sources.size());
+    auto isLarge = [&](size_t i) { return pool.size() > 1 && sources[i].size() >= 2 * ParallelScanner::MIN_CHUNK; };
+    pool.forEach(sources.size(), [&](size_t i) {
+        if (isLarge(i)) return;
+        CollectErrors collect(scanErrors[i]);
+        tokens[i] = Scanner(sources[i]).scanTokens();
+    });
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (!isLarge(i)) continue;
+        CollectErrors collect(scanErrors[i]);
+        tokens[i] = ParallelScanner(sources[i], pool).scanTokens();
+    }
+
+    // Parses the scripts, and the declarations of large ones, at once
+    std::vector<const TokenBuffer*> buffers;
+    for (const TokenBuffer& buffer : tokens) buffers.push_back(&buffer);
+    std::vector<ErrorLog> parseErrors;
+    std::vector<std::vector<std::shared_ptr<Stmt>>> statements = ParallelParser(pool).parse(buffers, parseErrors);
+
+    // Reports the errors in source order
+    for (size_t i = 0; i < sources.size(); i++) {
+        printErrors(scanErrors[i]);
+        printErrors(parseErrors[i]);
+    }
+    return statements;
+}
+
+bool Lox::runStream(std::istream& input) {
+    Scanner scanner(input);
+    Parser parser(scanner);
+    Interpreter interpreter(heapConfig);
+
+    std::shared_ptr<Stmt> statement;
+    while (parser.parseDeclaration(statement)) {
+        // Keep parsing after an error to report every syntax error, but run nothing more
+        if (statement == nullptr || hadError || interpreter.hadRuntimeError()) continue;
+        interpreter.interpret({statement});
+    }
+
+    if (printGcStats) reportGcStats(interpreter.getHeap());
+    return interpreter.hadRuntimeError();
+}
+
+void Lox::configureThreads(unsigned threads) {
+    loadThreads = threads;
+    TaskPool::configure(threads);
+}
+
+void Lox::configureCache(const std::string& directory, uint64_t maxBytes) {
+    cacheDirectory = directory;
+    cacheBytes = maxBytes;
+}
+
+void Lox::configureParsing(bool lazyFunctions) {
+    Parser::setLazyFunctions(lazyFunctions);
+}
+
+void Lox::configureHeap(const HeapConfig& config, bool printStats) {
+    heapConfig = config;
+    printGcStats = printStats;
 }
 
 void Lox::error(int line, const std::string& message) {
@@ -60,16 +234,40 @@ void Lox::error(Token token, const std::string& message) {
     if (token.getType() == TokenType::END_OF_FILE) {
         report(token.getLine(), " at end", message);
     } else {
-        report(token.getLine(), " at '" + token.getLexeme() + "'", message);
+        report(token.getLine(), " at '" + std::string(token.getLexeme()) + "'", message);
     }
 }
 
 void Lox::report(int line, const std::string& where, const std::string& message) {
+    if (errorLog != nullptr) {
+        // Printed later, in order with the errors of the other threads
+        errorLog->messages += "[line " + std::to_string(line) + "] Error" + where + ": " + message + "\n";
+        errorLog->hadError = true;
+        return;
+    }
     std::cout << "[line " << line << "] Error" << where << ": " << message << std::endl;
     hadError = true;
 }
 
-void Lox::runtimeError(RuntimeError error) {
-    std::cerr << error.what() << "\n[line" << error.token.getLine() << "]" << std::endl;
+void Lox::printErrors(const ErrorLog& log) {
+    if (!log.hadError) return;
+    std::cout << log.messages << std::flush;
     hadError = true;
-}
\ No newline at end of file
+}
+
+void Lox::reportGcStats(const Heap& heap) {
+    const GcStats& stats = heap.getStats();
+    const MemoryStats& memory = heap.getMemoryStats();
+    std::cerr << "[gc] minor collections: " << stats.minorCollections
+              << ", total pause: " << stats.minorPauseTotal << " ms"
+              << ", max pause: " << stats.minorPauseMax << " ms" << std::endl;
+    std::cerr << "[gc] major collections: " << stats.majorCollections
+              << ", total pause: " << stats.majorPauseTotal << " ms"
+              << ", max pause: " << stats.majorPauseMax << " ms" << std::endl;
+    std::cerr << "[gc] promoted bytes: " << stats.promotedBytes << std::endl;
+    for (size_t kind = 0; kind < MemoryStats::KINDS; kind++) {
+        std::cerr << "[gc] " << ObjectKindStrings[kind] << ": " << memory.liveObjects[kind] << " live"
+                  << " (" << memory.liveBytes[kind] << " bytes), " << memory.allocatedObjects[kind] << " allocated" << std::endl;
+    }
+    std::cerr << "[gc] peak heap: " << memory.peakBytes << " bytes" << std::endl;
+}
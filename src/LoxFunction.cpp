@@ -5,27 +5,40 @@ int LoxFunction::arity() {
     return declaration->params.size();
 }
 
-std::pair<std::shared_ptr<void>, TokenType> LoxFunction::call(Interpreter& interpreter, std::vector<std::pair<std::shared_ptr<void>, TokenType>> arguments) {
+Value LoxFunction::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
     // Create a new environment for the function call
-    auto environment = std::make_shared<Environment>(closure);
+    Environment* environment = interpreter.getHeap().allocate<Environment>(interpreter.getHeap(), closure);
 
     // Define the function parameters in the new environment
-    for (int i = 0; i < declaration->params.size(); i++) {
-        environment->define(declaration->params[i].getLexeme(), arguments[i]);
+    for (size_t i = 0; i < declaration->params.size(); i++) {
+        environment->define(std::string(declaration->params[i].getLexeme()), arguments[i]);
     }
 
     try {
         // Execute the function body in the new environment
-        interpreter.executeBlock(declaration->body, environment);
+        interpreter.executeBlock(declaration->body->statements(), environment);
     } catch (const ReturnException& e) {
         // Return the value from the return statement
-        return {e.value, e.type};
+        return e.value;
     }
 
     // If there was no return statement, return nil
-    return {nullptr, TokenType::NIL};
+    return Value();
 }
 
 std::string LoxFunction::toString() const {
-    return "<fn " + declaration->name.getLexeme() + ">";
-}
\ No newline at end of file
+    return "<fn " + std::string(declaration->name.getLexeme()) + ">";
+}
+
+void LoxFunction::trace(Heap& heap) {
+    heap.markObject(closure);
+}
+
+size_t LoxFunction::size() const {
+    return sizeof(LoxFunction) + sizeof(Function)
+        + declaration->params.size() * sizeof(Token);
+}
+
+LoxObject* LoxFunction::promote() {
+    return new LoxFunction(std::move(declaration), closure);
+}
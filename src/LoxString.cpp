@@ -0,0 +1,52 @@
+#include "LoxString.hpp"
+#include <vector>
+
+const std::string& LoxString::str(Heap& heap) {
+    if (isRope()) {
+        // The flat copy may be far larger than the rope, check it fits before building it
+        heap.reserve(length);
+        size_t before = size();
+        flatten();
+        heap.resized(this, before);
+    }
+    return characters;
+}
+
+void LoxString::flatten() {
+    // Walk the rope iteratively, left-leaning ropes can be as deep as they are long
+    std::string result;
+    result.reserve(length);
+    std::vector<const LoxString*> pending = {this};
+    while (!pending.empty()) {
+        const LoxString* node = pending.back();
+        pending.pop_back();
+        if (node->isRope()) {
+            pending.push_back(node->right);
+            pending.push_back(node->left);
+        } else {
+            result += node->characters;
+        }
+    }
+
+    // The halves are no longer needed and may be collected
+    characters = std::move(result);
+    left = nullptr;
+    right = nullptr;
+}
+
+void LoxString::trace(Heap& heap) {
+    heap.markObject(left);
+    heap.markObject(right);
+}
+
+size_t LoxString::size() const {
+    return sizeof(LoxString) + characters.capacity();
+}
+
+LoxObject* LoxString::promote() {
+    LoxString* promoted = new LoxString(std::move(characters));
+    promoted->left = left;
+    promoted->right = right;
+    promoted->length = length;
+    return promoted;
+}
@@ -0,0 +1,126 @@
+#include "LoxVM.hpp"
+#include "Lox.hpp"
+#include "LoxString.hpp"
+#include <stdexcept>
+
+Isolate::Isolate(const HeapConfig& config)
+    : interpreter(config), errors([](std::string_view text) { std::cerr << text << std::endl; }) {}
+
+void Isolate::setOutput(Sink sink) {
+    interpreter.setOutput(std::move(sink));
+}
+
+void Isolate::setErrors(Sink sink) {
+    interpreter.setErrors(sink);
+    errors = std::move(sink);
+}
+
+void Isolate::setArguments(const std::vector<std::string>& arguments) {
+    // Each string is a global as soon as it is allocated, so it is rooted before the next allocation
+    interpreter.defineGlobal("argc", Value::numberValue(static_cast<double>(arguments.size())));
+    for (size_t i = 0; i < arguments.size(); i++) {
+        LoxString* argument = interpreter.getHeap().allocate<LoxString>(arguments[i]);
+        interpreter.defineGlobal("arg" + std::to_string(i), Value::objectValue(TokenType::STRING, argument));
+    }
+}
+
+RunStatus Isolate::run(std::shared_ptr<const Program> program) {
+    if (program->hadError()) {
+        // The messages end with a newline the sink does not expect
+        const std::string& messages = program->getErrors();
+        errors(std::string_view(messages).substr(0, messages.size() - 1));
+        return RunStatus::COMPILE_ERROR;
+    }
+
+    // Functions declared by the program keep pointing into its tree and text
+    if (programs.empty() || programs.back() != program) programs.push_back(program);
+    return interpreter.interpret(program->getStatements()) ? RunStatus::OK : RunStatus::RUNTIME_ERROR;
+}
+
+bool Isolate::hadRuntimeError() const {
+    return interpreter.hadRuntimeError();
+}
+
+Heap& Isolate::getHeap() {
+    return interpreter.getHeap();
+}
+
+Evaluator::Evaluator(std::shared_ptr<const Rule> rule, const HeapConfig& config) : rule(std::move(rule)), interpreter(config) {}
+
+void Evaluator::setOutput(Sink sink) {
+    interpreter.setOutput(std::move(sink));
+}
+
+Value Evaluator::evaluate(const std::vector<RuleInput>& inputs) {
+    if (rule->hadError()) throw std::invalid_argument("Cannot evaluate a rule with syntax errors.");
+    if (inputs.size() != rule->inputs.size()) {
+        throw std::invalid_argument("Expected " + std::to_string(rule->inputs.size()) + " inputs but got " + std::to_string(inputs.size()) + ".");
+    }
+
+    // Bound inputs are globals, so they are rooted before the heap may collect
+    Heap& heap = interpreter.getHeap();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const RuleInput& input = inputs[i];
+        Value value;
+        switch (input.kind) {
+            case RuleInput::Kind::BOOLEAN: value = Value::boolean(input.boolean); break;
+            case RuleInput::Kind::NUMBER: value = Value::numberValue(input.number); break;
+            case RuleInput::Kind::STRING: value = Value::objectValue(TokenType::STRING, heap.allocate<LoxString>(std::string(input.text))); break;
+            default: break;
+        }
+        interpreter.defineGlobal(rule->inputs[i], value);
+    }
+    return interpreter.run(rule->statements, rule->expression.get());
+}
+
+bool Evaluator::test(const std::vector<RuleInput>& inputs) {
+    Value value = evaluate(inputs);
+    return value.type != TokenType::NIL && value.type != TokenType::FALSE;
+}
+
+std::string Evaluator::toString(const Value& value) {
+    return interpreter.stringify(value);
+}
+
+std::shared_ptr<const Program> LoxVM::compile(std::string source) const {
+    // The source is moved in before scanning, so the tokens view its final place
+    auto program = std::make_shared<Program>();
+    program->source = std::move(source);
+
+    // Errors go to the program's log, never to the process' output
+    Lox::CollectErrors collect(program->errors);
+    TokenBuffer tokens = Scanner(program->source).scanTokens();
+    program->statements = Parser(tokens).parse();
+    if (program->errors.hadError) program->statements.clear();
+    return program;
+}
+
+std::shared_ptr<const Rule> LoxVM::compileRule(std::string source, std::vector<std::string> inputs) const {
+    auto rule = std::make_shared<Rule>();
+    rule->source = std::move(source);
+    rule->inputs = std::move(inputs);
+
+    Lox::CollectErrors collect(rule->errors);
+    TokenBuffer tokens = Scanner(rule->source).scanTokens();
+    if (rule->errors.hadError) return rule;
+
+    // Most rules are a single expression, anything else must parse as a script
+    ErrorLog expressionErrors;
+    {
+        Lox::CollectErrors attempt(expressionErrors);
+        rule->expression = Parser(tokens).parseExpression();
+    }
+    if (rule->expression != nullptr) return rule;
+
+    rule->statements = Parser(tokens).parse();
+    if (rule->errors.hadError) rule->statements.clear();
+    return rule;
+}
+
+std::unique_ptr<Evaluator> LoxVM::createEvaluator(std::shared_ptr<const Rule> rule) const {
+    return std::make_unique<Evaluator>(std::move(rule), heapConfig);
+}
+
+std::unique_ptr<Isolate> LoxVM::createIsolate() const {
+    return std::make_unique<Isolate>(heapConfig);
+}
@@ -0,0 +1,212 @@
+#include "Parallel.hpp"
+#include "Interpreter.hpp"
+#include "NativeError.hpp"
+#include "RuntimeError.hpp"
+#include "Snapshot.hpp"
+#include "TaskPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <mutex>
+#include <optional>
+
+namespace {
+const size_t MAX_CHUNKS = 256; // Chunks a range is split into at most, fixed by its length alone so results never depend on timing
+const double TASK_MS = 1.0; // Work aimed at per task, so that the copies a task starts with are worth making
+const size_t TASKS_PER_WORKER = 4; // Tasks per worker at most, so chunks of uneven cost still balance
+const double MAX_COUNT = 9007199254740992.0; // Longest range, beyond which the indices are no longer exact
+
+// Positions of the copied values on a worker's value stack
+const size_t FN = 0;
+const size_t COMBINE = 1;
+const size_t INIT = 2;
+const size_t ACC = 3;
+
+/**
+ * @struct Range
+ * @brief A range split into chunks and the outcome of each, shared by the tasks running them
+ */
+struct Range {
+    Snapshot functions; // Copy of fn, then of combine and init when reducing
+    bool reduce = false; // Set for parallelReduce
+    double start = 0; // First index
+    size_t count = 0; // Number of indices
+    size_t chunks = 0; // Number of chunks
+    HeapConfig config; // Heap sizes of the calling interpreter, used by the workers
+    std::shared_ptr<Sinks> sinks; // Where the workers print
+    std::vector<Snapshot> results; // Folded value of each chunk when reducing
+
+    std::mutex lock; // Guards the failure
+    size_t failedChunk = SIZE_MAX; // Lowest chunk that failed, later chunks are skipped
+    std::string error; // Message of its error
+    std::optional<Token> token; // Where its error happened, if it was a runtime error
+
+    // First index of a chunk, as an offset from the start
+    size_t begin(size_t chunk) const {
+        return chunk * count / chunks;
+    }
+
+    bool skips(size_t chunk) {
+        std::lock_guard<std::mutex> guard(lock);
+        return chunk > failedChunk;
+    }
+
+    bool failed() {
+        std::lock_guard<std::mutex> guard(lock);
+        return failedChunk != SIZE_MAX;
+    }
+
+    // Keeps the error of the lowest chunk, which the loop would have met first
+    void fail(size_t chunk, const std::string& message, const std::optional<Token>& where) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (chunk > failedChunk) return;
+        failedChunk = chunk;
+        error = message;
+        token.reset();
+        if (where) token.emplace(*where);
+    }
+};
+
+/**
+ * @struct Worker
+ * @brief An interpreter holding copies of the functions, running chunks one after another
+ */
+struct Worker {
+    Interpreter interpreter;
+    Interpreter::Temporaries values; // fn, combine, init and the value being folded
+
+    explicit Worker(Range& range) : interpreter(range.config, range.sinks), values(interpreter, copies(range, interpreter)) {}
+
+    // Restores the functions into a new worker, where they are rooted before any call
+    static std::vector<Value> copies(Range& range, Interpreter& interpreter) {
+        std::vector<Value> values = range.functions.restoreAll(interpreter.getHeap());
+        values.resize(ACC + 1);
+        return values;
+    }
+
+    void run(Range& range, size_t chunk) {
+        Heap& heap = interpreter.getHeap();
+        size_t end = range.begin(chunk + 1);
+        for (size_t i = range.begin(chunk); i < end; i++) {
+            Value fn = values[FN];
+            Value value = interpreter.call(fn, {Value::numberValue(range.start + static_cast<double>(i))});
+            if (!range.reduce) continue;
+            if (i == range.begin(chunk)) {
+                values[ACC] = value;
+                continue;
+            }
+            Value combine = values[COMBINE];
+            Value combined = interpreter.call(combine, {values[ACC], value});
+            values[ACC] = combined;
+        }
+        if (range.reduce) range.results[chunk] = Snapshot::capture(values[ACC], heap);
+    }
+
+    // Runs chunks in order, stopping at the first that fails or follows a failed one
+    void runAll(Range& range, size_t first, size_t last) {
+        for (size_t chunk = first; chunk < last && !range.skips(chunk); chunk++) {
+            try {
+                run(range, chunk);
+            } catch (const RuntimeError& error) {
+                range.fail(chunk, error.what(), error.token);
+                return;
+            } catch (const std::exception& error) {
+                range.fail(chunk, error.what(), std::nullopt);
+                return;
+            }
+        }
+    }
+};
+
+Value runRange(Interpreter& interpreter, const std::vector<Value>& arguments, bool reduce) {
+    const Value& start = arguments[0];
+    const Value& end = arguments[1];
+    if (start.type != TokenType::NUMBER || end.type != TokenType::NUMBER || !std::isfinite(start.number) || !std::isfinite(end.number)) {
+        throw NativeError("Range bounds must be finite numbers.");
+    }
+    if (end.number - start.number > MAX_COUNT) throw NativeError("Range is too long.");
+    const Value& fn = arguments[2];
+    if (fn.type != TokenType::FUN || static_cast<LoxCallable*>(fn.object)->arity() != 1) {
+        throw NativeError("Can only run functions taking one argument in parallel.");
+    }
+    if (reduce) {
+        const Value& combine = arguments[3];
+        if (combine.type != TokenType::FUN || static_cast<LoxCallable*>(combine.object)->arity() != 2) {
+            throw NativeError("Can only reduce with functions taking two arguments.");
+        }
+    }
+
+    // Nothing to run leaves init as it is, just as the loop would
+    size_t count = end.number > start.number ? static_cast<size_t>(std::ceil(end.number - start.number)) : 0;
+    if (count == 0) return reduce ? arguments[4] : Value();
+
+    // Everything the functions reach is copied now, on the calling thread
+    auto range = std::make_shared<Range>();
+    range->functions = Snapshot::capture(reduce ? std::vector<Value>{fn, arguments[3], arguments[4]} : std::vector<Value>{fn}, interpreter.getHeap());
+    range->reduce = reduce;
+    range->start = start.number;
+    range->count = count;
+    range->chunks = std::min(count, MAX_CHUNKS);
+    range->config = interpreter.getHeap().getConfig();
+    range->sinks = interpreter.getSinks();
+    range->results.resize(reduce ? range->chunks : 0);
+
+    // The first chunk runs here, and how long it takes sizes the tasks running the others
+    Worker local(*range);
+    auto started = std::chrono::steady_clock::now();
+    local.runAll(*range, 0, 1);
+    double chunkMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+    TaskPool& pool = TaskPool::shared();
+    size_t left = range->chunks - 1;
+    size_t tasks = std::min(left, static_cast<size_t>(pool.size()) * TASKS_PER_WORKER);
+    double worth = chunkMs * static_cast<double>(left) / TASK_MS;
+    if (worth < static_cast<double>(tasks)) tasks = static_cast<size_t>(worth);
+    if (range->failed()) tasks = 0;
+
+    // The caller runs the first group of chunks while the pool runs the others, then helps it
+    std::vector<std::shared_ptr<TaskPool::Task>> submitted;
+    auto group = [&](size_t index) { return 1 + index * left / std::max<size_t>(tasks, 1); };
+    for (size_t index = 1; index < tasks; index++) {
+        size_t first = group(index);
+        size_t last = group(index + 1);
+        submitted.push_back(std::make_shared<TaskPool::Task>([range, first, last] {
+            try {
+                Worker worker(*range);
+                worker.runAll(*range, first, last);
+            } catch (const std::exception& error) {
+                range->fail(first, error.what(), std::nullopt);
+            }
+        }));
+        pool.submit(submitted.back());
+    }
+    if (!range->failed()) local.runAll(*range, 1, tasks > 1 ? group(1) : range->chunks);
+    for (const auto& task : submitted) pool.wait(*task);
+
+    if (range->failed()) {
+        // Errors with a line are reported there, others at the call
+        if (range->token) throw RuntimeError(*range->token, range->error);
+        throw NativeError(range->error);
+    }
+    if (!reduce) return Value();
+
+    // Combining the chunks in order after init keeps the result independent of how they ran
+    Heap& heap = local.interpreter.getHeap();
+    local.values[ACC] = local.values[INIT];
+    for (const Snapshot& result : range->results) {
+        Value combine = local.values[COMBINE];
+        Value combined = local.interpreter.call(combine, {local.values[ACC], result.restore(heap)});
+        local.values[ACC] = combined;
+    }
+    return Snapshot::capture(local.values[ACC], heap).restore(interpreter.getHeap());
+}
+}
+
+Value ParallelFor::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    return runRange(interpreter, arguments, false);
+}
+
+Value ParallelReduce::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    return runRange(interpreter, arguments, true);
+}
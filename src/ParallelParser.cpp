@@ -0,0 +1,93 @@
+#include "ParallelParser.hpp"
+#include "Lox.hpp"
+#include "Parser.hpp"
+#include <algorithm>
+
+namespace {
+    // A range of declarations of one script
+    struct Chunk {
+        size_t script; // Index of the script the chunk belongs to
+        uint32_t first; // Index of the first token
+        uint32_t limit; // Index of the first token of the next chunk, past the buffer for the last
+        std::vector<std::shared_ptr<Stmt>> statements; // Declarations parsed from the chunk
+        ErrorLog errors; // Errors reported while parsing it
+    };
+}
+
+std::vector<uint32_t> ParallelParser::split(const TokenBuffer& tokens, uint32_t minTokens) {
+    std::vector<uint32_t> starts = {0};
+    int depth = 0;
+
+    // The last token is the end of the file, which never starts a chunk
+    for (uint32_t i = 0; i + 2 < tokens.size(); i++) {
+        switch (tokens.type(i)) {
+            case TokenType::LEFT_PAREN:
+            case TokenType::LEFT_BRACE:
+                depth++;
+                break;
+            case TokenType::RIGHT_PAREN:
+                depth--;
+                break;
+            case TokenType::RIGHT_BRACE:
+            case TokenType::SEMICOLON:
+                // A statement ends here unless an else branch follows
+                if (tokens.type(i) == TokenType::RIGHT_BRACE) depth--;
+                if (depth == 0 && tokens.type(i + 1) != TokenType::ELSE && i + 1 - starts.back() >= minTokens) {
+                    starts.push_back(i + 1);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return starts;
+}
+
+std::vector<std::vector<std::shared_ptr<Stmt>>> ParallelParser::parse(const std::vector<const TokenBuffer*>& scripts,
+                                                                      std::vector<ErrorLog>& errors) {
+    // Split the large scripts, aiming for a few chunks per thread across all of them
+    size_t total = 0;
+    for (const TokenBuffer* tokens : scripts) total += tokens->size();
+    uint32_t target = static_cast<uint32_t>(std::max<size_t>(MIN_TOKENS, total / (pool.size() * CHUNKS_PER_THREAD)));
+
+    std::vector<Chunk> chunks;
+    for (size_t script = 0; script < scripts.size(); script++) {
+        const TokenBuffer& tokens = *scripts[script];
+        std::vector<uint32_t> starts = {0};
+        if (pool.size() > 1 && tokens.size() >= 2 * MIN_TOKENS) starts = split(tokens, target);
+        for (size_t i = 0; i < starts.size(); i++) {
+            uint32_t limit = i + 1 < starts.size() ? starts[i + 1] : UINT32_MAX;
+            chunks.push_back({script, starts[i], limit, {}, {}});
+        }
+    }
+
+    // Parse every chunk as a script of its own, collecting its errors
+    pool.forEach(chunks.size(), [&](size_t i) {
+        Chunk& chunk = chunks[i];
+        Lox::CollectErrors collect(chunk.errors);
+        chunk.statements = Parser(*scripts[chunk.script], chunk.first, chunk.limit).parse();
+    });
+
+    // Splice the chunks back in order, noting the split scripts that have errors
+    std::vector<std::vector<std::shared_ptr<Stmt>>> statements(scripts.size());
+    std::vector<size_t> reparse;
+    errors.assign(scripts.size(), ErrorLog());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        Chunk& chunk = chunks[i];
+        std::vector<std::shared_ptr<Stmt>>& parsed = statements[chunk.script];
+        bool whole = chunk.first == 0 && chunk.limit == UINT32_MAX;
+        if (chunk.errors.hadError && !whole && (reparse.empty() || reparse.back() != chunk.script)) {
+            reparse.push_back(chunk.script);
+        }
+        if (whole) errors[chunk.script] = std::move(chunk.errors);
+        parsed.insert(parsed.end(), std::make_move_iterator(chunk.statements.begin()), std::make_move_iterator(chunk.statements.end()));
+    }
+
+    // Scripts with errors are parsed again serially so the errors and recovery are the serial parser's
+    pool.forEach(reparse.size(), [&](size_t i) {
+        size_t script = reparse[i];
+        Lox::CollectErrors collect(errors[script]);
+        statements[script] = Parser(*scripts[script]).parse();
+    });
+    return statements;
+}
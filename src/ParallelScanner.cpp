@@ -0,0 +1,161 @@
+#include "ParallelScanner.hpp"
+#include "Lox.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    // The ways a chunk can start, see ParallelScanner
+    enum ChunkStart { OUTSIDE, IN_STRING, IN_COMMENT, IN_COMMENT_END, CHUNK_STARTS };
+
+    // Result of scanning one chunk
+    struct Chunk {
+        size_t begin; // Line start the chunk was split at
+        size_t end; // Line start of the next chunk
+        size_t starts[CHUNK_STARTS]; // Position the scan starts at for each way of starting
+        size_t exits[CHUNK_STARTS]; // Position the scan ends at for each way of starting
+        size_t start = 0; // Position the scan really starts at
+        TokenBuffer tokens; // Tokens starting in the chunk
+        std::vector<ScanError> errors; // Errors found in the chunk
+
+        Chunk(std::string_view source, size_t begin, size_t end) : begin(begin), end(end), tokens(source) {}
+    };
+
+    // Finds a character at or after a position, returning the end if there is none
+    size_t find(std::string_view source, char c, size_t from, size_t end) {
+        if (from >= end) return end;
+        const void* found = std::memchr(source.data() + from, c, end - from);
+        return found == nullptr ? end : static_cast<const char*>(found) - source.data();
+    }
+
+    // Position after the string whose body contains the given position
+    size_t afterString(std::string_view source, size_t from) {
+        size_t quote = find(source, '"', from, source.size());
+        return quote < source.size() ? quote + 1 : source.size();
+    }
+
+    // Position after the block comment whose body contains the given position. The
+    // scanner ends a comment before the first '*' or the character before the first
+    // '/', then consumes two characters, and this follows it exactly.
+    size_t afterComment(std::string_view source, size_t from) {
+        size_t slash = find(source, '/', from + 1, source.size());
+        size_t stop = find(source, '*', from, slash < source.size() ? slash - 1 : source.size());
+        return stop < source.size() ? stop + 2 : source.size();
+    }
+
+    // A pass following the quotes and slashes of a chunk from one way of starting
+    struct Pass {
+        std::vector<size_t> visited; // Positions the pass resumed at after each string, comment or slash
+        size_t exit = 0; // Position the scan of the chunk ends at
+    };
+
+    // Follows the quotes and slashes from a position to find where the scan of a chunk ends.
+    // Once it reaches a position an earlier pass resumed at, the rest is the same as that pass.
+    size_t exitOf(std::string_view source, size_t from, size_t limit, const ScanKernels& kernels,
+                  Pass* passes, int earlier) {
+        Pass& pass = passes[earlier];
+        size_t position = from;
+
+        // The next quote and slash are cached, and only searched again once passed
+        size_t quote = find(source, '"', position, limit);
+        size_t slash = find(source, '/', position, limit);
+        while (position < limit) {
+            for (int other = 0; other < earlier; other++) {
+                const std::vector<size_t>& visited = passes[other].visited;
+                if (std::binary_search(visited.begin(), visited.end(), position)) return passes[other].exit;
+            }
+            pass.visited.push_back(position);
+
+            if (quote < position) quote = find(source, '"', position, limit);
+            if (slash < position) slash = find(source, '/', position, limit);
+            size_t next = std::min(quote, slash);
+            if (next >= limit) return limit;
+
+            char after = next + 1 < source.size() ? source[next + 1] : '\0';
+            if (next == quote) {
+                position = afterString(source, next + 1);
+            } else if (after == '/') {
+                position = kernels.findNewline(source.data(), next + 2, source.size());
+            } else if (after == '*') {
+                position = afterComment(source, next + 2);
+            } else {
+                position = next + 1;
+            }
+        }
+        return position;
+    }
+}
+
+TokenBuffer ParallelScanner::scanTokens() {
+    // Token positions are 32-bit, and small sources are not worth splitting
+    if (source.size() > UINT32_MAX || pool.size() == 1 || source.size() < 2 * MIN_CHUNK) {
+        return Scanner(source, kernels).scanTokens();
+    }
+
+    // Split at line starts into chunks of about the same size
+    size_t target = std::max(MIN_CHUNK, source.size() / (pool.size() * CHUNKS_PER_THREAD));
+    std::vector<Chunk> chunks;
+    size_t begin = 0;
+    while (begin < source.size()) {
+        size_t end = source.size();
+        if (source.size() - begin > target + target / 2) {
+            end = find(source, '\n', begin + target, source.size());
+            if (end < source.size()) end++;
+        }
+        chunks.emplace_back(source, begin, end);
+        begin = end;
+    }
+
+    // Find where each chunk ends for every way it can start
+    pool.forEach(chunks.size(), [&](size_t index) {
+        Chunk& chunk = chunks[index];
+        chunk.starts[OUTSIDE] = chunk.begin;
+        chunk.starts[IN_STRING] = afterString(source, chunk.begin);
+        chunk.starts[IN_COMMENT] = afterComment(source, chunk.begin);
+        chunk.starts[IN_COMMENT_END] = chunk.begin + 1;
+        Pass passes[CHUNK_STARTS];
+        for (int way = 0; way < CHUNK_STARTS; way++) {
+            passes[way].exit = exitOf(source, chunk.starts[way], chunk.end, kernels, passes, way);
+            chunk.exits[way] = passes[way].exit;
+        }
+    });
+
+    // Each chunk starts where the scan of the one before it ends
+    size_t start = 0;
+    for (Chunk& chunk : chunks) {
+        chunk.start = start;
+        size_t* way = std::find(chunk.starts, chunk.starts + CHUNK_STARTS, start);
+        if (way != chunk.starts + CHUNK_STARTS) {
+            start = chunk.exits[way - chunk.starts];
+        } else {
+            Pass pass;
+            start = exitOf(source, start, chunk.end, kernels, &pass, 0);
+        }
+    }
+
+    // Scan every chunk from its real start
+    pool.forEach(chunks.size(), [&](size_t index) {
+        Chunk& chunk = chunks[index];
+        Scanner scanner(source, kernels);
+        scanner.scanRange(chunk.start, chunk.end, chunk.errors);
+        chunk.tokens = scanner.takeTokens();
+    });
+
+    // Join the chunks. A run of whitespace crossing a chunk end is scanned by both
+    // chunks, so each keeps only the newlines before the next one starts.
+    std::vector<TokenBuffer::Slice> slices;
+    std::vector<ScanError> errors;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        size_t next = i + 1 < chunks.size() ? chunks[i + 1].start : SIZE_MAX;
+        slices.push_back({&chunks[i].tokens, 0, chunks[i].start, next});
+        errors.insert(errors.end(), chunks[i].errors.begin(), chunks[i].errors.end());
+    }
+    TokenBuffer tokens = TokenBuffer::join(source, slices, pool);
+    tokens.add(TokenType::END_OF_FILE, static_cast<uint32_t>(source.size()), 0);
+
+    // Report the errors in source order, with lines counted over the whole source
+    for (const ScanError& error : errors) {
+        Lox::error(tokens.lineAt(static_cast<uint32_t>(error.offset)), error.message);
+    }
+    return tokens;
+}
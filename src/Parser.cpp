@@ -1,8 +1,19 @@
 #include "Parser.hpp"
 
 #include <vector>
+#include "PreParser.hpp"
 #include "Stmt.hpp"
 
+bool Parser::lazyFunctions = true;
+
+void Parser::setLazyFunctions(bool lazy) {
+    lazyFunctions = lazy;
+}
+
+bool Parser::getLazyFunctions() {
+    return lazyFunctions;
+}
+
 std::vector<std::shared_ptr<Stmt>> Parser::parse() {
     std::vector<std::shared_ptr<Stmt>> statements;
 
@@ -14,14 +25,45 @@ std::vector<std::shared_ptr<Stmt>> Parser::parse() {
     return statements;
 }
 
+std::vector<std::shared_ptr<Stmt>> Parser::parseChecked() {
+    checked = true;
+    return parse();
+}
+
+std::unique_ptr<Expr> Parser::parseExpression() {
+    try {
+        std::unique_ptr<Expr> expr = expression();
+        if (!isAtEnd()) throw error(peek(), "Expect end of expression.");
+        return expr;
+    } catch (const ParseError&) {
+        return nullptr;
+    }
+}
+
+bool Parser::parseDeclaration(std::shared_ptr<Stmt>& statement) {
+    statement = nullptr;
+    if (stream != nullptr) {
+        // Function bodies keep pointing into the text they were parsed from
+        stream->discard(current, parsedFunction);
+        current = 0;
+        lineCursor = 0;
+        parsedFunction = false;
+    }
+
+    if (isAtEnd()) return false;
+    statement = declaration();
+    return true;
+}
+
 // Parses a declaration
 std::shared_ptr<Stmt> Parser::declaration() {
     try {
         // Check for different types of declarations
-        if (match({TokenType::FUN})) return function("function");
-        if (match({TokenType::VAR})) return varDeclaration();
-        
-        return statement();
+        switch (typeAt(current)) {
+            case TokenType::FUN: advance(); return function("function");
+            case TokenType::VAR: advance(); return varDeclaration();
+            default: return statement();
+        }
     } catch (ParseError error) {
         // If an error occurs, synchronize the parser and return nullptr
         synchronize();
@@ -31,15 +73,17 @@ std::shared_ptr<Stmt> Parser::declaration() {
 
 std::shared_ptr<Stmt> Parser::statement() {
     // Check for different types of statements
-    if (match({TokenType::FOR})) return forStatement();
-    if (match({TokenType::IF})) return ifStatement();
-    if (match({TokenType::PRINT})) return printStatement();
-    if (match({TokenType::RETURN})) return returnStatement();
-    if (match({TokenType::WHILE})) return whileStatement();
-    if (match({TokenType::LEFT_BRACE})) return std::make_shared<Block>(block());
-
-    // If no other statement type matches, parse an expression statement
-    return expressionStatement();
+    switch (typeAt(current)) {
+        case TokenType::FOR: advance(); return forStatement();
+        case TokenType::IF: advance(); return ifStatement();
+        case TokenType::PRINT: advance(); return printStatement();
+        case TokenType::RETURN: advance(); return returnStatement();
+        case TokenType::WHILE: advance(); return whileStatement();
+        case TokenType::LEFT_BRACE: advance(); return std::make_shared<Block>(block());
+        default:
+            // If no other statement type matches, parse an expression statement
+            return expressionStatement();
+    }
 }
 
 std::vector<std::shared_ptr<Stmt>> Parser::block() {
@@ -55,9 +99,14 @@ std::vector<std::shared_ptr<Stmt>> Parser::block() {
     return statements;
 }
 
-std::shared_ptr<Stmt> Parser::function(const std::string& kind) {
-    Token name = consume(TokenType::IDENTIFIER, "Expect " + kind + " name.");
-    consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
+std::shared_ptr<Stmt> Parser::function(const char* kind) {
+    parsedFunction = true;
+
+    // The messages naming the kind are only built on error
+    if (!check(TokenType::IDENTIFIER)) throw error(peek(), std::string("Expect ") + kind + " name.");
+    Token name = token(advance());
+    if (!check(TokenType::LEFT_PAREN)) throw error(peek(), std::string("Expect '(' after ") + kind + " name.");
+    advance();
 
     // Parse function parameters
     std::vector<Token> params;
@@ -67,21 +116,43 @@ std::shared_ptr<Stmt> Parser::function(const std::string& kind) {
                 // Throw an error if the number of parameters exceeds 255
                 error(peek(), "Cannot have more than 255 parameters.");
             }
-            params.emplace_back(consume(TokenType::IDENTIFIER, "Expect parameter name."));
+            params.emplace_back(token(consume(TokenType::IDENTIFIER, "Expect parameter name.")));
         } while (match({TokenType::COMMA})); // Continue parsing parameters until a comma is not found
     }
 
     // Consume the closing parenthesis and opening brace
     consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
-    consume(TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body.");
+    if (!check(TokenType::LEFT_BRACE)) throw error(peek(), std::string("Expect '{' before ") + kind + " body.");
+    uint32_t open = advance();
+
+    // Keep the body as text if it can be parsed on the first call, otherwise parse it now
+    std::shared_ptr<FunctionBody> body = lazyFunctions ? lazyBody(open) : nullptr;
+    if (body == nullptr) body = std::make_shared<FunctionBody>(block());
+    return std::make_unique<Function>(name, std::move(params), std::move(body));
+}
+
+std::shared_ptr<FunctionBody> Parser::lazyBody(uint32_t open) {
+    // Bodies in checked tokens only need their closing brace, others must be free of errors
+    uint32_t close = current;
+    if (checked) {
+        for (size_t depth = 0; typeAt(close) != TokenType::END_OF_FILE; close++) {
+            if (typeAt(close) == TokenType::RIGHT_BRACE && depth == 0) break;
+            if (typeAt(close) == TokenType::LEFT_BRACE) depth++;
+            if (typeAt(close) == TokenType::RIGHT_BRACE) depth--;
+        }
+    } else if (!PreParser(tokens, stream, current, limit).body(close)) {
+        return nullptr;
+    }
+    current = close + 1;
 
-    // Create Function statement with the parsed parameters and body
-    std::vector<std::shared_ptr<Stmt>> body = block();
-    return std::make_unique<Function>(name, params, body);
+    // The text starts on the line of the opening brace, and ends before the closing one
+    uint32_t start = tokens.offset(open) + 1;
+    std::string_view text = tokens.getSource().substr(start, tokens.offset(close) - start);
+    return std::make_shared<FunctionBody>(text, tokens.lineFrom(tokens.offset(open), lineCursor));
 }
 
 std::shared_ptr<Stmt> Parser::returnStatement() {
-    Token keyword = previous();
+    Token keyword = token(previous());
     std::unique_ptr<Expr> value = nullptr;
 
     // Parse the return value if it exists
@@ -157,18 +228,18 @@ std::shared_ptr<Stmt> Parser::forStatement() {
         std::vector<std::shared_ptr<Stmt>> statements;
         statements.emplace_back(body);
         statements.emplace_back(std::make_unique<Expression>(std::move(increment)));
-        body = std::make_shared<Block>(statements);
+        body = std::make_shared<Block>(std::move(statements));
     }
 
     if (condition == nullptr) condition = std::make_unique<Literal>(TokenType::TRUE, nullptr); // If no condition is provided, default to true
 
     // Create and return the While statement
-    body = std::make_shared<While>(std::move(condition), body);
+    body = std::make_shared<While>(std::move(condition), std::move(body));
     if (initializer != nullptr){
         std::vector<std::shared_ptr<Stmt>> statements;
-        statements.emplace_back(initializer);
-        statements.emplace_back(body);
-        body = std::make_shared<Block>(statements);
+        statements.emplace_back(std::move(initializer));
+        statements.emplace_back(std::move(body));
+        body = std::make_shared<Block>(std::move(statements));
     }
 
     return body;
@@ -184,7 +255,7 @@ std::shared_ptr<Stmt> Parser::printStatement() {
 
 std::shared_ptr<Stmt> Parser::varDeclaration() {
     // Parse the variable name
-    Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
+    Token name = token(consume(TokenType::IDENTIFIER, "Expect variable name."));
 
     // Parse the initializer if it exists
     std::unique_ptr<Expr> initializer = nullptr;
@@ -204,172 +275,121 @@ std::shared_ptr<Stmt> Parser::expressionStatement() {
     return std::make_unique<Expression>(std::move(expr));
 }
 
-std::unique_ptr<Expr> Parser::expression() {
-    return assignment();
-}
-
-std::unique_ptr<Expr> Parser::assignment() {
-    // Parse the left-hand side of the assignment
-    std::unique_ptr<Expr> expr = logicalOr();
-
-    // Check for assignment operator
-    if (match({TokenType::EQUAL})) {
-        Token equals = previous();
-        std::unique_ptr<Expr> value = assignment(); // Parse the right-hand side of the assignment recursively
-
-        if (dynamic_cast<Variable*>(expr.get())) {
-            // If the left-hand side is a variable, return an Assign expression
-            return std::make_unique<Assign>(dynamic_cast<Variable*>(expr.release())->name, std::move(value));
-        }
-
-        throw error(equals, "Invalid assignment target."); // Throw an error if the left-hand side is not a variable
-    }
-
-    // If no assignment operator is found, return the parsed expression
-    return expr;
-}
-
-std::unique_ptr<Expr> Parser::logicalOr() {
-    std::unique_ptr<Expr> expr = logicalAnd();
-
-    // Check for logical OR operators
-    while (match({TokenType::OR})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = logicalAnd();
-        expr = std::make_unique<Logical>(std::move(expr), op, std::move(right));
-    }
+constexpr std::array<Parser::ParseRule, TOKEN_TYPE_COUNT> Parser::buildRules() {
+    std::array<ParseRule, TOKEN_TYPE_COUNT> rules{};
+    auto set = [&](TokenType type, PrefixRule prefix, InfixRule infix, Precedence precedence) {
+        rules[static_cast<size_t>(type)] = {prefix, infix, precedence};
+    };
+    set(TokenType::LEFT_PAREN, &Parser::grouping, &Parser::call, Precedence::CALL);
+    set(TokenType::MINUS, &Parser::unary, &Parser::binary, Precedence::TERM);
+    set(TokenType::PLUS, nullptr, &Parser::binary, Precedence::TERM);
+    set(TokenType::SLASH, nullptr, &Parser::binary, Precedence::FACTOR);
+    set(TokenType::STAR, nullptr, &Parser::binary, Precedence::FACTOR);
+    set(TokenType::BANG, &Parser::unary, nullptr, Precedence::NONE);
+    set(TokenType::BANG_EQUAL, nullptr, &Parser::binary, Precedence::EQUALITY);
+    set(TokenType::EQUAL, nullptr, &Parser::assignment, Precedence::ASSIGNMENT);
+    set(TokenType::EQUAL_EQUAL, nullptr, &Parser::binary, Precedence::EQUALITY);
+    set(TokenType::GREATER, nullptr, &Parser::binary, Precedence::COMPARISON);
+    set(TokenType::GREATER_EQUAL, nullptr, &Parser::binary, Precedence::COMPARISON);
+    set(TokenType::LESS, nullptr, &Parser::binary, Precedence::COMPARISON);
+    set(TokenType::LESS_EQUAL, nullptr, &Parser::binary, Precedence::COMPARISON);
+    set(TokenType::IDENTIFIER, &Parser::variable, nullptr, Precedence::NONE);
+    set(TokenType::STRING, &Parser::literal, nullptr, Precedence::NONE);
+    set(TokenType::NUMBER, &Parser::literal, nullptr, Precedence::NONE);
+    set(TokenType::AND, nullptr, &Parser::logical, Precedence::AND);
+    set(TokenType::OR, nullptr, &Parser::logical, Precedence::OR);
+    set(TokenType::FALSE, &Parser::literal, nullptr, Precedence::NONE);
+    set(TokenType::TRUE, &Parser::literal, nullptr, Precedence::NONE);
+    set(TokenType::NIL, &Parser::literal, nullptr, Precedence::NONE);
+    return rules;
+}
+
+const std::array<Parser::ParseRule, TOKEN_TYPE_COUNT> Parser::RULES = Parser::buildRules();
 
-    return expr;
-}
-
-std::unique_ptr<Expr> Parser::logicalAnd() {
-    std::unique_ptr<Expr> expr = equality();
-
-    // Check for logical AND operators
-    while (match({TokenType::AND})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = equality();
-        expr = std::make_unique<Logical>(std::move(expr), op, std::move(right));
-    }
-
-    return expr;
+std::unique_ptr<Expr> Parser::expression() {
+    return parsePrecedence(Precedence::ASSIGNMENT);
 }
 
-std::unique_ptr<Expr> Parser::equality() {
-    std::unique_ptr<Expr> expr = comparison();
+std::unique_ptr<Expr> Parser::parsePrecedence(Precedence precedence) {
+    // The token starting the expression decides how it is parsed
+    PrefixRule prefix = RULES[static_cast<size_t>(typeAt(current))].prefix;
+    if (prefix == nullptr) throw error(peek(), "Expect expression.");
+    advance();
+    std::unique_ptr<Expr> expr = (this->*prefix)();
 
-    // Check for equality operators
-    while (match({TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = comparison();
-        expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
+    // Operators binding at least as tightly as the given precedence take it as their left operand
+    while (true) {
+        const ParseRule& rule = RULES[static_cast<size_t>(typeAt(current))];
+        if (rule.precedence < precedence || rule.infix == nullptr) break;
+        advance();
+        expr = (this->*rule.infix)(std::move(expr));
     }
 
     return expr;
 }
 
-std::unique_ptr<Expr> Parser::comparison() {
-    std::unique_ptr<Expr> expr = term();
+std::unique_ptr<Expr> Parser::assignment(std::unique_ptr<Expr> target) {
+    // Assignment is right associative, so the value is parsed at the same precedence
+    uint32_t equals = previous();
+    std::unique_ptr<Expr> value = parsePrecedence(Precedence::ASSIGNMENT);
 
-    // Check for comparison operators    
-    while (match({TokenType::GREATER, TokenType::GREATER_EQUAL, TokenType::LESS, TokenType::LESS_EQUAL})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = term();
-        expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
+    if (Variable* variable = dynamic_cast<Variable*>(target.get())) {
+        // If the left-hand side is a variable, return an Assign expression
+        return std::make_unique<Assign>(variable->name, std::move(value));
     }
 
-    return expr;
+    throw error(equals, "Invalid assignment target."); // Throw an error if the left-hand side is not a variable
 }
 
-std::unique_ptr<Expr> Parser::term() {
-    std::unique_ptr<Expr> expr = factor();
-
-    // Check for addition and subtraction operators
-    while (match({TokenType::MINUS, TokenType::PLUS})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = factor();
-        expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
-    }
-
-    return expr;
+std::unique_ptr<Expr> Parser::logical(std::unique_ptr<Expr> left) {
+    // The right operand binds one level tighter, so chains associate to the left
+    uint32_t op = previous();
+    Precedence precedence = RULES[static_cast<size_t>(tokens.type(op))].precedence;
+    std::unique_ptr<Expr> right = parsePrecedence(static_cast<Precedence>(static_cast<int>(precedence) + 1));
+    return std::make_unique<Logical>(std::move(left), token(op), std::move(right));
 }
 
-std::unique_ptr<Expr> Parser::factor() {
-    std::unique_ptr<Expr> expr = unary();
-
-    // Check for multiplication and division operators
-    while (match({TokenType::SLASH, TokenType::STAR})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = unary();
-        expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
-    }
-
-    return expr;
+std::unique_ptr<Expr> Parser::binary(std::unique_ptr<Expr> left) {
+    // The right operand binds one level tighter, so chains associate to the left
+    uint32_t op = previous();
+    Precedence precedence = RULES[static_cast<size_t>(tokens.type(op))].precedence;
+    std::unique_ptr<Expr> right = parsePrecedence(static_cast<Precedence>(static_cast<int>(precedence) + 1));
+    return std::make_unique<Binary>(std::move(left), token(op), std::move(right));
 }
 
 std::unique_ptr<Expr> Parser::unary() {
-    // Check for unary operators
-    if (match({TokenType::BANG, TokenType::MINUS})) {
-        Token op = previous();
-        std::unique_ptr<Expr> right = unary();
-        return std::make_unique<Unary>(op, std::move(right));
-    }
-
-    return call();
+    // The operand may itself be a unary or call expression, but not a binary one
+    uint32_t op = previous();
+    std::unique_ptr<Expr> right = parsePrecedence(Precedence::UNARY);
+    return std::make_unique<Unary>(token(op), std::move(right));
 }
 
-std::unique_ptr<Expr> Parser::call() {
-    // Parse the primary expression
-    std::unique_ptr<Expr> expr = primary();
-
-    // Check for function calls
-    while (true) {
-        if (match({TokenType::LEFT_PAREN})) {
-            expr = finishCall(std::move(expr));
-        } else {
-            break;
-        }
-    }
-
-    return expr;
+std::unique_ptr<Expr> Parser::call(std::unique_ptr<Expr> callee) {
+    return finishCall(std::move(callee));
 }
 
-std::unique_ptr<Expr> Parser::primary() {
-    auto nilptr = std::shared_ptr<void>();
-
-    // Check for boolean literals
-    if (match({TokenType::FALSE})) {
-        return std::make_unique<Literal>(TokenType::FALSE, nilptr);
-    } else if (match({TokenType::TRUE})) {
-        return std::make_unique<Literal>(TokenType::TRUE, nilptr);
-    }
-
-    // Check for nil literal
-    else if (match({TokenType::NIL})) {
-        auto nilptr = std::shared_ptr<void>();
-        return std::make_unique<Literal>(TokenType::NIL, nilptr);
-    }
-
-    // Check for number and string literals
-    else if (match({TokenType::NUMBER, TokenType::STRING})) {
-        auto prevLiteral = previous().getLiteral();
-        return std::make_unique<Literal>(previous().getType(), prevLiteral);
-    }
-
-    // Check for identifiers
-    else if (match({TokenType::IDENTIFIER})) {
-        return std::make_unique<Variable>(previous());
-    }
-
-    // Check for grouped expressions
-    else if (match({TokenType::LEFT_PAREN})) {
-        std::unique_ptr<Expr> expr = expression();
-        consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
-        return std::make_unique<Grouping>(std::move(expr));
+std::unique_ptr<Expr> Parser::grouping() {
+    std::unique_ptr<Expr> expr = expression();
+    consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
+    return std::make_unique<Grouping>(std::move(expr));
+}
+
+std::unique_ptr<Expr> Parser::literal() {
+    // Number and string values are read from the token buffer
+    uint32_t token = previous();
+    TokenType type = tokens.type(token);
+    switch (type) {
+        case TokenType::NUMBER:
+            return std::make_unique<Literal>(type, std::make_shared<double>(tokens.number(token)));
+        case TokenType::STRING:
+            return std::make_unique<Literal>(type, std::make_shared<std::string>(tokens.string(token)));
+        default:
+            return std::make_unique<Literal>(type, nullptr);
     }
+}
 
-    // If none of the above cases match, throw an error
-    throw error(peek(), "Expect expression.");
+std::unique_ptr<Expr> Parser::variable() {
+    return std::make_unique<Variable>(token(previous()));
 }
 
 std::unique_ptr<Expr> Parser::finishCall(std::unique_ptr<Expr> callee) {
@@ -385,17 +405,17 @@ std::unique_ptr<Expr> Parser::finishCall(std::unique_ptr<Expr> callee) {
     }
 
     // Consume the closing parenthesis and return the Call expression
-    Token paren = consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
+    Token paren = token(consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments."));
     return std::make_unique<Call>(std::move(callee), paren, std::move(arguments)); 
 }
 
-Token Parser::consume(TokenType type, const std::string& message) {
+uint32_t Parser::consume(TokenType type, const char* message) {
     // Consumes the current token if it is of the given type, otherwise throws an error
     if (check(type)) return advance();
     throw error(peek(), message);
 }
 
-bool Parser::match(std::vector<TokenType> types) {
+bool Parser::match(std::initializer_list<TokenType> types) {
     // Checks if the current token is one of the given types
     for (TokenType type : types) {
         if (check(type)) {
@@ -409,10 +429,10 @@ bool Parser::match(std::vector<TokenType> types) {
 bool Parser::check(TokenType type) {
     // Checks if type of current token is equal to the given type
     if (isAtEnd()) return false;
-    return peek().getType() == type;
+    return typeAt(current) == type;
 }
 
-Token Parser::advance() {
+uint32_t Parser::advance() {
     // Advances the current token and returns the previous token
     if (!isAtEnd()) current++;
     return previous();
@@ -421,20 +441,33 @@ Token Parser::advance() {
 
 bool Parser::isAtEnd() {
     // Checks if the current token is the end of the file
-    return peek().getType() == TokenType::END_OF_FILE;
+    return typeAt(current) == TokenType::END_OF_FILE;
 }
 
-Token Parser::peek() {
-    return tokens[current];
+uint32_t Parser::peek() {
+    return current;
+}
+
+uint32_t Parser::previous() {
+    return current - 1;
+}
+
+TokenType Parser::typeAt(uint32_t index) {
+    if (index >= limit) return TokenType::END_OF_FILE;
+
+    // A streaming scanner only scans the tokens the parser asks for
+    if (stream != nullptr) stream->ensure(index);
+    return tokens.type(index);
 }
 
-Token Parser::previous() {
-    return tokens[current - 1];
+Token Parser::token(uint32_t index) {
+    // Tokens are mostly built in order, so lines are found by walking the newlines
+    return Token(tokens.type(index), tokens.lexeme(index), tokens.lineFrom(tokens.offset(index), lineCursor));
 }
 
-ParseError Parser::error(Token token, const std::string& message) {
-    Lox::error(token, message);
-    return ParseError(token, message);
+ParseError Parser::error(uint32_t token, const std::string& message) {
+    Lox::error(tokens.token(token), message);
+    return ParseError(tokens.token(token), message);
 }
 
 void Parser::synchronize() {
@@ -443,10 +476,10 @@ void Parser::synchronize() {
     // Skip tokens until a statement boundary is reached
     while (!isAtEnd()) {
         // Skip tokens until a semicolon is reached
-        if (previous().getType() == TokenType::SEMICOLON) return;
+        if (typeAt(previous()) == TokenType::SEMICOLON) return;
 
         // Check for statement boundaries
-        switch (peek().getType()) {
+        switch (typeAt(current)) {
             case TokenType::CLASS:
             case TokenType::FUN:
             case TokenType::VAR:
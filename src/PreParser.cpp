@@ -0,0 +1,175 @@
+#include "PreParser.hpp"
+
+bool PreParser::body(uint32_t& close) {
+    try {
+        // The body ends at the first closing brace outside its statements
+        while (!check(TokenType::RIGHT_BRACE) && typeAt(current) != TokenType::END_OF_FILE) {
+            declaration();
+        }
+        if (!check(TokenType::RIGHT_BRACE)) return false;
+        close = current;
+        return true;
+    } catch (Failure) {
+        return false;
+    }
+}
+
+void PreParser::declaration() {
+    switch (typeAt(current)) {
+        case TokenType::FUN: advance(); return function();
+        case TokenType::VAR: advance(); return varDeclaration();
+        default: return statement();
+    }
+}
+
+void PreParser::statement() {
+    switch (typeAt(current)) {
+        case TokenType::FOR:
+            advance();
+            return forStatement();
+        case TokenType::IF:
+            advance();
+            consume(TokenType::LEFT_PAREN);
+            expression();
+            consume(TokenType::RIGHT_PAREN);
+            statement();
+            if (match(TokenType::ELSE)) statement();
+            return;
+        case TokenType::PRINT:
+            advance();
+            expression();
+            return consume(TokenType::SEMICOLON);
+        case TokenType::RETURN:
+            advance();
+            if (!check(TokenType::SEMICOLON)) expression();
+            return consume(TokenType::SEMICOLON);
+        case TokenType::WHILE:
+            advance();
+            consume(TokenType::LEFT_PAREN);
+            expression();
+            consume(TokenType::RIGHT_PAREN);
+            return statement();
+        case TokenType::LEFT_BRACE:
+            advance();
+            return block();
+        default:
+            expression();
+            return consume(TokenType::SEMICOLON);
+    }
+}
+
+void PreParser::block() {
+    while (!check(TokenType::RIGHT_BRACE) && typeAt(current) != TokenType::END_OF_FILE) {
+        declaration();
+    }
+    consume(TokenType::RIGHT_BRACE);
+}
+
+void PreParser::function() {
+    consume(TokenType::IDENTIFIER);
+    consume(TokenType::LEFT_PAREN);
+
+    // More parameters than a call can pass is an error the parser reports too
+    if (!check(TokenType::RIGHT_PAREN)) {
+        size_t params = 0;
+        do {
+            if (params++ >= 255) throw Failure();
+            consume(TokenType::IDENTIFIER);
+        } while (match(TokenType::COMMA));
+    }
+    consume(TokenType::RIGHT_PAREN);
+    consume(TokenType::LEFT_BRACE);
+    block();
+}
+
+void PreParser::forStatement() {
+    consume(TokenType::LEFT_PAREN);
+
+    // Initializer, condition and increment
+    if (match(TokenType::VAR)) {
+        varDeclaration();
+    } else if (!match(TokenType::SEMICOLON)) {
+        expression();
+        consume(TokenType::SEMICOLON);
+    }
+    if (!check(TokenType::SEMICOLON)) expression();
+    consume(TokenType::SEMICOLON);
+    if (!check(TokenType::RIGHT_PAREN)) expression();
+    consume(TokenType::RIGHT_PAREN);
+
+    statement();
+}
+
+void PreParser::varDeclaration() {
+    consume(TokenType::IDENTIFIER);
+    if (match(TokenType::EQUAL)) expression();
+    consume(TokenType::SEMICOLON);
+}
+
+bool PreParser::expression(Precedence precedence) {
+    // The prefix rule of the first token says what kind of expression starts here
+    Parser::PrefixRule prefix = Parser::RULES[static_cast<size_t>(typeAt(current))].prefix;
+    if (prefix == nullptr) throw Failure();
+    advance();
+    bool variable = prefix == &Parser::variable;
+    if (prefix == &Parser::grouping) {
+        expression();
+        consume(TokenType::RIGHT_PAREN);
+    } else if (prefix == &Parser::unary) {
+        expression(Precedence::UNARY);
+    }
+
+    // Operators binding at least as tightly as the given precedence take it as their left operand
+    while (true) {
+        const Parser::ParseRule& rule = Parser::RULES[static_cast<size_t>(typeAt(current))];
+        if (rule.precedence < precedence || rule.infix == nullptr) break;
+        advance();
+        if (rule.infix == &Parser::assignment) {
+            // Only a variable can be assigned to
+            if (!variable) throw Failure();
+            expression(Precedence::ASSIGNMENT);
+        } else if (rule.infix == &Parser::call) {
+            if (!check(TokenType::RIGHT_PAREN)) {
+                size_t arguments = 0;
+                do {
+                    if (arguments++ >= 255) throw Failure();
+                    expression();
+                } while (match(TokenType::COMMA));
+            }
+            consume(TokenType::RIGHT_PAREN);
+        } else {
+            expression(static_cast<Precedence>(static_cast<int>(rule.precedence) + 1));
+        }
+        variable = false;
+    }
+
+    return variable;
+}
+
+void PreParser::consume(TokenType type) {
+    if (!check(type)) throw Failure();
+    advance();
+}
+
+bool PreParser::match(TokenType type) {
+    if (!check(type)) return false;
+    advance();
+    return true;
+}
+
+bool PreParser::check(TokenType type) {
+    TokenType next = typeAt(current);
+    return next != TokenType::END_OF_FILE && next == type;
+}
+
+void PreParser::advance() {
+    if (typeAt(current) != TokenType::END_OF_FILE) current++;
+}
+
+TokenType PreParser::typeAt(uint32_t index) {
+    if (index >= limit) return TokenType::END_OF_FILE;
+
+    // A streaming scanner only scans the tokens the pre-parser asks for
+    if (stream != nullptr) stream->ensure(index);
+    return tokens.type(index);
+}
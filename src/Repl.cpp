@@ -0,0 +1,48 @@
+#include "Repl.hpp"
+#include <sstream>
+
+// Checks if every syntax error of a program is at the end of its text, so more lines could complete it
+static bool isIncomplete(const Program& program) {
+    std::istringstream errors(program.getErrors());
+    std::string error;
+    while (std::getline(errors, error)) {
+        bool atEnd = error.find("Error at end:") != std::string::npos || error.find("Unterminated string.") != std::string::npos
+            || error.find("Unterminated block comment.") != std::string::npos;
+        if (!atEnd) return false;
+    }
+    return true;
+}
+
+Repl::Repl(const HeapConfig& config) : vm(config), isolate(vm.createIsolate()) {}
+
+void Repl::setOutput(Sink sink) {
+    isolate->setOutput(std::move(sink));
+}
+
+void Repl::setErrors(Sink sink) {
+    isolate->setErrors(std::move(sink));
+}
+
+bool Repl::feed(std::string_view line) {
+    // Lines are joined without a trailing newline, so an error at the end is on the last line typed
+    if (!pending.empty()) pending.append("\n");
+    pending.append(line);
+    std::shared_ptr<const Program> program = vm.compile(pending);
+    if (program->hadError() && isIncomplete(*program)) return true;
+    run(std::move(program));
+    return false;
+}
+
+void Repl::flush() {
+    if (pending.empty()) return;
+    run(vm.compile(pending));
+}
+
+Heap& Repl::getHeap() {
+    return isolate->getHeap();
+}
+
+void Repl::run(std::shared_ptr<const Program> program) {
+    pending.clear();
+    isolate->run(std::move(program));
+}
@@ -0,0 +1,222 @@
+#include "ScanKernels.hpp"
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define CPPLOX_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Scalar kernels, also used for the bytes after the last full vector
+
+    size_t scalarSkipWhitespace(const char* data, size_t pos, size_t end, TokenBuffer& tokens) {
+        for (; pos < end; pos++) {
+            char c = data[pos];
+            if (c == '\n') {
+                tokens.addNewline(static_cast<uint32_t>(pos));
+            } else if (c != ' ' && c != '\t' && c != '\r') {
+                break;
+            }
+        }
+        return pos;
+    }
+
+    size_t scalarFindNewline(const char* data, size_t pos, size_t end) {
+        while (pos < end && data[pos] != '\n') pos++;
+        return pos;
+    }
+
+    size_t scalarFindQuote(const char* data, size_t pos, size_t end, TokenBuffer& tokens) {
+        for (; pos < end && data[pos] != '"'; pos++) {
+            if (data[pos] == '\n') tokens.addNewline(static_cast<uint32_t>(pos));
+        }
+        return pos;
+    }
+
+    size_t scalarSkipIdentifier(const char* data, size_t pos, size_t end) {
+        while (pos < end && isCharClass(data[pos], CHAR_ALPHA | CHAR_DIGIT)) pos++;
+        return pos;
+    }
+
+    const ScanKernels SCALAR = {
+        "scalar", scalarSkipWhitespace, scalarFindNewline, scalarFindQuote, scalarSkipIdentifier
+    };
+
+#ifdef CPPLOX_SCAN_X86
+    // Records the newlines flagged by a comparison mask of the block starting at base
+    inline void recordNewlines(uint32_t mask, size_t base, TokenBuffer& tokens) {
+        while (mask != 0) {
+            tokens.addNewline(static_cast<uint32_t>(base + __builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+
+    // Bits of a mask below the given index
+    inline uint32_t bitsBelow(uint32_t mask, int index) {
+        return mask & ((1u << index) - 1);
+    }
+
+    // SSE2 kernels, 16 bytes per step
+
+    // Flags bytes that are at most the limit, comparing as unsigned
+    inline __m128i atMost(__m128i bytes, char limit) {
+        return _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(limit)), bytes);
+    }
+
+    size_t sse2SkipWhitespace(const char* data, size_t pos, size_t end, TokenBuffer& tokens) {
+        for (; pos + 16 <= end; pos += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i newline = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+            __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+            uint32_t lines = _mm_movemask_epi8(newline);
+            uint32_t other = ~_mm_movemask_epi8(_mm_or_si128(blank, newline)) & 0xFFFF;
+            if (other != 0) {
+                int index = __builtin_ctz(other);
+                recordNewlines(bitsBelow(lines, index), pos, tokens);
+                return pos + index;
+            }
+            recordNewlines(lines, pos, tokens);
+        }
+        return scalarSkipWhitespace(data, pos, end, tokens);
+    }
+
+    size_t sse2FindNewline(const char* data, size_t pos, size_t end) {
+        for (; pos + 16 <= end; pos += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            uint32_t lines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+            if (lines != 0) return pos + __builtin_ctz(lines);
+        }
+        return scalarFindNewline(data, pos, end);
+    }
+
+    size_t sse2FindQuote(const char* data, size_t pos, size_t end, TokenBuffer& tokens) {
+        for (; pos + 16 <= end; pos += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            uint32_t lines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+            uint32_t quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+            if (quotes != 0) {
+                int index = __builtin_ctz(quotes);
+                recordNewlines(bitsBelow(lines, index), pos, tokens);
+                return pos + index;
+            }
+            recordNewlines(lines, pos, tokens);
+        }
+        return scalarFindQuote(data, pos, end, tokens);
+    }
+
+    size_t sse2SkipIdentifier(const char* data, size_t pos, size_t end) {
+        for (; pos + 16 <= end; pos += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            // Setting bit 5 folds upper case onto lower case without creating new letters
+            __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+            __m128i alpha = atMost(_mm_sub_epi8(lower, _mm_set1_epi8('a')), 'z' - 'a');
+            __m128i digit = atMost(_mm_sub_epi8(chunk, _mm_set1_epi8('0')), 9);
+            __m128i underscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+            uint32_t other = ~_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), underscore)) & 0xFFFF;
+            if (other != 0) return pos + __builtin_ctz(other);
+        }
+        return scalarSkipIdentifier(data, pos, end);
+    }
+
+    const ScanKernels SSE2 = {
+        "sse2", sse2SkipWhitespace, sse2FindNewline, sse2FindQuote, sse2SkipIdentifier
+    };
+
+    // AVX2 kernels, 32 bytes per step, only called after checking the CPU supports them
+
+#define CPPLOX_AVX2 __attribute__((target("avx2")))
+
+    CPPLOX_AVX2 inline __m256i atMost256(__m256i bytes, char limit) {
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, _mm256_set1_epi8(limit)), bytes);
+    }
+
+    CPPLOX_AVX2 size_t avx2SkipWhitespace(const char* data, size_t pos, size_t end, TokenBuffer& tokens) {
+        for (; pos + 32 <= end; pos += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i newline = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+            __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+            uint32_t lines = _mm256_movemask_epi8(newline);
+            uint32_t other = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(blank, newline)));
+            if (other != 0) {
+                int index = __builtin_ctz(other);
+                recordNewlines(bitsBelow(lines, index), pos, tokens);
+                return pos + index;
+            }
+            recordNewlines(lines, pos, tokens);
+        }
+        return sse2SkipWhitespace(data, pos, end, tokens);
+    }
+
+    CPPLOX_AVX2 size_t avx2FindNewline(const char* data, size_t pos, size_t end) {
+        for (; pos + 32 <= end; pos += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            uint32_t lines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+            if (lines != 0) return pos + __builtin_ctz(lines);
+        }
+        return sse2FindNewline(data, pos, end);
+    }
+
+    CPPLOX_AVX2 size_t avx2FindQuote(const char* data, size_t pos, size_t end, TokenBuffer& tokens) {
+        for (; pos + 32 <= end; pos += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            uint32_t lines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+            uint32_t quotes = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+            if (quotes != 0) {
+                int index = __builtin_ctz(quotes);
+                recordNewlines(bitsBelow(lines, index), pos, tokens);
+                return pos + index;
+            }
+            recordNewlines(lines, pos, tokens);
+        }
+        return sse2FindQuote(data, pos, end, tokens);
+    }
+
+    CPPLOX_AVX2 size_t avx2SkipIdentifier(const char* data, size_t pos, size_t end) {
+        for (; pos + 32 <= end; pos += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+            __m256i alpha = atMost256(_mm256_sub_epi8(lower, _mm256_set1_epi8('a')), 'z' - 'a');
+            __m256i digit = atMost256(_mm256_sub_epi8(chunk, _mm256_set1_epi8('0')), 9);
+            __m256i underscore = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+            uint32_t other = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), underscore)));
+            if (other != 0) return pos + __builtin_ctz(other);
+        }
+        return sse2SkipIdentifier(data, pos, end);
+    }
+
+#undef CPPLOX_AVX2
+
+    const ScanKernels AVX2 = {
+        "avx2", avx2SkipWhitespace, avx2FindNewline, avx2FindQuote, avx2SkipIdentifier
+    };
+
+    bool cpuHasAvx2() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+}
+
+const ScanKernels& ScanKernels::best() {
+#ifdef CPPLOX_SCAN_X86
+    static const ScanKernels& selected = cpuHasAvx2() ? AVX2 : SSE2;
+    return selected;
+#else
+    return SCALAR;
+#endif
+}
+
+const ScanKernels& ScanKernels::scalar() {
+    return SCALAR;
+}
+
+std::vector<const ScanKernels*> ScanKernels::available() {
+    std::vector<const ScanKernels*> kernels = {&SCALAR};
+#ifdef CPPLOX_SCAN_X86
+    kernels.push_back(&SSE2);
+    if (cpuHasAvx2()) kernels.push_back(&AVX2);
+#endif
+    return kernels;
+}
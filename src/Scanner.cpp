@@ -1,27 +1,17 @@
 #include "Scanner.hpp"
 #include "Lox.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <charconv>
+
+TokenBuffer Scanner::scanTokens() {
+    // Token positions are stored as 32-bit offsets
+    if (source.size() > UINT32_MAX) {
+        Lox::error(1, "Source is larger than 4 GB.");
+        tokens.add(TokenType::END_OF_FILE, 0, 0);
+        return std::move(tokens);
+    }
 
-// Map of reserved keywords and their token types
-const std::unordered_map<std::string, TokenType> Scanner::keywords = {
-    {"and",    TokenType::AND},
-    {"class",  TokenType::CLASS},
-    {"else",   TokenType::ELSE},
-    {"false",  TokenType::FALSE},
-    {"for",    TokenType::FOR},
-    {"fun",    TokenType::FUN},
-    {"if",     TokenType::IF},
-    {"nil",    TokenType::NIL},
-    {"or",     TokenType::OR},
-    {"print",  TokenType::PRINT},
-    {"return", TokenType::RETURN},
-    {"super",  TokenType::SUPER},
-    {"this",   TokenType::THIS},
-    {"true",   TokenType::TRUE},
-    {"var",    TokenType::VAR},
-    {"while",  TokenType::WHILE}
-};
-
-std::vector<Token> Scanner::scanTokens() {
     while (!isAtEnd()) {
         // Loops through the source code and scans each token
         start = current;
@@ -29,16 +19,107 @@ std::vector<Token> Scanner::scanTokens() {
     }
 
     // Adds an end of file token to the end of the token list
-    Token endToken(TokenType::END_OF_FILE, "", nullptr, line);
-    tokens.emplace_back(endToken);
-    return tokens;
+    tokens.add(TokenType::END_OF_FILE, static_cast<uint32_t>(source.size()), 0);
+    return std::move(tokens);
+}
+
+void Scanner::scanRange(size_t from, size_t limit, std::vector<ScanError>& errors) {
+    deferredErrors = &errors;
+    current = from;
+    while (current < limit && !isAtEnd()) {
+        start = current;
+        scanToken();
+    }
+    deferredErrors = nullptr;
+}
+
+Scanner::Scanner(std::istream& input, const ScanKernels& kernels)
+    : tokens(""), kernels(kernels), input(&input), window(std::make_unique<std::string>()) {}
+
+void Scanner::ensure(uint32_t index) {
+    while (tokens.size() <= index) {
+        // Keep a character of lookahead, so only runs of characters can reach the end of the window
+        if (input != nullptr && source.size() - current < 2 && refill()) continue;
+
+        if (isAtEnd()) {
+            tokens.add(TokenType::END_OF_FILE, static_cast<uint32_t>(current), 0);
+            return;
+        }
+
+        uint32_t tokenCount = tokens.size();
+        size_t newlineCount = tokens.newlineCount();
+        start = current;
+        scanToken();
+
+        if (isAtEnd() && hasMoreInput()) {
+            // The run may continue in the next chunk, scan it again once that is read
+            tokens.truncate(tokenCount, newlineCount);
+            current = start;
+            refill();
+        }
+    }
+}
+
+void Scanner::discard(uint32_t count, bool keepText) {
+    ensure(count);
+    size_t offset = tokens.offset(count);
+    int line = tokens.lineAt(static_cast<uint32_t>(offset));
+
+    // Windows replaced while scanning the dropped tokens are only needed if they hold a function
+    for (auto& text : superseded) {
+        if (keepText) retained.push_back(std::move(text));
+    }
+    superseded.clear();
+    if (keepText) keepWindow = true;
+
+    // Scan on from the first kept token, which becomes offset zero
+    source = source.substr(offset);
+    tokens = TokenBuffer(source, line);
+    start = 0;
+    current = 0;
+}
+
+bool Scanner::hasMoreInput() const {
+    return input != nullptr && !inputDone;
+}
+
+bool Scanner::refill() {
+    if (!hasMoreInput()) return false;
+
+    // Read at least as much as is already buffered, so copying the window stays linear overall
+    size_t buffered = source.size();
+    size_t chunk = std::max(CHUNK_SIZE, buffered);
+    if (buffered + chunk > UINT32_MAX) {
+        Lox::error(tokens.lineAt(static_cast<uint32_t>(buffered)), "Declaration is larger than 4 GB.");
+        inputDone = true;
+        return false;
+    }
+    auto next = std::make_unique<std::string>();
+    next->reserve(buffered + chunk);
+    next->append(source);
+    next->resize(buffered + chunk);
+    input->read(&(*next)[buffered], chunk);
+    size_t read = static_cast<size_t>(input->gcount());
+    next->resize(buffered + read);
+    if (read < chunk) inputDone = true;
+
+    // Tokens of the declaration being parsed still point into the old window
+    if (keepWindow) {
+        retained.push_back(std::move(window));
+    } else {
+        superseded.push_back(std::move(window));
+    }
+    keepWindow = false;
+    window = std::move(next);
+    source = *window;
+    tokens.rebase(source);
+    return read > 0;
 }
 
 void Scanner::identifier() {
     // Scans an identifier and adds it to the token list
-    while (isAlphaNumeric(peek())) advance();
-    std::string text = source.substr(start, current - start);
-    TokenType type = keywords.find(text) != keywords.end() ? keywords.at(text) : TokenType::IDENTIFIER;
+    current = kernels.skipIdentifier(source.data(), current, source.size());
+    TokenType type = keywordType(source.substr(start, current - start));
     addToken(type);
 }
 
@@ -55,19 +136,14 @@ void Scanner::scanToken() {
     // Gets the current character
     char c = advance();
 
+    // Single character tokens come straight from the character table
+    if (isCharClass(c, CHAR_SINGLE)) {
+        addToken(CHAR_TABLES.tokens[static_cast<unsigned char>(c)]);
+        return;
+    }
+
     // Checks for the type of token
     switch (c) {
-        // Single character tokens
-        case '(': addToken(TokenType::LEFT_PAREN); break;
-        case ')': addToken(TokenType::RIGHT_PAREN); break;
-        case '{': addToken(TokenType::LEFT_BRACE); break;
-        case '}': addToken(TokenType::RIGHT_BRACE); break;
-        case ',': addToken(TokenType::COMMA); break;
-        case '.': addToken(TokenType::DOT); break;
-        case '-': addToken(TokenType::MINUS); break;
-        case '+': addToken(TokenType::PLUS); break;
-        case ';': addToken(TokenType::SEMICOLON); break;
-        case '*': addToken(TokenType::STAR); break;
         // Two character tokens
         case '!':
             addToken(match('=') ? TokenType::BANG_EQUAL : TokenType::BANG);
@@ -85,16 +161,15 @@ void Scanner::scanToken() {
         case '/':
             if (match('/')) {
                 // If the current character is a comment, then ignore the rest of the line
-                while (peek() != '\n' && !isAtEnd()) advance();
+                current = kernels.findNewline(source.data(), current, source.size());
             } else if (match('*')) {
                 // If the current character is a block comment, then ignore the rest of the block comment
                 while (peek() != '*' && peekNext() != '/' && !isAtEnd()) {
-                    if (peek() == '\n') line++;
-                    advance();
+                    if (advance() == '\n') newline();
                 }
 
                 if (isAtEnd()) {
-                    Lox::error(line, "Unterminated block comment.");
+                    if (!hasMoreInput()) error("Unterminated block comment.");
                     return;
                 }
 
@@ -110,10 +185,9 @@ void Scanner::scanToken() {
         case ' ':
         case '\r':
         case '\t':
-            // Ignore whitespace.
-            break;
         case '\n':
-            line++;
+            // Skip the whole run from the character just consumed, recording its newlines
+            current = kernels.skipWhitespace(source.data(), current - 1, source.size(), tokens);
             break;
         case '"': string(); break;
         // Literals
@@ -124,21 +198,31 @@ void Scanner::scanToken() {
                 identifier();
             } else {
                 // If the character is not a token, then it is a literal
-                Lox::error(line, "Unexpected character.");
+                error("Unexpected character.");
             }
             break;
     }
 }
 
 void Scanner::addToken(const TokenType type) {
-    addToken(type, nullptr);
+    // Adds a token to the token list
+    tokens.add(type, static_cast<uint32_t>(start), static_cast<uint32_t>(current - start));
 }
 
-void Scanner::addToken(const TokenType type, std::shared_ptr<void> literal) {
-    // Adds a token to the token list
-    std::string text = source.substr(start, current - start);
-    Token token(type, text, literal, line);
-    tokens.emplace_back(token);
+void Scanner::error(const std::string& message) {
+    if (deferredErrors != nullptr) {
+        deferredErrors->push_back({current, message});
+    } else {
+        Lox::error(line(), message);
+    }
+}
+
+void Scanner::newline() {
+    tokens.addNewline(static_cast<uint32_t>(current - 1));
+}
+
+int Scanner::line() const {
+    return tokens.lineAt(static_cast<uint32_t>(current));
 }
 
 bool Scanner::match(const char expected) {
@@ -158,28 +242,24 @@ char Scanner::peek() const{
 
 void Scanner::string() {
     // Scans a string literal
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n') line++;
-        advance();
-    }
+    current = kernels.findQuote(source.data(), current, source.size(), tokens);
 
     // Unterminated string
     if (isAtEnd()) {
-        Lox::error(line, "Unterminated string.");
+        if (!hasMoreInput()) error("Unterminated string.");
         return;
     }
 
     // The closing "
     advance();
 
-    // Trim the surrounding quotes
-    std::string value = source.substr(start + 1, current - start - 2);
-    addToken(TokenType::STRING, std::make_shared<std::string>(value));
+    // The value is the lexeme without its quotes, read back from the source by the parser
+    addToken(TokenType::STRING);
 }
 
 bool Scanner::isDigit(const char c) const {
     // Checks if the character is a digit
-    return c >= '0' && c <= '9';
+    return isCharClass(c, CHAR_DIGIT);
 }
 
 void Scanner::number() {
@@ -195,8 +275,10 @@ void Scanner::number() {
         while (isDigit(peek())) advance();
     }
 
-    double value = std::stod(source.substr(start, current - start));
-    addToken(TokenType::NUMBER, std::make_shared<double>(value));
+    // Parse in place, bounded so an exponent or hex prefix after the digits is not consumed
+    double value = 0;
+    std::from_chars(source.data() + start, source.data() + current, value);
+    tokens.addNumber(static_cast<uint32_t>(start), static_cast<uint32_t>(current - start), value);
 }
 
 char Scanner::peekNext() const {
@@ -207,12 +289,10 @@ char Scanner::peekNext() const {
 
 bool Scanner::isAlpha(const char c) const {
     // Checks if the character is an alphabet character
-    return (c >= 'a' && c <= 'z') ||
-           (c >= 'A' && c <= 'Z') ||
-           c == '_';
+    return isCharClass(c, CHAR_ALPHA);
 }
 
 bool Scanner::isAlphaNumeric(const char c) const {
     // Checks if the character is an alphabet character or a digit
-    return isAlpha(c) || isDigit(c);
+    return isCharClass(c, CHAR_ALPHA | CHAR_DIGIT);
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "Scheduler.hpp"
+#include <algorithm>
+
+void Scheduler::Histogram::record(uint64_t ns) {
+    // Below SUB_BUCKETS each value has a bucket, above it the three bits after the leading one pick the bucket
+    size_t bucket = ns;
+    if (ns >= SUB_BUCKETS) {
+        int octave = 63 - __builtin_clzll(ns);
+        bucket = static_cast<size_t>(octave - 2) * SUB_BUCKETS + ((ns >> (octave - 3)) & (SUB_BUCKETS - 1));
+    }
+    counts[bucket]++;
+    total++;
+    sumNs += ns;
+    maxNs = std::max(maxNs, ns);
+}
+
+void Scheduler::Histogram::merge(const Histogram& other) {
+    for (int i = 0; i < BUCKETS; i++) counts[i] += other.counts[i];
+    total += other.total;
+    sumNs += other.sumNs;
+    maxNs = std::max(maxNs, other.maxNs);
+}
+
+double Scheduler::Histogram::percentileUs(double fraction) const {
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen <= rank) continue;
+        uint64_t upper = i < SUB_BUCKETS ? i + 1 : static_cast<uint64_t>(SUB_BUCKETS + 1 + i % SUB_BUCKETS) << (i / SUB_BUCKETS - 1);
+        return static_cast<double>(std::min(upper, maxNs)) / 1000.0;
+    }
+    return static_cast<double>(maxNs) / 1000.0;
+}
+
+Scheduler::Context::Context(size_t id, std::shared_ptr<const Program> program, const HeapConfig& config)
+    : id(id), program(std::move(program)), interpreter(config), coroutine([this] {
+          status = interpreter.interpret(this->program->getStatements()) ? RunStatus::OK : RunStatus::RUNTIME_ERROR;
+      }) {}
+
+Scheduler::Scheduler(unsigned threads, uint64_t budget, const HeapConfig& config)
+    : budget(std::max<uint64_t>(budget, 1)), config(config) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++) lanes.push_back(std::make_unique<Lane>());
+    for (auto& lane : lanes) lane->thread = std::thread([this, &lane = *lane] { run(lane); });
+}
+
+Scheduler::~Scheduler() {
+    waitAll();
+    for (auto& lane : lanes) {
+        {
+            std::lock_guard<std::mutex> guard(lane->lock);
+            lane->stopping = true;
+        }
+        lane->ready.notify_one();
+    }
+    for (auto& lane : lanes) lane->thread.join();
+}
+
+size_t Scheduler::start(std::shared_ptr<const Program> program, Sink output, Sink errors) {
+    size_t id;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        id = statuses.size();
+        statuses.push_back(RunStatus::OK);
+        done.push_back(false);
+    }
+
+    if (program->hadError()) {
+        // The messages end with a newline the sink does not expect
+        const std::string& messages = program->getErrors();
+        errors(std::string_view(messages).substr(0, messages.size() - 1));
+        finish(id, RunStatus::COMPILE_ERROR);
+        return id;
+    }
+
+    auto context = std::make_unique<Context>(id, std::move(program), config);
+    context->interpreter.setOutput(std::move(output));
+    context->interpreter.setErrors(std::move(errors));
+    Context* self = context.get();
+    context->interpreter.setPreemption(budget, [self] { self->coroutine.yield(); });
+
+    // Contexts never move between lanes, so each goes where the fewest are
+    Lane& lane = **std::min_element(lanes.begin(), lanes.end(), [](const auto& a, const auto& b) { return a->load < b->load; });
+    lane.load++;
+    context->queuedAt = Clock::now();
+    {
+        std::lock_guard<std::mutex> guard(lane.lock);
+        lane.queue.push_back(std::move(context));
+    }
+    lane.ready.notify_one();
+    return id;
+}
+
+RunStatus Scheduler::wait(size_t id) {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&] { return done[id]; });
+    return statuses[id];
+}
+
+void Scheduler::waitAll() {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&] { return finished == statuses.size(); });
+}
+
+Scheduler::Stats Scheduler::getStats() const {
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stats.started = statuses.size();
+        stats.finished = finished;
+    }
+    Histogram slices;
+    Histogram waits;
+    for (const auto& lane : lanes) {
+        std::lock_guard<std::mutex> guard(lane->lock);
+        slices.merge(lane->slices);
+        waits.merge(lane->waits);
+        stats.preemptions += lane->preemptions;
+    }
+    stats.slices = slices.total;
+    stats.meanSliceUs = slices.total == 0 ? 0 : static_cast<double>(slices.sumNs) / static_cast<double>(slices.total) / 1000.0;
+    stats.p99SliceUs = slices.percentileUs(0.99);
+    stats.maxSliceUs = static_cast<double>(slices.maxNs) / 1000.0;
+    stats.p99WaitUs = waits.percentileUs(0.99);
+    return stats;
+}
+
+void Scheduler::run(Lane& lane) {
+    std::unique_lock<std::mutex> guard(lane.lock);
+    while (true) {
+        lane.ready.wait(guard, [&] { return lane.stopping || !lane.queue.empty(); });
+        if (lane.queue.empty()) return;
+        std::unique_ptr<Context> context = std::move(lane.queue.front());
+        lane.queue.pop_front();
+        guard.unlock();
+
+        // The turn runs on the context's own stack, with the pool's view of the tasks it is in the middle of
+        Clock::time_point began = Clock::now();
+        bool failed = false;
+        TaskPool::swapThreadState(context->poolState);
+        try {
+            context->coroutine.resume();
+        } catch (const std::exception& error) {
+            // Errors the interpreter does not report itself, such as running out of memory for a stack
+            std::shared_ptr<Sinks> sinks = context->interpreter.getSinks();
+            std::lock_guard<std::mutex> report(sinks->lock);
+            sinks->errors(error.what());
+            failed = true;
+        }
+        TaskPool::swapThreadState(context->poolState);
+        Clock::time_point ended = Clock::now();
+
+        bool preempted = !context->coroutine.isDone() && !failed;
+        guard.lock();
+        lane.slices.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(ended - began).count()));
+        lane.waits.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(began - context->queuedAt).count()));
+        if (preempted) {
+            lane.preemptions++;
+            context->queuedAt = ended;
+            lane.queue.push_back(std::move(context));
+            continue;
+        }
+
+        // The interpreter is freed off the lock, then the program is reported finished
+        guard.unlock();
+        size_t id = context->id;
+        RunStatus status = failed ? RunStatus::RUNTIME_ERROR : context->status;
+        context.reset();
+        lane.load--;
+        finish(id, status);
+        guard.lock();
+    }
+}
+
+void Scheduler::finish(size_t id, RunStatus status) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        statuses[id] = status;
+        done[id] = true;
+        finished++;
+    }
+    changed.notify_all();
+}
@@ -0,0 +1,622 @@
+#include "ScriptCache.hpp"
+#include "Expr.hpp"
+#include "Parser.hpp"
+#include "Stmt.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#ifndef CPPLOX_VERSION
+#define CPPLOX_VERSION "unknown"
+#endif
+
+namespace {
+    // Start of every image, followed by the text of the strings, their lengths and then the tree
+    struct ImageHeader {
+        char magic[4]; // "LOXC"
+        uint32_t format; // ScriptCache::FORMAT, in host byte order so foreign images never match
+        uint64_t version; // Hash of the interpreter version the image was written by
+        uint64_t sourceHash; // Hash of the script text
+        uint64_t sourceLength; // Length of the script text
+        uint64_t stringsLength; // Bytes of string text after the header
+        uint64_t tableLength; // Bytes of encoded string lengths after the text
+        uint64_t treeLength; // Bytes of encoded tree after the lengths
+        uint64_t checksum; // Hash of everything after the header
+    };
+
+    constexpr char MAGIC[4] = {'L', 'O', 'X', 'C'};
+
+    // Tag starting each encoded node, NONE stands for a null node
+    enum class NodeTag : unsigned char {
+        NONE, BLOCK, EXPRESSION, FUNCTION, IF, PRINT, RETURN, VAR, WHILE,
+        ASSIGN, BINARY, CALL, GROUPING, LITERAL, LOGICAL, UNARY, VARIABLE
+    };
+
+    // Thrown when an image ends early or refers outside itself
+    struct DamagedImage {};
+
+    // Appends a variable length integer, 7 bits per byte with the high bit set on all but the last
+    void appendVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    /**
+     * Encodes a tree in pre-order. Each distinct string is stored once and
+     * referred to by number, and each line as the difference from the line
+     * before it. Counts, numbers and differences are variable length integers.
+     * Function bodies not parsed yet are stored as the range of the script
+     * text they are parsed from.
+     */
+    class ImageWriter : public ExprVisitor, public StmtVisitor {
+        std::string_view source; // Text of the script, which lazy function bodies are stored as ranges of
+        std::unordered_map<std::string_view, uint64_t> numbers; // Number of each string already stored
+        int line = 0; // Line of the last token written
+    public:
+        explicit ImageWriter(std::string_view source) : source(source) {}
+
+        std::string tree; // Encoded nodes
+        std::string strings; // Text of the strings the nodes refer to, one after the other
+        std::string table; // Number of strings and the length of each
+
+        void varint(uint64_t value) {
+            appendVarint(tree, value);
+        }
+
+        void tag(NodeTag tag) {
+            tree += static_cast<char>(tag);
+        }
+
+        void string(std::string_view text) {
+            auto found = numbers.find(text);
+            if (found == numbers.end()) {
+                found = numbers.emplace(text, numbers.size()).first;
+                strings.append(text);
+                appendVarint(table, text.size());
+            }
+            varint(found->second);
+        }
+
+        void token(const Token& token) {
+            tree += static_cast<char>(token.getType());
+            string(token.getLexeme());
+
+            // Zigzag encoded, so small steps back are small numbers too
+            int64_t step = static_cast<int64_t>(token.getLine()) - line;
+            varint(static_cast<uint64_t>(step * 2) ^ static_cast<uint64_t>(step >> 63));
+            line = token.getLine();
+        }
+
+        void finish() {
+            std::string count;
+            appendVarint(count, numbers.size());
+            table.insert(0, count);
+        }
+
+        void stmt(const std::shared_ptr<Stmt>& stmt) {
+            if (stmt == nullptr) return tag(NodeTag::NONE);
+            stmt->accept(*this);
+        }
+
+        void stmts(const std::vector<std::shared_ptr<Stmt>>& stmts) {
+            varint(stmts.size());
+            for (const std::shared_ptr<Stmt>& stmt : stmts) this->stmt(stmt);
+        }
+
+        void expr(const std::unique_ptr<Expr>& expr) {
+            if (expr == nullptr) return tag(NodeTag::NONE);
+            expr->accept(*this);
+        }
+
+        void visitBlock(const Block& stmt) override {
+            tag(NodeTag::BLOCK);
+            stmts(stmt.statements);
+        }
+
+        void visitExpression(const Expression& stmt) override {
+            tag(NodeTag::EXPRESSION);
+            expr(stmt.expression);
+        }
+
+        void visitFunction(const Function& stmt) override {
+            tag(NodeTag::FUNCTION);
+            token(stmt.name);
+            varint(stmt.params.size());
+            for (const Token& param : stmt.params) token(param);
+
+            // A lazy body views the script text, unless it was parsed from another one
+            FunctionBody& body = *stmt.body;
+            std::string_view text = body.getText();
+            if (body.isLazy() && text.data() >= source.data() && text.data() + text.size() <= source.data() + source.size()) {
+                tree += static_cast<char>(1);
+                varint(static_cast<uint64_t>(text.data() - source.data()));
+                varint(text.size());
+                varint(static_cast<uint64_t>(body.getLine()));
+            } else {
+                tree += static_cast<char>(0);
+                stmts(body.statements());
+            }
+        }
+
+        void visitIf(const If& stmt) override {
+            tag(NodeTag::IF);
+            expr(stmt.condition);
+            this->stmt(stmt.thenBranch);
+            this->stmt(stmt.elseBranch);
+        }
+
+        void visitPrint(const Print& stmt) override {
+            tag(NodeTag::PRINT);
+            expr(stmt.expression);
+        }
+
+        void visitReturn(const Return& stmt) override {
+            tag(NodeTag::RETURN);
+            token(stmt.keyword);
+            expr(stmt.value);
+        }
+
+        void visitVar(const Var& stmt) override {
+            tag(NodeTag::VAR);
+            token(stmt.name);
+            expr(stmt.initializer);
+        }
+
+        void visitWhile(const While& stmt) override {
+            tag(NodeTag::WHILE);
+            expr(stmt.condition);
+            this->stmt(stmt.body);
+        }
+
+        void visitAssign(const Assign& expr) override {
+            tag(NodeTag::ASSIGN);
+            token(expr.name);
+            this->expr(expr.value);
+        }
+
+        void visitBinary(const Binary& expr) override {
+            tag(NodeTag::BINARY);
+            this->expr(expr.left);
+            token(expr.op);
+            this->expr(expr.right);
+        }
+
+        void visitCall(const Call& expr) override {
+            tag(NodeTag::CALL);
+            this->expr(expr.callee);
+            token(expr.paren);
+            varint(expr.arguments.size());
+            for (const std::unique_ptr<Expr>& argument : expr.arguments) this->expr(argument);
+        }
+
+        void visitGrouping(const Grouping& expr) override {
+            tag(NodeTag::GROUPING);
+            this->expr(expr.expression);
+        }
+
+        void visitLiteral(const Literal& expr) override {
+            tag(NodeTag::LITERAL);
+            tree += static_cast<char>(expr.type);
+            if (expr.type == TokenType::NUMBER) {
+                double value = *std::static_pointer_cast<double>(expr.value);
+                tree.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            } else if (expr.type == TokenType::STRING) {
+                string(*std::static_pointer_cast<std::string>(expr.value));
+            }
+        }
+
+        void visitLogical(const Logical& expr) override {
+            tag(NodeTag::LOGICAL);
+            this->expr(expr.left);
+            token(expr.op);
+            this->expr(expr.right);
+        }
+
+        void visitUnary(const Unary& expr) override {
+            tag(NodeTag::UNARY);
+            token(expr.op);
+            this->expr(expr.right);
+        }
+
+        void visitVariable(const Variable& expr) override {
+            tag(NodeTag::VARIABLE);
+            token(expr.name);
+        }
+    };
+
+    /**
+     * Decodes a tree written by ImageWriter, checking every read against the
+     * end of its section and every string number against the table.
+     */
+    class ImageReader {
+        std::string_view source; // Text of the script, which lazy function bodies view
+        const char* position; // Next byte to decode
+        const char* end; // End of the section being decoded
+        std::vector<std::string_view> strings; // Strings by number, viewing the mapping
+        uint64_t line = 0; // Line of the last token read, wrapping rather than overflowing in damaged images
+    public:
+        ImageReader(std::string_view source, std::string_view text, std::string_view table)
+            : source(source), position(table.data()), end(table.data() + table.size()) {
+            // The table holds the length of each string, which follow each other in the text
+            uint64_t count = varint();
+            if (count > table.size()) throw DamagedImage();
+            strings.reserve(count);
+            size_t offset = 0;
+            for (uint64_t i = 0; i < count; i++) {
+                uint64_t length = varint();
+                if (length > text.size() - offset) throw DamagedImage();
+                strings.push_back(text.substr(offset, length));
+                offset += length;
+            }
+            if (!atEnd() || offset != text.size()) throw DamagedImage();
+        }
+
+        void decode(std::string_view tree) {
+            position = tree.data();
+            end = tree.data() + tree.size();
+        }
+
+        bool atEnd() const {
+            return position == end;
+        }
+
+        unsigned char byte() {
+            if (position == end) throw DamagedImage();
+            return static_cast<unsigned char>(*position++);
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                unsigned char next = byte();
+                value |= static_cast<uint64_t>(next & 0x7F) << shift;
+                if ((next & 0x80) == 0) return value;
+            }
+            throw DamagedImage();
+        }
+
+        NodeTag tag() {
+            unsigned char tag = byte();
+            if (tag > static_cast<unsigned char>(NodeTag::VARIABLE)) throw DamagedImage();
+            return static_cast<NodeTag>(tag);
+        }
+
+        TokenType type() {
+            unsigned char type = byte();
+            if (type >= TOKEN_TYPE_COUNT) throw DamagedImage();
+            return static_cast<TokenType>(type);
+        }
+
+        std::string_view string() {
+            uint64_t number = varint();
+            if (number >= strings.size()) throw DamagedImage();
+            return strings[number];
+        }
+
+        Token token() {
+            TokenType type = this->type();
+            std::string_view lexeme = string();
+            uint64_t step = varint();
+            line += (step >> 1) ^ (0 - (step & 1));
+            return Token(type, lexeme, static_cast<int>(static_cast<int32_t>(line)));
+        }
+
+        std::vector<std::shared_ptr<Stmt>> stmts() {
+            uint64_t count = varint();
+            if (count > static_cast<uint64_t>(end - position)) throw DamagedImage(); // Every node takes a byte
+            std::vector<std::shared_ptr<Stmt>> stmts;
+            stmts.reserve(count);
+            for (uint64_t i = 0; i < count; i++) stmts.emplace_back(stmt());
+            return stmts;
+        }
+
+        std::shared_ptr<Stmt> stmt() {
+            switch (tag()) {
+                case NodeTag::NONE:
+                    return nullptr;
+                case NodeTag::BLOCK:
+                    return std::make_shared<Block>(stmts());
+                case NodeTag::EXPRESSION:
+                    return std::make_shared<Expression>(expr());
+                case NodeTag::FUNCTION: {
+                    Token name = token();
+                    uint64_t count = varint();
+                    if (count > static_cast<uint64_t>(end - position)) throw DamagedImage();
+                    std::vector<Token> params;
+                    params.reserve(count);
+                    for (uint64_t i = 0; i < count; i++) params.push_back(token());
+                    if (byte() == 0) return std::make_shared<Function>(name, std::move(params), std::make_shared<FunctionBody>(stmts()));
+                    uint64_t offset = varint();
+                    uint64_t length = varint();
+                    uint64_t line = varint();
+                    if (offset > source.size() || length > source.size() - offset || line > INT32_MAX) throw DamagedImage();
+                    auto body = std::make_shared<FunctionBody>(source.substr(offset, length), static_cast<int>(line));
+                    return std::make_shared<Function>(name, std::move(params), std::move(body));
+                }
+                case NodeTag::IF: {
+                    std::unique_ptr<Expr> condition = expr();
+                    std::shared_ptr<Stmt> thenBranch = stmt();
+                    return std::make_shared<If>(std::move(condition), std::move(thenBranch), stmt());
+                }
+                case NodeTag::PRINT:
+                    return std::make_shared<Print>(expr());
+                case NodeTag::RETURN: {
+                    Token keyword = token();
+                    return std::make_shared<Return>(keyword, expr());
+                }
+                case NodeTag::VAR: {
+                    Token name = token();
+                    return std::make_shared<Var>(name, expr());
+                }
+                case NodeTag::WHILE: {
+                    std::unique_ptr<Expr> condition = expr();
+                    return std::make_shared<While>(std::move(condition), stmt());
+                }
+                default:
+                    throw DamagedImage(); // An expression where a statement belongs
+            }
+        }
+
+        std::unique_ptr<Expr> expr() {
+            NodeTag tag = this->tag();
+            switch (tag) {
+                case NodeTag::NONE:
+                    return nullptr;
+                case NodeTag::ASSIGN: {
+                    Token name = token();
+                    return std::make_unique<Assign>(name, expr());
+                }
+                case NodeTag::BINARY:
+                case NodeTag::LOGICAL: {
+                    std::unique_ptr<Expr> left = expr();
+                    Token op = token();
+                    if (tag == NodeTag::LOGICAL) return std::make_unique<Logical>(std::move(left), op, expr());
+                    return std::make_unique<Binary>(std::move(left), op, expr());
+                }
+                case NodeTag::CALL: {
+                    std::unique_ptr<Expr> callee = expr();
+                    Token paren = token();
+                    uint64_t count = varint();
+                    if (count > static_cast<uint64_t>(end - position)) throw DamagedImage();
+                    std::vector<std::unique_ptr<Expr>> arguments;
+                    arguments.reserve(count);
+                    for (uint64_t i = 0; i < count; i++) arguments.emplace_back(expr());
+                    return std::make_unique<Call>(std::move(callee), paren, std::move(arguments));
+                }
+                case NodeTag::GROUPING:
+                    return std::make_unique<Grouping>(expr());
+                case NodeTag::LITERAL: {
+                    TokenType type = this->type();
+                    if (type == TokenType::NUMBER) {
+                        double value;
+                        if (end - position < static_cast<ptrdiff_t>(sizeof(value))) throw DamagedImage();
+                        std::memcpy(&value, position, sizeof(value));
+                        position += sizeof(value);
+                        return std::make_unique<Literal>(type, std::make_shared<double>(value));
+                    }
+                    if (type == TokenType::STRING) {
+                        return std::make_unique<Literal>(type, std::make_shared<std::string>(string()));
+                    }
+                    return std::make_unique<Literal>(type, nullptr);
+                }
+                case NodeTag::UNARY: {
+                    Token op = token();
+                    return std::make_unique<Unary>(op, expr());
+                }
+                case NodeTag::VARIABLE:
+                    return std::make_unique<Variable>(token());
+                default:
+                    throw DamagedImage(); // A statement where an expression belongs
+            }
+        }
+    };
+
+    // Formats a hash as 16 hexadecimal digits
+    std::string hex(uint64_t value) {
+        static const char DIGITS[] = "0123456789abcdef";
+        std::string text(16, '0');
+        for (int i = 15; i >= 0; i--, value >>= 4) text[i] = DIGITS[value & 0xF];
+        return text;
+    }
+}
+
+ScriptCache::ScriptCache(std::string directory, uint64_t maxBytes) : directory(std::move(directory)), maxBytes(maxBytes) {
+    // Images with lazy function bodies are kept apart from fully parsed ones
+    std::string format = std::string(CPPLOX_VERSION) + "/" + std::to_string(FORMAT);
+    if (!Parser::getLazyFunctions()) format += "/eager";
+    version = hash(format);
+}
+
+std::string ScriptCache::defaultDirectory() {
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome != nullptr && cacheHome[0] != '\0') return std::string(cacheHome) + "/cpplox";
+    const char* home = std::getenv("HOME");
+    if (home != nullptr && home[0] != '\0') return std::string(home) + "/.cache/cpplox";
+    return "";
+}
+
+std::string ScriptCache::pathOf(uint64_t key) const {
+    return directory + "/" + hex(key) + ".loxc";
+}
+
+std::unique_ptr<Source> ScriptCache::load(std::string_view source, std::vector<std::shared_ptr<Stmt>>& statements) const {
+    uint64_t key = hash(source, version);
+    std::string path = pathOf(key);
+    std::unique_ptr<Source> image = Source::map(path);
+    if (!image) return nullptr;
+
+    // The image must be written by this version for exactly this text
+    std::string_view text = image->text();
+    ImageHeader header;
+    if (text.size() < sizeof(header)) return nullptr;
+    std::memcpy(&header, text.data(), sizeof(header));
+    std::string_view body = text.substr(sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.format != FORMAT || header.version != version
+        || header.sourceHash != key || header.sourceLength != source.size()
+        || header.stringsLength > body.size() || header.tableLength > body.size() - header.stringsLength
+        || header.treeLength != body.size() - header.stringsLength - header.tableLength
+        || header.checksum != hash(body)) {
+        return nullptr;
+    }
+
+    try {
+        ImageReader reader(source, body.substr(0, header.stringsLength), body.substr(header.stringsLength, header.tableLength));
+        reader.decode(body.substr(header.stringsLength + header.tableLength));
+        statements = reader.stmts();
+        if (!reader.atEnd()) throw DamagedImage();
+    } catch (const DamagedImage&) {
+        statements.clear();
+        return nullptr;
+    }
+
+    // Marks the image as recently used, so eviction takes others first
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return image;
+}
+
+void ScriptCache::store(std::string_view source, const std::vector<std::shared_ptr<Stmt>>& statements) const {
+    ImageWriter writer(source);
+    writer.stmts(statements);
+    writer.finish();
+
+    ImageHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = FORMAT;
+    header.version = version;
+    header.sourceHash = hash(source, version);
+    header.sourceLength = source.size();
+    header.stringsLength = writer.strings.size();
+    header.tableLength = writer.table.size();
+    header.treeLength = writer.tree.size();
+    std::string body = std::move(writer.strings);
+    body += writer.table;
+    body += writer.tree;
+    header.checksum = hash(body);
+
+    // Concurrent runs each write their own temporary file, the last rename wins
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = pathOf(header.sourceHash);
+    std::string temporary = path + "." + hex(std::random_device()()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(body.data(), body.size());
+        if (!file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return;
+    }
+    evict();
+}
+
+void ScriptCache::evict() const {
+    struct Image {
+        std::filesystem::file_time_type used; // Last modification, set when the image is loaded
+        uint64_t size; // Bytes of the image
+        std::filesystem::path path; // Path of the image
+    };
+    std::vector<Image> images;
+    uint64_t total = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() != ".loxc") continue;
+        std::error_code entryError;
+        uint64_t size = entry.file_size(entryError);
+        std::filesystem::file_time_type used = entry.last_write_time(entryError);
+        if (entryError) continue; // Removed by another run meanwhile
+        images.push_back(Image{used, size, entry.path()});
+        total += size;
+    }
+    if (total <= maxBytes) return;
+
+    // Least recently used first; another run removing the same image at the same time is harmless
+    std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.used < b.used; });
+    for (const Image& image : images) {
+        if (total <= maxBytes) break;
+        std::filesystem::remove(image.path, error);
+        total -= image.size;
+    }
+}
+
+namespace {
+    constexpr uint64_t PRIME1 = 11400714785074694791ULL;
+    constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+    constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+    constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+    constexpr uint64_t PRIME5 = 2870177450012600261ULL;
+
+    inline uint64_t rotate(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    inline uint64_t read64(const char* data) {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t read32(const char* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t round(uint64_t accumulator, uint64_t input) {
+        return rotate(accumulator + input * PRIME2, 31) * PRIME1;
+    }
+
+    inline uint64_t merge(uint64_t hash, uint64_t accumulator) {
+        return (hash ^ round(0, accumulator)) * PRIME1 + PRIME4;
+    }
+}
+
+uint64_t ScriptCache::hash(std::string_view data, uint64_t seed) {
+    const char* position = data.data();
+    const char* end = position + data.size();
+    uint64_t hash;
+
+    // Four independent lanes over 32 byte stripes
+    if (data.size() >= 32) {
+        uint64_t lanes[4] = {seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1};
+        for (; end - position >= 32; position += 32) {
+            for (int lane = 0; lane < 4; lane++) lanes[lane] = round(lanes[lane], read64(position + 8 * lane));
+        }
+        hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+        for (uint64_t lane : lanes) hash = merge(hash, lane);
+    } else {
+        hash = seed + PRIME5;
+    }
+    hash += data.size();
+
+    // The tail, 8, 4 and 1 bytes at a time
+    for (; end - position >= 8; position += 8) hash = rotate(hash ^ round(0, read64(position)), 27) * PRIME1 + PRIME4;
+    if (end - position >= 4) {
+        hash = rotate(hash ^ (read32(position) * PRIME1), 23) * PRIME2 + PRIME3;
+        position += 4;
+    }
+    for (; position < end; position++) hash = rotate(hash ^ (static_cast<unsigned char>(*position) * PRIME5), 11) * PRIME1;
+
+    // Mix the last bits into every bit
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,280 @@
+#include "Server.hpp"
+#include "Source.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    constexpr uint32_t MAX_FRAME = 1u << 30; // Largest payload accepted, so a corrupt length cannot exhaust memory
+
+    // Writes the whole buffer, without raising SIGPIPE if the other side is gone
+    bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* data, size_t size) {
+        while (size > 0) {
+            ssize_t received = ::recv(fd, data, size, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            data += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    // The header and payload go out in one write, so frames written by different threads never interleave
+    bool writeFrame(int fd, char type, std::string_view payload) {
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        std::string frame(1 + sizeof(length) + payload.size(), '\0');
+        frame[0] = type;
+        std::memcpy(&frame[1], &length, sizeof(length));
+        std::memcpy(&frame[1 + sizeof(length)], payload.data(), payload.size());
+        return writeAll(fd, frame.data(), frame.size());
+    }
+
+    bool readFrame(int fd, char& type, std::string& payload) {
+        char header[1 + sizeof(uint32_t)];
+        if (!readAll(fd, header, sizeof(header))) return false;
+        type = header[0];
+        uint32_t length;
+        std::memcpy(&length, header + 1, sizeof(length));
+        if (length > MAX_FRAME) return false;
+        payload.resize(length);
+        return readAll(fd, payload.data(), length);
+    }
+
+    // Fills the address of a socket path, false if it is too long
+    bool socketAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+}
+
+Server::Server(std::string socketPath, unsigned jobs, const HeapConfig& config)
+    : socketPath(std::move(socketPath)), jobs(jobs == 0 ? std::max(1u, std::thread::hardware_concurrency()) : jobs), vm(config) {}
+
+Server::~Server() {
+    if (!workers.empty()) {
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+        }
+        queued.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+    }
+}
+
+bool Server::listen(std::string& error) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        error = "Socket path " + socketPath + " is too long.";
+        return false;
+    }
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        error = std::string("Could not create socket: ") + std::strerror(errno);
+        return false;
+    }
+
+    // A socket file left by a server that did not shut down cleanly is replaced
+    ::unlink(socketPath.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listener, SOMAXCONN) < 0) {
+        error = "Could not listen on " + socketPath + ": " + std::strerror(errno);
+        ::close(listener);
+        listener = -1;
+        return false;
+    }
+    for (unsigned i = 0; i < jobs; i++) workers.emplace_back(&Server::work, this);
+    return true;
+}
+
+void Server::serve() {
+    while (!stopping) {
+        int connection = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0) continue; // Interrupted, out of descriptors for a moment, or shut down by stop
+
+        // A client that never finishes its request, or never reads the reply, only holds a worker for a while
+        timeval timeout{timeoutSeconds, 0};
+        ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            connections.push_back(connection);
+        }
+        queued.notify_one();
+    }
+
+    // The workers finish the connections already accepted
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+    }
+    queued.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+}
+
+void Server::stop() {
+    // Only an atomic store and a system call, both allowed in a signal handler; shutdown wakes the blocked accept
+    stopping = true;
+    if (listener >= 0) ::shutdown(listener, SHUT_RDWR);
+}
+
+void Server::setRequestTimeout(long seconds) {
+    timeoutSeconds = std::max(1L, seconds);
+}
+
+Server::Stats Server::getStats() const {
+    std::lock_guard<std::mutex> lock(cacheLock);
+    return stats;
+}
+
+void Server::work() {
+    while (true) {
+        int connection;
+        {
+            std::unique_lock<std::mutex> lock(queueLock);
+            queued.wait(lock, [&] { return !connections.empty() || stopping; });
+            if (connections.empty()) return;
+            connection = connections.front();
+            connections.pop_front();
+        }
+        handle(connection);
+        ::close(connection);
+    }
+}
+
+void Server::handle(int connection) {
+    // Reads the request up to its run frame
+    ServeRequest request;
+    char type;
+    std::string payload;
+    while (true) {
+        if (!readFrame(connection, type, payload)) return;
+        if (type == 'R') break;
+        if (type == 'P') request.path = std::move(payload);
+        else if (type == 'S') request.source = std::move(payload);
+        else if (type == 'A') request.arguments.push_back(std::move(payload));
+    }
+
+    // A path is read on every request, the cache is keyed by its text
+    int status = 1;
+    bool readable = true;
+    bool connected = true; // Cleared once a write fails or times out, so a client that stopped reading costs one timeout
+    if (!request.path.empty()) {
+        std::unique_ptr<Source> file = Source::map(request.path);
+        readable = file != nullptr;
+        if (readable) request.source = std::string(file->text());
+        else connected = writeFrame(connection, 'E', "Could not open file " + request.path + "\n");
+    }
+    if (readable) {
+        std::shared_ptr<const Program> program = compile(std::move(request.source));
+
+        // Tasks spawned by the script may print from other threads
+        std::mutex writeLock;
+        auto sink = [&](char frame) {
+            return [&, frame](std::string_view text) {
+                std::lock_guard<std::mutex> lock(writeLock);
+                if (connected) connected = writeFrame(connection, frame, std::string(text) + "\n");
+            };
+        };
+        std::unique_ptr<Isolate> isolate = vm.createIsolate();
+        isolate->setOutput(sink('O'));
+        isolate->setErrors(sink('E'));
+        isolate->setArguments(request.arguments);
+        switch (isolate->run(program)) {
+            case RunStatus::OK: status = 0; break;
+            case RunStatus::COMPILE_ERROR: status = 65; break;
+            case RunStatus::RUNTIME_ERROR: status = 70; break;
+        }
+        // Waits for the script's tasks before the status is sent
+        isolate.reset();
+    }
+
+    // Counted before the status is sent, so a client that got it sees the request counted
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        stats.requests++;
+    }
+    int32_t exitStatus = status;
+    if (connected) writeFrame(connection, 'X', std::string_view(reinterpret_cast<const char*>(&exitStatus), sizeof(exitStatus)));
+}
+
+std::shared_ptr<const Program> Server::compile(std::string source) {
+    size_t hash = std::hash<std::string>()(source);
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        auto found = cacheIndex.find(hash);
+        if (found != cacheIndex.end() && found->second->second->getSource() == source) {
+            cache.splice(cache.begin(), cache, found->second);
+            stats.cacheHits++;
+            return cache.front().second;
+        }
+    }
+
+    // Compiled outside the lock, so other requests are not held up; two compiling the same text both succeed
+    std::shared_ptr<const Program> program = vm.compile(std::move(source));
+    std::lock_guard<std::mutex> lock(cacheLock);
+    stats.cacheMisses++;
+    auto found = cacheIndex.find(hash);
+    if (found != cacheIndex.end()) cache.erase(found->second);
+    cache.emplace_front(hash, program);
+    cacheIndex[hash] = cache.begin();
+    if (cache.size() > CACHE_PROGRAMS) {
+        cacheIndex.erase(cache.back().first);
+        cache.pop_back();
+    }
+    return program;
+}
+
+int Server::request(const std::string& socketPath, const ServeRequest& request, Sink output, Sink errors) {
+    sockaddr_un address;
+    int connection = -1;
+    if (socketAddress(socketPath, address)) connection = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0 || ::connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        errors("Could not connect to " + socketPath + "\n");
+        if (connection >= 0) ::close(connection);
+        return 1;
+    }
+
+    bool sent = request.path.empty() ? writeFrame(connection, 'S', request.source) : writeFrame(connection, 'P', request.path);
+    for (const std::string& argument : request.arguments) sent = sent && writeFrame(connection, 'A', argument);
+    sent = sent && writeFrame(connection, 'R', "");
+
+    // Passes the output and errors on as they arrive, until the exit status
+    char type;
+    std::string payload;
+    while (sent && readFrame(connection, type, payload)) {
+        if (type == 'O') {
+            output(payload);
+        } else if (type == 'E') {
+            errors(payload);
+        } else if (type == 'X' && payload.size() == sizeof(int32_t)) {
+            int32_t status;
+            std::memcpy(&status, payload.data(), sizeof(status));
+            ::close(connection);
+            return status;
+        }
+    }
+    errors("Lost the connection to " + socketPath + "\n");
+    ::close(connection);
+    return 1;
+}
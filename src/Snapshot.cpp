@@ -0,0 +1,150 @@
+#include "Snapshot.hpp"
+#include "Environment.hpp"
+#include "LoxFunction.hpp"
+#include "LoxString.hpp"
+#include "NativeError.hpp"
+#include <unordered_map>
+#include <unordered_set>
+
+Snapshot Snapshot::capture(const Value& value, Heap& heap) {
+    return capture(std::vector<Value>{value}, heap);
+}
+
+Snapshot Snapshot::capture(const std::vector<Value>& values, Heap& heap) {
+    Snapshot snapshot;
+    std::vector<LoxObject*> originals; // Original of each copied object
+    std::unordered_map<LoxObject*, uint32_t> copies; // Index of the copy of each original
+    std::unordered_map<uint32_t, std::unordered_set<std::string>> looked; // Names already looked up in each copied environment
+
+    // Objects get their index when first found and are copied in that order, so deep graphs need no recursion
+    auto find = [&](LoxObject* object) {
+        auto found = copies.find(object);
+        if (found != copies.end()) return found->second;
+        uint32_t index = static_cast<uint32_t>(snapshot.objects.size());
+        snapshot.objects.emplace_back();
+        snapshot.objects.back().kind = object->kind;
+        originals.push_back(object);
+        copies.emplace(object, index);
+        return index;
+    };
+    auto slot = [&](const Value& value) {
+        Slot slot;
+        slot.type = value.type;
+        if (value.type == TokenType::NUMBER) slot.number = value.number;
+        if (value.isObject()) slot.object = find(value.object);
+        return slot;
+    };
+
+    // A name is copied from the scope it resolves to, the first along the chain defining it
+    std::vector<std::pair<uint32_t, std::string>> lookups;
+    auto resolve = [&](uint32_t index, const std::string& name) {
+        while (looked[index].insert(name).second) {
+            Environment* environment = static_cast<Environment*>(originals[index]);
+            auto found = environment->getValues().find(name);
+            if (found != environment->getValues().end()) {
+                Slot copied = slot(found->second);
+                snapshot.objects[index].variables.emplace_back(name, copied);
+                return;
+            }
+            if (environment->enclosing == nullptr) return;
+            index = find(environment->enclosing);
+        }
+    };
+
+    for (const Value& value : values) {
+        snapshot.roots.push_back(slot(value));
+    }
+    size_t i = 0;
+    while (i < originals.size() || !lookups.empty()) {
+        if (i == originals.size()) {
+            // Every object found so far is copied, resolving a name may find more
+            std::pair<uint32_t, std::string> lookup = std::move(lookups.back());
+            lookups.pop_back();
+            resolve(lookup.first, lookup.second);
+            continue;
+        }
+        LoxObject* original = originals[i];
+        switch (original->kind) {
+            case ObjectKind::STRING:
+                snapshot.objects[i].text = static_cast<LoxString*>(original)->str(heap);
+                break;
+            case ObjectKind::FUNCTION: {
+                LoxFunction* function = static_cast<LoxFunction*>(original);
+                snapshot.objects[i].declaration = std::make_shared<Function>(function->getDeclaration());
+                uint32_t closure = find(function->getClosure());
+                snapshot.objects[i].link = closure;
+                for (const std::string& name : function->getDeclaration().body->referencedNames()) lookups.emplace_back(closure, name);
+                break;
+            }
+            case ObjectKind::ENVIRONMENT: {
+                // Only the chain is copied here, the variables as the functions closing over it name them
+                Environment* environment = static_cast<Environment*>(original);
+                uint32_t enclosing = environment->enclosing == nullptr ? NONE : find(environment->enclosing);
+                snapshot.objects[i].link = enclosing;
+                break;
+            }
+            default: {
+                LoxCallable* native = static_cast<LoxCallable*>(original);
+                snapshot.objects[i].copy = native->copier();
+                if (!snapshot.objects[i].copy) throw NativeError("Cannot copy " + native->toString() + " to another thread.");
+                break;
+            }
+        }
+        i++;
+    }
+    return snapshot;
+}
+
+Value Snapshot::restore(Heap& heap) const {
+    if (roots.empty()) return Value();
+    return restoreAll(heap)[0];
+}
+
+std::vector<Value> Snapshot::restoreAll(Heap& heap) const {
+    // Environments come first, functions are constructed with their closure
+    std::vector<LoxObject*> restored(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (objects[i].kind == ObjectKind::ENVIRONMENT) restored[i] = heap.allocate<Environment>(heap);
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+        const Object& object = objects[i];
+        switch (object.kind) {
+            case ObjectKind::STRING:
+                restored[i] = heap.allocate<LoxString>(object.text);
+                break;
+            case ObjectKind::FUNCTION:
+                restored[i] = heap.allocate<LoxFunction>(std::make_unique<Function>(*object.declaration),
+                                                         static_cast<Environment*>(restored[object.link]));
+                break;
+            case ObjectKind::ENVIRONMENT:
+                break;
+            default:
+                restored[i] = object.copy(heap);
+                break;
+        }
+    }
+
+    // Then every object exists and the variables can point to any of them
+    auto value = [&](const Slot& slot) {
+        if (slot.object != NONE) return Value::objectValue(slot.type, restored[slot.object]);
+        if (slot.type == TokenType::NUMBER) return Value::numberValue(slot.number);
+        Value value;
+        value.type = slot.type;
+        return value;
+    };
+    for (size_t i = 0; i < objects.size(); i++) {
+        const Object& object = objects[i];
+        if (object.kind != ObjectKind::ENVIRONMENT) continue;
+        Environment* environment = static_cast<Environment*>(restored[i]);
+        if (object.link != NONE) environment->enclosing = static_cast<Environment*>(restored[object.link]);
+        for (const auto& [name, slot] : object.variables) {
+            environment->define(name, value(slot));
+        }
+    }
+    std::vector<Value> values;
+    values.reserve(roots.size());
+    for (const Slot& root : roots) {
+        values.push_back(value(root));
+    }
+    return values;
+}
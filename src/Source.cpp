@@ -0,0 +1,55 @@
+#include "Source.hpp"
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CPPLOX_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Source::Source(std::string text)
+    : owned(std::move(text)), data(owned.data()), length(owned.size()) {}
+
+Source::~Source() {
+#ifdef CPPLOX_HAS_MMAP
+    if (mapping != nullptr) munmap(mapping, length);
+#endif
+}
+
+std::unique_ptr<Source> Source::map(const std::string& path) {
+#ifdef CPPLOX_HAS_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        // Pipes and devices cannot be mapped, read them instead
+        close(fd);
+    } else if (info.st_size == 0) {
+        // Empty files cannot be mapped either
+        close(fd);
+        return std::make_unique<Source>(std::string());
+    } else {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps the file alive
+        if (mapping != MAP_FAILED) {
+            // The scanner reads the file front to back once
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            std::unique_ptr<Source> source = std::make_unique<Source>(std::string());
+            source->mapping = mapping;
+            source->data = static_cast<const char*>(mapping);
+            source->length = info.st_size;
+            return source;
+        }
+    }
+#endif
+
+    // Read the whole file into memory
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return nullptr;
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return std::make_unique<Source>(std::move(text));
+}
@@ -0,0 +1,201 @@
+#include "TaskPool.hpp"
+
+thread_local TaskPool* TaskPool::currentPool = nullptr;
+thread_local TaskPool::Worker* TaskPool::currentWorker = nullptr;
+thread_local int TaskPool::helpDepth = 0;
+thread_local TaskPool::Task* TaskPool::currentTask = nullptr;
+
+namespace {
+std::mutex sharedLock; // Guards the shared pool and its size
+std::unique_ptr<TaskPool> sharedPool; // Started on first use, finished at exit
+unsigned sharedThreads = 0; // Workers of the shared pool, 0 for one per core
+}
+
+TaskPool::TaskPool(unsigned threads) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++) workers.push_back(std::make_unique<Worker>());
+
+    // The deques all exist before any worker may steal from them
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        Worker* self = worker.get();
+        worker->thread = std::thread([this, self] { workerLoop(self); });
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (const std::unique_ptr<Worker>& worker : workers) worker->thread.join();
+
+    // Tasks still running on spares may block and start more of them
+    while (true) {
+        std::vector<std::thread> started;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            started.swap(spares);
+        }
+        if (started.empty()) break;
+        for (std::thread& spare : started) spare.join();
+    }
+}
+
+TaskPool::Blocking::Blocking(TaskPool& pool) : pool(pool) {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.blocked++;
+    if (pool.blocked > pool.spares.size()) pool.spares.emplace_back([&pool] { pool.workerLoop(nullptr); });
+}
+
+TaskPool::Blocking::~Blocking() {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.blocked--;
+}
+
+TaskPool& TaskPool::shared() {
+    std::lock_guard<std::mutex> lock(sharedLock);
+    if (!sharedPool) {
+        unsigned threads = sharedThreads == 0 ? std::thread::hardware_concurrency() : sharedThreads;
+        sharedPool = std::make_unique<TaskPool>(threads);
+    }
+    return *sharedPool;
+}
+
+void TaskPool::configure(unsigned threads) {
+    std::lock_guard<std::mutex> lock(sharedLock);
+    sharedThreads = threads;
+    sharedPool.reset();
+}
+
+void TaskPool::swapThreadState(ThreadState& state) {
+    std::swap(currentTask, state.task);
+    std::swap(helpDepth, state.helpDepth);
+}
+
+void TaskPool::submit(std::shared_ptr<Task> task) {
+    // Workers keep their own tasks, other threads deal theirs out in turn
+    Worker* worker = currentPool == this && currentWorker != nullptr ? currentWorker : workers[nextWorker++ % workers.size()].get();
+    if (currentTask != nullptr) task->parent = currentTask->shared_from_this();
+    queued++;
+    changes++;
+    {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        worker->tasks.push_back(std::move(task));
+    }
+    notify();
+}
+
+void TaskPool::wait(Task& task) {
+    // A task nobody started runs on the waiting thread, as a plain call would
+    if (tryRun(task)) return;
+
+    while (!task.isDone()) {
+        // Help with the tasks the awaited one spawned while it runs elsewhere
+        uint64_t seen = changes;
+        if (helpDepth < MAX_HELP_DEPTH) {
+            helpDepth++;
+            bool ran = runOne(&task);
+            helpDepth--;
+            if (ran) continue;
+        }
+
+        // Nothing to help with, sleep until a task finishes or is queued
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepers++;
+        changed.wait(lock, [&] { return task.isDone() || (helpDepth < MAX_HELP_DEPTH && changes != seen); });
+        sleepers--;
+    }
+}
+
+bool TaskPool::tryRun(Task& task) {
+    int expected = Task::QUEUED;
+    if (!task.state.compare_exchange_strong(expected, Task::RUNNING)) return false;
+    Task* outer = currentTask;
+    currentTask = &task;
+    task.work();
+    task.work = nullptr;
+    currentTask = outer;
+    task.state = Task::DONE;
+    changes++;
+    notify();
+    return true;
+}
+
+bool TaskPool::runOne(const Task* awaited) {
+    // Tasks a waiter may run, searched from the given end of a deque
+    auto take = [awaited](std::deque<std::shared_ptr<Task>>& tasks, bool newest) {
+        std::shared_ptr<Task> task;
+        if (tasks.empty()) return task;
+        if (awaited == nullptr) {
+            task = std::move(newest ? tasks.back() : tasks.front());
+            newest ? tasks.pop_back() : tasks.pop_front();
+            return task;
+        }
+        for (size_t i = 0; i < tasks.size(); i++) {
+            size_t index = newest ? tasks.size() - 1 - i : i;
+            if (tasks[index]->descendsFrom(*awaited)) {
+                task = std::move(tasks[index]);
+                tasks.erase(tasks.begin() + index);
+                break;
+            }
+        }
+        return task;
+    };
+
+    // Newest task of the own deque first
+    if (currentPool == this && currentWorker != nullptr) {
+        while (true) {
+            std::shared_ptr<Task> task;
+            {
+                std::lock_guard<std::mutex> lock(currentWorker->lock);
+                task = take(currentWorker->tasks, true);
+            }
+            if (!task) break;
+            queued--;
+            // Tasks a waiter already ran are left behind in the deque and skipped here
+            if (tryRun(*task)) return true;
+        }
+    }
+
+    // Then the oldest task of another worker, starting from a different one on each thread
+    size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (size_t i = 0; i < workers.size(); i++) {
+        Worker* victim = workers[(start + i) % workers.size()].get();
+        while (true) {
+            std::shared_ptr<Task> task;
+            {
+                std::lock_guard<std::mutex> lock(victim->lock);
+                task = take(victim->tasks, false);
+            }
+            if (!task) break;
+            queued--;
+            if (tryRun(*task)) return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::notify() {
+    // Sleepers register before checking for work, so either they see the change or it sees them
+    if (sleepers == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    // Waiters deep in nested tasks ignore new tasks, so waking one thread could wake the wrong one
+    changed.notify_all();
+}
+
+void TaskPool::workerLoop(Worker* self) {
+    currentPool = this;
+    currentWorker = self;
+    while (true) {
+        if (runOne()) continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping && queued == 0) return;
+        sleepers++;
+        changed.wait(lock, [&] { return stopping || queued > 0; });
+        sleepers--;
+    }
+}
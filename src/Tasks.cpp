@@ -0,0 +1,52 @@
+#include "Tasks.hpp"
+#include "NativeError.hpp"
+#include "RuntimeError.hpp"
+
+Value LoxFuture::join(Interpreter& interpreter) {
+    TaskPool::shared().wait(*state->task);
+    if (state->failed) {
+        // Errors with a line are reported there, others at the join
+        if (state->token) throw RuntimeError(*state->token, state->error);
+        throw NativeError(state->error);
+    }
+    return state->result.restore(interpreter.getHeap());
+}
+
+Value Spawn::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& function = arguments[0];
+    if (function.type != TokenType::FUN || static_cast<LoxCallable*>(function.object)->arity() != 0) {
+        throw NativeError("Can only spawn functions taking no arguments.");
+    }
+
+    // Everything the function reaches is copied now, on the spawning thread
+    auto state = std::make_shared<LoxFuture::State>();
+    Snapshot snapshot = Snapshot::capture(function, interpreter.getHeap());
+    HeapConfig config = interpreter.getHeap().getConfig();
+    std::shared_ptr<Sinks> sinks = interpreter.getSinks();
+
+    // The task holds the state until it has run, the state holds the task for joiners
+    state->task = std::make_shared<TaskPool::Task>([state, snapshot = std::move(snapshot), config, sinks] {
+        try {
+            Interpreter task(config, sinks);
+            Value result = task.call(snapshot.restore(task.getHeap()), {});
+            state->result = Snapshot::capture(result, task.getHeap());
+        } catch (const RuntimeError& error) {
+            state->failed = true;
+            state->error = error.what();
+            state->token.emplace(error.token);
+        } catch (const std::exception& error) {
+            state->failed = true;
+            state->error = error.what();
+        }
+    });
+    interpreter.track(state->task);
+    TaskPool::shared().submit(state->task);
+    return Value::objectValue(TokenType::FUN, interpreter.getHeap().allocate<LoxFuture>(state));
+}
+
+Value Join::call(Interpreter& interpreter, const std::vector<Value>& arguments) {
+    const Value& handle = arguments[0];
+    LoxFuture* future = handle.type == TokenType::FUN ? dynamic_cast<LoxFuture*>(static_cast<LoxCallable*>(handle.object)) : nullptr;
+    if (future == nullptr) throw NativeError("Can only join futures.");
+    return future->join(interpreter);
+}
@@ -0,0 +1,64 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+void ThreadPool::forEach(size_t count, const std::function<void(size_t)>& task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        next = 0;
+        busy = workers.size();
+        failure = nullptr;
+        batch++;
+    }
+    wake.notify_all();
+    work();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+    this->task = nullptr;
+    if (failure) std::rethrow_exception(failure);
+}
+
+void ThreadPool::work() {
+    for (size_t index = next++; index < count; index = next++) {
+        try {
+            (*task)(index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure) failure = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || batch != seen; });
+            if (stopping) return;
+            seen = batch;
+        }
+        work();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+        }
+        finished.notify_one();
+    }
+}
@@ -2,17 +2,10 @@
 #include "TokenInfo.hpp"
 
 std::string Token::toString() const {
-    std::string result = "Type: " + TOKENINFO_HPP::getTypeString(type) + ", Literal: ";
-    if (literal == nullptr) {
-        result += "null";
-    } else {
-        result += *static_cast<std::string*>(literal.get());
-    };
-    result += '\n';
-    return result;
+    return "Type: " + getTypeString(type) + ", Lexeme: " + std::string(lexeme) + '\n';
 }
 
-std::string Token::getLexeme() const {
+std::string_view Token::getLexeme() const {
     return lexeme;
 }
 
@@ -20,10 +13,6 @@ TokenType Token::getType() const {
     return type;
 }
 
-std::shared_ptr<void> Token::getLiteral() const {
-    return literal;
-}
-
 int Token::getLine() const {
     return line;
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "TokenBuffer.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+void TokenBuffer::addNumber(uint32_t offset, uint32_t length, double value) {
+    numberTokens.push_back(size());
+    numbers.push_back(value);
+    add(TokenType::NUMBER, offset, length);
+}
+
+void TokenBuffer::truncate(uint32_t tokenCount, size_t newlineCount) {
+    types.resize(tokenCount);
+    offsets.resize(tokenCount);
+    lengths.resize(tokenCount);
+    while (!numberTokens.empty() && numberTokens.back() >= tokenCount) {
+        numberTokens.pop_back();
+        numbers.pop_back();
+    }
+    newlines.resize(newlineCount);
+}
+
+TokenBuffer TokenBuffer::join(std::string_view source, const std::vector<Slice>& slices, ThreadPool& pool) {
+    // Find where each slice starts in its buffer and in the joined one
+    size_t count = slices.size();
+    std::vector<size_t> firstNumber(count), firstNewline(count), lastNewline(count);
+    std::vector<size_t> tokenAt(count + 1), numberAt(count + 1), newlineAt(count + 1);
+    for (size_t i = 0; i < count; i++) {
+        const Slice& slice = slices[i];
+        const TokenBuffer& part = *slice.buffer;
+        firstNumber[i] = std::lower_bound(part.numberTokens.begin(), part.numberTokens.end(), slice.first) - part.numberTokens.begin();
+        firstNewline[i] = std::lower_bound(part.newlines.begin(), part.newlines.end(), slice.newlinesFrom) - part.newlines.begin();
+        lastNewline[i] = std::lower_bound(part.newlines.begin() + firstNewline[i], part.newlines.end(), slice.newlinesTo) - part.newlines.begin();
+        tokenAt[i + 1] = tokenAt[i] + part.size() - slice.first;
+        numberAt[i + 1] = numberAt[i] + part.numbers.size() - firstNumber[i];
+        newlineAt[i + 1] = newlineAt[i] + lastNewline[i] - firstNewline[i];
+    }
+
+    TokenBuffer joined(source);
+    joined.types.resize(tokenAt[count]);
+    joined.offsets.resize(tokenAt[count]);
+    joined.lengths.resize(tokenAt[count]);
+    joined.numberTokens.resize(numberAt[count]);
+    joined.numbers.resize(numberAt[count]);
+    joined.newlines.resize(newlineAt[count]);
+
+    pool.forEach(count, [&](size_t i) {
+        const Slice& slice = slices[i];
+        const TokenBuffer& part = *slice.buffer;
+        std::copy(part.types.begin() + slice.first, part.types.end(), joined.types.begin() + tokenAt[i]);
+        std::copy(part.offsets.begin() + slice.first, part.offsets.end(), joined.offsets.begin() + tokenAt[i]);
+        std::copy(part.lengths.begin() + slice.first, part.lengths.end(), joined.lengths.begin() + tokenAt[i]);
+        std::copy(part.numbers.begin() + firstNumber[i], part.numbers.end(), joined.numbers.begin() + numberAt[i]);
+        std::copy(part.newlines.begin() + firstNewline[i], part.newlines.begin() + lastNewline[i], joined.newlines.begin() + newlineAt[i]);
+
+        // Number tokens are renumbered to their index in the joined buffer
+        for (size_t j = firstNumber[i]; j < part.numberTokens.size(); j++) {
+            joined.numberTokens[numberAt[i] + j - firstNumber[i]] = static_cast<uint32_t>(part.numberTokens[j] - slice.first + tokenAt[i]);
+        }
+    });
+    return joined;
+}
+
+double TokenBuffer::number(uint32_t index) const {
+    // Number tokens are appended in order, so the side table is sorted by token index
+    auto found = std::lower_bound(numberTokens.begin(), numberTokens.end(), index);
+    return numbers[found - numberTokens.begin()];
+}
+
+int TokenBuffer::lineAt(uint32_t offset) const {
+    // The line is the first line plus the number of newlines before the offset
+    return firstLine + static_cast<int>(newlinesBefore(offset));
+}
+
+size_t TokenBuffer::newlinesBefore(uint32_t offset) const {
+    return std::lower_bound(newlines.begin(), newlines.end(), offset) - newlines.begin();
+}
+
+int TokenBuffer::lineFrom(uint32_t offset, size_t& cursor) const {
+    // Search again if the offset is before the cursor
+    if (cursor > newlines.size() || (cursor > 0 && newlines[cursor - 1] >= offset)) {
+        cursor = newlinesBefore(offset);
+    }
+    while (cursor < newlines.size() && newlines[cursor] < offset) cursor++;
+    return firstLine + static_cast<int>(cursor);
+}
+
+size_t TokenBuffer::memoryUsage() const {
+    return types.capacity() * sizeof(TokenType)
+        + offsets.capacity() * sizeof(uint32_t)
+        + lengths.capacity() * sizeof(uint32_t)
+        + numberTokens.capacity() * sizeof(uint32_t)
+        + numbers.capacity() * sizeof(double)
+        + newlines.capacity() * sizeof(uint32_t);
+}
@@ -1,17 +1,172 @@
 #include "Lox.hpp"
+#include "Server.hpp"
+#include <cctype>
+#include <csignal>
+#include <filesystem>
+
+// Parses a byte count with an optional K, M or G suffix, returns 0 if malformed
+static size_t parseSize(const std::string& text) {
+    size_t end = 0;
+    unsigned long long value = 0;
+    try {
+        value = std::stoull(text, &end);
+    } catch (const std::exception&) {
+        return 0;
+    }
+
+    std::string suffix = text.substr(end);
+    if (suffix.empty()) return value;
+    if (suffix.size() != 1) return 0;
+    switch (std::toupper(static_cast<unsigned char>(suffix[0]))) {
+        case 'K': return value * 1024;
+        case 'M': return value * 1024 * 1024;
+        case 'G': return value * 1024 * 1024 * 1024;
+        default: return 0;
+    }
+}
+
+// Checks if an argument is the given option and stores its value after the '='
+static bool matchOption(const std::string& argument, const std::string& option, std::string& value) {
+    if (argument.compare(0, option.size() + 1, option + "=") != 0) return false;
+    value = argument.substr(option.size() + 1);
+    return true;
+}
+
+// Checks if an argument is the given option, taking its value after the '=' or from the next argument
+static bool matchSeparateOption(int argc, char* argv[], int& i, const std::string& option, std::string& value) {
+    if (matchOption(argv[i], option, value)) return true;
+    if (argv[i] != option || i + 1 >= argc) return false;
+    value = argv[++i];
+    return true;
+}
+
+// The server stopped by SIGINT and SIGTERM
+static Server* server = nullptr;
+
+static void stopServer(int) {
+    if (server != nullptr) server->stop();
+}
+
+// Serves script runs over a socket until interrupted
+static int serve(const std::string& socketPath, unsigned jobs, const HeapConfig& heapConfig) {
+    Server instance(socketPath, jobs, heapConfig);
+    std::string error;
+    if (!instance.listen(error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    server = &instance;
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    instance.serve();
+    server = nullptr;
+    return 0;
+}
+
+// Runs a script on a server, passing its output through and exiting with its status
+static int runOnServer(const std::string& socketPath, const std::vector<std::string>& scripts) {
+    ServeRequest request;
+    if (scripts[0] == "-") {
+        request.source.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    } else {
+        // The server resolves paths from its own directory
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::absolute(scripts[0], error);
+        request.path = error ? scripts[0] : path.string();
+    }
+    request.arguments.assign(scripts.begin() + 1, scripts.end());
+    return Server::request(socketPath, request, [](std::string_view text) { std::cout << text << std::flush; },
+                           [](std::string_view text) { std::cerr << text << std::flush; });
+}
 
 int main(int argc, char* argv[]) {
     Lox lox;
+    HeapConfig heapConfig;
+    bool gcStats = false;
+    bool stream = false;
+    unsigned threads = 0;
+    std::string cacheDirectory = ScriptCache::defaultDirectory();
+    uint64_t cacheBytes = ScriptCache::DEFAULT_MAX_BYTES;
+    bool lazyFunctions = true;
+    std::string batch;
+    unsigned jobs = 0;
+    std::string serveSocket;
+    std::string clientSocket;
+    std::vector<std::string> scripts;
+
+    // Separate the options from the script paths
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        std::string value;
+        if (!clientSocket.empty() && !scripts.empty()) {
+            // Everything after the script is an argument to it
+            scripts.push_back(argument);
+        } else if (argument == "--gc-stats") {
+            gcStats = true;
+        } else if (argument == "--stream") {
+            stream = true;
+        } else if (matchOption(argument, "--heap-size", value) && parseSize(value) > 0) {
+            heapConfig.heapSize = parseSize(value);
+        } else if (matchOption(argument, "--nursery-size", value) && parseSize(value) > 0) {
+            heapConfig.nurserySize = parseSize(value);
+        } else if (matchOption(argument, "--max-heap", value) && parseSize(value) > 0) {
+            heapConfig.maxHeap = parseSize(value);
+        } else if (matchOption(argument, "--threads", value) && parseSize(value) > 0) {
+            threads = static_cast<unsigned>(parseSize(value));
+        } else if (matchOption(argument, "--cache-dir", value) && !value.empty()) {
+            cacheDirectory = value;
+        } else if (matchOption(argument, "--cache-size", value) && parseSize(value) > 0) {
+            cacheBytes = parseSize(value);
+        } else if (argument == "--no-cache") {
+            cacheDirectory.clear();
+        } else if (argument == "--eager") {
+            lazyFunctions = false;
+        } else if (matchSeparateOption(argc, argv, i, "--batch", value) && !value.empty()) {
+            batch = value;
+        } else if (matchSeparateOption(argc, argv, i, "--jobs", value) && parseSize(value) > 0) {
+            jobs = static_cast<unsigned>(parseSize(value));
+        } else if (matchSeparateOption(argc, argv, i, "--serve", value) && !value.empty()) {
+            serveSocket = value;
+        } else if (matchSeparateOption(argc, argv, i, "--client", value) && !value.empty()) {
+            clientSocket = value;
+        } else if (argument.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown or malformed option " << argument << std::endl;
+            return 1;
+        } else {
+            scripts.push_back(argument);
+        }
+    }
+    lox.configureHeap(heapConfig, gcStats);
+    lox.configureThreads(threads);
+    lox.configureCache(cacheDirectory, cacheBytes);
+    lox.configureParsing(lazyFunctions);
 
-    if (argc > 2) {
-        std::cerr << "Usage: cpplox [script]" << std::endl;
+    int modes = !batch.empty() + !serveSocket.empty() + !clientSocket.empty();
+    bool misused = modes > 1 || (modes == 1 && stream) || ((!batch.empty() || !serveSocket.empty()) && !scripts.empty())
+        || (!clientSocket.empty() && scripts.empty());
+    if ((scripts.size() > 1 && stream) || misused) {
+        // Only a single script can be streamed, a batch takes its scripts from the directory or list, and a server from its clients
+        std::cerr << "Usage: cpplox [--gc-stats] [--heap-size=N] [--nursery-size=N] [--max-heap=N] [--stream] [--threads=N] [--cache-dir=DIR] [--cache-size=N] [--no-cache] [--eager]"
+                  << " [script... | - | --batch DIR|LIST [--jobs N] | --serve SOCKET [--jobs N] | --client SOCKET script|- [argument...]]" << std::endl;
         return 1;
-    } else if (argc == 2) {
+    } else if (!serveSocket.empty()) {
+        // Run the scripts sent over the socket until interrupted
+        return serve(serveSocket, jobs, heapConfig);
+    } else if (!clientSocket.empty()) {
+        // Run the script on the server listening on the socket
+        return runOnServer(clientSocket, scripts);
+    } else if (!batch.empty()) {
+        // Run every script of the batch in an interpreter of its own
+        return lox.runBatch(batch, jobs);
+    } else if (scripts.size() > 1) {
+        // Run the files passed as arguments as one program
+        lox.runFiles(scripts);
+    } else if (scripts.size() == 1) {
         // Run file passed as argument
-        lox.runFile(argv[1]);
+        lox.runFile(scripts[0], stream);
     } else {
         // Run interactive prompt
         lox.runPrompt();
-    } 
+    }
     return 0;
-}
\ No newline at end of file
+}
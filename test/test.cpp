@@ -1,11 +1,28 @@
 #define BOOST_TEST_MODULE InterpreterTest
 #include <boost/test/included/unit_test.hpp>
+#include "Batch.hpp"
+#include "BatchRunner.hpp"
+#include "Repl.hpp"
+#include "LoxVM.hpp"
+#include "Scheduler.hpp"
+#include "Server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
+#include <malloc.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 
 // Function to trim leading and trailing whitespace
@@ -28,9 +45,19 @@ const std::string readFile(const std::string& path) {
     return buffer.str();
 }
 
-// Function to run a file
-const std::string runFile(const std::string& path) {
-    const std::string command = "./cpplox " + path + " > output.txt";
+// Parsed scripts are cached in the build directory rather than the user's cache
+const std::string CACHE_HOME = "XDG_CACHE_HOME=cache ";
+
+// Function to run a file, optionally passing command line options to the interpreter
+const std::string runFile(const std::string& path, const std::string& options = "") {
+    const std::string command = CACHE_HOME + "./cpplox " + (options.empty() ? "" : options + " ") + path + " > output.txt";
+    std::system(command.c_str());
+    return trimWhitespace(readFile("output.txt"));
+}
+
+// Function to run a file with the address space of the interpreter capped in kilobytes
+const std::string runFileWithMemoryLimit(const std::string& path, int limitKb) {
+    const std::string command = "ulimit -v " + std::to_string(limitKb) + "; " + CACHE_HOME + "./cpplox " + path + " > output.txt";
     std::system(command.c_str());
     return trimWhitespace(readFile("output.txt"));
 }
@@ -70,4 +97,885 @@ BOOST_AUTO_TEST_CASE(Test6) {
     std::string output = runFile("../test/lox_programs/test6.lox");
     std::string expectedOutput = readFile("../test/lox_programs/test6_expected.txt");
     BOOST_CHECK_EQUAL(output, expectedOutput);
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(Test7) {
+    // A million closures caught in reference cycles must be reclaimed to fit in 128 MB
+    std::string output = runFileWithMemoryLimit("../test/lox_programs/test7.lox", 128 * 1024);
+    std::string expectedOutput = readFile("../test/lox_programs/test7_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+}
+
+BOOST_AUTO_TEST_CASE(Test8) {
+    // A tiny nursery and old space force frequent minor and major collections
+    std::string output = runFile("../test/lox_programs/test8.lox", "--nursery-size=1K --heap-size=16K");
+    std::string expectedOutput = readFile("../test/lox_programs/test8_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+}
+
+BOOST_AUTO_TEST_CASE(Test9) {
+    std::string output = runFile("../test/lox_programs/test9.lox");
+    std::string expectedOutput = readFile("../test/lox_programs/test9_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+}
+
+BOOST_AUTO_TEST_CASE(Test10) {
+    // A runaway allocation loop is stopped with a runtime error once the live heap passes the limit
+    std::string output = runFile("../test/lox_programs/test10.lox", "--max-heap=1M");
+    std::string expectedOutput = readFile("../test/lox_programs/test10_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+}
+
+
+BOOST_AUTO_TEST_CASE(Test11) {
+    // Whitespace, comment, string and identifier runs longer than one SIMD block
+    std::string output = runFile("../test/lox_programs/test11.lox");
+    std::string expectedOutput = readFile("../test/lox_programs/test11_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+}
+
+
+BOOST_AUTO_TEST_CASE(Test12) {
+    // Streaming runs each declaration once parsed, functions outlive the text window they came from
+    std::string output = runFile("../test/lox_programs/test12.lox", "--stream");
+    std::string expectedOutput = readFile("../test/lox_programs/test12_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+
+    // Standard input is read as it arrives when streaming, and whole otherwise
+    BOOST_CHECK_EQUAL(runFile("- < ../test/lox_programs/test12.lox", "--stream"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("- < ../test/lox_programs/test12.lox"), expectedOutput);
+}
+
+
+BOOST_AUTO_TEST_CASE(Test13) {
+    // Scripts of 2 MB or more are scanned in chunks, which may start inside strings and comments
+    const int rows = 40000;
+    {
+        std::ofstream script("parallel.lox");
+        script << "var total = 0;\nvar row = \"\";\n";
+        for (int i = 0; i < rows; i++) {
+            script << "row = \"row " << i << "\n    continued on a second line\"; // " << i << "\n"
+                   << "/* block comment\n   spanning lines */ total = total + " << i << ";\n";
+        }
+        script << "print total;\nprint row;\n";
+    }
+    std::string output = runFile("parallel.lox", "--threads=4");
+    BOOST_CHECK_EQUAL(output, runFile("parallel.lox", "--threads=1"));
+    BOOST_CHECK_EQUAL(output, "799980000\nrow 39999\n    continued on a second line");
+
+    // Errors are reported with lines counted across the chunks
+    {
+        std::ofstream script("parallel.lox", std::ios::app);
+        script << "@\n";
+    }
+    BOOST_CHECK_EQUAL(runFile("parallel.lox", "--threads=4"), "[line " + std::to_string(4 * rows + 5) + "] Error: Unexpected character.");
+}
+
+
+BOOST_AUTO_TEST_CASE(Test14) {
+    // Several scripts run in order as one program
+    std::string output = runFile("../test/lox_programs/test14_lib.lox ../test/lox_programs/test14.lox");
+    std::string expectedOutput = readFile("../test/lox_programs/test14_expected.txt");
+    BOOST_CHECK_EQUAL(output, expectedOutput);
+
+    // Scripts of 128K tokens or more have their top-level declarations parsed in chunks
+    const int rows = 20000;
+    {
+        std::ofstream script("declarations.lox");
+        script << "var total = 0;\n";
+        for (int i = 0; i < rows; i++) {
+            script << "fun f" << i << "(a) { if (a > " << i % 10 << ") { return a; } else { return -a; } }\n"
+                   << "if (f" << i << "(" << i % 20 << ") > 0) total = total + 1; else total = total - 1;\n"
+                   << "for (var j = 0; j < 2; j = j + 1) { total = total + j; }\n";
+        }
+        script << "print total;\n";
+    }
+    output = runFile("declarations.lox", "--threads=4");
+    BOOST_CHECK_EQUAL(output, runFile("declarations.lox", "--threads=1"));
+    BOOST_CHECK_EQUAL(output, "20000");
+
+    // Errors are reported in file order, scanner errors before parser errors, and nothing runs
+    {
+        std::ofstream script("declarations.lox", std::ios::app);
+        script << "print total\n@\n";
+    }
+    output = runFile("declarations.lox ../test/lox_programs/test14_lib.lox declarations.lox", "--threads=4");
+    const std::string errors = "[line " + std::to_string(3 * rows + 4) + "] Error: Unexpected character.\n"
+                               "[line " + std::to_string(3 * rows + 5) + "] Error at end: Expect ';' after value.";
+    BOOST_CHECK_EQUAL(output, errors + "\n" + errors);
+}
+
+
+// Counts the cached images in a directory
+size_t countImages(const std::string& directory) {
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) count += entry.path().extension() == ".loxc";
+    return count;
+}
+
+BOOST_AUTO_TEST_CASE(Test15) {
+    // Unchanged scripts are loaded from their cached image, and run the same as when parsed
+    std::filesystem::remove_all("test15_cache");
+    std::filesystem::copy_file("../test/lox_programs/test15.lox", "cached.lox", std::filesystem::copy_options::overwrite_existing);
+    std::string expectedOutput = readFile("../test/lox_programs/test15_expected.txt");
+    BOOST_CHECK_EQUAL(runFile("cached.lox", "--cache-dir=test15_cache"), expectedOutput);
+    BOOST_CHECK_EQUAL(countImages("test15_cache"), 1);
+    BOOST_CHECK_EQUAL(runFile("cached.lox", "--cache-dir=test15_cache"), expectedOutput);
+
+    // A changed script gets an image of its own, with the lines of its tokens kept
+    {
+        std::ofstream script("cached.lox", std::ios::app);
+        script << "\nprint \"changed\";\nprint -\"not a number\";\n";
+    }
+    for (int run = 0; run < 2; run++) {
+        std::system((CACHE_HOME + "./cpplox --cache-dir=test15_cache cached.lox > output.txt 2>&1").c_str());
+        BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), expectedOutput + "\nchanged\nOperand must be a number.\n[line 30]");
+    }
+    BOOST_CHECK_EQUAL(countImages("test15_cache"), 2);
+
+    // Damaged images are ignored and replaced
+    for (const auto& entry : std::filesystem::directory_iterator("test15_cache")) {
+        std::fstream image(entry.path(), std::ios::in | std::ios::out | std::ios::binary);
+        image.seekp(60);
+        image.write("damaged", 7);
+    }
+    std::filesystem::copy_file("../test/lox_programs/test15.lox", "cached.lox", std::filesystem::copy_options::overwrite_existing);
+    BOOST_CHECK_EQUAL(runFile("cached.lox", "--cache-dir=test15_cache"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("cached.lox", "--cache-dir=test15_cache"), expectedOutput);
+
+    // Scripts with syntax errors are not cached
+    {
+        std::ofstream script("cached.lox", std::ios::app);
+        script << "print ;\n";
+    }
+    runFile("cached.lox", "--cache-dir=test15_cache");
+    BOOST_CHECK_EQUAL(countImages("test15_cache"), 2);
+
+    // Past the size limit the image used least recently is removed, and loading an image counts as a use
+    std::filesystem::remove_all("test15_lru");
+    auto images = [] {
+        std::set<std::string> names;
+        for (const auto& entry : std::filesystem::directory_iterator("test15_lru")) names.insert(entry.path().filename().string());
+        return names;
+    };
+    for (char name : std::string("abc")) std::ofstream(std::string(1, name) + ".lox") << "print \"" << name << "\";\n";
+    runFile("a.lox", "--cache-dir=test15_lru");
+    std::set<std::string> first = images();
+    uintmax_t imageSize = std::filesystem::file_size("test15_lru/" + *first.begin());
+    const std::string limited = "--cache-dir=test15_lru --cache-size=" + std::to_string(imageSize * 5 / 2);
+    runFile("b.lox", limited);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    BOOST_CHECK_EQUAL(runFile("a.lox", limited), "a");
+    BOOST_CHECK_EQUAL(runFile("c.lox", limited), "c");
+    std::set<std::string> kept = images();
+    BOOST_CHECK_EQUAL(kept.size(), 2u);
+    BOOST_CHECK(kept.count(*first.begin()) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(Test16) {
+    // Function bodies parsed on first call run the same as bodies parsed when declared
+    std::string expectedOutput = readFile("../test/lox_programs/test16_expected.txt");
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test16.lox"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test16.lox", "--eager"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test16.lox", "--stream"), expectedOutput);
+
+    // Runtime errors in a body parsed late report the line in the script
+    {
+        std::ofstream script("lazy.lox");
+        script << "fun later(a) {\n    print \"called\";\n\n    return -a;\n}\nprint \"start\";\nlater(\"text\");\n";
+    }
+    std::system((CACHE_HOME + "./cpplox lazy.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "start\ncalled\nOperand must be a number.\n[line 4]");
+
+    // Syntax errors in bodies never called are still reported, and nothing runs
+    {
+        std::ofstream script("lazy.lox");
+        script << "print \"start\";\n"
+               << "fun broken() {\n    var a = 1\n    print a;\n}\n"
+               << "fun nested() {\n    fun inner() {\n        (a) = 2;\n    }\n    return inner;\n}\n"
+               << "fun tooMany() {\n    fun many(";
+        for (int i = 0; i < 256; i++) script << (i > 0 ? ", " : "") << "p" << i;
+        script << ") {}\n}\n";
+    }
+    const std::string errors = "[line 4] Error at 'print': Expect ';' after variable declaration.\n"
+                               "[line 8] Error at '=': Invalid assignment target.\n"
+                               "[line 13] Error at 'p255': Cannot have more than 255 parameters.";
+    BOOST_CHECK_EQUAL(runFile("lazy.lox"), errors);
+    BOOST_CHECK_EQUAL(runFile("lazy.lox", "--eager"), errors);
+}
+
+BOOST_AUTO_TEST_CASE(Test17) {
+    // One compiled program runs at once in 64 isolates, each with its own globals, output and errors
+    HeapConfig config;
+    config.nurserySize = 64 * 1024;
+    LoxVM vm(config);
+    std::shared_ptr<const Program> shared = vm.compile(
+        "fun makeCounter(start) {\n"
+        "    var count = start;\n"
+        "    fun next() { count = count + 1; return count; }\n"
+        "    return next;\n"
+        "}\n"
+        "fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+        "var counter = makeCounter(id * 100);\n"
+        "var text = \"\";\n"
+        "for (var i = 0; i < 200; i = i + 1) { counter(); text = text + \"ab\"; }\n"
+        "print counter();\n"
+        "print fib(12) + id;\n"
+        "print text == text + \"\";\n");
+    std::shared_ptr<const Program> failing = vm.compile("print -\"text\";");
+    std::shared_ptr<const Program> broken = vm.compile("print 1 +;");
+    BOOST_CHECK(!shared->hadError());
+    BOOST_CHECK_EQUAL(broken->getErrors(), "[line 1] Error at ';': Expect expression.\n");
+
+    struct Result {
+        std::string output;
+        std::string errors;
+        std::vector<RunStatus> statuses;
+    };
+    const int isolates = 64;
+    std::vector<Result> results(isolates);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < isolates; id++) {
+        threads.emplace_back([&, id] {
+            Result& result = results[id];
+            std::unique_ptr<Isolate> isolate = vm.createIsolate();
+            isolate->setOutput([&](std::string_view text) { result.output.append(text).append("\n"); });
+            isolate->setErrors([&](std::string_view text) { result.errors.append(text).append("\n"); });
+            result.statuses.push_back(isolate->run(vm.compile("var id = " + std::to_string(id) + ";")));
+            result.statuses.push_back(isolate->run(shared));
+            if (id % 2 == 1) result.statuses.push_back(isolate->run(failing));
+            if (id % 4 == 3) result.statuses.push_back(isolate->run(broken));
+            result.statuses.push_back(isolate->run(vm.compile("print counter();")));
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    for (int id = 0; id < isolates; id++) {
+        const Result& result = results[id];
+        std::string expected = std::to_string(id * 100 + 201) + "\n" + std::to_string(144 + id) + "\ntrue\n"
+                               + std::to_string(id * 100 + 202) + "\n";
+        BOOST_CHECK_EQUAL(result.output, expected);
+        std::vector<RunStatus> statuses = {RunStatus::OK, RunStatus::OK};
+        std::string errors;
+        if (id % 2 == 1) {
+            statuses.push_back(RunStatus::RUNTIME_ERROR);
+            errors += "Operand must be a number.\n[line 1]\n";
+        }
+        if (id % 4 == 3) {
+            statuses.push_back(RunStatus::COMPILE_ERROR);
+            errors += "[line 1] Error at ';': Expect expression.\n";
+        }
+        statuses.push_back(RunStatus::OK);
+        BOOST_CHECK_EQUAL(result.errors, errors);
+        BOOST_CHECK(result.statuses == statuses);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Test18) {
+    // Spawned functions see copies of what they capture, with one worker or several
+    std::string expectedOutput = readFile("../test/lox_programs/test18_expected.txt");
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test18.lox", "--threads=1"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test18.lox", "--threads=4"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test18.lox", "--stream"), expectedOutput);
+
+    // A runtime error in a task is reported by the join, at the line where it happened
+    {
+        std::ofstream script("tasks.lox");
+        script << "fun failing() {\n    var x = 1;\n    return x + \"a\";\n}\n"
+               << "var future = spawn(failing);\nprint \"before\";\njoin(future);\nprint \"after\";\n";
+    }
+    std::system((CACHE_HOME + "./cpplox tasks.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "before\nOperands must be two numbers or two strings.\n[line 3]");
+
+    // Only futures can be joined, and only functions taking no arguments spawned
+    {
+        std::ofstream script("tasks.lox");
+        script << "fun f(a) {}\nspawn(f);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox tasks.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Can only spawn functions taking no arguments.\n[line 2]");
+    {
+        std::ofstream script("tasks.lox");
+        script << "join(clock);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox tasks.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Can only join futures.\n[line 1]");
+}
+
+BOOST_AUTO_TEST_CASE(Test19) {
+    // Async functions interleave at their sleeps and awaits, streamed or not
+    std::string expectedOutput = readFile("../test/lox_programs/test19_expected.txt");
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test19.lox"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test19.lox", "--stream"), expectedOutput);
+
+    // A runtime error in an async function is reported by the await, at the line where it happened
+    {
+        std::ofstream script("async.lox");
+        script << "fun failing() {\n    sleep(1);\n    return 1 + \"a\";\n}\n"
+               << "var promise = async(failing);\nprint \"before\";\nawait(promise);\nprint \"after\";\n";
+    }
+    std::system((CACHE_HOME + "./cpplox async.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "before\nOperands must be two numbers or two strings.\n[line 3]");
+
+    // Functions waiting for each other are reported instead of hanging
+    {
+        std::ofstream script("async.lox");
+        script << "var promise;\nfun self() { return await(promise); }\npromise = async(self);\nawait(promise);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox async.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Every async function is waiting for another.\n[line 4]");
+
+    // Lines from a pipe are handed out while other functions run, then nil at the end
+    {
+        std::ofstream script("async.lox");
+        script << "fun reader() {\n    var line = readLineAsync(0);\n    while (line != nil) { print line; line = readLineAsync(0); }\n"
+               << "    return \"eof\";\n}\nprint await(async(reader));\n";
+    }
+    std::system((CACHE_HOME + "printf 'one\\ntwo' | ./cpplox async.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "one\ntwo\neof");
+    {
+        std::ofstream script("async.lox");
+        script << "readLineAsync(99);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox async.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Cannot read from file descriptor 99.\n[line 1]");
+
+    // A promise held by a global does not stop tasks and parallel loops that never name it
+    {
+        std::ofstream script("async.lox");
+        script << "fun fast() { return 1; }\nvar p = async(fast);\nprint await(p);\n"
+               << "fun work() { return 42; }\nprint join(spawn(work));\n"
+               << "fun square(i) { return i * i; }\nfun add(a, b) { return a + b; }\nprint parallelReduce(0, 10, square, add, 0);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox async.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "1\n42\n285");
+
+    // An isolate dropped with async functions waiting for each other unwinds them, freeing what their frames held
+    {
+        LoxVM vm;
+        std::shared_ptr<const Program> program = vm.compile(
+            "var promise;\nfun deep(n) { if (n == 0) return await(promise); return deep(n - 1); }\n"
+            "fun self() { return deep(100); }\npromise = async(self);\nawait(promise);\n");
+        auto run = [&] {
+            std::unique_ptr<Isolate> isolate = vm.createIsolate();
+            std::string errors;
+            isolate->setErrors([&](std::string_view text) { errors.append(text).append("\n"); });
+            BOOST_CHECK(isolate->run(program) == RunStatus::RUNTIME_ERROR);
+            BOOST_CHECK_EQUAL(errors, "Every async function is waiting for another.\n[line 5]\n");
+        };
+        run();
+        size_t before = mallinfo2().uordblks;
+        for (int i = 0; i < 50; i++) run();
+        BOOST_CHECK_LT(mallinfo2().uordblks, before + 64 * 1024);
+    }
+
+    // Promises belong to one interpreter and cannot be copied into a task
+    {
+        std::ofstream script("async.lox");
+        script << "fun f() { return 1; }\nvar promise = async(f);\nfun g() { return promise; }\nspawn(g);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox async.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Cannot copy <promise> to another thread.\n[line 4]");
+}
+
+BOOST_AUTO_TEST_CASE(Test20) {
+    // Parallel loops give the same results with one worker or several
+    std::string expectedOutput = readFile("../test/lox_programs/test20_expected.txt");
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test20.lox", "--threads=1"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test20.lox", "--threads=4"), expectedOutput);
+
+    // The error reported is the one the loop would meet first, at the line where it happened
+    {
+        std::ofstream script("parallel.lox");
+        script << "fun add(a, b) { return a + b; }\nfun check(i) {\n    if (i >= 300) return i + \"late\";\n"
+               << "    if (i >= 200) return i + \"early\";\n    return i;\n}\nprint parallelReduce(0, 1000, check, add, 0);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox --threads=4 parallel.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Operands must be two numbers or two strings.\n[line 4]");
+
+    // Bounds must be numbers, and the functions must take the right number of arguments
+    {
+        std::ofstream script("parallel.lox");
+        script << "fun f(i) { return i; }\nparallelFor(0, \"10\", f);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox parallel.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Range bounds must be finite numbers.\n[line 2]");
+    {
+        std::ofstream script("parallel.lox");
+        script << "fun f() { return 1; }\nparallelFor(0, 10, f);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox parallel.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Can only run functions taking one argument in parallel.\n[line 2]");
+    {
+        std::ofstream script("parallel.lox");
+        script << "fun f(i) { return i; }\nparallelReduce(0, 10, f, f, 0);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox parallel.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Can only reduce with functions taking two arguments.\n[line 2]");
+}
+
+BOOST_AUTO_TEST_CASE(Test21) {
+    // Channels connect tasks the same way with one worker or several
+    std::string expectedOutput = readFile("../test/lox_programs/test21_expected.txt");
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test21.lox", "--threads=1"), expectedOutput);
+    BOOST_CHECK_EQUAL(runFile("../test/lox_programs/test21.lox", "--threads=4"), expectedOutput);
+
+    // A sender waits once the channel is full, until a value is received
+    {
+        std::ofstream script("channels.lox");
+        script << "var ch = channel(2);\nfun producer() {\n    for (var i = 0; i < 4; i = i + 1) { send(ch, i); print \"sent \" + \"x\"; }\n}\n"
+               << "spawn(producer);\nsleep(100);\nprint \"receiving\";\nfor (var i = 0; i < 4; i = i + 1) recv(ch);\n";
+    }
+    for (const char* threads : {"--threads=1", "--threads=4"}) {
+        std::system((CACHE_HOME + "./cpplox " + threads + " channels.lox > output.txt 2>&1").c_str());
+        std::string output = trimWhitespace(readFile("output.txt"));
+        std::string blocked = "sent x\nsent x\nreceiving";
+        BOOST_CHECK_EQUAL(output.substr(0, blocked.size()), blocked);
+        BOOST_CHECK_EQUAL(std::count(output.begin(), output.end(), '\n'), 4);
+    }
+
+    // Only channels can be sent to and received from, and capacities are whole and positive
+    {
+        std::ofstream script("channels.lox");
+        script << "var ch = channel(1);\nsend(clock, 1);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox channels.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Can only send to channels.\n[line 2]");
+    {
+        std::ofstream script("channels.lox");
+        script << "recv(1);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox channels.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Can only receive from channels.\n[line 1]");
+    {
+        std::ofstream script("channels.lox");
+        script << "channel(0.5);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox channels.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Channel capacity must be an integer from 1 to 1048576.\n[line 1]");
+
+    // Receiving from an empty channel nothing else holds fails instead of waiting forever
+    {
+        std::ofstream script("channels.lox");
+        script << "var ch = channel(1);\nsend(ch, 1);\nprint recv(ch);\nrecv(ch);\n";
+    }
+    std::system((CACHE_HOME + "./cpplox channels.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "1\nNothing else can send to the channel.\n[line 4]");
+
+    // Promises stay with their interpreter
+    {
+        std::ofstream script("channels.lox");
+        script << "var ch = channel(1);\nfun f() {}\nsend(ch, async(f));\n";
+    }
+    std::system((CACHE_HOME + "./cpplox channels.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "Cannot copy <promise> to another thread.\n[line 3]");
+}
+
+BOOST_AUTO_TEST_CASE(Test22) {
+    // Hundreds of programs take turns on two threads and each prints what it would alone
+    HeapConfig config;
+    config.nurserySize = 64 * 1024;
+    LoxVM vm(config);
+    const std::string body =
+        "fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+        "var total = 0;\n"
+        "for (var i = 0; i < 100; i = i + 1) total = total + i;\n"
+        "print total + id;\n"
+        "print fib(10);\n"
+        "if (id == 3) print -\"text\";\n"
+        "fun task() { return fib(8); }\n"
+        "print join(spawn(task));\n";
+    std::shared_ptr<const Program> broken = vm.compile("print 1 +;");
+    const size_t programs = 200;
+    std::vector<std::string> outputs(programs);
+    std::vector<std::string> errors(programs);
+    std::vector<size_t> ids;
+    {
+        Scheduler scheduler(2, 50, config);
+        for (size_t id = 0; id < programs; id++) {
+            std::shared_ptr<const Program> run = id == 5 ? broken : vm.compile("var id = " + std::to_string(id) + ";\n" + body);
+            ids.push_back(scheduler.start(run, [&, id](std::string_view text) { outputs[id].append(text).append("\n"); },
+                                          [&, id](std::string_view text) { errors[id].append(text).append("\n"); }));
+        }
+        for (size_t id = 0; id < programs; id++) {
+            RunStatus expected = id == 5 ? RunStatus::COMPILE_ERROR : id == 3 ? RunStatus::RUNTIME_ERROR : RunStatus::OK;
+            BOOST_CHECK(scheduler.wait(ids[id]) == expected);
+        }
+        Scheduler::Stats stats = scheduler.getStats();
+        BOOST_CHECK_EQUAL(stats.started, programs);
+        BOOST_CHECK_EQUAL(stats.finished, programs);
+        BOOST_CHECK_GT(stats.preemptions, programs);
+        BOOST_CHECK_EQUAL(stats.slices, stats.preemptions + programs - 1);
+        BOOST_CHECK_GT(stats.p99SliceUs, 0);
+        BOOST_CHECK_LE(stats.p99SliceUs, stats.maxSliceUs);
+    }
+    for (size_t id = 0; id < programs; id++) {
+        if (id == 5) {
+            BOOST_CHECK_EQUAL(outputs[id], "");
+            BOOST_CHECK_EQUAL(errors[id], "[line 1] Error at ';': Expect expression.\n");
+        } else if (id == 3) {
+            BOOST_CHECK_EQUAL(outputs[id], "4953\n55\n");
+            BOOST_CHECK_EQUAL(errors[id], "Operand must be a number.\n[line 7]\n");
+        } else {
+            BOOST_CHECK_EQUAL(outputs[id], std::to_string(4950 + id) + "\n55\n21\n");
+            BOOST_CHECK_EQUAL(errors[id], "");
+        }
+    }
+
+    // On one thread a long loop gives way to the program started after it, which finishes first
+    std::string log;
+    {
+        Scheduler scheduler(1, 100);
+        Sink append = [&](std::string_view text) { log.append(text).append("\n"); };
+        scheduler.start(vm.compile("var x = 0;\nfor (var i = 0; i < 10000; i = i + 1) x = x + 1;\nprint \"long\";\n"), append, append);
+        scheduler.start(vm.compile("print \"short\";\n"), append, append);
+    }
+    BOOST_CHECK_EQUAL(log, "short\nlong\n");
+
+    // A coroutine destroyed while suspended runs the destructors of its frames, and nothing after its yield
+    struct Guard {
+        bool& ran;
+        ~Guard() {
+            ran = true;
+        }
+    };
+    bool unwound = false;
+    bool resumed = false;
+    Coroutine* suspended = nullptr;
+    {
+        Coroutine coroutine([&] {
+            Guard guard{unwound};
+            suspended->yield();
+            resumed = true;
+        });
+        suspended = &coroutine;
+        coroutine.resume();
+        BOOST_CHECK(!unwound);
+    }
+    BOOST_CHECK(unwound);
+    BOOST_CHECK(!resumed);
+}
+
+BOOST_AUTO_TEST_CASE(Test23) {
+    // A rule compiled once is evaluated against many inputs, on several threads sharing it
+    LoxVM vm;
+    std::shared_ptr<const Rule> rule = vm.compileRule("price * qty > limit and region == \"EU\"", {"price", "qty", "limit", "region"});
+    BOOST_CHECK(!rule->hadError());
+    std::vector<size_t> wrong(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < wrong.size(); t++) {
+        threads.emplace_back([&, t] {
+            std::unique_ptr<Evaluator> evaluator = vm.createEvaluator(rule);
+            for (size_t i = 0; i < 20000; i++) {
+                double price = static_cast<double>(i % 50);
+                double qty = static_cast<double>(t + 1);
+                bool eu = i % 3 != 0;
+                bool passes = evaluator->test({price, qty, 100, eu ? "EU" : "US"});
+                if (passes != (price * qty > 100 && eu)) wrong[t]++;
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    BOOST_CHECK(wrong == std::vector<size_t>(4, 0));
+
+    // A script gives the value it returns, or nil without a return
+    std::shared_ptr<const Rule> script = vm.compileRule(
+        "var total = price * qty;\nif (total > 10) return total - 10;\nif (total == 0) print \"empty\";\n", {"price", "qty"});
+    std::unique_ptr<Evaluator> evaluator = vm.createEvaluator(script);
+    std::string printed;
+    evaluator->setOutput([&](std::string_view text) { printed.append(text).append("\n"); });
+    BOOST_CHECK_EQUAL(evaluator->toString(evaluator->evaluate({3, 4})), "2");
+    BOOST_CHECK_EQUAL(evaluator->toString(evaluator->evaluate({1, 4})), "nil");
+    BOOST_CHECK(evaluator->evaluate({0, 4}).type == TokenType::NIL);
+    BOOST_CHECK_EQUAL(printed, "empty\n");
+
+    // Strings, booleans and nil are bound as Lox values
+    std::shared_ptr<const Rule> text = vm.compileRule("flag and name + \"!\"", {"flag", "name"});
+    evaluator = vm.createEvaluator(text);
+    BOOST_CHECK_EQUAL(evaluator->toString(evaluator->evaluate({true, std::string("hi")})), "hi!");
+    BOOST_CHECK_EQUAL(evaluator->toString(evaluator->evaluate({false, "hi"})), "false");
+    BOOST_CHECK_EQUAL(evaluator->toString(evaluator->evaluate({nullptr, "hi"})), "nil");
+
+    // Runtime errors are thrown at their line and leave the evaluator usable
+    evaluator = vm.createEvaluator(rule);
+    BOOST_CHECK_EXCEPTION(evaluator->evaluate({"a", 2, 3, "EU"}), std::runtime_error, [](const std::runtime_error& error) {
+        return std::string(error.what()) == "Operands must be numbers.";
+    });
+    BOOST_CHECK(evaluator->test({2, 3, 1, "EU"}));
+    BOOST_CHECK_THROW(evaluator->evaluate({1, 2}), std::invalid_argument);
+
+    // Syntax errors are kept by the rule, which cannot be evaluated
+    std::shared_ptr<const Rule> broken = vm.compileRule("price *", {"price"});
+    BOOST_CHECK_EQUAL(broken->getErrors(), "[line 1] Error at end: Expect expression.\n");
+    BOOST_CHECK_THROW(vm.createEvaluator(broken)->evaluate({1}), std::invalid_argument);
+    BOOST_CHECK_EQUAL(vm.compileRule("var x = 1", {})->getErrors(), "[line 1] Error at end: Expect ';' after variable declaration.\n");
+}
+
+// What the batch holds for a row, printed as the interpreter prints values
+static std::string batchRow(const BatchResult& result, size_t row) {
+    switch (result.kinds[row]) {
+        case BatchResult::Kind::NUMBER: {
+            std::ostringstream text;
+            text << result.numbers[row];
+            return text.str();
+        }
+        case BatchResult::Kind::BOOLEAN: return result.booleans[row] ? "true" : "false";
+        case BatchResult::Kind::STRING:
+        case BatchResult::Kind::FUNCTION: return result.strings[row];
+        default: return "nil";
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Test24) {
+    // Rules evaluated over columns give, with every kernel set, what the interpreter gives row by row
+    LoxVM vm;
+    size_t rows = 2500;
+    std::vector<double> price(rows), qty(rows);
+    std::vector<std::string> region(rows);
+    std::unique_ptr<bool[]> flag(new bool[rows]);
+    for (size_t i = 0; i < rows; i++) {
+        price[i] = i % 97 == 0 ? std::nan("") : static_cast<double>(i % 50) - 10;
+        qty[i] = static_cast<double>(i % 7);
+        region[i] = i % 3 == 0 ? "US" : "EU";
+        flag[i] = i % 5 != 0;
+    }
+    std::vector<Column> columns = {price, qty, region, Column(flag.get())};
+    std::vector<std::string> inputs = {"price", "qty", "region", "flag"};
+    std::vector<std::string> sources = {
+        "price * qty > 100 and region == \"EU\"",
+        "-(price / qty) <= price - 1 or !flag",
+        "price != price or qty == 3",
+        "flag and region + \"-\" + region",
+        "(qty > 2 or nil) and (price >= 0 or \"negative\")",
+        "region == \"EU\" or price",
+        "price == nil or 1 + 2 == 3",
+    };
+    for (const std::string& source : sources) {
+        std::shared_ptr<const Rule> rule = vm.compileRule(source, inputs);
+        Evaluator scalar(rule);
+        for (const BatchKernels* kernels : BatchKernels::available()) {
+            BatchEvaluator batch(rule);
+            batch.setKernels(*kernels);
+            BatchResult result = batch.evaluate(columns, rows);
+            size_t wrong = 0;
+            for (size_t i = 0; i < rows; i++) {
+                Value value = scalar.evaluate({price[i], qty[i], region[i], flag[i]});
+                if (batchRow(result, i) != scalar.toString(value)) wrong++;
+            }
+            BOOST_CHECK_MESSAGE(wrong == 0, source << " with " << kernels->name << ": " << wrong << " wrong rows");
+            BOOST_CHECK_EQUAL(batch.getScalarRows(), 0u);
+        }
+    }
+
+    // A chunk with a row the interpreter rejects falls back, and the first failing row's error is thrown
+    std::shared_ptr<const Rule> mixed = vm.compileRule("flag or qty + region", inputs);
+    BatchEvaluator batch(mixed);
+    BOOST_CHECK_EXCEPTION(batch.evaluate(columns, rows), std::runtime_error, [](const std::runtime_error& error) {
+        return std::string(error.what()) == "Operands must be two numbers or two strings.";
+    });
+    BOOST_CHECK_EQUAL(batch.getScalarRows(), 0u);
+
+    // Rules with calls fall back for every row and still give the interpreter's values
+    std::shared_ptr<const Rule> call = vm.compileRule("clock() >= 0 and qty", inputs);
+    BatchEvaluator calls(call);
+    BatchResult result = calls.evaluate(columns, rows);
+    BOOST_CHECK_EQUAL(calls.getScalarRows(), rows);
+    BOOST_CHECK_EQUAL(batchRow(result, 10), "3");
+    BOOST_CHECK_EQUAL(batchRow(BatchEvaluator(vm.compileRule("clock", {})).evaluate({}, 1), 0), "<native fn>");
+
+    // The columns must match the inputs
+    BOOST_CHECK_THROW(batch.evaluate({price}, rows), std::invalid_argument);
+    BOOST_CHECK_THROW(BatchEvaluator(vm.compileRule("price *", inputs)).evaluate(columns, rows), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(Test25) {
+    // A batch runs each script in an interpreter of its own, capturing what it prints and how it ended
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "cpplox-test-batch";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    for (int i = 0; i < 20; i++) {
+        // Every script declares the same global, which would clash if they shared a scope
+        std::ofstream(directory / ("ok" + std::to_string(i / 10) + std::to_string(i % 10) + ".lox"))
+            << "var x = " << i << ";\nfor (var j = 0; j < 100; j = j + 1) x = x + 1;\nprint x;\n";
+    }
+    std::ofstream(directory / "runtime.lox") << "print \"before\";\nprint nil + 1;\nprint \"after\";\n";
+    std::ofstream(directory / "syntax.lox") << "print ;\n";
+    std::ofstream(directory / "notes.txt") << "not a script\n";
+
+    std::vector<std::string> paths = BatchRunner::listScripts(directory.string());
+    BOOST_REQUIRE_EQUAL(paths.size(), 22u);
+    BOOST_CHECK_EQUAL(std::filesystem::path(paths[0]).filename().string(), "ok00.lox");
+    std::vector<ScriptResult> results = BatchRunner(4).run(paths);
+    for (int i = 0; i < 20; i++) {
+        BOOST_CHECK_EQUAL(results[i].status, 0);
+        BOOST_CHECK_EQUAL(results[i].output, std::to_string(i + 100) + "\n");
+        BOOST_CHECK(results[i].errors.empty());
+    }
+    BOOST_CHECK_EQUAL(results[20].status, 70);
+    BOOST_CHECK_EQUAL(results[20].output, "before\n");
+    BOOST_CHECK_EQUAL(results[20].errors, "Operands must be two numbers or two strings.\n[line 2]\n");
+    BOOST_CHECK_EQUAL(results[21].status, 65);
+    BOOST_CHECK_EQUAL(results[21].errors, "[line 1] Error at ';': Expect expression.\n");
+
+    // A list file names the scripts, skipping blank lines and comments, and a missing script fails alone
+    std::ofstream(directory / "list.txt") << "# nightly\n" << paths[3] << "\r\n\n" << (directory / "missing.lox").string() << "\n";
+    results = BatchRunner(2).run(BatchRunner::listScripts((directory / "list.txt").string()));
+    BOOST_REQUIRE_EQUAL(results.size(), 2u);
+    BOOST_CHECK_EQUAL(results[0].output, "103\n");
+    BOOST_CHECK_EQUAL(results[1].status, 1);
+    BOOST_CHECK(BatchRunner::listScripts((directory / "none").string()).empty());
+    std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(Test26) {
+    // A session keeps its globals and functions from one entry to the next
+    Repl repl;
+    std::string output, errors;
+    repl.setOutput([&](std::string_view text) { output.append(text).append("\n"); });
+    repl.setErrors([&](std::string_view text) { errors.append(text).append("\n"); });
+    BOOST_CHECK(!repl.feed("var base = 10;"));
+    BOOST_CHECK(repl.feed("fun add(n) {"));
+    BOOST_CHECK(repl.feed("  return base + n;"));
+    BOOST_CHECK(!repl.feed("}"));
+    BOOST_CHECK(!repl.feed("print add(1);"));
+    BOOST_CHECK(!repl.feed("base = 20; print add(1);"));
+    BOOST_CHECK_EQUAL(output, "11\n21\n");
+
+    // Strings and statements may span lines, and other syntax errors are reported at once
+    output.clear();
+    BOOST_CHECK(repl.feed("print \"two"));
+    BOOST_CHECK(!repl.feed("lines\";"));
+    BOOST_CHECK(!repl.feed("print 1 +;"));
+    BOOST_CHECK_EQUAL(output, "two\nlines\n");
+    BOOST_CHECK_EQUAL(errors, "[line 1] Error at ';': Expect expression.\n");
+
+    // Runtime errors leave the session usable, and incomplete input can be run to see its errors
+    errors.clear();
+    BOOST_CHECK(!repl.feed("print add(nil);"));
+    BOOST_CHECK_EQUAL(errors, "Operands must be two numbers or two strings.\n[line 2]\n");
+    BOOST_CHECK(repl.feed("print base"));
+    repl.flush();
+    BOOST_CHECK_EQUAL(errors, "Operands must be two numbers or two strings.\n[line 2]\n[line 1] Error at end: Expect ';' after value.\n");
+    output.clear();
+    BOOST_CHECK(!repl.feed("print base;"));
+    BOOST_CHECK_EQUAL(output, "20\n");
+
+    // Functions from many entries ago still run, their programs kept alive by the session
+    for (int i = 0; i < 200; i++) repl.feed("fun f" + std::to_string(i) + "() { return " + std::to_string(i) + "; }");
+    for (int i = 0; i < 5000; i++) repl.feed("var junk = \"" + std::to_string(i) + "\" + \"x\";");
+    output.clear();
+    repl.feed("print f0() + f199();");
+    BOOST_CHECK_EQUAL(output, "199\n");
+}
+
+BOOST_AUTO_TEST_CASE(Test27) {
+    // A server runs scripts sent over its socket and streams back their output, errors and status
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "cpplox-test-serve";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::string socket = (directory / "lox.sock").string();
+    std::ofstream(directory / "greet.lox") << "print \"hello \" + arg0;\nprint argc;\n";
+    std::ofstream(directory / "fail.lox") << "print \"before\";\nprint nil + 1;\n";
+
+    Server server(socket, 2);
+    std::string error;
+    BOOST_REQUIRE(server.listen(error));
+    std::thread serving([&] { server.serve(); });
+
+    auto run = [&](const ServeRequest& request, std::string& output, std::string& errors) {
+        return Server::request(socket, request, [&](std::string_view text) { output.append(text); },
+                               [&](std::string_view text) { errors.append(text); });
+    };
+
+    // Clients at the same time each get their own script's output, the first run having compiled the script
+    std::string output, errorText;
+    BOOST_CHECK_EQUAL(run({(directory / "greet.lox").string(), "", {"first"}}, output, errorText), 0);
+    BOOST_CHECK_EQUAL(output, "hello first\n1\n");
+    std::vector<std::string> outputs(8), errors(8);
+    std::vector<int> statuses(8);
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        clients.emplace_back([&, i] {
+            statuses[i] = run({(directory / "greet.lox").string(), "", {"client" + std::to_string(i), "extra"}}, outputs[i], errors[i]);
+        });
+    }
+    for (std::thread& client : clients) client.join();
+    for (size_t i = 0; i < outputs.size(); i++) {
+        BOOST_CHECK_EQUAL(statuses[i], 0);
+        BOOST_CHECK_EQUAL(outputs[i], "hello client" + std::to_string(i) + "\n2\n");
+        BOOST_CHECK(errors[i].empty());
+    }
+
+    // Inline source, runtime and syntax errors and missing files give the statuses cpplox exits with
+    output.clear();
+    BOOST_CHECK_EQUAL(run({"", "var x = 40; print x + 2;", {}}, output, errorText), 0);
+    BOOST_CHECK_EQUAL(output, "42\n");
+    output.clear();
+    BOOST_CHECK_EQUAL(run({(directory / "fail.lox").string(), "", {}}, output, errorText), 70);
+    BOOST_CHECK_EQUAL(output, "before\n");
+    BOOST_CHECK_EQUAL(errorText, "Operands must be two numbers or two strings.\n[line 2]\n");
+    errorText.clear();
+    BOOST_CHECK_EQUAL(run({"", "print ;", {}}, output, errorText), 65);
+    BOOST_CHECK_EQUAL(errorText, "[line 1] Error at ';': Expect expression.\n");
+    errorText.clear();
+    BOOST_CHECK_EQUAL(run({(directory / "missing.lox").string(), "", {}}, output, errorText), 1);
+    BOOST_CHECK_EQUAL(errorText, "Could not open file " + (directory / "missing.lox").string() + "\n");
+
+    // The greeting was compiled once, however many clients sent it
+    Server::Stats stats = server.getStats();
+    BOOST_CHECK_EQUAL(stats.requests, 13u);
+    BOOST_CHECK_EQUAL(stats.cacheMisses, 4u);
+    BOOST_CHECK_EQUAL(stats.cacheHits, 8u);
+
+    // A client that never reads its reply holds the only worker for one timeout, then the next request runs
+    {
+        std::string slowSocket = (directory / "slow.sock").string();
+        Server slow(slowSocket, 1);
+        slow.setRequestTimeout(1);
+        BOOST_REQUIRE(slow.listen(error));
+        std::thread slowServing([&] { slow.serve(); });
+        int stalled = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, slowSocket.c_str(), slowSocket.size() + 1);
+        BOOST_REQUIRE_EQUAL(::connect(stalled, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        auto send = [&](char type, const std::string& payload) {
+            uint32_t length = static_cast<uint32_t>(payload.size());
+            std::string frame(1, type);
+            frame.append(reinterpret_cast<const char*>(&length), sizeof(length)).append(payload);
+            BOOST_REQUIRE_EQUAL(::send(stalled, frame.data(), frame.size(), 0), static_cast<ssize_t>(frame.size()));
+        };
+        send('S', "for (var i = 0; i < 100000; i = i + 1) print \"" + std::string(100, 'x') + "\";");
+        send('R', "");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        auto start = std::chrono::steady_clock::now();
+        output.clear();
+        BOOST_CHECK_EQUAL(Server::request(slowSocket, {"", "print 7;", {}}, [&](std::string_view text) { output.append(text); },
+                                          [&](std::string_view text) { errorText.append(text); }),
+                          0);
+        BOOST_CHECK_EQUAL(output, "7\n");
+        BOOST_CHECK_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 8.0);
+        ::close(stalled);
+        slow.stop();
+        slowServing.join();
+        BOOST_CHECK_EQUAL(slow.getStats().requests, 2u);
+    }
+
+    server.stop();
+    serving.join();
+    errorText.clear();
+    BOOST_CHECK_EQUAL(run({"", "print 1;", {}}, output, errorText), 1);
+    BOOST_CHECK_EQUAL(errorText, "Could not connect to " + socket + "\n");
+    std::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(Test28) {
+    // Numbers print with their trailing zeros trimmed, and without the point if nothing is left after it
+    {
+        std::ofstream script("numbers.lox");
+        script << "print 2.50;\nprint 100;\nprint 1.05;\nprint -0.5;\nprint 10 / 4;\n";
+    }
+    std::system((CACHE_HOME + "./cpplox numbers.lox > output.txt 2>&1").c_str());
+    BOOST_CHECK_EQUAL(trimWhitespace(readFile("output.txt")), "2.5\n100\n1.05\n-0.5\n2.5");
+}
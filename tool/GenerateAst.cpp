@@ -71,11 +71,11 @@ void defineType(std::ofstream& file, const std::string& baseName, const std::str
         std::vector<std::string> fieldTokens = split(fields[i], " ");
         std::string fieldType = fieldTokens[0];
         std::string fieldName = fieldTokens[1];
-        if (fieldType.find("std::unique") != std::string::npos) {
-            // Move the unique pointer
+        if (fieldType.find("std::") != std::string::npos) {
+            // Move pointers and vectors, the parameter is the parser's own copy
             file << fieldName << "(std::move(" << fieldName << "))";
         } else {
-            // Copy the shared pointer
+            // Copy tokens and types
             file << fieldName << "(" << fieldName << ")";
         }
         if (i != fields.size() - 1) {
@@ -93,7 +93,8 @@ void defineType(std::ofstream& file, const std::string& baseName, const std::str
     file << "\n";
 }
 
-void defineAst(const std::string& outputDir, const std::string& baseName, const std::vector<std::string>& types) {
+void defineAst(const std::string& outputDir, const std::string& baseName, const std::vector<std::string>& types,
+               const std::vector<std::string>& includes = {}) {
     std::string path = outputDir + "/" + baseName + ".hpp";
     std::ofstream file(path);
 
@@ -104,7 +105,11 @@ void defineAst(const std::string& outputDir, const std::string& baseName, const
 
     // Headers
     file << "#include <memory>\n";
+    file << "#include <vector>\n";
     file << "#include \"Token.hpp\"\n";
+    for (const std::string& include : includes) {
+        file << "#include \"" << include << "\"\n";
+    }
     file << "\n";
 
     // Forward declarations
@@ -153,11 +158,11 @@ int main() {
     defineAst(outputDir, "Stmt", {
         "Block : std::vector<std::shared_ptr<Stmt>> statements",
         "Expression : std::unique_ptr<Expr> expression",
-        "Function : Token name, std::vector<Token> params, std::vector<std::shared_ptr<Stmt>> body",
+        "Function : Token name, std::vector<Token> params, std::shared_ptr<FunctionBody> body",
         "If : std::unique_ptr<Expr> condition, std::shared_ptr<Stmt> thenBranch, std::shared_ptr<Stmt> elseBranch",
         "Print : std::unique_ptr<Expr> expression",
         "Return : Token keyword, std::unique_ptr<Expr> value",
         "Var : Token name, std::unique_ptr<Expr> initializer",
         "While : std::unique_ptr<Expr> condition, std::shared_ptr<Stmt> body"
-    });
+    }, {"FunctionBody.hpp"});
 }
\ No newline at end of file